@@ -0,0 +1,35 @@
+#include "AnimationClip.h"
+#include <stdexcept>
+#include <cmath>
+
+using namespace DirectX;
+
+void AnimationClip::AddTrack(unsigned int target, Channel path, const std::vector<float>& times, const std::vector<XMFLOAT4>& values)
+{
+	if (times.empty() || times.size() != values.size())
+		throw std::invalid_argument("Error adding animation track: Every key needs a time and a value");
+	for (size_t k = 1; k < times.size(); k++)
+	{
+		if (!(times[k] >= times[k - 1]))
+			throw std::invalid_argument("Error adding animation track: Key times must not go backwards");
+	}
+
+	Track track = {};
+	track.Target = target;
+	track.Path = path;
+	track.KeyStart = (unsigned int)Times.size();
+	track.KeyCount = (unsigned int)times.size();
+	Tracks.push_back(track);
+
+	Times.insert(Times.end(), times.begin(), times.end());
+	Values.insert(Values.end(), values.begin(), values.end());
+	Duration = fmaxf(Duration, times.back());
+}
+
+unsigned int AnimationClip::GetTargetCount() const
+{
+	unsigned int count = 0;
+	for (const Track& track : Tracks)
+		count = track.Target + 1 > count ? track.Target + 1 : count;
+	return count;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <DirectXMath.h>
+
+// --------------------------------------------------------
+// Keyframed position, rotation and scale tracks, each
+// animating one target (an index the clip's player maps
+// to a transform, see AnimationSampler)
+//
+// - Every track's keys live in two arrays shared by the
+//   whole clip (times, and values as four floats each),
+//   with each track owning one contiguous range, so a clip
+//   is three allocations however many tracks it has
+// - Values are local to the target's parent, like Transform's
+//   own, and rotations are quaternions
+// - Between keys, positions and scales are interpolated
+//   linearly and rotations with a normalized lerp, and
+//   before the first or after the last key they hold
+// --------------------------------------------------------
+struct AnimationClip
+{
+	enum class Channel
+	{
+		Position,
+		Rotation,
+		Scale
+	};
+
+	struct Track
+	{
+		unsigned int Target;
+		Channel Path;
+		unsigned int KeyStart;	// Into Times and Values
+		unsigned int KeyCount;
+	};
+
+	std::string Name;
+	float Duration = 0.0f;	// Seconds, at least the last key's time
+	std::vector<Track> Tracks;
+	std::vector<float> Times;
+	std::vector<DirectX::XMFLOAT4> Values;	// w is unused for positions and scales
+
+	// Appends a track, extending the duration to its last key
+	// - Throws std::invalid_argument without keys, with a different
+	//   number of times and values, or with times that go backwards
+	void AddTrack(unsigned int target, Channel path, const std::vector<float>& times, const std::vector<DirectX::XMFLOAT4>& values);
+
+	// The highest target any track uses, plus one
+	unsigned int GetTargetCount() const;
+};
@@ -0,0 +1,225 @@
+#include "AnimationSampler.h"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <cmath>
+
+using namespace DirectX;
+
+AnimationSampler::AnimationSampler(std::shared_ptr<TransformPool> pool) :
+	pool(pool),
+	searchCount(0),
+	sampleTime(0.0)
+{
+}
+
+unsigned int AnimationSampler::Play(std::shared_ptr<AnimationClip> clip, const std::vector<unsigned int>& targetSlots,
+	float startTime, float speed, bool loop)
+{
+	if (!clip || targetSlots.size() < clip->GetTargetCount())
+		throw std::invalid_argument("Error playing animation: Every target in the clip needs a transform");
+
+	unsigned int index = (unsigned int)instances.size();
+	Instance instance = {};
+	instance.Clip = clip;
+	instance.Time = startTime;
+	instance.Speed = speed;
+	instance.Loop = loop;
+	instances.push_back(instance);
+	sampleTimes.push_back(startTime);
+
+	for (const AnimationClip::Track& track : clip->Tracks)
+	{
+		Binding binding = {};
+		binding.Times = &clip->Times[track.KeyStart];
+		binding.Values = &clip->Values[track.KeyStart];
+		binding.KeyCount = track.KeyCount;
+		binding.Key = 0;
+		binding.Slot = targetSlots[track.Target];
+		binding.Instance = index;
+		bindings[(int)track.Path].push_back(binding);
+	}
+	return index;
+}
+
+// Looping clips wrap here too, so their times never grow large
+// enough to lose precision
+void AnimationSampler::Advance(float deltaTime)
+{
+	for (Instance& instance : instances)
+	{
+		instance.Time += deltaTime * instance.Speed;
+		float duration = instance.Clip->Duration;
+		if (instance.Loop && duration > 0.0f)
+		{
+			instance.Time = fmodf(instance.Time, duration);
+			if (instance.Time < 0.0f)
+				instance.Time += duration;
+		}
+	}
+}
+
+void AnimationSampler::Sample(float extraTime)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	searchCount = 0;
+
+	for (size_t i = 0; i < instances.size(); i++)
+	{
+		const Instance& instance = instances[i];
+		float time = instance.Time + extraTime * instance.Speed;
+		float duration = instance.Clip->Duration;
+		if (instance.Loop && duration > 0.0f)
+		{
+			time = fmodf(time, duration);
+			if (time < 0.0f)
+				time += duration;
+		}
+		sampleTimes[i] = time;
+	}
+
+	SampleChannel(AnimationClip::Channel::Position);
+	SampleChannel(AnimationClip::Channel::Rotation);
+	SampleChannel(AnimationClip::Channel::Scale);
+	sampleTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+AnimationSampler::Stats AnimationSampler::GetStats()
+{
+	Stats stats = {};
+	stats.InstanceCount = (unsigned int)instances.size();
+	for (const std::vector<Binding>& list : bindings)
+		stats.TrackCount += (unsigned int)list.size();
+	stats.SearchCount = searchCount;
+	stats.SampleTime = sampleTime;
+	return stats;
+}
+
+bool AnimationSampler::IsAnimated(unsigned int slot, AnimationClip::Channel channel) const
+{
+	for (const Binding& binding : bindings[(int)channel])
+	{
+		if (binding.Slot == slot)
+			return true;
+	}
+	return false;
+}
+
+// --------------------------------------------------------
+// Four tracks at a time: each lane's two keys are found and
+// loaded, the four are transposed so each vector holds one
+// component of every track, and then everything else is
+// done for all of them at once
+// - The last group is padded by repeating its first track
+// --------------------------------------------------------
+void AnimationSampler::SampleChannel(AnimationClip::Channel channel)
+{
+	std::vector<Binding>& list = bindings[(int)channel];
+	bool rotation = channel == AnimationClip::Channel::Rotation;
+	for (size_t first = 0; first < list.size(); first += 4)
+	{
+		unsigned int count = list.size() - first < 4 ? (unsigned int)(list.size() - first) : 4;
+		XMMATRIX from, to;
+		XMFLOAT4 amounts;
+		float* amount = &amounts.x;
+		for (unsigned int lane = 0; lane < 4; lane++)
+		{
+			if (lane >= count)
+			{
+				from.r[lane] = from.r[0];
+				to.r[lane] = to.r[0];
+				amount[lane] = amount[0];
+				continue;
+			}
+
+			Binding& binding = list[first + lane];
+			amount[lane] = FindKey(binding, sampleTimes[binding.Instance]);
+			unsigned int next = binding.Key + 1 < binding.KeyCount ? binding.Key + 1 : binding.Key;
+			from.r[lane] = XMLoadFloat4(&binding.Values[binding.Key]);
+			to.r[lane] = XMLoadFloat4(&binding.Values[next]);
+		}
+		from = XMMatrixTranspose(from);
+		to = XMMatrixTranspose(to);
+		XMVECTOR t = XMLoadFloat4(&amounts);
+
+		// A quaternion and its negation are the same rotation, so
+		// each blends toward whichever of the two is closer
+		if (rotation)
+		{
+			XMVECTOR dot = XMVectorMultiply(from.r[0], to.r[0]);
+			for (int c = 1; c < 4; c++)
+				dot = XMVectorMultiplyAdd(from.r[c], to.r[c], dot);
+			XMVECTOR flip = XMVectorLess(dot, XMVectorZero());
+			for (int c = 0; c < 4; c++)
+				to.r[c] = XMVectorSelect(to.r[c], XMVectorNegate(to.r[c]), flip);
+		}
+
+		XMMATRIX result;
+		for (int c = 0; c < 4; c++)
+			result.r[c] = XMVectorMultiplyAdd(XMVectorSubtract(to.r[c], from.r[c]), t, from.r[c]);
+
+		if (rotation)
+		{
+			XMVECTOR lengthSquared = XMVectorMultiply(result.r[0], result.r[0]);
+			for (int c = 1; c < 4; c++)
+				lengthSquared = XMVectorMultiplyAdd(result.r[c], result.r[c], lengthSquared);
+			XMVECTOR inverseLength = XMVectorReciprocalSqrt(lengthSquared);
+			for (int c = 0; c < 4; c++)
+				result.r[c] = XMVectorMultiply(result.r[c], inverseLength);
+		}
+		result = XMMatrixTranspose(result);
+
+		for (unsigned int lane = 0; lane < count; lane++)
+		{
+			unsigned int slot = list[first + lane].Slot;
+			XMFLOAT4 value;
+			XMStoreFloat4(&value, result.r[lane]);
+			switch (channel)
+			{
+			case AnimationClip::Channel::Position: pool->SetPosition(slot, XMFLOAT3(value.x, value.y, value.z)); break;
+			case AnimationClip::Channel::Rotation: pool->SetRotation(slot, value); break;
+			case AnimationClip::Channel::Scale: pool->SetScale(slot, XMFLOAT3(value.x, value.y, value.z)); break;
+			}
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Leaves the binding's Key at the key before the time, and
+// returns how far the time is toward the key after it
+// - Starts from last time's key, and only searches when the
+//   time is before it or more than one key past it
+// - Before the first key or after the last, the value holds
+// --------------------------------------------------------
+float AnimationSampler::FindKey(Binding& binding, float time)
+{
+	const float* times = binding.Times;
+	unsigned int last = binding.KeyCount - 1;
+	if (time <= times[0])
+	{
+		binding.Key = 0;
+		return 0.0f;
+	}
+	if (time >= times[last])
+	{
+		binding.Key = last;
+		return 0.0f;
+	}
+
+	// From here on the time is strictly between the first and last
+	// keys, so there's always a key after the one found
+	unsigned int key = binding.Key;
+	if (times[key] > time || (key + 2 <= last && times[key + 2] <= time))
+	{
+		key = (unsigned int)(std::upper_bound(times, times + last + 1, time) - times) - 1;
+		searchCount++;
+	}
+	else if (times[key + 1] <= time)
+	{
+		key++;
+	}
+	binding.Key = key;
+
+	float span = times[key + 1] - times[key];
+	return span > 0.0f ? (time - times[key]) / span : 0.0f;
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include "AnimationClip.h"
+#include "TransformPool.h"
+
+// --------------------------------------------------------
+// Plays animation clips on slots of a TransformPool, and
+// samples every playing track at once
+//
+// - Tracks are sorted into one list per channel when a clip
+//   starts, and each list is sampled four tracks at a time,
+//   one SIMD lane per track (the keys on either side are
+//   gathered and transposed so the blend, and for rotations
+//   the normalization, are done for all four together)
+// - Each track remembers which keys it was between last
+//   time, so playing forward only ever moves a key or two
+//   ahead: finding the keys is O(1) per track per frame,
+//   and only a jump backwards (like looping) searches
+// - Results go straight into the pool, marking the slots
+//   dirty for its next Update()
+// - Time advances separately from sampling, so the clock
+//   can run in fixed steps while sampling happens every
+//   frame, a little ahead (see Sample())
+// - Clips shouldn't change once they're playing, as tracks
+//   point into their key arrays
+// --------------------------------------------------------
+class AnimationSampler
+{
+public:
+	struct Stats
+	{
+		unsigned int InstanceCount;	// Clips playing
+		unsigned int TrackCount;	// Tracks sampled each time
+		unsigned int SearchCount;	// Tracks that had to search for their keys last time
+		double SampleTime;			// Milliseconds the last Sample() took
+	};
+
+	AnimationSampler(std::shared_ptr<TransformPool> pool = TransformPool::GetShared());
+
+	// Starts a clip, with targetSlots mapping each of the clip's
+	// targets to a slot of the pool (returns the instance's index)
+	// - Throws std::invalid_argument if there are fewer slots than
+	//   the clip has targets
+	unsigned int Play(std::shared_ptr<AnimationClip> clip, const std::vector<unsigned int>& targetSlots,
+		float startTime = 0.0f, float speed = 1.0f, bool loop = true);
+
+	// Moves every clip's time along
+	void Advance(float deltaTime);
+
+	// Writes every track's value, each at its clip's time plus
+	// extraTime (like the part of a fixed step that's passed since
+	// the last one, so what's drawn doesn't stutter)
+	void Sample(float extraTime = 0.0f);
+
+	Stats GetStats();
+
+	// Whether a playing track writes this part of the slot (so any
+	// other change to it is overwritten by the next Sample())
+	bool IsAnimated(unsigned int slot, AnimationClip::Channel channel) const;
+
+private:
+	struct Instance
+	{
+		std::shared_ptr<AnimationClip> Clip;
+		float Time;
+		float Speed;
+		bool Loop;
+	};
+
+	// One track, bound to its pool slot
+	struct Binding
+	{
+		const float* Times;
+		const DirectX::XMFLOAT4* Values;
+		unsigned int KeyCount;
+		unsigned int Key;		// The key before the last sample's time
+		unsigned int Slot;
+		unsigned int Instance;
+	};
+
+	std::shared_ptr<TransformPool> pool;
+	std::vector<Instance> instances;
+	std::vector<float> sampleTimes;		// Per instance, for the current Sample()
+	std::vector<Binding> bindings[3];	// One list per AnimationClip::Channel
+	unsigned int searchCount;
+	double sampleTime;
+
+	void SampleChannel(AnimationClip::Channel channel);
+	float FindKey(Binding& binding, float time);
+};
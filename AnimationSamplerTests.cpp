@@ -0,0 +1,257 @@
+#include "Tests.h"
+#include "AnimationSampler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	// --------------------------------------------------------
+	// A track's value at a time, the slow way: a binary search
+	// for the keys, then a lerp (normalized, and toward the
+	// nearer sign, for rotations)
+	// --------------------------------------------------------
+	XMFLOAT4 SampleTrack(const AnimationClip& clip, const AnimationClip::Track& track, float time)
+	{
+		const float* times = &clip.Times[track.KeyStart];
+		const XMFLOAT4* values = &clip.Values[track.KeyStart];
+		unsigned int last = track.KeyCount - 1;
+		if (time <= times[0])
+			return values[0];
+		if (time >= times[last])
+			return values[last];
+
+		unsigned int key = (unsigned int)(std::upper_bound(times, times + last + 1, time) - times) - 1;
+		float span = times[key + 1] - times[key];
+		float amount = span > 0.0f ? (time - times[key]) / span : 0.0f;
+		XMVECTOR from = XMLoadFloat4(&values[key]);
+		XMVECTOR to = XMLoadFloat4(&values[key + 1]);
+		XMFLOAT4 result;
+		if (track.Path == AnimationClip::Channel::Rotation)
+		{
+			if (XMVectorGetX(XMVector4Dot(from, to)) < 0.0f)
+				to = XMVectorNegate(to);
+			XMStoreFloat4(&result, XMQuaternionNormalize(XMVectorLerp(from, to, amount)));
+		}
+		else
+		{
+			XMStoreFloat4(&result, XMVectorLerp(from, to, amount));
+		}
+		return result;
+	}
+
+	bool Near(XMFLOAT3 a, XMFLOAT4 b, float tolerance)
+	{
+		return Tests::Near(a.x, b.x, tolerance) && Tests::Near(a.y, b.y, tolerance) && Tests::Near(a.z, b.z, tolerance);
+	}
+
+	// The same rotation, whichever sign each quaternion has
+	bool SameRotation(XMFLOAT4 a, XMFLOAT4 b, float tolerance)
+	{
+		return fabsf(XMVectorGetX(XMVector4Dot(XMLoadFloat4(&a), XMLoadFloat4(&b)))) > 1.0f - tolerance;
+	}
+
+	// --------------------------------------------------------
+	// Two targets: the first with irregularly spaced position
+	// and rotation keys (the rotations often changing sign) and
+	// a single held scale key, the second with rotations that
+	// only start part way in
+	// --------------------------------------------------------
+	std::shared_ptr<AnimationClip> MakeClip(std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> value(-2.0f, 2.0f);
+		std::uniform_real_distribution<float> spacing(0.05f, 0.3f);
+		std::shared_ptr<AnimationClip> clip = std::make_shared<AnimationClip>();
+
+		std::vector<float> times;
+		std::vector<XMFLOAT4> positions, rotations;
+		float time = 0.0f;
+		for (int k = 0; k < 13; k++)
+		{
+			times.push_back(time);
+			time += spacing(random);
+			positions.push_back(XMFLOAT4(value(random), value(random), value(random), 0));
+			XMVECTOR rotation = XMQuaternionRotationRollPitchYaw(value(random), value(random), value(random));
+			XMStoreFloat4(&rotations.emplace_back(), (random() % 2) ? rotation : XMVectorNegate(rotation));
+		}
+		clip->AddTrack(0, AnimationClip::Channel::Position, times, positions);
+		clip->AddTrack(0, AnimationClip::Channel::Rotation, times, rotations);
+		clip->AddTrack(0, AnimationClip::Channel::Scale, { 0.5f }, { XMFLOAT4(2, 3, 4, 0) });
+
+		std::vector<float> laterTimes(times.begin() + 5, times.end());
+		std::vector<XMFLOAT4> laterRotations(rotations.begin() + 5, rotations.end());
+		clip->AddTrack(1, AnimationClip::Channel::Rotation, laterTimes, laterRotations);
+		return clip;
+	}
+
+	// --------------------------------------------------------
+	// Milliseconds a frame (at 60 per second) to advance and
+	// sample this many transforms, each playing a loop around
+	// a circle, a full turn and a pulse from a different point,
+	// with only the sampler's work timed
+	// --------------------------------------------------------
+	double MillisecondsPerFrame(unsigned int transformCount)
+	{
+		std::shared_ptr<AnimationClip> clip = std::make_shared<AnimationClip>();
+		std::vector<float> times;
+		std::vector<XMFLOAT4> positions, rotations, scales;
+		for (int k = 0; k <= 32; k++)
+		{
+			float angle = XM_2PI * k / 32;
+			times.push_back(2.0f * k / 32);
+			positions.push_back(XMFLOAT4(cosf(angle), sinf(angle * 2.0f) * 0.5f, sinf(angle), 0));
+			XMStoreFloat4(&rotations.emplace_back(), XMQuaternionRotationRollPitchYaw(0, angle, 0));
+			scales.push_back(XMFLOAT4(1.0f + 0.25f * sinf(angle), 1, 1, 0));
+		}
+		clip->AddTrack(0, AnimationClip::Channel::Position, times, positions);
+		clip->AddTrack(0, AnimationClip::Channel::Rotation, times, rotations);
+		clip->AddTrack(0, AnimationClip::Channel::Scale, times, scales);
+
+		std::shared_ptr<TransformPool> pool = std::make_shared<TransformPool>();
+		AnimationSampler sampler(pool);
+		for (unsigned int i = 0; i < transformCount; i++)
+			sampler.Play(clip, { pool->Allocate() }, clip->Duration * i / transformCount);
+		sampler.Sample();
+
+		unsigned int frames = 0;
+		double milliseconds = 0.0;
+		while (frames < 3 || milliseconds < 100.0)
+		{
+			auto start = std::chrono::steady_clock::now();
+			sampler.Advance(1.0f / 60.0f);
+			sampler.Sample();
+			milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			pool->Update();
+			frames++;
+		}
+		return milliseconds / frames;
+	}
+}
+
+// --------------------------------------------------------
+// 103 clips (so the last group of four is partly padding)
+// at different start times and speeds, some backwards and
+// some not looping, matched against sampling each track
+// on its own every frame
+// --------------------------------------------------------
+TEST(AnimationSamplerMatchesScalarSampling)
+{
+	std::mt19937 random(1);
+	std::shared_ptr<AnimationClip> clip = MakeClip(random);
+	std::shared_ptr<TransformPool> pool = std::make_shared<TransformPool>();
+	AnimationSampler sampler(pool);
+
+	struct Playing
+	{
+		float Time;
+		float Speed;
+		bool Loop;
+		unsigned int Slots[2];
+	};
+	std::vector<Playing> playing;
+	std::uniform_real_distribution<float> start(-0.5f, clip->Duration + 0.5f);
+	std::uniform_real_distribution<float> speed(-2.0f, 2.0f);
+	for (int i = 0; i < 103; i++)
+	{
+		Playing p = { start(random), speed(random), (i % 5) != 0, { pool->Allocate(), pool->Allocate() } };
+		sampler.Play(clip, { p.Slots[0], p.Slots[1] }, p.Time, p.Speed, p.Loop);
+		playing.push_back(p);
+	}
+	CHECK(sampler.GetStats().InstanceCount == 103);
+	CHECK(sampler.GetStats().TrackCount == 103 * 4);
+
+	// The second target only has a rotation track, and slots no clip
+	// plays on aren't animated at all (what the entity UI locks)
+	unsigned int idle = pool->Allocate();
+	CHECK(sampler.IsAnimated(playing[7].Slots[0], AnimationClip::Channel::Scale));
+	CHECK(sampler.IsAnimated(playing[7].Slots[1], AnimationClip::Channel::Rotation));
+	CHECK(!sampler.IsAnimated(playing[7].Slots[1], AnimationClip::Channel::Position));
+	CHECK(!sampler.IsAnimated(playing[7].Slots[1], AnimationClip::Channel::Scale));
+	CHECK(!sampler.IsAnimated(idle, AnimationClip::Channel::Position));
+
+	unsigned int mismatches = 0;
+	for (int frame = 0; frame < 300; frame++)
+	{
+		const float deltaTime = 1.0f / 60.0f;
+		const float extraTime = 0.004f;
+		sampler.Advance(deltaTime);
+		sampler.Sample(extraTime);
+
+		for (Playing& p : playing)
+		{
+			// Time kept the way Advance() and Sample() keep it
+			p.Time += deltaTime * p.Speed;
+			float time = p.Time + extraTime * p.Speed;
+			if (p.Loop)
+			{
+				p.Time = fmodf(p.Time, clip->Duration);
+				p.Time += p.Time < 0.0f ? clip->Duration : 0.0f;
+				time = fmodf(p.Time + extraTime * p.Speed, clip->Duration);
+				time += time < 0.0f ? clip->Duration : 0.0f;
+			}
+
+			for (const AnimationClip::Track& track : clip->Tracks)
+			{
+				unsigned int slot = p.Slots[track.Target];
+				XMFLOAT4 expected = SampleTrack(*clip, track, time);
+				switch (track.Path)
+				{
+				case AnimationClip::Channel::Position: mismatches += !Near(pool->GetPosition(slot), expected, 1e-4f); break;
+				case AnimationClip::Channel::Rotation: mismatches += !SameRotation(pool->GetRotation(slot), expected, 1e-5f); break;
+				case AnimationClip::Channel::Scale: mismatches += !Near(pool->GetScale(slot), expected, 0.0f); break;
+				}
+			}
+		}
+	}
+	CHECK(mismatches == 0);
+}
+
+// Playing forward without wrapping never has to search for keys
+TEST(AnimationSamplerOnlySearchesOnJumps)
+{
+	std::mt19937 random(2);
+	std::shared_ptr<AnimationClip> clip = MakeClip(random);
+	std::shared_ptr<TransformPool> pool = std::make_shared<TransformPool>();
+	AnimationSampler sampler(pool);
+	for (int i = 0; i < 64; i++)
+		sampler.Play(clip, { pool->Allocate(), pool->Allocate() }, (clip->Duration - 1.0f) * i / 64.0f, 1.0f, false);
+
+	// The first sample starts every track from its first key
+	sampler.Sample();
+	CHECK(sampler.GetStats().SearchCount > 0);
+
+	unsigned int searches = 0;
+	for (int frame = 0; frame < 50; frame++)
+	{
+		sampler.Advance(1.0f / 60.0f);
+		sampler.Sample();
+		searches += sampler.GetStats().SearchCount;
+	}
+	CHECK(searches == 0);
+
+	// A clip needs a slot for every target
+	bool threw = false;
+	try { sampler.Play(clip, { pool->Allocate() }); }
+	catch (const std::invalid_argument&) { threw = true; }
+	CHECK(threw);
+}
+
+// Milliseconds a frame to advance and sample, with three tracks per transform
+BENCHMARK(AnimationSamplerThroughput)
+{
+	const unsigned int counts[] = { 10000, 50000, 100000 };
+	for (unsigned int count : counts)
+	{
+		double milliseconds = MillisecondsPerFrame(count);
+		printf("  %6u transforms: %.3f ms a frame, %.1fM tracks/s\n",
+			count, milliseconds, count * 3 / milliseconds / 1000.0);
+		CHECK(milliseconds > 0.0);
+	}
+}
@@ -7,4 +7,10 @@ struct ConstantBufferData {
 	DirectX::XMFLOAT4X4 worldMatrix;
 	DirectX::XMFLOAT4X4 viewMatrix;
 	DirectX::XMFLOAT4X4 projMatrix;
+};
+
+// Matches ObjectData in ShaderInclude.hlsli (register b1)
+struct ObjectConstants {
+	DirectX::XMFLOAT4X4 worldMatrix;
+	DirectX::XMFLOAT4X4 worldInvMatrix;
 };
\ No newline at end of file
@@ -38,7 +38,7 @@ void Camera::UpdateViewMatrix()
 void Camera::UpdateProjectionMatrix(float aspectRatio)
 {
 	this->aspectRatio = aspectRatio;
-	DirectX::XMStoreFloat4x4(&projectionMatrix, DirectX::XMMatrixPerspectiveFovLH(fov, aspectRatio, 0.01f, 1000.0f));
+	DirectX::XMStoreFloat4x4(&projectionMatrix, DirectX::XMMatrixPerspectiveFovLH(fov, aspectRatio, nearClipDist, farClipDist));
 }
 
 void Camera::Update(float dt)
@@ -63,10 +63,13 @@ void Camera::Update(float dt)
 		float cursorMovementX = Input::GetMouseXDelta() * lookSpeed;
 		float cursorMovementY = Input::GetMouseYDelta() * lookSpeed;
 
-		transform->Rotate(cursorMovementY, cursorMovementX, 0);
+		// Pitch and yaw are added as angles (rather than with Rotate(),
+		// which turns about the camera's own axes) so it never rolls
+		DirectX::XMFLOAT3 rotation = transform->GetPitchYawRoll();
+		rotation.x += cursorMovementY;
+		rotation.y += cursorMovementX;
 
 		// Clamp y rotation
-		DirectX::XMFLOAT3 rotation = transform->GetPitchYawRoll();
 		if (rotation.x > (3.1415962f / 2.0f)) { rotation.x = (3.1415962f / 2.0f); }
 		if (rotation.x < -(3.1415962f / 2.0f)) { rotation.x = -(3.1415962f / 2.0f); }
 		transform->SetRotation(rotation);
@@ -94,3 +97,18 @@ float Camera::GetFov()
 {
 	return fov;
 }
+
+float Camera::GetAspectRatio()
+{
+	return aspectRatio;
+}
+
+float Camera::GetNearClip()
+{
+	return nearClipDist;
+}
+
+float Camera::GetFarClip()
+{
+	return farClipDist;
+}
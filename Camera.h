@@ -26,5 +26,8 @@ public:
 	DirectX::XMFLOAT4X4 GetProj();
 	DirectX::XMFLOAT3 GetPosition();
 	float GetFov();
+	float GetAspectRatio();
+	float GetNearClip();
+	float GetFarClip();
 };
 
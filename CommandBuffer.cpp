@@ -0,0 +1,188 @@
+#include "CommandBuffer.h"
+#include <cstring>
+
+void CommandBuffer::SetInputLayout(const void* layout)
+{
+	Add(CommandType::SetInputLayout).Resource = layout;
+}
+
+void CommandBuffer::SetVertexShader(const void* shader)
+{
+	Add(CommandType::SetVertexShader).Resource = shader;
+}
+
+void CommandBuffer::SetPixelShader(const void* shader)
+{
+	Add(CommandType::SetPixelShader).Resource = shader;
+}
+
+void CommandBuffer::SetRasterizerState(const void* state)
+{
+	Add(CommandType::SetRasterizerState).Resource = state;
+}
+
+void CommandBuffer::SetDepthStencilState(const void* state)
+{
+	Add(CommandType::SetDepthStencilState).Resource = state;
+}
+
+void CommandBuffer::SetRenderTargets(const void* renderTarget, const void* depthStencil)
+{
+	Command& command = Add(CommandType::SetRenderTargets);
+	command.Resource = renderTarget;
+	command.DepthStencil = depthStencil;
+}
+
+void CommandBuffer::SetViewport(float x, float y, float width, float height)
+{
+	float viewport[4] = { x, y, width, height };
+	AddData(Add(CommandType::SetViewport), viewport, sizeof(viewport));
+}
+
+void CommandBuffer::SetVertexBuffer(unsigned int slot, const void* buffer, unsigned int stride, unsigned int offset)
+{
+	Command& command = Add(CommandType::SetVertexBuffer);
+	command.Slot = slot;
+	command.Resource = buffer;
+	command.Arguments[0] = stride;
+	command.Arguments[1] = offset;
+}
+
+void CommandBuffer::SetIndexBuffer(const void* buffer)
+{
+	Add(CommandType::SetIndexBuffer).Resource = buffer;
+}
+
+void CommandBuffer::SetConstantBuffer(ShaderStage stage, unsigned int slot, const void* buffer)
+{
+	Command& command = Add(CommandType::SetConstantBuffer);
+	command.Stage = stage;
+	command.Slot = slot;
+	command.Resource = buffer;
+}
+
+void CommandBuffer::SetShaderResource(ShaderStage stage, unsigned int slot, const void* resource)
+{
+	Command& command = Add(CommandType::SetShaderResource);
+	command.Stage = stage;
+	command.Slot = slot;
+	command.Resource = resource;
+}
+
+void CommandBuffer::SetSampler(ShaderStage stage, unsigned int slot, const void* sampler)
+{
+	Command& command = Add(CommandType::SetSampler);
+	command.Stage = stage;
+	command.Slot = slot;
+	command.Resource = sampler;
+}
+
+void CommandBuffer::ClearShaderResources(ShaderStage stage)
+{
+	Add(CommandType::ClearShaderResources).Stage = stage;
+}
+
+void CommandBuffer::UpdateBuffer(const void* buffer, const void* data, unsigned int size)
+{
+	Command& command = Add(CommandType::UpdateBuffer);
+	command.Resource = buffer;
+	AddData(command, data, size);
+}
+
+void CommandBuffer::ClearRenderTarget(const void* renderTarget, const float color[4])
+{
+	Command& command = Add(CommandType::ClearRenderTarget);
+	command.Resource = renderTarget;
+	AddData(command, color, sizeof(float) * 4);
+}
+
+void CommandBuffer::ClearDepth(const void* depthStencil, float depth)
+{
+	Command& command = Add(CommandType::ClearDepth);
+	command.Resource = depthStencil;
+	AddData(command, &depth, sizeof(float));
+}
+
+void CommandBuffer::Draw(unsigned int vertexCount, unsigned int startVertex)
+{
+	Command& command = Add(CommandType::Draw);
+	command.Arguments[0] = vertexCount;
+	command.Arguments[1] = startVertex;
+}
+
+void CommandBuffer::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	Command& command = Add(CommandType::DrawIndexed);
+	command.Arguments[0] = indexCount;
+	command.Arguments[1] = startIndex;
+	command.Arguments[2] = (unsigned int)baseVertex;
+}
+
+void CommandBuffer::Clear()
+{
+	commands.clear();
+	data.clear();
+}
+
+const std::vector<Command>& CommandBuffer::GetCommands() const
+{
+	return commands;
+}
+
+const void* CommandBuffer::GetData(const Command& command) const
+{
+	return command.DataSize == 0 ? nullptr : &data[command.DataOffset];
+}
+
+size_t CommandBuffer::GetDataSize() const
+{
+	return data.size();
+}
+
+const char* CommandBuffer::GetName(CommandType type)
+{
+	switch (type)
+	{
+	case CommandType::SetInputLayout: return "SetInputLayout";
+	case CommandType::SetVertexShader: return "SetVertexShader";
+	case CommandType::SetPixelShader: return "SetPixelShader";
+	case CommandType::SetRasterizerState: return "SetRasterizerState";
+	case CommandType::SetDepthStencilState: return "SetDepthStencilState";
+	case CommandType::SetRenderTargets: return "SetRenderTargets";
+	case CommandType::SetViewport: return "SetViewport";
+	case CommandType::SetVertexBuffer: return "SetVertexBuffer";
+	case CommandType::SetIndexBuffer: return "SetIndexBuffer";
+	case CommandType::SetConstantBuffer: return "SetConstantBuffer";
+	case CommandType::SetShaderResource: return "SetShaderResource";
+	case CommandType::SetSampler: return "SetSampler";
+	case CommandType::ClearShaderResources: return "ClearShaderResources";
+	case CommandType::UpdateBuffer: return "UpdateBuffer";
+	case CommandType::ClearRenderTarget: return "ClearRenderTarget";
+	case CommandType::ClearDepth: return "ClearDepth";
+	case CommandType::Draw: return "Draw";
+	case CommandType::DrawIndexed: return "DrawIndexed";
+	}
+	return "Unknown";
+}
+
+Command& CommandBuffer::Add(CommandType type)
+{
+	Command command = {};
+	command.Type = type;
+	commands.push_back(command);
+	return commands.back();
+}
+
+// --------------------------------------------------------
+// Each copy starts 16 bytes in, so whole vectors and
+// matrices stay aligned wherever the backend reads them
+// --------------------------------------------------------
+void CommandBuffer::AddData(Command& command, const void* source, unsigned int size)
+{
+	size_t offset = (data.size() + 15) & ~(size_t)15;
+	data.resize(offset + size);
+	if (size > 0)
+		memcpy(&data[offset], source, size);
+	command.DataOffset = (unsigned int)offset;
+	command.DataSize = size;
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// --------------------------------------------------------
+// Rendering recorded as a list of commands, which a backend
+// then carries out (D3D11Backend), or only checks and counts
+// (NullBackend)
+//
+// - Covers what drawing needs: the pipeline (shaders, input
+//   layout, rasterizer and depth stencil states, render
+//   targets and viewport), binding buffers, shader resources
+//   and samplers, updating buffers, clearing and drawing
+// - Resources are opaque handles; for the D3D11 backend each
+//   is the matching ID3D11 interface pointer, which has to
+//   stay alive until the commands are executed
+// - Buffer updates, viewports and clear colors are copied
+//   in, so callers can reuse their own memory right away
+// - Nothing here includes Direct3D, so recording and the
+//   null backend build (and can be tested) anywhere
+// --------------------------------------------------------
+enum class ShaderStage
+{
+	Vertex,
+	Pixel
+};
+
+enum class CommandType
+{
+	SetInputLayout,
+	SetVertexShader,
+	SetPixelShader,
+	SetRasterizerState,
+	SetDepthStencilState,
+	SetRenderTargets,
+	SetViewport,
+	SetVertexBuffer,
+	SetIndexBuffer,
+	SetConstantBuffer,
+	SetShaderResource,
+	SetSampler,
+	ClearShaderResources,
+	UpdateBuffer,
+	ClearRenderTarget,
+	ClearDepth,
+	Draw,
+	DrawIndexed
+};
+
+struct Command
+{
+	CommandType Type;
+	ShaderStage Stage;			// For constant buffers, shader resources and samplers
+	unsigned int Slot;
+	const void* Resource;
+	const void* DepthStencil;	// The second view of SetRenderTargets
+	unsigned int Arguments[3];	// Counts, offsets and strides, depending on the type
+	unsigned int DataOffset;	// Into the buffer's own data (see GetData())
+	unsigned int DataSize;
+};
+
+class CommandBuffer
+{
+public:
+	// Slot counts of Direct3D 11, which NullBackend checks against
+	static const unsigned int VertexBufferSlots = 32;
+	static const unsigned int ConstantBufferSlots = 14;
+	static const unsigned int ShaderResourceSlots = 128;
+	static const unsigned int SamplerSlots = 16;
+
+	// Null handles unbind, wherever Direct3D allows it
+	void SetInputLayout(const void* layout);
+	void SetVertexShader(const void* shader);
+	void SetPixelShader(const void* shader);
+	void SetRasterizerState(const void* state);
+	void SetDepthStencilState(const void* state);
+	void SetRenderTargets(const void* renderTarget, const void* depthStencil);
+	void SetViewport(float x, float y, float width, float height);	// Depths of 0 to 1
+
+	void SetVertexBuffer(unsigned int slot, const void* buffer, unsigned int stride, unsigned int offset);
+	void SetIndexBuffer(const void* buffer);	// 32-bit indices
+	void SetConstantBuffer(ShaderStage stage, unsigned int slot, const void* buffer);
+	void SetShaderResource(ShaderStage stage, unsigned int slot, const void* resource);
+	void SetSampler(ShaderStage stage, unsigned int slot, const void* sampler);
+	void ClearShaderResources(ShaderStage stage);	// Unbinds every slot
+
+	// Rewrites the start of the buffer (all of it, for constant buffers)
+	void UpdateBuffer(const void* buffer, const void* data, unsigned int size);
+	void ClearRenderTarget(const void* renderTarget, const float color[4]);
+	void ClearDepth(const void* depthStencil, float depth);
+
+	void Draw(unsigned int vertexCount, unsigned int startVertex);
+	void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex);
+
+	// Empties the buffer, keeping its memory
+	void Clear();
+
+	const std::vector<Command>& GetCommands() const;
+	const void* GetData(const Command& command) const;
+	size_t GetDataSize() const;	// Bytes copied in since the last Clear()
+
+	// Names for reporting
+	static const char* GetName(CommandType type);
+
+private:
+	std::vector<Command> commands;
+	std::vector<unsigned char> data;
+
+	Command& Add(CommandType type);
+	void AddData(Command& command, const void* source, unsigned int size);
+};
+
+// --------------------------------------------------------
+// Carries out recorded commands, keeping whatever is bound
+// from one Execute() to the next (like a device context)
+// --------------------------------------------------------
+class CommandBackend
+{
+public:
+	virtual ~CommandBackend() = default;
+	virtual void Execute(const CommandBuffer& commands) = 0;
+};
@@ -0,0 +1,202 @@
+#include "Tests.h"
+#include "CommandBuffer.h"
+#include "NullBackend.h"
+
+#include <string>
+
+namespace
+{
+	// Handles are only compared, so any distinct addresses will do
+	char handles[16];
+	const void* renderTarget = &handles[0];
+	const void* depthStencil = &handles[1];
+	const void* rasterizer = &handles[2];
+	const void* inputLayout = &handles[3];
+	const void* vertexShader = &handles[4];
+	const void* pixelShader = &handles[5];
+	const void* vertexConstants = &handles[6];
+	const void* pixelConstants = &handles[7];
+	const void* sampler = &handles[8];
+	const void* texture = &handles[9];
+	const void* vertexBuffer = &handles[10];
+	const void* indexBuffer = &handles[11];
+
+	// How many of the backend's kept errors contain the message
+	unsigned int CountErrors(const NullBackend& backend, const char* message)
+	{
+		unsigned int count = 0;
+		for (const std::string& error : backend.GetErrors())
+			count += error.find(message) != std::string::npos;
+		return count;
+	}
+
+	// Enough for a draw without a vertex buffer to be valid
+	void RecordTarget(CommandBuffer& commands)
+	{
+		commands.SetViewport(0.0f, 0.0f, 1280.0f, 720.0f);
+		commands.SetRenderTargets(renderTarget, depthStencil);
+		commands.SetVertexShader(vertexShader);
+	}
+}
+
+// --------------------------------------------------------
+// A frame shaped like Game::Draw(): clears, the pipeline,
+// two entities sharing a mesh (so the second one's buffer
+// binds are redundant), then a full screen triangle
+// --------------------------------------------------------
+TEST(CommandBufferValidFrameHasNoErrors)
+{
+	const float color[4] = { 0.4f, 0.6f, 0.75f, 0.0f };
+	float world[2][16] = {};
+	world[1][0] = 1.0f;
+
+	CommandBuffer commands;
+	commands.ClearRenderTarget(renderTarget, color);
+	commands.ClearDepth(depthStencil, 1.0f);
+	commands.SetViewport(0.0f, 0.0f, 1280.0f, 720.0f);
+	commands.SetRenderTargets(renderTarget, depthStencil);
+	commands.SetRasterizerState(rasterizer);
+	commands.SetInputLayout(inputLayout);
+	commands.SetVertexShader(vertexShader);
+	commands.SetPixelShader(pixelShader);
+	commands.SetConstantBuffer(ShaderStage::Vertex, 0, vertexConstants);
+	commands.SetConstantBuffer(ShaderStage::Pixel, 0, pixelConstants);
+	commands.SetSampler(ShaderStage::Pixel, 0, sampler);
+	commands.SetShaderResource(ShaderStage::Pixel, 0, texture);
+	for (int e = 0; e < 2; e++)
+	{
+		commands.UpdateBuffer(vertexConstants, world[e], sizeof(world[e]));
+		commands.SetVertexBuffer(0, vertexBuffer, 32, 0);
+		commands.SetIndexBuffer(indexBuffer);
+		commands.DrawIndexed(36, 0, 0);
+	}
+	commands.SetRenderTargets(renderTarget, 0);
+	commands.SetInputLayout(0);
+	commands.Draw(3, 0);
+	commands.ClearShaderResources(ShaderStage::Pixel);
+	CHECK(commands.GetCommands().size() == 24);
+
+	// Updates are copies, aligned for the backends to read whole vectors
+	world[0][0] = 5.0f;
+	const Command& update = commands.GetCommands()[12];
+	CHECK(update.Type == CommandType::UpdateBuffer);
+	CHECK(update.DataSize == sizeof(world[0]) && update.DataOffset % 16 == 0);
+	CHECK(((const float*)commands.GetData(update))[0] == 0.0f);
+
+	NullBackend backend;
+	backend.Execute(commands);
+	NullBackend::Stats stats = backend.GetStats();
+	CHECK(stats.ErrorCount == 0);
+	CHECK(backend.GetErrors().empty());
+	CHECK(stats.CommandCount == 24);
+	CHECK(stats.DrawCount == 3);
+	CHECK(stats.VertexCount == 36 * 2 + 3);
+	CHECK(stats.ShaderChanges == 4);	// Layout, both shaders, then no layout
+	CHECK(stats.StateChanges == 4);		// Viewport, rasterizer and both target changes
+	CHECK(stats.BufferBinds == 4);
+	CHECK(stats.ResourceBinds == 3);	// Sampler, texture and unbinding them all
+	CHECK(stats.RedundantBinds == 2);
+	CHECK(stats.UpdateCount == 2);
+	CHECK(stats.UpdateBytes == sizeof(world));
+	CHECK(stats.ClearCount == 2);
+
+	// Bindings carry over to the next Execute() (like a context's),
+	// and Reset() forgets them along with the counts
+	backend.Execute(commands);
+	CHECK(backend.GetStats().RedundantBinds > stats.RedundantBinds * 2);
+	backend.Reset();
+	backend.Execute(commands);
+	NullBackend::Stats again = backend.GetStats();
+	CHECK(again.ErrorCount == 0);
+	CHECK(again.ShaderChanges == stats.ShaderChanges && again.StateChanges == stats.StateChanges);
+	CHECK(again.BufferBinds == stats.BufferBinds && again.ResourceBinds == stats.ResourceBinds);
+	CHECK(again.RedundantBinds == stats.RedundantBinds);
+}
+
+// Each kind of mistake is reported once, against the command that made it
+TEST(CommandBufferInvalidCommandsAreReported)
+{
+	// Drawing with nothing bound
+	{
+		CommandBuffer commands;
+		commands.Draw(3, 0);
+		NullBackend backend;
+		backend.Execute(commands);
+		CHECK(backend.GetStats().ErrorCount == 3);
+		CHECK(backend.GetErrors().size() == 3);
+		CHECK(backend.GetErrors()[0] == "Command 0 (Draw): No vertex shader is bound");
+		CHECK(CountErrors(backend, "No render target or depth stencil is bound") == 1);
+		CHECK(CountErrors(backend, "No viewport is set") == 1);
+		CHECK(backend.GetStats().DrawCount == 1);
+	}
+
+	// An indexed draw without indices, and a layout without vertices
+	{
+		CommandBuffer commands;
+		RecordTarget(commands);
+		commands.DrawIndexed(36, 0, 0);
+		commands.SetInputLayout(inputLayout);
+		commands.Draw(3, 0);
+		NullBackend backend;
+		backend.Execute(commands);
+		CHECK(backend.GetStats().ErrorCount == 2);
+		CHECK(CountErrors(backend, "Command 3 (DrawIndexed): No index buffer is bound") == 1);
+		CHECK(CountErrors(backend, "Command 5 (Draw): The input layout has no vertex buffer to read") == 1);
+	}
+
+	// Slots past Direct3D 11's limits aren't bound
+	{
+		CommandBuffer commands;
+		commands.SetVertexBuffer(CommandBuffer::VertexBufferSlots, vertexBuffer, 32, 0);
+		commands.SetConstantBuffer(ShaderStage::Pixel, CommandBuffer::ConstantBufferSlots, pixelConstants);
+		commands.SetShaderResource(ShaderStage::Vertex, CommandBuffer::ShaderResourceSlots, texture);
+		commands.SetSampler(ShaderStage::Pixel, CommandBuffer::SamplerSlots, sampler);
+		commands.SetSampler(ShaderStage::Pixel, CommandBuffer::SamplerSlots - 1, sampler);
+		NullBackend backend;
+		backend.Execute(commands);
+		CHECK(backend.GetStats().ErrorCount == 4);
+		CHECK(CountErrors(backend, "The slot is out of range") == 4);
+		CHECK(backend.GetStats().BufferBinds == 0);
+		CHECK(backend.GetStats().ResourceBinds == 1);
+	}
+
+	// Vertices without a stride, though unbinding needs none
+	{
+		CommandBuffer commands;
+		commands.SetVertexBuffer(0, vertexBuffer, 0, 0);
+		commands.SetVertexBuffer(1, 0, 0, 0);
+		NullBackend backend;
+		backend.Execute(commands);
+		CHECK(backend.GetStats().ErrorCount == 1);
+		CHECK(CountErrors(backend, "Command 0 (SetVertexBuffer): The vertex stride is zero") == 1);
+	}
+
+	// Updates and clears of nothing, and an empty viewport
+	{
+		const float color[4] = {};
+		CommandBuffer commands;
+		commands.UpdateBuffer(0, color, sizeof(color));
+		commands.UpdateBuffer(vertexConstants, color, 0);
+		commands.ClearRenderTarget(0, color);
+		commands.ClearDepth(0, 1.0f);
+		commands.SetViewport(0.0f, 0.0f, 0.0f, 720.0f);
+		NullBackend backend;
+		backend.Execute(commands);
+		CHECK(backend.GetStats().ErrorCount == 5);
+		CHECK(CountErrors(backend, "The buffer is null") == 1);
+		CHECK(CountErrors(backend, "There's no data") == 1);
+		CHECK(CountErrors(backend, "The view is null") == 2);
+		CHECK(CountErrors(backend, "The viewport is empty") == 1);
+	}
+
+	// Past the first few, errors are only counted
+	{
+		CommandBuffer commands;
+		for (int i = 0; i < 20; i++)
+			commands.Draw(3, 0);
+		NullBackend backend;
+		backend.Execute(commands);
+		CHECK(backend.GetStats().ErrorCount == 20 * 3);
+		CHECK(backend.GetErrors().size() == NullBackend::MaxErrors);
+	}
+}
@@ -0,0 +1,157 @@
+#include "D3D11Backend.h"
+#include <cstring>
+
+D3D11Backend::D3D11Backend(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context) :
+	context(context)
+{
+}
+
+void D3D11Backend::Execute(const CommandBuffer& commands)
+{
+	for (const Command& command : commands.GetCommands())
+	{
+		switch (command.Type)
+		{
+		case CommandType::SetInputLayout:
+			context->IASetInputLayout((ID3D11InputLayout*)command.Resource);
+			break;
+		case CommandType::SetVertexShader:
+			context->VSSetShader((ID3D11VertexShader*)command.Resource, 0, 0);
+			break;
+		case CommandType::SetPixelShader:
+			context->PSSetShader((ID3D11PixelShader*)command.Resource, 0, 0);
+			break;
+		case CommandType::SetRasterizerState:
+			context->RSSetState((ID3D11RasterizerState*)command.Resource);
+			break;
+		case CommandType::SetDepthStencilState:
+			context->OMSetDepthStencilState((ID3D11DepthStencilState*)command.Resource, 0);
+			break;
+
+		case CommandType::SetRenderTargets:
+		{
+			ID3D11RenderTargetView* renderTarget = (ID3D11RenderTargetView*)command.Resource;
+			context->OMSetRenderTargets(1, &renderTarget, (ID3D11DepthStencilView*)command.DepthStencil);
+			break;
+		}
+
+		case CommandType::SetViewport:
+		{
+			const float* rectangle = (const float*)commands.GetData(command);
+			D3D11_VIEWPORT viewport = {};
+			viewport.TopLeftX = rectangle[0];
+			viewport.TopLeftY = rectangle[1];
+			viewport.Width = rectangle[2];
+			viewport.Height = rectangle[3];
+			viewport.MaxDepth = 1.0f;
+			context->RSSetViewports(1, &viewport);
+			break;
+		}
+
+		case CommandType::SetVertexBuffer:
+		{
+			ID3D11Buffer* buffer = (ID3D11Buffer*)command.Resource;
+			UINT stride = command.Arguments[0];
+			UINT offset = command.Arguments[1];
+			context->IASetVertexBuffers(command.Slot, 1, &buffer, &stride, &offset);
+			break;
+		}
+
+		case CommandType::SetIndexBuffer:
+			context->IASetIndexBuffer((ID3D11Buffer*)command.Resource, DXGI_FORMAT_R32_UINT, 0);
+			break;
+
+		case CommandType::SetConstantBuffer:
+		{
+			ID3D11Buffer* buffer = (ID3D11Buffer*)command.Resource;
+			if (command.Stage == ShaderStage::Vertex)
+				context->VSSetConstantBuffers(command.Slot, 1, &buffer);
+			else
+				context->PSSetConstantBuffers(command.Slot, 1, &buffer);
+			break;
+		}
+
+		case CommandType::SetShaderResource:
+		{
+			ID3D11ShaderResourceView* resource = (ID3D11ShaderResourceView*)command.Resource;
+			if (command.Stage == ShaderStage::Vertex)
+				context->VSSetShaderResources(command.Slot, 1, &resource);
+			else
+				context->PSSetShaderResources(command.Slot, 1, &resource);
+			break;
+		}
+
+		case CommandType::SetSampler:
+		{
+			ID3D11SamplerState* sampler = (ID3D11SamplerState*)command.Resource;
+			if (command.Stage == ShaderStage::Vertex)
+				context->VSSetSamplers(command.Slot, 1, &sampler);
+			else
+				context->PSSetSamplers(command.Slot, 1, &sampler);
+			break;
+		}
+
+		case CommandType::ClearShaderResources:
+		{
+			ID3D11ShaderResourceView* nullResources[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT] = {};
+			if (command.Stage == ShaderStage::Vertex)
+				context->VSSetShaderResources(0, D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT, nullResources);
+			else
+				context->PSSetShaderResources(0, D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT, nullResources);
+			break;
+		}
+
+		case CommandType::UpdateBuffer:
+			UpdateBuffer((ID3D11Buffer*)command.Resource, commands.GetData(command), command.DataSize);
+			break;
+
+		case CommandType::ClearRenderTarget:
+			context->ClearRenderTargetView((ID3D11RenderTargetView*)command.Resource, (const float*)commands.GetData(command));
+			break;
+		case CommandType::ClearDepth:
+			context->ClearDepthStencilView((ID3D11DepthStencilView*)command.Resource, D3D11_CLEAR_DEPTH, *(const float*)commands.GetData(command), 0);
+			break;
+
+		case CommandType::Draw:
+			context->Draw(command.Arguments[0], command.Arguments[1]);
+			break;
+		case CommandType::DrawIndexed:
+			context->DrawIndexed(command.Arguments[0], command.Arguments[1], (INT)command.Arguments[2]);
+			break;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Constant buffers can only be rewritten whole, and other
+// default buffers get just the range that was recorded
+// --------------------------------------------------------
+void D3D11Backend::UpdateBuffer(ID3D11Buffer* buffer, const void* data, unsigned int size)
+{
+	if (!buffer || size == 0)
+		return;
+
+	D3D11_BUFFER_DESC desc = {};
+	buffer->GetDesc(&desc);
+	if (desc.Usage == D3D11_USAGE_DYNAMIC)
+	{
+		D3D11_MAPPED_SUBRESOURCE mapped = {};
+		if (SUCCEEDED(context->Map(buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		{
+			memcpy(mapped.pData, data, size);
+			context->Unmap(buffer, 0);
+		}
+	}
+	else if (desc.BindFlags & D3D11_BIND_CONSTANT_BUFFER)
+	{
+		context->UpdateSubresource(buffer, 0, 0, data, 0, 0);
+	}
+	else
+	{
+		D3D11_BOX box = {};
+		box.right = size;
+		box.bottom = 1;
+		box.back = 1;
+		context->UpdateSubresource(buffer, 0, &box, data, 0, 0);
+	}
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include "CommandBuffer.h"
+
+// --------------------------------------------------------
+// Replays recorded commands on a Direct3D 11 device context,
+// each handle being the matching ID3D11 interface pointer
+//
+// - Buffer updates map dynamic buffers (discarding what was
+//   there) and use UpdateSubresource() for the rest, so the
+//   recording doesn't need to know how a buffer was created
+// --------------------------------------------------------
+class D3D11Backend : public CommandBackend
+{
+public:
+	D3D11Backend(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+
+	void Execute(const CommandBuffer& commands) override;
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+
+	void UpdateBuffer(ID3D11Buffer* buffer, const void* data, unsigned int size);
+};
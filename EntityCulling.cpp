@@ -0,0 +1,118 @@
+#include "EntityCulling.h"
+
+using namespace DirectX;
+
+namespace EntityCulling
+{
+	void Bounds::Resize(unsigned int count)
+	{
+		size_t padded = (count + 3) & ~3u;
+		CenterX.resize(padded);
+		CenterY.resize(padded);
+		CenterZ.resize(padded);
+		ExtentX.resize(padded);
+		ExtentY.resize(padded);
+		ExtentZ.resize(padded);
+		Count = count;
+	}
+
+	// --------------------------------------------------------
+	// With row vectors, each of the box's axes becomes a row of
+	// the matrix scaled by the extent along it, and the world
+	// box reaches as far as their absolute values added up
+	// --------------------------------------------------------
+	void Bounds::Set(unsigned int index, XMFLOAT3 boundsMin, XMFLOAT3 boundsMax, const XMFLOAT4X4& world)
+	{
+		XMMATRIX matrix = XMLoadFloat4x4(&world);
+		XMVECTOR localMin = XMLoadFloat3(&boundsMin);
+		XMVECTOR localMax = XMLoadFloat3(&boundsMax);
+		XMVECTOR localCenter = XMVectorScale(XMVectorAdd(localMin, localMax), 0.5f);
+		XMVECTOR localExtent = XMVectorScale(XMVectorSubtract(localMax, localMin), 0.5f);
+
+		XMFLOAT3 center, extent;
+		XMStoreFloat3(&center, XMVector3Transform(localCenter, matrix));
+		XMVECTOR reach = XMVectorMultiply(XMVectorAbs(matrix.r[0]), XMVectorSplatX(localExtent));
+		reach = XMVectorMultiplyAdd(XMVectorAbs(matrix.r[1]), XMVectorSplatY(localExtent), reach);
+		reach = XMVectorMultiplyAdd(XMVectorAbs(matrix.r[2]), XMVectorSplatZ(localExtent), reach);
+		XMStoreFloat3(&extent, reach);
+
+		CenterX[index] = center.x;
+		CenterY[index] = center.y;
+		CenterZ[index] = center.z;
+		ExtentX[index] = extent.x;
+		ExtentY[index] = extent.y;
+		ExtentZ[index] = extent.z;
+	}
+
+	// --------------------------------------------------------
+	// Four boxes at a time, each vector holding one component
+	// of all four, and a plane's components splatted across
+	// - A box is kept while it reaches the inside of every plane,
+	//   and a group stops being tested once none of it does
+	// - Lanes past the end of the padded last group are ignored
+	// --------------------------------------------------------
+	void Cull(const Frustum& frustum, const Bounds& bounds, std::vector<unsigned int>& visible)
+	{
+		visible.clear();
+
+		XMVECTOR planeX[6], planeY[6], planeZ[6], planeW[6];
+		for (int p = 0; p < 6; p++)
+		{
+			XMVECTOR plane = XMLoadFloat4(&frustum.Planes[p]);
+			planeX[p] = XMVectorSplatX(plane);
+			planeY[p] = XMVectorSplatY(plane);
+			planeZ[p] = XMVectorSplatZ(plane);
+			planeW[p] = XMVectorSplatW(plane);
+		}
+
+		for (unsigned int first = 0; first < bounds.Count; first += 4)
+		{
+			XMVECTOR centerX = XMLoadFloat4((const XMFLOAT4*)&bounds.CenterX[first]);
+			XMVECTOR centerY = XMLoadFloat4((const XMFLOAT4*)&bounds.CenterY[first]);
+			XMVECTOR centerZ = XMLoadFloat4((const XMFLOAT4*)&bounds.CenterZ[first]);
+			XMVECTOR extentX = XMLoadFloat4((const XMFLOAT4*)&bounds.ExtentX[first]);
+			XMVECTOR extentY = XMLoadFloat4((const XMFLOAT4*)&bounds.ExtentY[first]);
+			XMVECTOR extentZ = XMLoadFloat4((const XMFLOAT4*)&bounds.ExtentZ[first]);
+
+			XMVECTOR inside = XMVectorTrueInt();
+			for (int p = 0; p < 6; p++)
+			{
+				XMVECTOR distance = XMVectorMultiply(planeX[p], centerX);
+				distance = XMVectorMultiplyAdd(planeY[p], centerY, distance);
+				distance = XMVectorMultiplyAdd(planeZ[p], centerZ, distance);
+				distance = XMVectorAdd(distance, planeW[p]);
+
+				XMVECTOR reach = XMVectorMultiply(XMVectorAbs(planeX[p]), extentX);
+				reach = XMVectorMultiplyAdd(XMVectorAbs(planeY[p]), extentY, reach);
+				reach = XMVectorMultiplyAdd(XMVectorAbs(planeZ[p]), extentZ, reach);
+
+				inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(XMVectorAdd(distance, reach), XMVectorZero()));
+				if (XMVector4EqualInt(inside, XMVectorFalseInt()))
+					break;
+			}
+
+			XMUINT4 lanes;
+			XMStoreUInt4(&lanes, inside);
+			const uint32_t* lane = &lanes.x;
+			unsigned int count = bounds.Count - first < 4 ? bounds.Count - first : 4;
+			for (unsigned int i = 0; i < count; i++)
+			{
+				if (lane[i])
+					visible.push_back(first + i);
+			}
+		}
+	}
+
+	void RemoveOccluded(const OcclusionBuffer& buffer, const Bounds& bounds, std::vector<unsigned int>& visible)
+	{
+		size_t kept = 0;
+		for (unsigned int index : visible)
+		{
+			XMFLOAT3 center(bounds.CenterX[index], bounds.CenterY[index], bounds.CenterZ[index]);
+			XMFLOAT3 extent(bounds.ExtentX[index], bounds.ExtentY[index], bounds.ExtentZ[index]);
+			if (!buffer.IsOccluded(center, extent))
+				visible[kept++] = index;
+		}
+		visible.resize(kept);
+	}
+}
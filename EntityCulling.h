@@ -0,0 +1,58 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <DirectXMath.h>
+#include "Frustum.h"
+#include "OcclusionBuffer.h"
+
+class GameEntity;
+class Camera;
+
+// --------------------------------------------------------
+// Frustum culling of whole entities, using each mesh's
+// object space bounding box
+//
+// - Boxes are moved into world space once per frame (the
+//   box around the mesh's box, after the world matrix), so
+//   any number of frusta can test them after that, like the
+//   camera's and the shadow map's
+// - World boxes are stored as a structure of arrays, so the
+//   frustum test loads four entities' centers and extents
+//   straight into vectors and tests all four against each
+//   plane at once, stopping early once all four are out
+// - Frustum::IntersectsBox() is the same test one entity at
+//   a time, and is what the results are checked against
+// - What's left can then be tested against an OcclusionBuffer
+// - Gather() and GetFrustum(), which read entities and cameras,
+//   are in EntityCullingScene.cpp, so the rest builds without
+//   the renderer (as in the Tests project)
+// --------------------------------------------------------
+namespace EntityCulling
+{
+	// World space boxes, one per entity, padded to a multiple of four
+	struct Bounds
+	{
+		std::vector<float> CenterX, CenterY, CenterZ;
+		std::vector<float> ExtentX, ExtentY, ExtentZ;	// Half sizes
+		unsigned int Count = 0;
+
+		void Resize(unsigned int count);
+
+		// The box around an object space box after the world matrix
+		void Set(unsigned int index, DirectX::XMFLOAT3 boundsMin, DirectX::XMFLOAT3 boundsMax, const DirectX::XMFLOAT4X4& world);
+	};
+
+	// Fills the bounds from every entity's mesh and transform
+	void Gather(const std::vector<std::shared_ptr<GameEntity>>& entities, Bounds& bounds);
+
+	// Replaces the list with the index of every box that isn't
+	// completely outside the frustum, in order
+	void Cull(const Frustum& frustum, const Bounds& bounds, std::vector<unsigned int>& visible);
+
+	// Removes every listed box that the buffer shows is hidden,
+	// keeping the rest in order
+	void RemoveOccluded(const OcclusionBuffer& buffer, const Bounds& bounds, std::vector<unsigned int>& visible);
+
+	// The frustum of a camera's view and projection
+	Frustum GetFrustum(std::shared_ptr<Camera> camera);
+}
@@ -0,0 +1,25 @@
+#include "EntityCulling.h"
+#include "GameEntity.h"
+#include "Camera.h"
+
+using namespace DirectX;
+
+namespace EntityCulling
+{
+	void Gather(const std::vector<std::shared_ptr<GameEntity>>& entities, Bounds& bounds)
+	{
+		bounds.Resize((unsigned int)entities.size());
+		for (unsigned int i = 0; i < bounds.Count; i++)
+		{
+			std::shared_ptr<Mesh> mesh = entities[i]->GetMesh();
+			bounds.Set(i, mesh->GetBoundsMin(), mesh->GetBoundsMax(), entities[i]->GetTransform()->GetWorldMatrix());
+		}
+	}
+
+	Frustum GetFrustum(std::shared_ptr<Camera> camera)
+	{
+		XMFLOAT4X4 view = camera->GetView();
+		XMFLOAT4X4 proj = camera->GetProj();
+		return Frustum::FromMatrix(XMLoadFloat4x4(&view) * XMLoadFloat4x4(&proj));
+	}
+}
@@ -0,0 +1,248 @@
+#include "Tests.h"
+#include "EntityCulling.h"
+
+#include <cfloat>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	Frustum MakeFrustum()
+	{
+		XMMATRIX view = XMMatrixLookToLH(XMVectorSet(1, 2, -3, 0), XMVectorSet(0.3f, -0.2f, 1.0f, 0.0f), XMVectorSet(0, 1, 0, 0));
+		XMMATRIX proj = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 100.0f);
+		return Frustum::FromMatrix(view * proj);
+	}
+
+	// --------------------------------------------------------
+	// Boxes scattered around the frustum, and then as many
+	// again placed on one of its planes, reaching within a
+	// hair either side of it (the cases most likely to split
+	// the four wide test from the one at a time one)
+	// --------------------------------------------------------
+	void MakeBoxes(const Frustum& frustum, unsigned int count, std::mt19937& random, EntityCulling::Bounds& bounds)
+	{
+		std::uniform_real_distribution<float> spread(-60.0f, 60.0f);
+		std::uniform_real_distribution<float> size(0.01f, 4.0f);
+		std::uniform_real_distribution<float> hair(-1e-3f, 1e-3f);
+		bounds.Resize(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			XMFLOAT3 center(spread(random), spread(random), spread(random) + 40.0f);
+			XMFLOAT3 extent(size(random), size(random), size(random));
+			if (i % 2)
+			{
+				const XMFLOAT4& plane = frustum.Planes[random() % 6];
+				XMVECTOR normal = XMLoadFloat4(&plane);
+				float distance = XMVectorGetX(XMVector3Dot(normal, XMLoadFloat3(&center))) + plane.w;
+				float reach = fabsf(plane.x) * extent.x + fabsf(plane.y) * extent.y + fabsf(plane.z) * extent.z;
+				XMStoreFloat3(&center, XMLoadFloat3(&center) - normal * (distance + reach + hair(random)));
+			}
+			bounds.CenterX[i] = center.x;
+			bounds.CenterY[i] = center.y;
+			bounds.CenterZ[i] = center.z;
+			bounds.ExtentX[i] = extent.x;
+			bounds.ExtentY[i] = extent.y;
+			bounds.ExtentZ[i] = extent.z;
+		}
+
+		// The padding holds stale boxes (like a bigger last frame's)
+		// that would all be visible, so listing any of them shows
+		for (size_t i = count; i < bounds.CenterX.size(); i++)
+		{
+			bounds.CenterX[i] = 0.0f;
+			bounds.CenterY[i] = 0.0f;
+			bounds.CenterZ[i] = 40.0f;
+			bounds.ExtentX[i] = 1000.0f;
+			bounds.ExtentY[i] = 1000.0f;
+			bounds.ExtentZ[i] = 1000.0f;
+		}
+	}
+
+	struct CullingTimes
+	{
+		double GatherTime;		// Milliseconds to fill the bounds
+		double CullTime;		// Milliseconds for Cull()
+		double ScalarCullTime;	// Milliseconds for the same with Frustum::IntersectsBox()
+		unsigned int VisibleCount;
+		unsigned int MismatchCount;	// Boxes the two disagreed on (should be zero)
+	};
+
+	// --------------------------------------------------------
+	// Culls this many randomly rotated and scaled unit cubes,
+	// scattered through a 1000 unit box around the camera, both
+	// four at a time and one at a time
+	// --------------------------------------------------------
+	CullingTimes TimeCulling(unsigned int entityCount)
+	{
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> spread(-500.0f, 500.0f);
+		std::uniform_real_distribution<float> angle(0.0f, XM_2PI);
+		std::uniform_real_distribution<float> size(0.5f, 5.0f);
+		std::vector<XMFLOAT4X4> worlds(entityCount);
+		for (XMFLOAT4X4& world : worlds)
+		{
+			XMMATRIX scale = XMMatrixScaling(size(random), size(random), size(random));
+			XMMATRIX rotation = XMMatrixRotationRollPitchYaw(angle(random), angle(random), angle(random));
+			XMMATRIX translation = XMMatrixTranslation(spread(random), spread(random), spread(random));
+			XMStoreFloat4x4(&world, scale * rotation * translation);
+		}
+		XMFLOAT3 boundsMin(-0.5f, -0.5f, -0.5f);
+		XMFLOAT3 boundsMax(0.5f, 0.5f, 0.5f);
+
+		XMMATRIX view = XMMatrixLookToLH(XMVectorZero(), XMVectorSet(0.3f, -0.2f, 1.0f, 0.0f), XMVectorSet(0, 1, 0, 0));
+		XMMATRIX proj = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 400.0f);
+		Frustum frustum = Frustum::FromMatrix(view * proj);
+
+		CullingTimes result = {};
+		EntityCulling::Bounds bounds;
+		std::vector<unsigned int> visible;
+		std::vector<bool> scalarVisible(entityCount);
+		unsigned int passes = 0;
+		while (passes < 3 || result.CullTime + result.ScalarCullTime < 100.0)
+		{
+			auto start = std::chrono::steady_clock::now();
+			bounds.Resize(entityCount);
+			for (unsigned int i = 0; i < entityCount; i++)
+				bounds.Set(i, boundsMin, boundsMax, worlds[i]);
+			auto gathered = std::chrono::steady_clock::now();
+			EntityCulling::Cull(frustum, bounds, visible);
+			auto culled = std::chrono::steady_clock::now();
+			for (unsigned int i = 0; i < entityCount; i++)
+			{
+				XMFLOAT3 center(bounds.CenterX[i], bounds.CenterY[i], bounds.CenterZ[i]);
+				XMFLOAT3 extent(bounds.ExtentX[i], bounds.ExtentY[i], bounds.ExtentZ[i]);
+				scalarVisible[i] = frustum.IntersectsBox(center, extent);
+			}
+			auto end = std::chrono::steady_clock::now();
+
+			result.GatherTime += std::chrono::duration<double, std::milli>(gathered - start).count();
+			result.CullTime += std::chrono::duration<double, std::milli>(culled - gathered).count();
+			result.ScalarCullTime += std::chrono::duration<double, std::milli>(end - culled).count();
+			passes++;
+		}
+		result.GatherTime /= passes;
+		result.CullTime /= passes;
+		result.ScalarCullTime /= passes;
+
+		// Both lists are in order, so they can be walked together
+		result.VisibleCount = (unsigned int)visible.size();
+		size_t next = 0;
+		for (unsigned int i = 0; i < entityCount; i++)
+		{
+			bool listed = next < visible.size() && visible[next] == i;
+			if (listed)
+				next++;
+			if (listed != scalarVisible[i])
+				result.MismatchCount++;
+		}
+		return result;
+	}
+}
+
+// --------------------------------------------------------
+// Cull() against Frustum::IntersectsBox() one box at a time,
+// at counts that leave the last group of four anywhere from
+// full to one box
+// --------------------------------------------------------
+TEST(EntityCullingMatchesScalarTest)
+{
+	Frustum frustum = MakeFrustum();
+	const unsigned int counts[] = { 1, 2, 3, 4, 5, 7, 1003, 10001 };
+	std::mt19937 random(1);
+	for (unsigned int count : counts)
+	{
+		EntityCulling::Bounds bounds;
+		MakeBoxes(frustum, count, random, bounds);
+		std::vector<unsigned int> visible;
+		EntityCulling::Cull(frustum, bounds, visible);
+
+		unsigned int mismatches = 0;
+		unsigned int straddlersKept = 0;
+		size_t next = 0;
+		for (unsigned int i = 0; i < count; i++)
+		{
+			bool listed = next < visible.size() && visible[next] == i;
+			if (listed)
+				next++;
+			XMFLOAT3 center(bounds.CenterX[i], bounds.CenterY[i], bounds.CenterZ[i]);
+			XMFLOAT3 extent(bounds.ExtentX[i], bounds.ExtentY[i], bounds.ExtentZ[i]);
+			bool expected = frustum.IntersectsBox(center, extent);
+			mismatches += listed != expected;
+			straddlersKept += (i % 2) && expected;
+		}
+		CHECK(mismatches == 0);
+		CHECK(next == visible.size());	// Nothing out of order, or past the end
+
+		// The straddling boxes really do land on both sides
+		if (count > 1000)
+			CHECK(straddlersKept > 0 && straddlersKept < count / 2);
+	}
+
+	// Nothing to cull leaves nothing listed
+	EntityCulling::Bounds empty;
+	empty.Resize(0);
+	std::vector<unsigned int> visible = { 1, 2, 3 };
+	EntityCulling::Cull(frustum, empty, visible);
+	CHECK(visible.empty());
+}
+
+// A world box has to hold all eight corners of the moved box, and no more
+TEST(EntityCullingWorldBoxesFitTransformedCorners)
+{
+	std::mt19937 random(2);
+	std::uniform_real_distribution<float> value(-3.0f, 3.0f);
+	unsigned int outside = 0;
+	unsigned int loose = 0;
+	for (int i = 0; i < 1000; i++)
+	{
+		XMFLOAT3 boundsMin(value(random) - 3.0f, value(random) - 3.0f, value(random) - 3.0f);
+		XMFLOAT3 boundsMax(value(random) + 3.0f, value(random) + 3.0f, value(random) + 3.0f);
+		XMMATRIX matrix =
+			XMMatrixScaling(fabsf(value(random)) + 0.1f, fabsf(value(random)) + 0.1f, fabsf(value(random)) + 0.1f) *
+			XMMatrixRotationRollPitchYaw(value(random), value(random), value(random)) *
+			XMMatrixTranslation(value(random) * 10.0f, value(random) * 10.0f, value(random) * 10.0f);
+		XMFLOAT4X4 world;
+		XMStoreFloat4x4(&world, matrix);
+
+		EntityCulling::Bounds bounds;
+		bounds.Resize(1);
+		bounds.Set(0, boundsMin, boundsMax, world);
+		XMVECTOR low = XMVectorSet(bounds.CenterX[0] - bounds.ExtentX[0], bounds.CenterY[0] - bounds.ExtentY[0], bounds.CenterZ[0] - bounds.ExtentZ[0], 0);
+		XMVECTOR high = XMVectorSet(bounds.CenterX[0] + bounds.ExtentX[0], bounds.CenterY[0] + bounds.ExtentY[0], bounds.CenterZ[0] + bounds.ExtentZ[0], 0);
+
+		XMVECTOR cornerMin = XMVectorReplicate(FLT_MAX);
+		XMVECTOR cornerMax = XMVectorReplicate(-FLT_MAX);
+		for (int c = 0; c < 8; c++)
+		{
+			XMVECTOR corner = XMVector3Transform(XMVectorSet(
+				(c & 1) ? boundsMax.x : boundsMin.x,
+				(c & 2) ? boundsMax.y : boundsMin.y,
+				(c & 4) ? boundsMax.z : boundsMin.z, 1.0f), matrix);
+			cornerMin = XMVectorMin(cornerMin, corner);
+			cornerMax = XMVectorMax(cornerMax, corner);
+		}
+		XMVECTOR tolerance = XMVectorReplicate(1e-3f);
+		outside += !XMVector3LessOrEqual(low - tolerance, cornerMin) || !XMVector3GreaterOrEqual(high + tolerance, cornerMax);
+		loose += !XMVector3NearEqual(low, cornerMin, tolerance) || !XMVector3NearEqual(high, cornerMax, tolerance);
+	}
+	CHECK(outside == 0);
+	CHECK(loose == 0);
+}
+
+// Milliseconds to gather and cull, four at a time and one at a time
+BENCHMARK(EntityCullingThroughput)
+{
+	const unsigned int counts[] = { 10000, 100000, 1000000 };
+	for (unsigned int count : counts)
+	{
+		CullingTimes result = TimeCulling(count);
+		printf("  %7u boxes: gather %.3f ms, cull %.3f ms (one at a time %.3f ms), %u visible\n",
+			count, result.GatherTime, result.CullTime, result.ScalarCullTime, result.VisibleCount);
+		CHECK(result.MismatchCount == 0);
+	}
+}
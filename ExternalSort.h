@@ -0,0 +1,252 @@
+#pragma once
+#include <algorithm>
+#include <cstdio>
+#include <cstddef>
+#include <fstream>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// Files of fixed-size records, and a merge sort for files
+// too big to fit in memory
+//
+// - Records are plain structs written as raw bytes, so the
+//   files are temporary and never leave the machine
+// - Sorting reads memory-sized runs, sorts each in memory,
+//   then merges the runs (in more than one pass if there
+//   are too many to buffer at once)
+// - Memory use is bounded by the budget given to each call
+//   plus a small read or write buffer per open file
+// --------------------------------------------------------
+namespace ExternalSort
+{
+	// Smallest read buffer worth giving each run while merging
+	const size_t MinMergeBuffer = 256 << 10;
+
+	// --------------------------------------------------------
+	// Appends records to a file through a buffer
+	// --------------------------------------------------------
+	template <typename T>
+	class RecordWriter
+	{
+	public:
+		RecordWriter(const std::string& fileName, size_t bufferBytes = 1 << 20)
+			: file(fileName, std::ios::binary | std::ios::trunc), count(0)
+		{
+			if (!file.is_open())
+				throw std::runtime_error("Error creating temporary file: " + fileName);
+			buffer.reserve(std::max<size_t>(1, bufferBytes / sizeof(T)));
+		}
+		~RecordWriter()
+		{
+			// Failures only throw from an explicit Close()
+			if (file.is_open())
+			{
+				Flush();
+				file.close();
+			}
+		}
+		RecordWriter(const RecordWriter&) = delete;
+		RecordWriter& operator=(const RecordWriter&) = delete;
+
+		void Write(const T& record)
+		{
+			buffer.push_back(record);
+			count++;
+			if (buffer.size() == buffer.capacity())
+				Flush();
+		}
+
+		void Write(const T* records, size_t recordCount)
+		{
+			for (size_t i = 0; i < recordCount; i++)
+				Write(records[i]);
+		}
+
+		unsigned long long GetCount() { return count; }
+
+		// Throws if anything failed to write (e.g. the disk is full)
+		void Close()
+		{
+			if (!file.is_open())
+				return;
+			Flush();
+			bool failed = !file.good();
+			file.close();
+			if (failed)
+				throw std::runtime_error("Error writing temporary file");
+		}
+
+	private:
+		std::ofstream file;
+		std::vector<T> buffer;
+		unsigned long long count;
+
+		void Flush()
+		{
+			if (!buffer.empty())
+				file.write((const char*)buffer.data(), (std::streamsize)(sizeof(T) * buffer.size()));
+			buffer.clear();
+		}
+	};
+
+	// --------------------------------------------------------
+	// Reads records from a file in order through a buffer
+	// --------------------------------------------------------
+	template <typename T>
+	class RecordReader
+	{
+	public:
+		RecordReader(const std::string& fileName, size_t bufferBytes = 1 << 20)
+			: file(fileName, std::ios::binary), position(0), filled(0)
+		{
+			if (!file.is_open())
+				throw std::runtime_error("Error opening temporary file: " + fileName);
+			buffer.resize(std::max<size_t>(1, bufferBytes / sizeof(T)));
+		}
+		RecordReader(const RecordReader&) = delete;
+		RecordReader& operator=(const RecordReader&) = delete;
+
+		// Returns false once every record has been read
+		bool Read(T& record)
+		{
+			if (position == filled && !Fill())
+				return false;
+			record = buffer[position++];
+			return true;
+		}
+
+		// The next record, without consuming it (null at the end)
+		const T* Peek()
+		{
+			if (position == filled && !Fill())
+				return nullptr;
+			return &buffer[position];
+		}
+
+	private:
+		std::ifstream file;
+		std::vector<T> buffer;
+		size_t position;
+		size_t filled;
+
+		bool Fill()
+		{
+			file.read((char*)buffer.data(), (std::streamsize)(sizeof(T) * buffer.size()));
+			filled = (size_t)file.gcount() / sizeof(T);
+			position = 0;
+			return filled > 0;
+		}
+	};
+
+	// Merges already sorted files into one
+	template <typename T, typename Less>
+	void Merge(const std::vector<std::string>& inputFiles, const std::string& outputFile, Less less, size_t memoryBudget)
+	{
+		size_t bufferBytes = std::max(MinMergeBuffer, memoryBudget / (inputFiles.size() + 1));
+		std::vector<std::unique_ptr<RecordReader<T>>> readers;
+		for (const std::string& input : inputFiles)
+			readers.push_back(std::make_unique<RecordReader<T>>(input, bufferBytes));
+		RecordWriter<T> writer(outputFile, bufferBytes);
+
+		// The queue holds each reader's next record (the smallest on top)
+		auto greater = [&](size_t a, size_t b) { return less(*readers[b]->Peek(), *readers[a]->Peek()); };
+		std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heads(greater);
+		for (size_t i = 0; i < readers.size(); i++)
+		{
+			if (readers[i]->Peek())
+				heads.push(i);
+		}
+
+		T record;
+		while (!heads.empty())
+		{
+			size_t reader = heads.top();
+			heads.pop();
+			readers[reader]->Read(record);
+			writer.Write(record);
+			if (readers[reader]->Peek())
+				heads.push(reader);
+		}
+		writer.Close();
+	}
+
+	// --------------------------------------------------------
+	// Sorts a file of records into another file, using about
+	// memoryBudget bytes (plus file buffers)
+	// - Run files go next to the output and are removed again
+	// - Equal records may come out in any order, so keys that
+	//   need to be deterministic should include a unique id
+	// --------------------------------------------------------
+	template <typename T, typename Less>
+	void Sort(const std::string& inputFile, const std::string& outputFile, Less less, size_t memoryBudget)
+	{
+		std::vector<std::string> runs;
+		{
+			RecordReader<T> reader(inputFile, MinMergeBuffer);
+			std::vector<T> run;
+			run.reserve(std::max<size_t>(1, memoryBudget / sizeof(T)));
+
+			T record;
+			bool more = reader.Read(record);
+			while (more)
+			{
+				run.clear();
+				while (more && run.size() < run.capacity())
+				{
+					run.push_back(record);
+					more = reader.Read(record);
+				}
+				std::sort(run.begin(), run.end(), less);
+
+				runs.push_back(outputFile + ".run" + std::to_string(runs.size()));
+				RecordWriter<T> writer(runs.back(), MinMergeBuffer);
+				writer.Write(run.data(), run.size());
+				writer.Close();
+			}
+		}
+
+		if (runs.empty())
+		{
+			RecordWriter<T> empty(outputFile);
+			return;
+		}
+
+		// Merge as many runs at a time as the budget can buffer
+		// (keeping one buffer for the output, and merging at
+		// least two even when the budget is tiny)
+		size_t fanIn = std::max<size_t>(3, memoryBudget / MinMergeBuffer) - 1;
+		size_t pass = 0;
+		while (runs.size() > 1)
+		{
+			std::vector<std::string> merged;
+			for (size_t first = 0; first < runs.size(); first += fanIn)
+			{
+				std::vector<std::string> group(runs.begin() + first, runs.begin() + std::min(runs.size(), first + fanIn));
+				if (group.size() == 1)
+				{
+					merged.push_back(group[0]);
+					continue;
+				}
+
+				bool last = runs.size() <= fanIn;
+				merged.push_back(last ? outputFile : outputFile + ".merge" + std::to_string(pass) + "_" + std::to_string(merged.size()));
+				Merge<T>(group, merged.back(), less, memoryBudget);
+				for (const std::string& run : group)
+					remove(run.c_str());
+			}
+			runs.swap(merged);
+			pass++;
+		}
+
+		// A single run is already the sorted file
+		if (runs[0] != outputFile)
+		{
+			remove(outputFile.c_str());
+			rename(runs[0].c_str(), outputFile.c_str());
+		}
+	}
+}
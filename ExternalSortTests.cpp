@@ -0,0 +1,120 @@
+#include "Tests.h"
+#include "ExternalSort.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const char* inputFile = "ExternalSortTests.in";
+	const char* outputFile = "ExternalSortTests.out";
+
+	// Shaped like MeshConverter's records: a key with many repeats,
+	// and a unique id that makes the order deterministic
+	struct Record
+	{
+		uint64_t Key;
+		uint64_t Id;
+	};
+
+	bool Less(const Record& a, const Record& b)
+	{
+		return a.Key != b.Key ? a.Key < b.Key : a.Id < b.Id;
+	}
+
+	void WriteRecords(const std::vector<Record>& records)
+	{
+		ExternalSort::RecordWriter<Record> writer(inputFile);
+		writer.Write(records.data(), records.size());
+		writer.Close();
+	}
+
+	std::vector<Record> ReadRecords(const char* file)
+	{
+		std::vector<Record> records;
+		ExternalSort::RecordReader<Record> reader(file, 4096);
+		Record record;
+		while (reader.Read(record))
+			records.push_back(record);
+		return records;
+	}
+
+	bool Exists(const std::string& file)
+	{
+		return std::ifstream(file).is_open();
+	}
+
+	bool SameRecords(const std::vector<Record>& a, const std::vector<Record>& b)
+	{
+		return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(),
+			[](const Record& x, const Record& y) { return x.Key == y.Key && x.Id == y.Id; });
+	}
+}
+
+// --------------------------------------------------------
+// A budget of 64 KB holds 4096 records, so 200k records make
+// 49 runs, and merging two at a time (all the budget can
+// buffer) takes six passes
+// --------------------------------------------------------
+TEST(ExternalSortMatchesStdSort)
+{
+	std::mt19937 random(7);
+	std::vector<Record> records(200000);
+	for (size_t i = 0; i < records.size(); i++)
+		records[i] = { random() % 1000, (uint64_t)i };
+	WriteRecords(records);
+
+	const size_t budget = 64 << 10;
+	CHECK(budget / sizeof(Record) * 48 < records.size());
+	ExternalSort::Sort<Record>(inputFile, outputFile, Less, budget);
+
+	std::vector<Record> expected = records;
+	std::sort(expected.begin(), expected.end(), Less);
+	CHECK(SameRecords(ReadRecords(outputFile), expected));
+
+	// No runs or merges are left behind, from any pass
+	bool leftovers = false;
+	for (int i = 0; i < 49; i++)
+		leftovers = leftovers || Exists(std::string(outputFile) + ".run" + std::to_string(i));
+	for (int pass = 0; pass < 6; pass++)
+	{
+		for (int i = 0; i < 25; i++)
+			leftovers = leftovers || Exists(std::string(outputFile) + ".merge" + std::to_string(pass) + "_" + std::to_string(i));
+	}
+	CHECK(!leftovers);
+
+	// A 1 MB budget: four runs, merged three at a time
+	ExternalSort::Sort<Record>(inputFile, outputFile, Less, (size_t)1 << 20);
+	CHECK(SameRecords(ReadRecords(outputFile), expected));
+
+	std::remove(inputFile);
+	std::remove(outputFile);
+}
+
+// Files that make no runs, or only one, which becomes the output
+TEST(ExternalSortHandlesEmptyAndSingleRuns)
+{
+	WriteRecords({});
+	ExternalSort::Sort<Record>(inputFile, outputFile, Less, 64 << 10);
+	CHECK(Exists(outputFile) && ReadRecords(outputFile).empty());
+
+	std::vector<Record> records = { { 3, 0 }, { 1, 1 }, { 3, 2 }, { 2, 3 }, { 1, 4 } };
+	WriteRecords(records);
+	ExternalSort::Sort<Record>(inputFile, outputFile, Less, 64 << 10);
+	std::vector<Record> expected = records;
+	std::sort(expected.begin(), expected.end(), Less);
+	CHECK(SameRecords(ReadRecords(outputFile), expected));
+	CHECK(!Exists(std::string(outputFile) + ".run0"));
+
+	// And a budget smaller than one record still makes progress
+	ExternalSort::Sort<Record>(inputFile, outputFile, Less, 1);
+	CHECK(SameRecords(ReadRecords(outputFile), expected));
+
+	std::remove(inputFile);
+	std::remove(outputFile);
+}
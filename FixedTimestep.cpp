@@ -0,0 +1,49 @@
+#include "FixedTimestep.h"
+#include <stdexcept>
+#include <cmath>
+
+FixedTimestep::FixedTimestep(float stepLength, unsigned int maxStepsPerFrame) :
+	stepLength(stepLength),
+	accumulator(0.0),
+	maxStepsPerFrame(maxStepsPerFrame),
+	stats()
+{
+	if (!(stepLength > 0.0f) || maxStepsPerFrame == 0)
+		throw std::invalid_argument("Error creating timestep: The step length and steps per frame must be positive");
+}
+
+// --------------------------------------------------------
+// Accumulates in double precision, so thousands of frames'
+// worth of rounding can't add up to a missing step
+// --------------------------------------------------------
+unsigned int FixedTimestep::Advance(float deltaTime)
+{
+	accumulator += fmax((double)deltaTime, 0.0);
+
+	double steps = floor(accumulator / stepLength);
+	accumulator -= steps * stepLength;
+	if (steps > maxStepsPerFrame)
+	{
+		stats.DroppedTime += (steps - maxStepsPerFrame) * stepLength;
+		steps = maxStepsPerFrame;
+	}
+
+	stats.FrameStepCount = (unsigned int)steps;
+	stats.StepCount += stats.FrameStepCount;
+	return stats.FrameStepCount;
+}
+
+float FixedTimestep::GetStepLength()
+{
+	return (float)stepLength;
+}
+
+float FixedTimestep::GetAlpha()
+{
+	return (float)(accumulator / stepLength);
+}
+
+FixedTimestep::Stats FixedTimestep::GetStats()
+{
+	return stats;
+}
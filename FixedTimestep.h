@@ -0,0 +1,48 @@
+#pragma once
+
+// --------------------------------------------------------
+// Turns variable frame times into a whole number of fixed
+// length simulation steps
+//
+// - Time left over after the last whole step carries into
+//   the next frame, so the steps keep up with real time
+// - A frame never runs more than a set number of steps, so
+//   one long frame (a hitch, or a breakpoint) can't snowball
+//   into an ever longer catch up; whatever doesn't fit is
+//   dropped
+// - GetAlpha() is how far the frame is between the last
+//   step and the next one, for drawing a blend of the last
+//   two steps (see InterpolatedTransform)
+// - Never reads the clock itself, so it can run headless
+//   with made up frame times
+// --------------------------------------------------------
+class FixedTimestep
+{
+public:
+	struct Stats
+	{
+		unsigned long long StepCount;	// Every step so far
+		unsigned int FrameStepCount;	// Steps the last Advance() asked for
+		double DroppedTime;				// Seconds skipped by the catch up limit
+	};
+
+	// Throws std::invalid_argument unless the step length and
+	// step limit are positive
+	FixedTimestep(float stepLength = 1.0f / 60.0f, unsigned int maxStepsPerFrame = 8);
+
+	// Adds a frame's time, returning how many steps to run for it
+	unsigned int Advance(float deltaTime);
+
+	float GetStepLength();
+
+	// From zero (just stepped) up to one (a step is due)
+	float GetAlpha();
+
+	Stats GetStats();
+
+private:
+	double stepLength;
+	double accumulator;		// Time since the last step
+	unsigned int maxStepsPerFrame;
+	Stats stats;
+};
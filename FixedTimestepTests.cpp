@@ -0,0 +1,159 @@
+#include "Tests.h"
+#include "FixedTimestep.h"
+#include "InterpolatedTransform.h"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	// --------------------------------------------------------
+	// Runs the same loop Game::Update() does for the given
+	// number of seconds at a render rate (with frame times
+	// jittered by up to a fifth either way), returning the
+	// simulated state after every step
+	// --------------------------------------------------------
+	std::vector<TransformState> Simulate(float seconds, float renderRate, unsigned int seed, float* worstDrawError)
+	{
+		FixedTimestep time;
+		std::shared_ptr<Transform> transform = std::make_shared<Transform>();
+		InterpolatedTransform interpolated(transform);
+
+		std::vector<TransformState> states;
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<float> jitter(0.8f, 1.2f);
+		float elapsed = 0.0f;
+		while (elapsed < seconds)
+		{
+			float deltaTime = jitter(random) / renderRate;
+			elapsed += deltaTime;
+
+			unsigned int steps = time.Advance(deltaTime);
+			for (unsigned int s = 0; s < steps; s++)
+			{
+				interpolated.BeginStep();
+
+				// Spins like the helix, and drifts
+				interpolated.Rotate(time.GetStepLength(), -time.GetStepLength(), 0.0f);
+				interpolated.GetState().Position.x += time.GetStepLength() * 2.0f;
+				states.push_back(interpolated.GetState());
+			}
+
+			// What's drawn is the blend of the last two steps
+			float alpha = time.GetAlpha();
+			interpolated.Apply(alpha);
+			if (states.size() >= 2)
+			{
+				float expected = states[states.size() - 2].Position.x +
+					alpha * (states.back().Position.x - states[states.size() - 2].Position.x);
+				*worstDrawError = fmaxf(*worstDrawError, fabsf(transform->GetPosition().x - expected));
+			}
+		}
+		return states;
+	}
+
+	bool Equal(const TransformState& a, const TransformState& b)
+	{
+		return
+			a.Position.x == b.Position.x && a.Position.y == b.Position.y && a.Position.z == b.Position.z &&
+			a.Rotation.x == b.Rotation.x && a.Rotation.y == b.Rotation.y &&
+			a.Rotation.z == b.Rotation.z && a.Rotation.w == b.Rotation.w &&
+			a.Scale.x == b.Scale.x && a.Scale.y == b.Scale.y && a.Scale.z == b.Scale.z;
+	}
+}
+
+// --------------------------------------------------------
+// Ten simulated seconds at 30, 60 and 144 frames a second
+// take the same steps to exactly the same states
+// - Float frame times can land the last step on either side
+//   of the ten second mark, so the counts may differ by one
+// --------------------------------------------------------
+TEST(FixedTimestepMatchesAcrossRenderRates)
+{
+	const float rates[] = { 30.0f, 60.0f, 144.0f };
+	std::vector<std::vector<TransformState>> runs;
+	for (unsigned int i = 0; i < 3; i++)
+	{
+		float drawError = 0.0f;
+		runs.push_back(Simulate(10.0f, rates[i], i + 1, &drawError));
+		CHECK(drawError < 1e-4f);
+	}
+
+	for (const std::vector<TransformState>& run : runs)
+	{
+		CHECK(run.size() >= 599 && run.size() <= 601);
+		size_t shared = std::min(run.size(), runs[0].size());
+		unsigned int mismatches = 0;
+		for (size_t s = 0; s < shared; s++)
+			mismatches += !Equal(run[s], runs[0][s]);
+		CHECK(mismatches == 0);
+	}
+
+	// And the states did change, so matching means something
+	CHECK(runs[0].back().Position.x > 19.0f);
+}
+
+// --------------------------------------------------------
+// Edits made straight to the Transform between frames (as
+// the entity UI makes them) become the simulated state, so
+// the next steps carry on from them instead of undoing them
+// --------------------------------------------------------
+TEST(InterpolatedTransformAdoptsOutsideChanges)
+{
+	std::shared_ptr<Transform> transform = std::make_shared<Transform>();
+	InterpolatedTransform interpolated(transform);
+	for (int step = 0; step < 3; step++)
+	{
+		interpolated.BeginStep();
+		interpolated.GetState().Position.x += 1.0f;
+	}
+	interpolated.Apply(0.5f);
+	CHECK(Tests::Near(transform->GetPosition().x, 2.5f, 1e-5f));
+
+	// Moved and scaled between frames, then one more step
+	transform->SetPosition(10.0f, 20.0f, 30.0f);
+	transform->SetScale(2.0f, 2.0f, 2.0f);
+	interpolated.BeginStep();
+	CHECK(Tests::Near(interpolated.GetState().Position.x, 10.0f, 0.0f));
+	interpolated.GetState().Position.x += 1.0f;
+	interpolated.Apply(1.0f);
+	XMFLOAT3 position = transform->GetPosition();
+	CHECK(Tests::Near(position.x, 11.0f, 1e-5f) && Tests::Near(position.y, 20.0f, 1e-5f) && Tests::Near(position.z, 30.0f, 1e-5f));
+	CHECK(Tests::Near(transform->GetScale().y, 2.0f, 1e-5f));
+
+	// And an edit with no step before the next frame isn't blended away
+	transform->SetPosition(-5.0f, 0.0f, 0.0f);
+	interpolated.Apply(0.25f);
+	CHECK(Tests::Near(transform->GetPosition().x, -5.0f, 1e-5f));
+}
+
+TEST(FixedTimestepLimitsCatchUp)
+{
+	FixedTimestep time(0.01f, 4);
+
+	// Leftover time carries over...
+	CHECK(time.Advance(0.025f) == 2);
+	CHECK(Tests::Near(time.GetAlpha(), 0.5f, 1e-4f));
+	CHECK(time.Advance(0.005f) == 1);
+	CHECK(Tests::Near(time.GetAlpha(), 0.0f, 1e-4f));
+
+	// ...but a hitch runs at most four steps, dropping the rest
+	CHECK(time.Advance(1.0f) == 4);
+	FixedTimestep::Stats stats = time.GetStats();
+	CHECK(stats.StepCount == 7);
+	CHECK(stats.FrameStepCount == 4);
+	CHECK(Tests::Near((float)stats.DroppedTime, 0.96f, 1e-4f));
+
+	// Negative frame times are ignored rather than stepping backwards
+	CHECK(time.Advance(-1.0f) == 0);
+
+	bool threw = false;
+	try { FixedTimestep invalid(0.0f); }
+	catch (const std::invalid_argument&) { threw = true; }
+	CHECK(threw);
+}
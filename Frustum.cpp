@@ -0,0 +1,58 @@
+#include "Frustum.h"
+#include <cmath>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Gribb/Hartmann plane extraction: with row vectors, each
+// plane is a sum or difference of the matrix's columns
+// --------------------------------------------------------
+Frustum Frustum::FromMatrix(FXMMATRIX matrix)
+{
+	XMMATRIX columns = XMMatrixTranspose(matrix);
+
+	XMVECTOR planes[6] =
+	{
+		XMVectorAdd(columns.r[3], columns.r[0]),		// Left
+		XMVectorSubtract(columns.r[3], columns.r[0]),	// Right
+		XMVectorAdd(columns.r[3], columns.r[1]),		// Bottom
+		XMVectorSubtract(columns.r[3], columns.r[1]),	// Top
+		columns.r[2],									// Near (depth starts at zero)
+		XMVectorSubtract(columns.r[3], columns.r[2]),	// Far
+	};
+
+	Frustum frustum;
+	for (int i = 0; i < 6; i++)
+		XMStoreFloat4(&frustum.Planes[i], XMPlaneNormalize(planes[i]));
+	return frustum;
+}
+
+bool Frustum::IntersectsSphere(XMFLOAT3 center, float radius) const
+{
+	XMVECTOR c = XMLoadFloat3(&center);
+	for (int i = 0; i < 6; i++)
+	{
+		if (XMVectorGetX(XMPlaneDotCoord(XMLoadFloat4(&Planes[i]), c)) < -radius)
+			return false;
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// The box's extent projected onto each plane's normal is
+// how far it reaches toward the plane from its center
+// - Can keep a box that's outside the frustum near a corner,
+//   but never drops one that's inside
+// --------------------------------------------------------
+bool Frustum::IntersectsBox(XMFLOAT3 center, XMFLOAT3 extent) const
+{
+	for (int i = 0; i < 6; i++)
+	{
+		const XMFLOAT4& plane = Planes[i];
+		float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+		float reach = fabsf(plane.x) * extent.x + fabsf(plane.y) * extent.y + fabsf(plane.z) * extent.z;
+		if (distance + reach < 0.0f)
+			return false;
+	}
+	return true;
+}
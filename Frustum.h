@@ -0,0 +1,26 @@
+#pragma once
+#include <DirectXMath.h>
+
+// --------------------------------------------------------
+// The six clip planes of a view frustum
+//
+// - Extracted straight from a (world *) view * projection
+//   matrix, so passing a world matrix in as well gives the
+//   planes in that object's local space
+// - Planes are normalized and face inwards
+// --------------------------------------------------------
+struct Frustum
+{
+	// Left, right, bottom, top, near, far (xyz = normal, w = distance)
+	DirectX::XMFLOAT4 Planes[6];
+
+	// Expects Direct3D's clip space (depth from 0 to 1)
+	static Frustum FromMatrix(DirectX::FXMMATRIX matrix);
+
+	// True unless the sphere is completely outside one of the planes
+	bool IntersectsSphere(DirectX::XMFLOAT3 center, float radius) const;
+
+	// True unless the axis-aligned box (center and half size) is
+	// completely outside one of the planes
+	bool IntersectsBox(DirectX::XMFLOAT3 center, DirectX::XMFLOAT3 extent) const;
+};
@@ -8,9 +8,13 @@
 #include "SimpleShader.h"
 #include "Material.h"
 #include "WICTextureLoader.h"
+#include "SceneQuery.h"
+#include "D3D11Backend.h"
 
 
 #include <DirectXMath.h>
+#include <chrono>
+#include <stdexcept>
 // This code assumes files are in "ImGui" subfolder!
 // Adjust as necessary for your own folder structure and project setup
 #include "ImGui/imgui.h"
@@ -35,6 +39,38 @@ namespace {
 	XMFLOAT3 ambientColor = XMFLOAT3(0.2f, 0.2f, 0.2f);
 	int blurRadius = 0;
 	int ppIsEnabled = 0; // change to 1 to disable custom post process
+
+	// Milliseconds this frame's culling took
+	double cullTime = 0.0;
+
+	// Occluders are entities in view at least this big (largest
+	// half size of their world box) with meshes this simple
+	bool occlusionCulling = true;
+	const float minOccluderExtent = 2.0f;
+	const unsigned int maxOccluderTriangles = 2048;
+	unsigned int occludedCount = 0;
+	std::string occlusionImageResult;
+
+	// Checking every frame with the null backend is extra CPU
+	// time on every frame, so it's only on by default in debug
+	// builds (release ones can turn it on from the UI)
+#ifdef _DEBUG
+	bool validateCommands = true;
+#else
+	bool validateCommands = false;
+#endif
+
+	// Milliseconds this frame spent recording its passes, and
+	// running them through each backend
+	double recordTime = 0.0;
+	double validateTime = 0.0;
+	double executeTime = 0.0;
+	unsigned int recordedCommands = 0;
+	size_t recordedBytes = 0;
+
+	// The most recent right click's pick, and how long it took
+	SceneQuery::Hit pickHit;
+	double pickTime = -1.0;	// Milliseconds (negative before the first pick)
 }
 
 // --------------------------------------------------------
@@ -52,6 +88,11 @@ void Game::Initialize()
 	// Set initial graphics API state
 	Graphics::Context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
+	// Drawing is recorded, shaders included, and replayed at the
+	// end of each frame
+	ISimpleShader::Commands = &Graphics::Commands;
+	commandBackend = std::make_shared<D3D11Backend>(Graphics::Context);
+
 	directionalLight = {};
 	directionalLight.Type = LIGHT_DIRECTIONAL_TYPE;
 	directionalLight.Direction = XMFLOAT3(0.0f, -1.0f, 1.0f);
@@ -147,13 +188,18 @@ Game::~Game()
 void Game::CreateGeometry()
 {
 	// Initialize mesh objects
+	// - The detailed meshes are split into clusters, so the parts
+	//   facing away or out of view can be culled before drawing
+	ObjLoader::LoadOptions clusteredOptions;
+	clusteredOptions.BuildClusters = true;
+
 	cube = std::make_shared<Mesh>(FixPath("../../Assets/cube.obj").c_str());
 	meshes.push_back(cube);
 	// Square
-	cylinder = std::make_shared<Mesh>(FixPath("../../Assets/cylinder.obj").c_str());
+	cylinder = std::make_shared<Mesh>(FixPath("../../Assets/cylinder.obj").c_str(), clusteredOptions, VertexFormat::Packed);
 	meshes.push_back(cylinder);
 	// Octagon
-	helix = std::make_shared<Mesh>(FixPath("../../Assets/helix.obj").c_str());
+	helix = std::make_shared<Mesh>(FixPath("../../Assets/helix.obj").c_str(), clusteredOptions, VertexFormat::Packed);
 	meshes.push_back(helix);
 
 	quad = std::make_shared<Mesh>(FixPath("../../Assets/quad.obj").c_str());
@@ -162,14 +208,34 @@ void Game::CreateGeometry()
 	quad_2F = std::make_shared<Mesh>(FixPath("../../Assets/quad_double_sided.obj").c_str());
 	meshes.push_back(quad_2F);
 
-	torus = std::make_shared<Mesh>(FixPath("../../Assets/torus.obj").c_str());
+	torus = std::make_shared<Mesh>(FixPath("../../Assets/torus.obj").c_str(), clusteredOptions, VertexFormat::Packed);
 	meshes.push_back(torus);
 
-	sphere = std::make_shared<Mesh>(FixPath("../../Assets/sphere.obj").c_str());
+	sphere = std::make_shared<Mesh>(FixPath("../../Assets/sphere.obj").c_str(), clusteredOptions, VertexFormat::Packed);
 	meshes.push_back(sphere);
 
+	// Several objects and materials in one file, drawn as one
+	// submesh per material from the same buffers
+	pedestal = std::make_shared<Mesh>(FixPath("../../Assets/pedestal.obj").c_str());
+	meshes.push_back(pedestal);
+
+	// A glTF scene, whose vertices go to the GPU straight from the
+	// mapped file wherever they're already laid out like Vertex
+	GltfLoader::Scene crates = GltfLoader::Load(FixPath("../../Assets/crates.glb").c_str());
+	gltfStats = crates.LoadStats;
+	std::vector<std::shared_ptr<Mesh>> crateMeshes;
+	for (int i = 0; i < (int)crates.Meshes.size(); i++)
+	{
+		crateMeshes.push_back(std::make_shared<Mesh>(crates, i));
+		meshes.push_back(crateMeshes.back());
+	}
+
 	std::shared_ptr<SimpleVertexShader> vs = std::make_shared<SimpleVertexShader>(
 		Graphics::Device, Graphics::Context, FixPath(L"VertexShader.cso").c_str());
+	// Packed shaders need an explicit layout, since reflection only sees floats
+	std::shared_ptr<SimpleVertexShader> packedVS = std::make_shared<SimpleVertexShader>(
+		Graphics::Device, Graphics::Context, FixPath(L"VertexShaderPacked.cso").c_str(),
+		Mesh::CreatePackedInputLayout(FixPath(L"VertexShaderPacked.cso").c_str()), false);
 	std::shared_ptr<SimplePixelShader> ps = std::make_shared<SimplePixelShader>(
 		Graphics::Device, Graphics::Context, FixPath(L"PixelShader.cso").c_str());
 	std::shared_ptr<SimplePixelShader> uvPS = std::make_shared<SimplePixelShader>(
@@ -192,6 +258,9 @@ void Game::CreateGeometry()
 	// Shadow shader
 	shadowVS = std::make_shared<SimpleVertexShader>(
 		Graphics::Device, Graphics::Context, FixPath(L"ShadowVertexShader.cso").c_str());
+	shadowPackedVS = std::make_shared<SimpleVertexShader>(
+		Graphics::Device, Graphics::Context, FixPath(L"ShadowVertexShaderPacked.cso").c_str(),
+		Mesh::CreatePackedInputLayout(FixPath(L"ShadowVertexShaderPacked.cso").c_str()), false);
 
 	ppPS = std::make_shared<SimplePixelShader>(
 		Graphics::Device, Graphics::Context, FixPath(L"PostProcess.cso").c_str());
@@ -245,10 +314,11 @@ void Game::CreateGeometry()
 
 	// Shadows stuff
 	// Create the actual texture that will be the shadow map
+	// - Room for every cascade's square, side by side
 	
 	D3D11_TEXTURE2D_DESC shadowDesc = {};
-	shadowDesc.Width = 1024; // Ideally a power of 2 (like 1024)
-	shadowDesc.Height = 1024; // Ideally a power of 2 (like 1024)
+	shadowDesc.Width = shadowSettings.Resolution * ShadowCascades::MaxCascades;
+	shadowDesc.Height = shadowSettings.Resolution; // Ideally a power of 2 (like 1024)
 	shadowDesc.ArraySize = 1;
 	shadowDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
 	shadowDesc.CPUAccessFlags = 0;
@@ -282,24 +352,8 @@ void Game::CreateGeometry()
 		&srvDesc,
 		shadowSRV.GetAddressOf());
 
-	// Directional light projection matrix
-	// Needs a orthogonal projection matrix
-	DirectX::XMVECTOR directLightDir = DirectX::XMVECTOR{0, 30, 0, 0.0f};
-
-	DirectX::XMMATRIX lightView = DirectX::XMMatrixLookAtLH(
-		DirectX::XMVectorSet(0, 30, -30, 0),
-		DirectX::XMVectorSet(0, 0, 0, 0),
-		DirectX::XMVectorSet(0, 1, 0, 0));
-	DirectX::XMStoreFloat4x4(&lightViewMatrix, lightView);
-
-	// Projection matrix
-	float lightProjSize = 50.0f;
-	DirectX::XMMATRIX shadowProjMat = DirectX::XMMatrixOrthographicLH(
-		lightProjSize,
-		lightProjSize,
-		1.0f,
-		100.0f);
-	DirectX::XMStoreFloat4x4(&lightProjectionMatrix, shadowProjMat);
+	// The directional light's view and projections are fitted to
+	// the camera every frame (see ShadowCascades and Draw())
 
 	D3D11_RASTERIZER_DESC shadowRastDesc = {};
 	shadowRastDesc.FillMode = D3D11_FILL_SOLID;
@@ -363,18 +417,21 @@ void Game::CreateGeometry()
 	
 
 	std::shared_ptr<Material> mat1 = std::make_shared<Material>(XMFLOAT4(0.0f, 0.0f, 0.0f, 1.000f),vs,ps,XMFLOAT2(1,1),XMFLOAT2(0,0),0.0f);
+	mat1->SetPackedVertexShader(packedVS);
 	mat1->AddSampler("BasicSampler", samplerState);
 	mat1->AddTextureSRV("Albedo", cobbleAlbedoSRV);
 	mat1->AddTextureSRV("NormalMap", cobbleNormalSRV);
 	mat1->AddTextureSRV("RoughnessMap", cobbleRoughnessSRV);
 	mat1->AddTextureSRV("MetalnessMap", cobbleMetalSRV);
 	std::shared_ptr<Material> mat2 = std::make_shared<Material>(XMFLOAT4(0.0f, 0.0f, 0.0f, 1.000f),vs,ps,XMFLOAT2(1,1),XMFLOAT2(0,0),-0.2f);
+	mat2->SetPackedVertexShader(packedVS);
 	mat2->AddSampler("BasicSampler", samplerState);
 	mat2->AddTextureSRV("Albedo", floorAlbedoSRV);
 	mat2->AddTextureSRV("NormalMap", floorNormalSRV);
 	mat2->AddTextureSRV("RoughnessMap", floorRoughnessSRV);
 	mat2->AddTextureSRV("MetalnessMap", floorMetalSRV);
 	std::shared_ptr<Material> mat3 = std::make_shared<Material>(XMFLOAT4(0.0f, 0.0f, 0.0f, 1.000f),vs,ps,XMFLOAT2(1,1),XMFLOAT2(0,0),-0.4f);
+	mat3->SetPackedVertexShader(packedVS);
 	mat3->AddSampler("BasicSampler", samplerState);
 	mat3->AddTextureSRV("Albedo", woodAlbedoSRV);
 	mat3->AddTextureSRV("NormalMap", woodNormalSRV);
@@ -390,6 +447,46 @@ void Game::CreateGeometry()
 	std::shared_ptr<GameEntity> e7 = std::make_shared<GameEntity>(sphere, mat2);
 	std::shared_ptr<GameEntity> e8 = std::make_shared<GameEntity>(cylinder, mat3);
 
+	// The pedestal's materials come from its .mtl file
+	std::vector<std::shared_ptr<Material>> pedestalMaterials;
+	for (int i = 0; i < pedestal->GetSubmeshCount(); i++)
+		pedestalMaterials.push_back(CreateMaterial(pedestal->GetSubmeshMaterial(i), vs, packedVS, ps, samplerState));
+	std::shared_ptr<GameEntity> e9 = std::make_shared<GameEntity>(pedestal, pedestalMaterials);
+
+	// The glTF scene's images are decoded straight from the mapped file
+	std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> crateImages(crates.Images.size());
+	for (size_t i = 0; i < crates.Images.size(); i++)
+	{
+		const GltfLoader::Image& image = crates.Images[i];
+		if (image.Data)
+			CreateWICTextureFromMemory(Graphics::Device.Get(), Graphics::Context.Get(),
+				(const uint8_t*)image.Data, image.Size, 0, crateImages[i].GetAddressOf());
+		else if (!image.Path.empty())
+			CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(),
+				std::wstring(image.Path.begin(), image.Path.end()).c_str(), 0, crateImages[i].GetAddressOf());
+	}
+	std::vector<std::shared_ptr<Material>> crateMaterials;
+	for (const GltfLoader::MaterialDesc& description : crates.Materials)
+		crateMaterials.push_back(CreateMaterial(description, crateImages, vs, packedVS, ps, samplerState));
+	std::shared_ptr<Material> crateDefaultMaterial = CreateMaterial(GltfLoader::MaterialDesc(), crateImages, vs, packedVS, ps, samplerState);
+
+	// Every node with a mesh becomes an entity, already in place
+	std::vector<std::shared_ptr<GameEntity>> crateEntities;
+	for (const GltfLoader::Node& node : crates.Nodes)
+	{
+		if (node.Mesh < 0)
+			continue;
+
+		std::vector<std::shared_ptr<Material>> nodeMaterials;
+		for (const GltfLoader::Primitive& primitive : crates.Meshes[node.Mesh].Primitives)
+			nodeMaterials.push_back(primitive.Material >= 0 ? crateMaterials[primitive.Material] : crateDefaultMaterial);
+		std::shared_ptr<GameEntity> entity = std::make_shared<GameEntity>(crateMeshes[node.Mesh], nodeMaterials);
+		entity->GetTransform()->SetPosition(node.Position);
+		entity->GetTransform()->SetRotation(node.Rotation);
+		entity->GetTransform()->SetScale(node.Scale);
+		crateEntities.push_back(entity);
+	}
+
 
 	entities.push_back(e1);
 	entities.push_back(e2);
@@ -399,6 +496,8 @@ void Game::CreateGeometry()
 	entities.push_back(e6);
 	entities.push_back(e7);
 	entities.push_back(e8);
+	entities.push_back(e9);
+	entities.insert(entities.end(), crateEntities.begin(), crateEntities.end());
 
 
 	sky = std::make_shared<Sky>(
@@ -420,6 +519,136 @@ void Game::CreateGeometry()
 	entities[3].get()->GetTransform()->SetPosition(-10, 0, 0);
 	entities[4].get()->GetTransform()->SetPosition(10, 0, 0);
 	entities[5].get()->GetTransform()->SetPosition(0, -5, 0);
+	entities[5].get()->GetTransform()->SetScale(50, 1, 50);
+	entities[6].get()->GetTransform()->SetPosition(0, -4, 5);
+
+	// The helix spins by itself (see Simulate())
+	simulatedTransforms.push_back(std::make_shared<InterpolatedTransform>(entities[2]->GetTransform()));
+
+	// The torus and the sphere next to it bob up and down, out of
+	// step, with the torus turning and the sphere pulsing
+	std::shared_ptr<AnimationClip> hover = std::make_shared<AnimationClip>();
+	hover->Name = "Hover";
+	std::vector<float> times;
+	std::vector<XMFLOAT4> torusPositions, torusRotations, spherePositions, sphereScales;
+	for (int k = 0; k <= 8; k++)
+	{
+		float angle = XM_2PI * k / 8;
+		times.push_back(4.0f * k / 8);
+		torusPositions.push_back(XMFLOAT4(-10, 0.5f * sinf(angle), 0, 0));
+		XMStoreFloat4(&torusRotations.emplace_back(), XMQuaternionRotationRollPitchYaw(0, angle, 0));
+		spherePositions.push_back(XMFLOAT4(10, -0.5f * sinf(angle), 0, 0));
+		float pulse = 1.0f + 0.2f * sinf(angle * 2.0f);
+		sphereScales.push_back(XMFLOAT4(pulse, pulse, pulse, 0));
+	}
+	hover->AddTrack(0, AnimationClip::Channel::Position, times, torusPositions);
+	hover->AddTrack(0, AnimationClip::Channel::Rotation, times, torusRotations);
+	hover->AddTrack(1, AnimationClip::Channel::Position, times, spherePositions);
+	hover->AddTrack(1, AnimationClip::Channel::Scale, times, sphereScales);
+	animations.Play(hover, { entities[3]->GetTransform()->GetPoolSlot(), entities[4]->GetTransform()->GetPoolSlot() });
+}
+
+// --------------------------------------------------------
+// Builds a Material from a mesh's .mtl description, loading
+// each texture file only once across every material
+// --------------------------------------------------------
+std::shared_ptr<Material> Game::CreateMaterial(const MtlLoader::MaterialDescription& description,
+	std::shared_ptr<SimpleVertexShader> vs, std::shared_ptr<SimpleVertexShader> packedVS,
+	std::shared_ptr<SimplePixelShader> ps, Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler)
+{
+	// The pixel shader adds the tint on top of the lighting, which
+	// is what an emissive color does
+	std::shared_ptr<Material> material = std::make_shared<Material>(
+		XMFLOAT4(description.EmissiveColor.x, description.EmissiveColor.y, description.EmissiveColor.z, description.Opacity),
+		vs, ps, XMFLOAT2(1, 1), XMFLOAT2(0, 0), description.Roughness);
+	material->SetPackedVertexShader(packedVS);
+	material->AddSampler("BasicSampler", sampler);
+
+	const std::pair<const char*, const std::string*> textures[] =
+	{
+		{ "Albedo", &description.DiffuseMap },
+		{ "NormalMap", &description.NormalMap },
+		{ "RoughnessMap", &description.RoughnessMap },
+		{ "MetalnessMap", &description.MetalnessMap },
+	};
+	for (const auto& texture : textures)
+	{
+		if (texture.second->empty())
+			continue;
+
+		// Paths are already relative to the .mtl file, so only need widening
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv = mtlTextures[*texture.second];
+		if (!srv)
+			CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(),
+				std::wstring(texture.second->begin(), texture.second->end()).c_str(), 0, srv.GetAddressOf());
+		material->AddTextureSRV(texture.first, srv);
+	}
+	return material;
+}
+
+
+// --------------------------------------------------------
+// Builds a Material from a glTF material, given the scene's
+// images (loaded once for all its materials)
+// - The pixel shader only takes textures, so factors become
+//   1x1 textures, gamma encoded where the shader decodes
+// - glTF packs roughness and metalness into one texture's
+//   green and blue channels, but the shader reads separate
+//   red channels, so those two always come from the factors
+// --------------------------------------------------------
+std::shared_ptr<Material> Game::CreateMaterial(const GltfLoader::MaterialDesc& description,
+	const std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>>& images,
+	std::shared_ptr<SimpleVertexShader> vs, std::shared_ptr<SimpleVertexShader> packedVS,
+	std::shared_ptr<SimplePixelShader> ps, Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler)
+{
+	std::shared_ptr<Material> material = std::make_shared<Material>(
+		XMFLOAT4(description.Emissive.x, description.Emissive.y, description.Emissive.z, description.BaseColor.w),
+		vs, ps, XMFLOAT2(1, 1), XMFLOAT2(0, 0), description.Roughness);
+	material->SetPackedVertexShader(packedVS);
+	material->AddSampler("BasicSampler", sampler);
+
+	float gamma = 1.0f / 2.2f;
+	XMFLOAT4 baseColor(powf(description.BaseColor.x, gamma), powf(description.BaseColor.y, gamma), powf(description.BaseColor.z, gamma), 1.0f);
+	bool hasAlbedo = description.BaseColorImage >= 0 && images[description.BaseColorImage];
+	bool hasNormals = description.NormalImage >= 0 && images[description.NormalImage];
+	material->AddTextureSRV("Albedo", hasAlbedo ? images[description.BaseColorImage] : CreateSolidTexture(baseColor));
+	material->AddTextureSRV("NormalMap", hasNormals ? images[description.NormalImage] : CreateSolidTexture(XMFLOAT4(0.5f, 0.5f, 1.0f, 1.0f)));
+	material->AddTextureSRV("RoughnessMap", CreateSolidTexture(XMFLOAT4(description.Roughness, 0, 0, 1)));
+	material->AddTextureSRV("MetalnessMap", CreateSolidTexture(XMFLOAT4(description.Metallic, 0, 0, 1)));
+	return material;
+}
+
+// --------------------------------------------------------
+// A 1x1 texture of a single color, for materials described
+// by values rather than texture files
+// --------------------------------------------------------
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Game::CreateSolidTexture(DirectX::XMFLOAT4 color)
+{
+	unsigned char pixel[4] = {
+		(unsigned char)(fminf(fmaxf(color.x, 0.0f), 1.0f) * 255.0f + 0.5f),
+		(unsigned char)(fminf(fmaxf(color.y, 0.0f), 1.0f) * 255.0f + 0.5f),
+		(unsigned char)(fminf(fmaxf(color.z, 0.0f), 1.0f) * 255.0f + 0.5f),
+		(unsigned char)(fminf(fmaxf(color.w, 0.0f), 1.0f) * 255.0f + 0.5f) };
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = 1;
+	desc.Height = 1;
+	desc.MipLevels = 1;
+	desc.ArraySize = 1;
+	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_IMMUTABLE;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	D3D11_SUBRESOURCE_DATA data = {};
+	data.pSysMem = pixel;
+	data.SysMemPitch = sizeof(pixel);
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	Graphics::Device->CreateTexture2D(&desc, &data, texture.GetAddressOf());
+	Graphics::Device->CreateShaderResourceView(texture.Get(), 0, srv.GetAddressOf());
+	return srv;
 }
 
 
@@ -446,10 +675,49 @@ void Game::Update(float deltaTime, float totalTime)
 	if (Input::KeyDown(VK_ESCAPE))
 		Window::Quit();
 	ResetUI(deltaTime);
+
+	// The camera follows input every frame, while everything else
+	// moves in fixed steps and is drawn between the last two
 	cameras[currentCamIndex]->Update(deltaTime);
+	unsigned int steps = simulationTime.Advance(deltaTime);
+	for (unsigned int s = 0; s < steps; s++)
+	{
+		for (std::shared_ptr<InterpolatedTransform>& t : simulatedTransforms)
+			t->BeginStep();
+		Simulate(simulationTime.GetStepLength());
+	}
+	for (std::shared_ptr<InterpolatedTransform>& t : simulatedTransforms)
+		t->Apply(simulationTime.GetAlpha());
+
+	// Animations are sampled part way into the next step rather than
+	// interpolated, since they're just a function of time
+	animations.Sample(simulationTime.GetAlpha() * simulationTime.GetStepLength());
+
+	// Right clicking picks whatever's under the mouse
+	if (Input::MouseRightPress())
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		MeshBvh::Ray ray = SceneQuery::GetScreenRay(cameras[currentCamIndex],
+			(float)Input::GetMouseX(), (float)Input::GetMouseY(), (float)Window::Width(), (float)Window::Height());
+		SceneQuery::Raycast(entities, ray, pickHit);
+		pickTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
 	BuildUI();
 }
 
+// --------------------------------------------------------
+// Changes only simulated state, never what's drawn, so the
+// result depends on the number of steps and not on frame
+// times
+// --------------------------------------------------------
+void Game::Simulate(float stepLength)
+{
+	// The helix spins
+	simulatedTransforms[0]->Rotate(stepLength, -stepLength, 0);
+
+	animations.Advance(stepLength);
+}
+
 
 // --------------------------------------------------------
 // Clear the screen, redraw everything, present to the user
@@ -461,84 +729,138 @@ void Game::Draw(float deltaTime, float totalTime)
 	// - At the beginning of Game::Draw() before drawing *anything*
 	{
 
+		// Start recording the frame
+		Graphics::Commands.Clear();
+
 		// Clear the back buffer (erase what's on screen) and depth buffer
-		Graphics::Context->ClearRenderTargetView(Graphics::BackBufferRTV.Get(),	color);
-		Graphics::Context->ClearDepthStencilView(Graphics::DepthBufferDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+		Graphics::Commands.ClearRenderTarget(Graphics::BackBufferRTV.Get(), color);
+		Graphics::Commands.ClearDepth(Graphics::DepthBufferDSV.Get(), 1.0f);
+
+		// Last frame's UI rebound the input assembler behind the arena's back
+		MeshArena::GetShared()->BeginFrame();
+
+		// Every transform that moved since last frame gets its
+		// matrices rebuilt in one batch, before anything reads them
+		TransformPool::GetShared()->Update();
+
+		// Counts entities that did or didn't rewrite their matrices
+		GameEntity::ResetUploadStats();
+
+		// The first light's shadow cascades follow the camera
+		std::shared_ptr<Camera> camera = cameras[currentCamIndex];
+		cascadeCount = ShadowCascades::Fit(shadowSettings, camera->GetView(), camera->GetFov(), camera->GetAspectRatio(),
+			camera->GetNearClip(), camera->GetFarClip(), lights[0].Direction, cascades);
+
+		// Boxes are gathered once, then culled for each pass
+		std::chrono::high_resolution_clock::time_point cullStart = std::chrono::high_resolution_clock::now();
+		EntityCulling::Gather(entities, entityBounds);
+		for (int c = 0; c < cascadeCount; c++)
+			EntityCulling::Cull(ShadowCascades::GetFrustum(cascades[c]), entityBounds, shadowCasters[c]);
+		EntityCulling::Cull(EntityCulling::GetFrustum(camera), entityBounds, visibleEntities);
+
+		// Then whatever the big occluders hide is dropped too
+		occludedCount = 0;
+		if (occlusionCulling)
+		{
+			XMFLOAT4X4 view = camera->GetView();
+			XMFLOAT4X4 proj = camera->GetProj();
+			XMFLOAT4X4 viewProjection;
+			XMStoreFloat4x4(&viewProjection, XMLoadFloat4x4(&view) * XMLoadFloat4x4(&proj));
+			occlusion.Begin(viewProjection);
+			for (unsigned int index : visibleEntities)
+			{
+				const MeshBvh::Tree& tree = entities[index]->GetMesh()->GetBvh();
+				float extent = fmaxf(entityBounds.ExtentX[index], fmaxf(entityBounds.ExtentY[index], entityBounds.ExtentZ[index]));
+				if (extent >= minOccluderExtent && tree.Triangles.size() <= maxOccluderTriangles)
+					occlusion.AddOccluder(tree, entities[index]->GetTransform()->GetWorldMatrix());
+			}
+			occlusion.Rasterize();
 
-		
+			size_t inView = visibleEntities.size();
+			EntityCulling::RemoveOccluded(occlusion, entityBounds, visibleEntities);
+			occludedCount = (unsigned int)(inView - visibleEntities.size());
+		}
+		cullTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - cullStart).count();
 	}
 	
+	std::chrono::high_resolution_clock::time_point recordStart = std::chrono::high_resolution_clock::now();
+
 	// Shadow stuff needs to happen BEFORE the frame starts to render
-	Graphics::Context->ClearDepthStencilView(shadowDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
-	ID3D11RenderTargetView* nullRTV{};
-	Graphics::Context->OMSetRenderTargets(1, &nullRTV, shadowDSV.Get());
-	Graphics::Context->RSSetState(shadowRasterizer.Get());
-
-
-	D3D11_VIEWPORT viewport = {};
-	viewport.Width = 1024.0f;
-	viewport.Height = 1024.0f;
-	viewport.MaxDepth = 1.0f;
-	Graphics::Context->RSSetViewports(1, &viewport);
-
-	shadowVS->SetShader();
-	shadowVS->SetMatrix4x4("view", lightViewMatrix);
-	shadowVS->SetMatrix4x4("projection", lightProjectionMatrix);
-	Graphics::Context->PSSetShader(0, 0, 0);
-	// Loop and draw all entities
-	for (auto& e : entities)
+	Graphics::Commands.ClearDepth(shadowDSV.Get(), 1.0f);
+	Graphics::Commands.SetRenderTargets(0, shadowDSV.Get());
+	Graphics::Commands.SetRasterizerState(shadowRasterizer.Get());
+
+	Graphics::Commands.SetPixelShader(0);
+	// Each cascade draws the entities inside its own frustum into
+	// its own square of the atlas
+	float shadowSize = (float)shadowSettings.Resolution;
+	for (int c = 0; c < cascadeCount; c++)
 	{
-		shadowVS->SetMatrix4x4("world", e->GetTransform()->GetWorldMatrix());
-		shadowVS->CopyAllBufferData();
-		// Draw the mesh directly to avoid the entity's material
-		e->GetMesh()->Draw();
+		Graphics::Commands.SetViewport(shadowSize * c, 0.0f, shadowSize, shadowSize);
+
+		for (unsigned int index : shadowCasters[c])
+		{
+			std::shared_ptr<GameEntity>& e = entities[index];
+			// Pick the shadow shader that matches the mesh's vertex layout
+			bool packed = e->GetMesh()->GetVertexFormat() == VertexFormat::Packed;
+			std::shared_ptr<SimpleVertexShader> vs = packed ? shadowPackedVS : shadowVS;
+			vs->SetShader();
+			e->BindObjectConstants();
+			vs->SetMatrix4x4("view", cascades[c].View);
+			vs->SetMatrix4x4("projection", cascades[c].Projection);
+			if (packed)
+			{
+				vs->SetFloat3("positionOffset", e->GetMesh()->GetQuantization().Offset);
+				vs->SetFloat3("positionScale", e->GetMesh()->GetQuantization().Scale);
+			}
+			vs->CopyBufferData("externalData");
+			// Draw the mesh directly to avoid the entity's material
+			e->GetMesh()->Draw();
+		}
 	}
 
-	viewport.Width = (float)Window::Width();
-	viewport.Height = (float)Window::Height();
-	Graphics::Context->RSSetViewports(1, &viewport);
-	Graphics::Context->OMSetRenderTargets(
-		1,
-		Graphics::BackBufferRTV.GetAddressOf(),
-		Graphics::DepthBufferDSV.Get());
-	Graphics::Context->RSSetState(0);
+	Graphics::Commands.SetViewport(0.0f, 0.0f, (float)Window::Width(), (float)Window::Height());
+	Graphics::Commands.SetRenderTargets(Graphics::BackBufferRTV.Get(), Graphics::DepthBufferDSV.Get());
+	Graphics::Commands.SetRasterizerState(0);
 
 	// Post process
 	const float num[4] = { 0.0f,0.0f,0.0f,1.0f };
-	Graphics::Context->ClearRenderTargetView(ppRTV.Get(), num);
-	Graphics::Context->OMSetRenderTargets(1, ppRTV.GetAddressOf(), Graphics::DepthBufferDSV.Get());
+	Graphics::Commands.ClearRenderTarget(ppRTV.Get(), num);
+	Graphics::Commands.SetRenderTargets(ppRTV.Get(), Graphics::DepthBufferDSV.Get());
 
 	// DRAW geometry
 	// - These steps are generally repeated for EACH object you draw
 	// - Other Direct3D calls will also be necessary to do more complex things
 	if (showTriangle)
 	{
-		for (int i=0;i<entities.size(); i++) {
-
-			entities[i]->GetMaterial()->GetVertexShader()->SetMatrix4x4("lightView", lightViewMatrix);
-			entities[i]->GetMaterial()->GetVertexShader()->SetMatrix4x4("lightProjection", lightProjectionMatrix);
-
-			entities[i]->GetMaterial()->GetPixelShader()->SetFloat3("ambient", ambientColor);
-
-			entities[i]->GetMaterial()->GetPixelShader()->SetShaderResourceView("ShadowMap", shadowSRV);
-			entities[i]->GetMaterial()->GetPixelShader()->SetSamplerState("ShadowSampler", shadowSampler);
-
-			entities[i]->GetMaterial()->GetPixelShader()->SetData("lights", &lights[0], sizeof(Light) * (int)lights.size());
-
-			entities[i]->Draw(cameras[currentCamIndex]);
-		}
-		float sinWave = (float)sin(totalTime);
-
-
-		entities[5].get()->GetTransform()->SetScale(50, 1, 50);
-
-		entities[2].get()->GetTransform()->Rotate(deltaTime, -deltaTime, 0);
-
+		// Pixels are shadowed by the first cascade that covers them
+		XMFLOAT4X4 shadowViewProjections[ShadowCascades::MaxCascades] = {};
+		for (int c = 0; c < cascadeCount; c++)
+			shadowViewProjections[c] = cascades[c].ViewProjection;
+
+		// Sorted by shader, material, mesh then depth, so each is
+		// only set when it changes
+		renderQueue.Begin(cameras[currentCamIndex]);
+		for (unsigned int i : visibleEntities)
+			renderQueue.Add(entities[i].get());
+		renderQueue.Sort();
+
+		// The frame's data goes to each pixel shader as it's set
+		renderQueue.Submit([&](std::shared_ptr<SimplePixelShader> ps) {
+			ps->SetFloat3("ambient", ambientColor);
+
+			ps->SetShaderResourceView("ShadowMap", shadowSRV);
+			ps->SetSamplerState("ShadowSampler", shadowSampler);
+			ps->SetData("shadowViewProjections", shadowViewProjections, sizeof(XMFLOAT4X4) * cascadeCount);
+			ps->SetInt("cascadeCount", cascadeCount);
+
+			ps->SetData("lights", &lights[0], sizeof(Light) * (int)lights.size());
+		});
 		sky->Draw(cameras[currentCamIndex]);
 	}
 
 	// Back to the screen (no depth buffer necessary at this point)
-	Graphics::Context->OMSetRenderTargets(1, Graphics::BackBufferRTV.GetAddressOf(), 0);
+	Graphics::Commands.SetRenderTargets(Graphics::BackBufferRTV.Get(), 0);
 
 	// Activate shaders and bind resources
 	// Also set any required cbuffer data (not shown)
@@ -568,10 +890,27 @@ void Game::Draw(float deltaTime, float totalTime)
 	CustomPPPS->SetInt("enabled",ppIsEnabled);
 	CustomPPPS->CopyAllBufferData();
 
-	Graphics::Context->Draw(3, 0); // Draw exactly 3 vertices (one triangle)
+	Graphics::Commands.Draw(3, 0); // Draw exactly 3 vertices (one triangle)
+
+	Graphics::Commands.ClearShaderResources(ShaderStage::Pixel);
 
-	ID3D11ShaderResourceView* nullSRVs[128] = {};
-	Graphics::Context->PSSetShaderResources(0, 128, nullSRVs);
+	// Check the frame without drawing it (if validating), then
+	// draw it for real (the null backend starts from nothing each
+	// frame, as the frame sets all the state it draws with)
+	std::chrono::high_resolution_clock::time_point recordEnd = std::chrono::high_resolution_clock::now();
+	if (validateCommands)
+	{
+		commandValidation.Reset();
+		commandValidation.Execute(Graphics::Commands);
+	}
+	std::chrono::high_resolution_clock::time_point validateEnd = std::chrono::high_resolution_clock::now();
+	commandBackend->Execute(Graphics::Commands);
+	std::chrono::high_resolution_clock::time_point executeEnd = std::chrono::high_resolution_clock::now();
+	recordTime = std::chrono::duration<double, std::milli>(recordEnd - recordStart).count();
+	validateTime = std::chrono::duration<double, std::milli>(validateEnd - recordEnd).count();
+	executeTime = std::chrono::duration<double, std::milli>(executeEnd - validateEnd).count();
+	recordedCommands = (unsigned int)Graphics::Commands.GetCommands().size();
+	recordedBytes = Graphics::Commands.GetDataSize();
 
 
 	// Frame END
@@ -645,6 +984,7 @@ void Game::BuildUI() {
 			ImGui::Text("Space: Up");
 			ImGui::Text("X: Down");
 			ImGui::Text("Hold Left Mouse Button: Look Around");
+			ImGui::Text("Right Mouse Button: Pick");
 			ImGui::TreePop();
 		}
 		XMFLOAT3 pos = cameras[currentCamIndex]->GetPosition();
@@ -652,6 +992,11 @@ void Game::BuildUI() {
 		ImGui::Text("Field of View: %.1f Degrees", cameras[currentCamIndex]->GetFov() * (180/3.141598623));
 		ImGui::TreePop();
 	}
+	if (pickTime >= 0.0 && pickHit.Entity >= 0)
+		ImGui::Text("Picked: Entity %d, submesh %d, triangle %u at %.2f units (%.3f ms)",
+			pickHit.Entity, pickHit.Submesh, pickHit.Triangle, pickHit.Distance, pickTime);
+	else if (pickTime >= 0.0)
+		ImGui::Text("Picked: Nothing (%.3f ms)", pickTime);
 	static bool checked = true;
 	if (ImGui::Checkbox("Show Triangle",&checked)) {
 		showTriangle = !showTriangle;
@@ -669,18 +1014,44 @@ void Game::BuildUI() {
 				XMFLOAT3 pos = eTransform->GetPosition();
 				XMFLOAT3 rot = eTransform->GetPitchYawRoll();
 				XMFLOAT3 scale = eTransform->GetScale();
-				
-				
+
+				// Simulated entities pick up edits as their new state (see
+				// InterpolatedTransform), but animation tracks overwrite
+				// whatever they drive every frame, so those fields are locked
+				unsigned int slot = eTransform->GetPoolSlot();
+				ImGui::BeginDisabled(animations.IsAnimated(slot, AnimationClip::Channel::Position));
 				if (ImGui::DragFloat3("Position", &pos.x,0.01f)) {
 					eTransform->SetPosition(pos);
 				}
+				ImGui::EndDisabled();
+				ImGui::BeginDisabled(animations.IsAnimated(slot, AnimationClip::Channel::Rotation));
 				if (ImGui::DragFloat3("Rotation", &rot.x,0.01f)) {
 					eTransform->SetRotation(rot);
 				}
+				ImGui::EndDisabled();
+				ImGui::BeginDisabled(animations.IsAnimated(slot, AnimationClip::Channel::Scale));
 				if (ImGui::DragFloat3("Scale", &scale.x,0.01f)) {
 					eTransform->SetScale(scale);
 				}
+				ImGui::EndDisabled();
 				ImGui::Text("Mesh Indices: %d", entities[i]->GetMesh()->GetIndexCount());
+
+				// Attaching keeps the entity where it is, and then it
+				// follows its parent around (-1 for no parent)
+				int parent = -1;
+				for (int p = 0; p < entities.size(); p++)
+				{
+					if (entities[p]->GetTransform().get() == eTransform->GetParent())
+						parent = p;
+				}
+				if (ImGui::InputInt("Parent Entity", &parent) && parent >= -1 && parent < (int)entities.size())
+				{
+					try
+					{
+						eTransform->SetParent(parent >= 0 ? entities[parent]->GetTransform().get() : nullptr);
+					}
+					catch (const std::invalid_argument&) {}
+				}
 				ImGui::PushID(i);
 				if (ImGui::TreeNode("","Entity %d material",i)) {
 					XMFLOAT2 uvScale = entities[i]->GetMaterial()->GetUVScale();
@@ -709,14 +1080,118 @@ void Game::BuildUI() {
 		}
 		ImGui::TreePop();
 	}
+	// Transform UI
+	if (ImGui::TreeNode("Transforms")) {
+		TransformPool::Stats transformStats = TransformPool::GetShared()->GetStats();
+		ImGui::Text("Pool: %u transforms (%u slots)", transformStats.TransformCount, transformStats.Capacity);
+		ImGui::Text("Last update: %u local and %u world matrices in %.3f ms",
+			transformStats.UpdatedCount, transformStats.WorldUpdatedCount, transformStats.UpdateTime);
+		FixedTimestep::Stats simulationStats = simulationTime.GetStats();
+		ImGui::Text("Simulation: %llu steps of %.1f ms (%u this frame), %.2f s dropped",
+			simulationStats.StepCount, simulationTime.GetStepLength() * 1000.0f,
+			simulationStats.FrameStepCount, simulationStats.DroppedTime);
+		GameEntity::UploadStats uploadStats = GameEntity::GetUploadStats();
+		ImGui::Text("Object constants: %u uploaded, %u already current",
+			uploadStats.Uploaded, uploadStats.Skipped);
+		ImGui::TreePop();
+	}
+	// Animation UI
+	if (ImGui::TreeNode("Animation")) {
+		AnimationSampler::Stats animationStats = animations.GetStats();
+		ImGui::Text("%u clips playing, %u tracks", animationStats.InstanceCount, animationStats.TrackCount);
+		ImGui::Text("Last sample: %.3f ms (%u key searches)", animationStats.SampleTime, animationStats.SearchCount);
+		ImGui::TreePop();
+	}
+	// Culling UI
+	if (ImGui::TreeNode("Culling")) {
+		ImGui::Text("Camera: %u of %u entities drawn", (unsigned int)visibleEntities.size(), (unsigned int)entities.size());
+		for (int c = 0; c < cascadeCount; c++)
+			ImGui::Text("Shadow cascade %d: %u of %u entities drawn", c, (unsigned int)shadowCasters[c].size(), (unsigned int)entities.size());
+		ImGui::Text("Gathering and culling: %.3f ms", cullTime);
+		ImGui::Checkbox("Occlusion culling", &occlusionCulling);
+		if (occlusionCulling)
+		{
+			OcclusionBuffer::Stats occlusionStats = occlusion.GetStats();
+			ImGui::Text("%u occluders (%u of %u triangles drawn) in %.3f ms, %u entities hidden",
+				occlusionStats.OccluderCount, occlusionStats.RasterizedCount, occlusionStats.TriangleCount,
+				occlusionStats.RasterizeTime, occludedCount);
+			if (ImGui::Button("Save Occlusion Buffer"))
+				occlusionImageResult = occlusion.WriteImage("occlusion.bmp") ? "Saved occlusion.bmp" : "Couldn't write occlusion.bmp";
+			if (!occlusionImageResult.empty())
+				ImGui::Text("%s", occlusionImageResult.c_str());
+		}
+		ImGui::TreePop();
+	}
+	// Render queue UI
+	if (ImGui::TreeNode("Render Queue")) {
+		RenderQueue::Stats queueStats = renderQueue.GetStats();
+		ImGui::Text("%u packets, sorted in %.3f ms, submitted in %.3f ms", queueStats.PacketCount, queueStats.SortTime, queueStats.SubmitTime);
+		ImGui::Text("Without the queue: %u of each state change", queueStats.PacketCount);
+		ImGui::Text("In the order added: %u vertex shaders, %u pixel shaders, %u materials, %u meshes",
+			queueStats.Unsorted.VertexShaders, queueStats.Unsorted.PixelShaders, queueStats.Unsorted.Materials, queueStats.Unsorted.Meshes);
+		ImGui::Text("Sorted: %u vertex shaders, %u pixel shaders, %u materials, %u meshes",
+			queueStats.Sorted.VertexShaders, queueStats.Sorted.PixelShaders, queueStats.Sorted.Materials, queueStats.Sorted.Meshes);
+		ImGui::TreePop();
+	}
+	// Command UI
+	if (ImGui::TreeNode("Commands")) {
+		NullBackend::Stats commandStats = commandValidation.GetStats();
+		ImGui::Text("%u commands (%.1f KB of data), passes recorded in %.3f ms", recordedCommands, recordedBytes / 1024.0f, recordTime);
+		ImGui::Text("Null backend: %.3f ms, D3D11 backend: %.3f ms", validateTime, executeTime);
+		ImGui::Checkbox("Validate every frame", &validateCommands);
+		if (validateCommands)
+		{
+			ImGui::Text("%u draws (%llu vertices and indices)", commandStats.DrawCount, (unsigned long long)commandStats.VertexCount);
+			ImGui::Text("Shader changes: %u, other state changes: %u", commandStats.ShaderChanges, commandStats.StateChanges);
+			ImGui::Text("Buffer binds: %u, resource binds: %u, redundant binds: %u", commandStats.BufferBinds, commandStats.ResourceBinds, commandStats.RedundantBinds);
+			ImGui::Text("Buffer updates: %u (%.1f KB)", commandStats.UpdateCount, commandStats.UpdateBytes / 1024.0f);
+			ImGui::Text("Errors: %u", commandStats.ErrorCount);
+			for (const std::string& error : commandValidation.GetErrors())
+				ImGui::Text("%s", error.c_str());
+		}
+		else
+		{
+			ImGui::Text("Validate for draw, state and error counts");
+		}
+		ImGui::TreePop();
+	}
 	// Mesh UI
 	if (ImGui::TreeNode("Meshes")) {
+		MeshArena::Stats arenaStats = MeshArena::GetShared()->GetStats();
+		ImGui::Text("Arena: %u meshes in %u pages", arenaStats.AllocationCount, arenaStats.PageCount);
+		ImGui::Text("Vertices: %.2f of %.2f MB (%.0f%% fragmented)",
+			arenaStats.VertexBytesUsed / (1024.0 * 1024.0), arenaStats.VertexBytes / (1024.0 * 1024.0), arenaStats.VertexFragmentation * 100.0f);
+		ImGui::Text("Indices: %.2f of %.2f MB (%.0f%% fragmented)",
+			arenaStats.IndexBytesUsed / (1024.0 * 1024.0), arenaStats.IndexBytes / (1024.0 * 1024.0), arenaStats.IndexFragmentation * 100.0f);
+		ImGui::Text("Buffer binds: %u (%u skipped)", arenaStats.PageBinds, arenaStats.SkippedBinds);
+		ImGui::Text("glTF: %u primitives, %u with vertices in place, %u with indices in place",
+			gltfStats.PrimitiveCount, gltfStats.InPlaceVertexPrimitives, gltfStats.InPlaceIndexPrimitives);
+		ImGui::Text("glTF conversion: %u attributes, %.1f of %.1f KB",
+			gltfStats.ConvertedAttributes, gltfStats.ConvertedBytes / 1024.0, gltfStats.BinaryBytes / 1024.0);
 		for (int i = 0; i < meshes.size();i++) {
 			ImGui::PushID(i);
 			if (ImGui::TreeNode("", "Mesh %d ",i)) {
 				ImGui::Text("Triangles: %d", meshes[i]->GetIndexCount() / 3);
 				ImGui::Text("Vertices: %d", meshes[i]->GetVertexCount());
+				ImGui::Text("Vertices Before Welding: %d", meshes[i]->GetSourceVertexCount());
+				ImGui::Text("Vertex Format: %s (%u bytes)",
+					meshes[i]->GetVertexFormat() == VertexFormat::Packed ? "Packed" : "Full",
+					meshes[i]->GetVertexStride());
 				ImGui::Text("Indices: %d", meshes[i]->GetIndexCount());
+				ImGui::Text("ACMR: %.3f -> %.3f", meshes[i]->GetCacheStats().Before.ACMR, meshes[i]->GetCacheStats().After.ACMR);
+				ImGui::Text("ATVR: %.3f -> %.3f", meshes[i]->GetCacheStats().Before.ATVR, meshes[i]->GetCacheStats().After.ATVR);
+				ImGui::Text("BVH: %d nodes", (int)meshes[i]->GetBvh().Nodes.size());
+				if (meshes[i]->GetClusterCount() > 0)
+					ImGui::Text("Clusters: %d of %d visible (%.3f ms to cull)",
+						meshes[i]->GetVisibleClusterCount(), meshes[i]->GetClusterCount(), meshes[i]->GetClusterCullTime());
+				for (int lod = 1; lod < meshes[i]->GetLodCount(); lod++)
+					ImGui::Text("LOD %d: %d triangles (error %.3f)", lod, meshes[i]->GetLod(lod).IndexCount / 3, meshes[i]->GetLod(lod).Error);
+				if (meshes[i]->GetSubmeshCount() > 1)
+				{
+					for (int sub = 0; sub < meshes[i]->GetSubmeshCount(); sub++)
+						ImGui::Text("Submesh %d: %d triangles (material \"%s\")", sub,
+							meshes[i]->GetSubmesh(sub).Lods[0].IndexCount / 3, meshes[i]->GetSubmesh(sub).Material.c_str());
+				}
 				ImGui::TreePop();
 			}
 			ImGui::PopID();
@@ -738,7 +1213,13 @@ void Game::BuildUI() {
 		ImGui::TreePop();
 	}
 	if (ImGui::TreeNode("Shadow Map")) {
-		ImGui::Image((ImTextureID)shadowSRV.Get(), ImVec2(256, 256));
+		ImGui::SliderInt("Cascades", &shadowSettings.CascadeCount, 1, ShadowCascades::MaxCascades);
+		ImGui::SliderFloat("Shadow distance", &shadowSettings.MaxDistance, 5.0f, 500.0f);
+		ImGui::SliderFloat("Split blend", &shadowSettings.SplitBlend, 0.0f, 1.0f);
+		for (int c = 0; c < cascadeCount; c++)
+			ImGui::Text("Cascade %d: %.2f to %.2f, %.3f units per texel", c, cascades[c].NearDepth, cascades[c].FarDepth, cascades[c].TexelSize);
+		ImGui::Image((ImTextureID)shadowSRV.Get(), ImVec2(128.0f * ShadowCascades::MaxCascades, 128.0f));
+		ImGui::TreePop();
 	}
 	if (ImGui::TreeNode("Post Process")) {
 		if (ImGui::TreeNode("Blur")) {
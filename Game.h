@@ -5,10 +5,19 @@
 #include <memory>
 #include "Mesh.h"
 #include <vector>
+#include <string>
+#include <unordered_map>
 #include "GameEntity.h"
 #include "Camera.h"
 #include "Lights.h"
 #include "Sky.h"
+#include "FixedTimestep.h"
+#include "InterpolatedTransform.h"
+#include "AnimationSampler.h"
+#include "EntityCulling.h"
+#include "ShadowCascades.h"
+#include "RenderQueue.h"
+#include "NullBackend.h"
 
 class Game
 {
@@ -29,9 +38,20 @@ private:
 
 	// Initialization helper methods - feel free to customize, combine, remove, etc.
 	void CreateGeometry();
+	std::shared_ptr<Material> CreateMaterial(const MtlLoader::MaterialDescription& description,
+		std::shared_ptr<SimpleVertexShader> vs, std::shared_ptr<SimpleVertexShader> packedVS,
+		std::shared_ptr<SimplePixelShader> ps, Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler);
+	std::shared_ptr<Material> CreateMaterial(const GltfLoader::MaterialDesc& description,
+		const std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>>& images,
+		std::shared_ptr<SimpleVertexShader> vs, std::shared_ptr<SimpleVertexShader> packedVS,
+		std::shared_ptr<SimplePixelShader> ps, Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler);
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateSolidTexture(DirectX::XMFLOAT4 color);
 	void ResetUI(float deltaTime);
 	void BuildUI();
 
+	// One fixed length step of everything that moves by itself
+	void Simulate(float stepLength);
+
 	// Note the usage of ComPtr below
 	//  - This is a smart pointer for objects that abide by the
 	//     Component Object Model, which DirectX objects do
@@ -52,11 +72,14 @@ private:
 	std::shared_ptr<Sky> sky;
 
 	// Shadows
+	// - The shadow map is an atlas of every cascade's square, side by side
 	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> shadowDSV;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowSRV;
-	DirectX::XMFLOAT4X4 lightViewMatrix;
-	DirectX::XMFLOAT4X4 lightProjectionMatrix;
+	ShadowCascades::Settings shadowSettings;
+	ShadowCascades::Cascade cascades[ShadowCascades::MaxCascades];
+	int cascadeCount = 0;
 	std::shared_ptr<SimpleVertexShader> shadowVS;
+	std::shared_ptr<SimpleVertexShader> shadowPackedVS;	// For meshes using PackedVertex
 	// Shadow Rasterizer object
 	Microsoft::WRL::ComPtr<ID3D11RasterizerState> shadowRasterizer;
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> shadowSampler;
@@ -78,9 +101,40 @@ private:
 	std::shared_ptr<Mesh> quad_2F;
 	std::shared_ptr<Mesh> sphere;
 	std::shared_ptr<Mesh> torus;
+	std::shared_ptr<Mesh> pedestal;
 	std::vector<std::shared_ptr<Mesh>> meshes;
 	std::vector<std::shared_ptr<GameEntity>> entities;
 
+	// Every entity's world space box, gathered each frame, and
+	// the entities the camera and each shadow cascade can see
+	EntityCulling::Bounds entityBounds;
+	std::vector<unsigned int> visibleEntities;
+	std::vector<unsigned int> shadowCasters[ShadowCascades::MaxCascades];
+
+	// The biggest simple meshes in view are drawn into this on
+	// the CPU, and whatever they hide isn't drawn at all
+	OcclusionBuffer occlusion;
+
+	// The main pass's draws, sorted so shared state is only set once
+	RenderQueue renderQueue;
+
+	// Each frame's commands are checked and counted by the null
+	// backend (when validating), then carried out by the D3D11 one
+	std::shared_ptr<CommandBackend> commandBackend;
+	NullBackend commandValidation;
+
+	// The simulation runs in fixed steps, and what's drawn is
+	// interpolated between the last two
+	FixedTimestep simulationTime;
+	std::vector<std::shared_ptr<InterpolatedTransform>> simulatedTransforms;
+	AnimationSampler animations;
+
+	// Textures loaded for materials described by .mtl files, by path
+	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> mtlTextures;
+
+	// How much of the glTF scene could be used straight from its file
+	GltfLoader::Stats gltfStats;
+
 	// Camera
 	std::shared_ptr<Camera> mainCam;
 	std::shared_ptr<Camera> secondCam;
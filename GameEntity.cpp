@@ -3,10 +3,38 @@
 #include "Graphics.h"
 #include "Camera.h"
 
+// Anonymous namespace for the upload counts, which are private to this file
+namespace
+{
+	GameEntity::UploadStats uploadStats = {};
+}
+
 GameEntity::GameEntity(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material) :
-	mesh(mesh), material(material)
+	mesh(mesh), materials(mesh->GetSubmeshCount(), material)
 {
 	transform = std::make_shared<Transform>();
+	CreateObjectConstants();
+}
+
+GameEntity::GameEntity(std::shared_ptr<Mesh> mesh, std::vector<std::shared_ptr<Material>> submeshMaterials) :
+	mesh(mesh), materials(submeshMaterials)
+{
+	// Submeshes without a material of their own use the last one given
+	materials.resize(mesh->GetSubmeshCount(), materials.empty() ? nullptr : materials.back());
+	transform = std::make_shared<Transform>();
+	CreateObjectConstants();
+}
+
+void GameEntity::CreateObjectConstants()
+{
+	D3D11_BUFFER_DESC cbd = {};
+	cbd.Usage = D3D11_USAGE_DEFAULT;	// Rewritten with UpdateSubresource(), like SimpleShader's
+	cbd.ByteWidth = sizeof(ObjectConstants);
+	cbd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	Graphics::Device->CreateBuffer(&cbd, 0, objectConstants.GetAddressOf());
+
+	// Transform versions are never zero, so the first bind uploads
+	uploadedVersion = 0;
 }
 
 std::shared_ptr<Mesh> GameEntity::GetMesh()
@@ -19,37 +47,112 @@ std::shared_ptr<Transform> GameEntity::GetTransform()
 	return transform;
 }
 
-std::shared_ptr<Material> GameEntity::GetMaterial()
+std::shared_ptr<Material> GameEntity::GetMaterial(int submesh)
+{
+	return materials[submesh];
+}
+
+int GameEntity::GetMaterialCount()
+{
+	return (int)materials.size();
+}
+
+std::shared_ptr<SimpleVertexShader> GameEntity::GetVertexShader(int submesh)
 {
-	return material;
+	if (mesh->GetVertexFormat() == VertexFormat::Packed)
+		return materials[submesh]->GetPackedVertexShader();
+	return materials[submesh]->GetVertexShader();
 }
 
 void GameEntity::SetMaterial(std::shared_ptr<Material> material)
 {
-	this->material = material;
+	for (std::shared_ptr<Material>& m : materials)
+		m = material;
 }
 
+void GameEntity::SetMaterial(int submesh, std::shared_ptr<Material> material)
+{
+	materials[submesh] = material;
+}
+
+void GameEntity::BindObjectConstants()
+{
+	uint64_t version = transform->GetVersion();
+	if (version != uploadedVersion)
+	{
+		ObjectConstants constants = {};
+		constants.worldMatrix = transform->GetWorldMatrix();
+		constants.worldInvMatrix = transform->GetWorldInverseTransposeMatrix();
+		Graphics::Commands.UpdateBuffer(objectConstants.Get(), &constants, sizeof(ObjectConstants));
+		uploadedVersion = version;
+		uploadStats.Uploaded++;
+	}
+	else
+	{
+		uploadStats.Skipped++;
+	}
+
+	Graphics::Commands.SetConstantBuffer(ShaderStage::Vertex, 1, objectConstants.Get());
+}
+
+GameEntity::UploadStats GameEntity::GetUploadStats()
+{
+	return uploadStats;
+}
+
+void GameEntity::ResetUploadStats()
+{
+	uploadStats = {};
+}
+
+// --------------------------------------------------------
+// Binds the mesh's buffers once, then draws each run of
+// submeshes that share a material with a single DrawIndexed
+// (so a mesh with one material is still one draw)
+// - World matrices are only uploaded when the transform has
+//   changed since the last time (see BindObjectConstants())
+// --------------------------------------------------------
 void GameEntity::Draw(std::shared_ptr<Camera> cam)
 {
-	material->GetVertexShader()->SetShader();
-	material->GetPixelShader()->SetShader();
+	mesh->PrepareDraw(cam, transform->GetWorldMatrix());
+
+	int submeshCount = (int)materials.size();
+	for (int first = 0; first < submeshCount;)
+	{
+		int count = 1;
+		while (first + count < submeshCount && materials[first + count] == materials[first])
+			count++;
+
+		std::shared_ptr<Material> material = materials[first];
+		std::shared_ptr<SimpleVertexShader> vs = GetVertexShader(first);
+		vs->SetShader();
+		material->GetPixelShader()->SetShader();
+		BindObjectConstants();
+
+		//vs->SetFloat4("colorTint", material->GetColorTint());
+		vs->SetMatrix4x4("viewMatrix", cam->GetView());
+		vs->SetMatrix4x4("projMatrix", cam->GetProj());
 
-	//material->GetVertexShader()->SetFloat4("colorTint", material->GetColorTint());
-	material->GetVertexShader()->SetMatrix4x4("worldMatrix", transform->GetWorldMatrix());
-	material->GetVertexShader()->SetMatrix4x4("viewMatrix", cam->GetView());
-	material->GetVertexShader()->SetMatrix4x4("projMatrix", cam->GetProj());
-	material->GetVertexShader()->SetMatrix4x4("worldInvMatrix", transform->GetWorldInverseTransposeMatrix());
+		// Packed positions are stored relative to the mesh's bounds
+		if (mesh->GetVertexFormat() == VertexFormat::Packed)
+		{
+			vs->SetFloat3("positionOffset", mesh->GetQuantization().Offset);
+			vs->SetFloat3("positionScale", mesh->GetQuantization().Scale);
+		}
 
-	material->GetVertexShader()->CopyAllBufferData();
+		// Only the per-frame data, as ObjectData comes from BindObjectConstants()
+		vs->CopyBufferData("ExternalData");
 
-	material->GetPixelShader()->SetFloat4("colorTint", material->GetColorTint());
-	material->GetPixelShader()->SetFloat2("uvScale", material->GetUVScale());
-	material->GetPixelShader()->SetFloat2("uvOffset", material->GetUVOffset());
-	material->GetPixelShader()->SetFloat3("cameraPosition", cam->GetPosition());
-	material->GetPixelShader()->SetFloat("roughness", material->GetRoughness());
-	material->GetPixelShader()->CopyAllBufferData();
+		material->GetPixelShader()->SetFloat4("colorTint", material->GetColorTint());
+		material->GetPixelShader()->SetFloat2("uvScale", material->GetUVScale());
+		material->GetPixelShader()->SetFloat2("uvOffset", material->GetUVOffset());
+		material->GetPixelShader()->SetFloat3("cameraPosition", cam->GetPosition());
+		material->GetPixelShader()->SetFloat("roughness", material->GetRoughness());
+		material->GetPixelShader()->CopyAllBufferData();
 
-	material->PrepareMaterial();
+		material->PrepareMaterial();
 
-	mesh->Draw();
+		mesh->DrawSubmeshes(first, count);
+		first += count;
+	}
 }
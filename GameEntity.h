@@ -1,6 +1,10 @@
 #pragma once
 #include "stdio.h"
 #include "memory"
+#include "vector"
+#include <cstdint>
+#include <d3d11.h>
+#include <wrl/client.h>
 #include "Mesh.h"
 #include "Transform.h"
 #include "Camera.h"
@@ -11,16 +15,48 @@ class GameEntity
 private:
 	std::shared_ptr<Mesh> mesh;
 	std::shared_ptr<Transform> transform;
-	std::shared_ptr<Material> material;
+	std::vector<std::shared_ptr<Material>> materials;	// One per submesh of the mesh
+
+	// World matrices for the vertex shaders (ObjectData, register b1),
+	// and the transform version they were last written from
+	Microsoft::WRL::ComPtr<ID3D11Buffer> objectConstants;
+	uint64_t uploadedVersion;
+
+	void CreateObjectConstants();
 public:
+	// How many times entities had to rewrite their object constants
+	// since the last reset, and how many times they were still current
+	struct UploadStats
+	{
+		unsigned int Uploaded;
+		unsigned int Skipped;
+	};
+
+	// The material is used for every submesh
 	GameEntity(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material);
+	GameEntity(std::shared_ptr<Mesh> mesh, std::vector<std::shared_ptr<Material>> submeshMaterials);
 
 	std::shared_ptr<Mesh> GetMesh();
 	std::shared_ptr<Transform> GetTransform();
-	std::shared_ptr<Material> GetMaterial();
+	std::shared_ptr<Material> GetMaterial(int submesh = 0);
+	int GetMaterialCount();
 
+	// The material's vertex shader that matches the mesh's vertex format
+	std::shared_ptr<SimpleVertexShader> GetVertexShader(int submesh = 0);
+
+	// Replaces the material of every submesh
 	void SetMaterial(std::shared_ptr<Material> material);
+	void SetMaterial(int submesh, std::shared_ptr<Material> material);
+
+	// Rewrites the object constants if the transform changed since
+	// they were last written, then binds them to the vertex shader
+	// stage (after the shader's own SetShader(), which binds its
+	// unused copy of ObjectData to the same slot)
+	void BindObjectConstants();
 
 	void Draw(std::shared_ptr<Camera> cam);
+
+	static UploadStats GetUploadStats();
+	static void ResetUploadStats();
 };
 
@@ -0,0 +1,912 @@
+#include "GltfLoader.h"
+#include <stdexcept>
+#include <charconv>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <climits>
+
+using namespace DirectX;
+
+// Anonymous namespace for the JSON parser and accessor helpers,
+// which are private to this file
+namespace
+{
+	const uint32_t GlbMagic = 0x46546C67;		// "glTF"
+	const uint32_t JsonChunkType = 0x4E4F534A;	// "JSON"
+	const uint32_t BinChunkType = 0x004E4942;	// "BIN\0"
+
+	// glTF's component types, and primitive modes we can draw
+	enum ComponentType
+	{
+		Byte = 5120,
+		UnsignedByte = 5121,
+		Short = 5122,
+		UnsignedShort = 5123,
+		UnsignedInt = 5125,
+		Float = 5126
+	};
+
+	enum PrimitiveMode
+	{
+		Triangles = 4,
+		TriangleStrip = 5,
+		TriangleFan = 6
+	};
+
+	// --------------------------------------------------------
+	// Just enough JSON for glTF's description chunk: values
+	// are parsed into a tree, and objects keep their members
+	// in order (glTF objects are small, so finding a member
+	// is a linear search)
+	// --------------------------------------------------------
+	struct JsonValue
+	{
+		enum class Type { Null, Bool, Number, String, Array, Object };
+		Type ValueType = Type::Null;
+		bool Bool = false;
+		double Number = 0.0;
+		std::string String;
+		std::vector<JsonValue> Elements;
+		std::vector<std::pair<std::string, JsonValue>> Members;
+
+		const JsonValue* Find(const char* key) const
+		{
+			for (const auto& member : Members)
+			{
+				if (member.first == key)
+					return &member.second;
+			}
+			return nullptr;
+		}
+
+		// Member lookups with defaults, for the optional properties
+		// that make up most of glTF
+		int GetInt(const char* key, int defaultValue) const
+		{
+			const JsonValue* value = Find(key);
+			bool inRange = value && value->ValueType == Type::Number && value->Number >= INT_MIN && value->Number <= INT_MAX;
+			return inRange ? (int)value->Number : defaultValue;
+		}
+
+		float GetFloat(const char* key, float defaultValue) const
+		{
+			const JsonValue* value = Find(key);
+			return value && value->ValueType == Type::Number ? (float)value->Number : defaultValue;
+		}
+
+		bool GetBool(const char* key, bool defaultValue) const
+		{
+			const JsonValue* value = Find(key);
+			return value && value->ValueType == Type::Bool ? value->Bool : defaultValue;
+		}
+
+		std::string GetString(const char* key) const
+		{
+			const JsonValue* value = Find(key);
+			return value && value->ValueType == Type::String ? value->String : std::string();
+		}
+
+		// Fills in up to count numbers from an array member, leaving
+		// the rest of values alone
+		void GetFloats(const char* key, float* values, size_t count) const
+		{
+			const JsonValue* value = Find(key);
+			if (!value)
+				return;
+			for (size_t i = 0; i < count && i < value->Elements.size(); i++)
+				values[i] = (float)value->Elements[i].Number;
+		}
+
+		// Elements of an array member (empty if there's no such array)
+		const std::vector<JsonValue>& GetArray(const char* key) const
+		{
+			static const std::vector<JsonValue> empty;
+			const JsonValue* value = Find(key);
+			return value && value->ValueType == Type::Array ? value->Elements : empty;
+		}
+	};
+
+	class JsonParser
+	{
+	public:
+		JsonParser(const char* text, size_t length) : current(text), end(text + length) {}
+
+		JsonValue ParseDocument()
+		{
+			JsonValue value = ParseValue(0);
+			SkipWhitespace();
+			if (current != end)
+				Fail();
+			return value;
+		}
+
+	private:
+		// Nothing in glTF nests anywhere near this deep
+		static const int MaxDepth = 64;
+
+		const char* current;
+		const char* end;
+
+		[[noreturn]] void Fail()
+		{
+			throw std::invalid_argument("Error loading glTF: The JSON chunk is malformed");
+		}
+
+		void SkipWhitespace()
+		{
+			while (current < end && (*current == ' ' || *current == '\t' || *current == '\n' || *current == '\r'))
+				current++;
+		}
+
+		void Expect(const char* literal)
+		{
+			size_t length = strlen(literal);
+			if ((size_t)(end - current) < length || memcmp(current, literal, length) != 0)
+				Fail();
+			current += length;
+		}
+
+		JsonValue ParseValue(int depth)
+		{
+			SkipWhitespace();
+			if (current == end || depth > MaxDepth)
+				Fail();
+
+			JsonValue value;
+			switch (*current)
+			{
+			case '{':
+				value.ValueType = JsonValue::Type::Object;
+				current++;
+				SkipWhitespace();
+				if (current < end && *current == '}')
+				{
+					current++;
+					break;
+				}
+				while (true)
+				{
+					SkipWhitespace();
+					std::string key = ParseString();
+					SkipWhitespace();
+					Expect(":");
+					value.Members.emplace_back(std::move(key), ParseValue(depth + 1));
+					SkipWhitespace();
+					if (current < end && *current == ',')
+					{
+						current++;
+						continue;
+					}
+					Expect("}");
+					break;
+				}
+				break;
+
+			case '[':
+				value.ValueType = JsonValue::Type::Array;
+				current++;
+				SkipWhitespace();
+				if (current < end && *current == ']')
+				{
+					current++;
+					break;
+				}
+				while (true)
+				{
+					value.Elements.push_back(ParseValue(depth + 1));
+					SkipWhitespace();
+					if (current < end && *current == ',')
+					{
+						current++;
+						continue;
+					}
+					Expect("]");
+					break;
+				}
+				break;
+
+			case '"':
+				value.ValueType = JsonValue::Type::String;
+				value.String = ParseString();
+				break;
+
+			case 't':
+				Expect("true");
+				value.ValueType = JsonValue::Type::Bool;
+				value.Bool = true;
+				break;
+
+			case 'f':
+				Expect("false");
+				value.ValueType = JsonValue::Type::Bool;
+				break;
+
+			case 'n':
+				Expect("null");
+				break;
+
+			default:
+			{
+				// from_chars doesn't take a leading plus, and neither does JSON
+				std::from_chars_result result = std::from_chars(current, end, value.Number);
+				if (result.ec != std::errc())
+					Fail();
+				value.ValueType = JsonValue::Type::Number;
+				current = result.ptr;
+				break;
+			}
+			}
+			return value;
+		}
+
+		std::string ParseString()
+		{
+			Expect("\"");
+			std::string result;
+			while (true)
+			{
+				if (current == end)
+					Fail();
+
+				char c = *current++;
+				if (c == '"')
+					return result;
+				if (c != '\\')
+				{
+					result += c;
+					continue;
+				}
+
+				if (current == end)
+					Fail();
+				c = *current++;
+				switch (c)
+				{
+				case 'b': result += '\b'; break;
+				case 'f': result += '\f'; break;
+				case 'n': result += '\n'; break;
+				case 'r': result += '\r'; break;
+				case 't': result += '\t'; break;
+				case 'u':
+				{
+					// Encoded as UTF-8 (surrogate pairs come out as two
+					// separate characters, which only matters for names)
+					if (end - current < 4)
+						Fail();
+					unsigned int code = 0;
+					std::from_chars_result hex = std::from_chars(current, current + 4, code, 16);
+					if (hex.ec != std::errc() || hex.ptr != current + 4)
+						Fail();
+					current += 4;
+					if (code < 0x80)
+						result += (char)code;
+					else if (code < 0x800)
+					{
+						result += (char)(0xC0 | (code >> 6));
+						result += (char)(0x80 | (code & 0x3F));
+					}
+					else
+					{
+						result += (char)(0xE0 | (code >> 12));
+						result += (char)(0x80 | ((code >> 6) & 0x3F));
+						result += (char)(0x80 | (code & 0x3F));
+					}
+					break;
+				}
+				default: result += c; break;	// Quotes, backslashes and slashes
+				}
+			}
+		}
+	};
+
+	// --------------------------------------------------------
+	// Where an accessor's elements sit in the binary chunk,
+	// already checked to be in range
+	// --------------------------------------------------------
+	struct Accessor
+	{
+		const unsigned char* Data = nullptr;	// First element (null for an all-zero accessor)
+		size_t Stride = 0;
+		size_t Count = 0;
+		int ComponentType = 0;
+		int Components = 0;
+		bool Normalized = false;
+		int BufferView = -1;
+		const JsonValue* Json = nullptr;
+	};
+
+	size_t GetComponentSize(int componentType)
+	{
+		switch (componentType)
+		{
+		case Byte: case UnsignedByte: return 1;
+		case Short: case UnsignedShort: return 2;
+		case UnsignedInt: case Float: return 4;
+		default: return 0;
+		}
+	}
+
+	int GetComponentCount(const std::string& type)
+	{
+		if (type == "SCALAR") return 1;
+		if (type == "VEC2") return 2;
+		if (type == "VEC3") return 3;
+		if (type == "VEC4") return 4;
+		return 0;
+	}
+
+	Accessor GetAccessor(const JsonValue& document, int index, const unsigned char* bin, size_t binSize)
+	{
+		const std::vector<JsonValue>& accessors = document.GetArray("accessors");
+		if (index < 0 || index >= (int)accessors.size())
+			throw std::invalid_argument("Error loading glTF: A primitive references an accessor that doesn't exist");
+
+		const JsonValue& json = accessors[index];
+		Accessor accessor;
+		accessor.Json = &json;
+		int count = json.GetInt("count", -1);
+		if (count < 0)
+			throw std::invalid_argument("Error loading glTF: An accessor has no count");
+		accessor.Count = (size_t)count;
+		accessor.ComponentType = json.GetInt("componentType", 0);
+		accessor.Components = GetComponentCount(json.GetString("type"));
+		accessor.Normalized = json.GetBool("normalized", false);
+		accessor.BufferView = json.GetInt("bufferView", -1);
+
+		size_t elementSize = GetComponentSize(accessor.ComponentType) * accessor.Components;
+		if (elementSize == 0)
+			throw std::invalid_argument("Error loading glTF: An accessor has an unknown type");
+		if (json.Find("sparse"))
+			throw std::invalid_argument("Error loading glTF: Sparse accessors aren't supported");
+
+		// Without a buffer view, every element is zero
+		accessor.Stride = elementSize;
+		if (accessor.BufferView < 0)
+			return accessor;
+
+		const std::vector<JsonValue>& views = document.GetArray("bufferViews");
+		if (accessor.BufferView >= (int)views.size())
+			throw std::invalid_argument("Error loading glTF: An accessor references a buffer view that doesn't exist");
+
+		const JsonValue& view = views[accessor.BufferView];
+		if (view.GetInt("buffer", 0) != 0 || !bin)
+			throw std::invalid_argument("Error loading glTF: Only the .glb's own binary chunk is supported as a buffer");
+
+		// Negative values wrap around to sizes that fail the range checks,
+		// except for the stride, which glTF keeps below 256
+		size_t viewOffset = (size_t)view.GetInt("byteOffset", 0);
+		size_t viewLength = (size_t)view.GetInt("byteLength", 0);
+		size_t offset = (size_t)json.GetInt("byteOffset", 0);
+		int stride = view.GetInt("byteStride", 0);
+		if (stride < 0 || stride > 255)
+			throw std::invalid_argument("Error loading glTF: A buffer view has an invalid stride");
+		accessor.Stride = stride > 0 ? (size_t)stride : elementSize;
+
+		// The last element has to end within the view, and the view
+		// within the chunk
+		if (viewOffset > binSize || viewLength > binSize - viewOffset ||
+			(accessor.Count > 0 && (offset > viewLength ||
+				(accessor.Count - 1) * accessor.Stride + elementSize > viewLength - offset)))
+			throw std::invalid_argument("Error loading glTF: An accessor is out of range of its buffer");
+
+		accessor.Data = bin + viewOffset + offset;
+		return accessor;
+	}
+
+	// One component as a float, applying normalization
+	float ReadComponent(const unsigned char* data, int componentType, bool normalized)
+	{
+		switch (componentType)
+		{
+		case Float: { float value; memcpy(&value, data, 4); return value; }
+		case Byte: { int8_t value = (int8_t)data[0]; return normalized ? fmaxf(value / 127.0f, -1.0f) : value; }
+		case UnsignedByte: return normalized ? data[0] / 255.0f : data[0];
+		case Short: { int16_t value; memcpy(&value, data, 2); return normalized ? fmaxf(value / 32767.0f, -1.0f) : value; }
+		case UnsignedShort: { uint16_t value; memcpy(&value, data, 2); return normalized ? value / 65535.0f : value; }
+		case UnsignedInt: { uint32_t value; memcpy(&value, data, 4); return (float)value; }
+		default: return 0.0f;
+		}
+	}
+
+	// --------------------------------------------------------
+	// Copies one attribute into a member of every vertex (at
+	// byte offset member), in a single strided pass
+	// - Floats are copied as they are, anything else decoded
+	// - Components the accessor doesn't have are left alone
+	// --------------------------------------------------------
+	void CopyAttribute(const Accessor& accessor, std::vector<Vertex>& vertices, size_t member, int components)
+	{
+		int count = accessor.Components < components ? accessor.Components : components;
+		if (!accessor.Data)
+		{
+			for (Vertex& vertex : vertices)
+				memset((char*)&vertex + member, 0, count * sizeof(float));
+			return;
+		}
+
+		const unsigned char* source = accessor.Data;
+		if (accessor.ComponentType == Float)
+		{
+			for (Vertex& vertex : vertices)
+			{
+				memcpy((char*)&vertex + member, source, count * sizeof(float));
+				source += accessor.Stride;
+			}
+			return;
+		}
+
+		size_t componentSize = GetComponentSize(accessor.ComponentType);
+		for (Vertex& vertex : vertices)
+		{
+			float* destination = (float*)((char*)&vertex + member);
+			for (int c = 0; c < count; c++)
+				destination[c] = ReadComponent(source + c * componentSize, accessor.ComponentType, accessor.Normalized);
+			source += accessor.Stride;
+		}
+	}
+
+	// Whether the attribute is float data at the given offset from
+	// the position, within one buffer view of Vertex's stride
+	bool IsInPlace(const Accessor& attribute, const Accessor& position, size_t member, int components)
+	{
+		return attribute.Data &&
+			attribute.ComponentType == Float &&
+			attribute.Components == components &&
+			attribute.Count == position.Count &&
+			attribute.BufferView == position.BufferView &&
+			attribute.Stride == sizeof(Vertex) &&
+			attribute.Data == position.Data + member;
+	}
+
+	void ReverseWinding(std::vector<unsigned int>& indices)
+	{
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			unsigned int swap = indices[i + 1];
+			indices[i + 1] = indices[i + 2];
+			indices[i + 2] = swap;
+		}
+	}
+
+	// Area weighted normals, for primitives that don't have any
+	// (from clockwise triangles, in the file's right-handed space)
+	void GenerateNormals(std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices)
+	{
+		std::vector<XMFLOAT3> sums(vertices.size(), XMFLOAT3(0, 0, 0));
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			XMVECTOR a = XMLoadFloat3(&vertices[indices[i]].Position);
+			XMVECTOR b = XMLoadFloat3(&vertices[indices[i + 1]].Position);
+			XMVECTOR c = XMLoadFloat3(&vertices[indices[i + 2]].Position);
+			XMVECTOR normal = XMVector3Cross(XMVectorSubtract(c, a), XMVectorSubtract(b, a));
+			for (size_t corner = 0; corner < 3; corner++)
+				XMStoreFloat3(&sums[indices[i + corner]], XMVectorAdd(XMLoadFloat3(&sums[indices[i + corner]]), normal));
+		}
+		for (size_t v = 0; v < vertices.size(); v++)
+			XMStoreFloat3(&vertices[v].Normal, XMVector3Normalize(XMLoadFloat3(&sums[v])));
+	}
+
+	// --------------------------------------------------------
+	// Reads a primitive's indices as a 32-bit triangle list in
+	// the file's winding (or makes them, if there are none)
+	// --------------------------------------------------------
+	void ReadIndices(const JsonValue& document, const JsonValue& primitive, int mode, size_t vertexCount,
+		const unsigned char* bin, size_t binSize, std::vector<unsigned int>& indices)
+	{
+		std::vector<unsigned int> source;
+		int indexAccessor = primitive.GetInt("indices", -1);
+		if (indexAccessor < 0)
+		{
+			source.resize(vertexCount);
+			for (size_t i = 0; i < vertexCount; i++)
+				source[i] = (unsigned int)i;
+		}
+		else
+		{
+			Accessor accessor = GetAccessor(document, indexAccessor, bin, binSize);
+			if (accessor.Components != 1 || accessor.ComponentType == Float ||
+				accessor.ComponentType == Byte || accessor.ComponentType == Short)
+				throw std::invalid_argument("Error loading glTF: Indices have to be unsigned scalars");
+
+			source.resize(accessor.Count);
+			for (size_t i = 0; i < accessor.Count && accessor.Data; i++)
+			{
+				const unsigned char* data = accessor.Data + i * accessor.Stride;
+				switch (accessor.ComponentType)
+				{
+				case UnsignedByte: source[i] = data[0]; break;
+				case UnsignedShort: { uint16_t value; memcpy(&value, data, 2); source[i] = value; break; }
+				default: memcpy(&source[i], data, 4); break;
+				}
+			}
+		}
+
+		for (unsigned int index : source)
+		{
+			if (index >= vertexCount)
+				throw std::invalid_argument("Error loading glTF: An index is out of range of its vertices");
+		}
+
+		// Strips alternate their winding, and fans share their first vertex
+		indices.clear();
+		if (mode == Triangles)
+		{
+			source.resize(source.size() - source.size() % 3);
+			indices = std::move(source);
+		}
+		for (size_t i = 2; mode == TriangleStrip && i < source.size(); i++)
+		{
+			bool odd = (i & 1) != 0;
+			indices.insert(indices.end(), { source[i - 2], source[odd ? i : i - 1], source[odd ? i - 1 : i] });
+		}
+		for (size_t i = 2; mode == TriangleFan && i < source.size(); i++)
+			indices.insert(indices.end(), { source[0], source[i - 1], source[i] });
+	}
+
+	// --------------------------------------------------------
+	// Fills in a primitive, pointing into the binary chunk for
+	// whatever already matches and converting the rest
+	// --------------------------------------------------------
+	void LoadPrimitive(const JsonValue& document, const JsonValue& json, const unsigned char* bin, size_t binSize,
+		const GltfLoader::LoadOptions& options, GltfLoader::Primitive& primitive, GltfLoader::Stats& stats)
+	{
+		const JsonValue* attributes = json.Find("attributes");
+		int positionIndex = attributes ? attributes->GetInt("POSITION", -1) : -1;
+		if (positionIndex < 0)
+			throw std::invalid_argument("Error loading glTF: A primitive has no positions");
+
+		Accessor position = GetAccessor(document, positionIndex, bin, binSize);
+		if (position.Components != 3 || position.Count > 0xFFFFFFFFull)
+			throw std::invalid_argument("Error loading glTF: A primitive's positions aren't three-component vectors");
+
+		int uvIndex = attributes->GetInt("TEXCOORD_0", -1);
+		int normalIndex = attributes->GetInt("NORMAL", -1);
+		int tangentIndex = attributes->GetInt("TANGENT", -1);
+		Accessor uv = uvIndex >= 0 ? GetAccessor(document, uvIndex, bin, binSize) : Accessor();
+		Accessor normal = normalIndex >= 0 ? GetAccessor(document, normalIndex, bin, binSize) : Accessor();
+		Accessor tangent = tangentIndex >= 0 ? GetAccessor(document, tangentIndex, bin, binSize) : Accessor();
+		for (const Accessor* attribute : { &uv, &normal, &tangent })
+		{
+			if (attribute->Json && attribute->Count != position.Count)
+				throw std::invalid_argument("Error loading glTF: A primitive's attributes have different counts");
+		}
+
+		primitive.Material = json.GetInt("material", -1);
+		primitive.VertexCount = (unsigned int)position.Count;
+		int mode = json.GetInt("mode", Triangles);
+
+		// Bounds are required to be in the file, so only missing
+		// ones need a pass over the positions
+		const JsonValue* min = position.Json->Find("min");
+		const JsonValue* max = position.Json->Find("max");
+		bool hasBounds = min && max && min->Elements.size() == 3 && max->Elements.size() == 3;
+		if (hasBounds)
+		{
+			position.Json->GetFloats("min", &primitive.BoundsMin.x, 3);
+			position.Json->GetFloats("max", &primitive.BoundsMax.x, 3);
+		}
+
+		// Vertices already laid out like Vertex are used in place
+		bool vertexInPlace =
+			position.Data &&
+			position.ComponentType == Float &&
+			position.Stride == sizeof(Vertex) &&
+			(uintptr_t)position.Data % alignof(Vertex) == 0 &&
+			IsInPlace(uv, position, offsetof(Vertex, UV), 2) &&
+			IsInPlace(normal, position, offsetof(Vertex, Normal), 3) &&
+			IsInPlace(tangent, position, offsetof(Vertex, Tangent), 4);
+
+		// So are 32-bit triangle lists, as long as the winding stays and
+		// nothing is generated (tangents can add vertices)
+		bool generateNormals = !vertexInPlace && !normal.Json;
+		bool generateTangents = !vertexInPlace && !tangent.Json;
+		int indexAccessor = json.GetInt("indices", -1);
+		Accessor index = indexAccessor >= 0 ? GetAccessor(document, indexAccessor, bin, binSize) : Accessor();
+		bool indexInPlace =
+			!options.ConvertToLeftHanded &&
+			!generateNormals &&
+			!generateTangents &&
+			mode == Triangles &&
+			index.Data &&
+			index.ComponentType == UnsignedInt &&
+			index.Components == 1 &&
+			index.Stride == sizeof(unsigned int) &&
+			index.Count % 3 == 0 &&
+			(uintptr_t)index.Data % alignof(unsigned int) == 0;
+
+		// Indices used in place only need checking, while the rest are
+		// read into a triangle list, with the winding reversed to keep
+		// front faces clockwise once Z is mirrored
+		std::vector<unsigned int> indices;
+		if (indexInPlace)
+		{
+			const unsigned int* source = (const unsigned int*)index.Data;
+			unsigned int largest = 0;
+			for (size_t i = 0; i < index.Count; i++)
+				largest = source[i] > largest ? source[i] : largest;
+			if (index.Count > 0 && largest >= position.Count)
+				throw std::invalid_argument("Error loading glTF: An index is out of range of its vertices");
+		}
+		else
+		{
+			ReadIndices(document, json, mode, position.Count, bin, binSize, indices);
+			if (options.ConvertToLeftHanded)
+				ReverseWinding(indices);
+		}
+		if (!vertexInPlace)
+		{
+			std::vector<Vertex>& vertices = primitive.ConvertedVertices;
+			vertices.assign(position.Count, Vertex{ XMFLOAT3(0, 0, 0), XMFLOAT2(0, 0), XMFLOAT3(0, 0, 0), XMFLOAT4(1, 0, 0, 1) });
+			CopyAttribute(position, vertices, offsetof(Vertex, Position), 3);
+			stats.ConvertedAttributes++;
+			for (const auto& attribute : { std::make_pair(&uv, offsetof(Vertex, UV)), std::make_pair(&normal, offsetof(Vertex, Normal)), std::make_pair(&tangent, offsetof(Vertex, Tangent)) })
+			{
+				if (!attribute.first->Json)
+					continue;
+				CopyAttribute(*attribute.first, vertices, attribute.second, attribute.first == &uv ? 2 : attribute.first == &normal ? 3 : 4);
+				stats.ConvertedAttributes++;
+			}
+
+			// Both are generated from clockwise triangles, in the file's
+			// space, which gives tangents glTF's handedness (so normal
+			// maps are read with green pointing up the texture)
+			if (!options.ConvertToLeftHanded && !indexInPlace)
+				ReverseWinding(indices);
+			if (generateNormals)
+			{
+				GenerateNormals(vertices, indices);
+				stats.GeneratedNormals++;
+			}
+			if (generateTangents)
+			{
+				MeshTangents::Options tangentOptions;
+				tangentOptions.TangentMode = options.TangentMode;
+				MeshTangents::Generate(vertices, indices, indices.size(), tangentOptions);
+				stats.GeneratedTangents++;
+			}
+			if (!options.ConvertToLeftHanded && !indexInPlace)
+				ReverseWinding(indices);
+
+			primitive.Vertices = vertices.data();
+			primitive.VertexCount = (unsigned int)vertices.size();
+			stats.ConvertedBytes += vertices.size() * sizeof(Vertex);
+		}
+		else
+		{
+			primitive.Vertices = (const Vertex*)position.Data;
+			stats.InPlaceVertexPrimitives++;
+		}
+
+		if (!hasBounds)
+		{
+			XMVECTOR boundsMin = XMVectorReplicate(0.0f);
+			XMVECTOR boundsMax = XMVectorReplicate(0.0f);
+			for (unsigned int v = 0; v < primitive.VertexCount; v++)
+			{
+				XMVECTOR p = XMLoadFloat3(&primitive.Vertices[v].Position);
+				boundsMin = v == 0 ? p : XMVectorMin(boundsMin, p);
+				boundsMax = v == 0 ? p : XMVectorMax(boundsMax, p);
+			}
+			XMStoreFloat3(&primitive.BoundsMin, boundsMin);
+			XMStoreFloat3(&primitive.BoundsMax, boundsMax);
+		}
+
+		if (indexInPlace)
+		{
+			primitive.Indices = (const unsigned int*)index.Data;
+			primitive.IndexCount = (unsigned int)index.Count;
+			stats.InPlaceIndexPrimitives++;
+			return;
+		}
+
+		primitive.ConvertedIndices = std::move(indices);
+		primitive.Indices = primitive.ConvertedIndices.data();
+		primitive.IndexCount = (unsigned int)primitive.ConvertedIndices.size();
+		stats.ConvertedBytes += primitive.ConvertedIndices.size() * sizeof(unsigned int);
+	}
+
+	// A node's own transform, from its matrix or its translation,
+	// rotation and scale (glTF's column-major matrices are already
+	// laid out like DirectXMath's row vector ones)
+	XMMATRIX GetLocalMatrix(const JsonValue& node)
+	{
+		if (node.Find("matrix"))
+		{
+			XMFLOAT4X4 matrix;
+			XMStoreFloat4x4(&matrix, XMMatrixIdentity());
+			node.GetFloats("matrix", &matrix._11, 16);
+			return XMLoadFloat4x4(&matrix);
+		}
+
+		XMFLOAT3 translation(0, 0, 0);
+		XMFLOAT4 rotation(0, 0, 0, 1);
+		XMFLOAT3 scale(1, 1, 1);
+		node.GetFloats("translation", &translation.x, 3);
+		node.GetFloats("rotation", &rotation.x, 4);
+		node.GetFloats("scale", &scale.x, 3);
+		return XMMatrixScaling(scale.x, scale.y, scale.z) *
+			XMMatrixRotationQuaternion(XMQuaternionNormalize(XMLoadFloat4(&rotation))) *
+			XMMatrixTranslation(translation.x, translation.y, translation.z);
+	}
+
+	// The angles XMMatrixRotationRollPitchYaw() needs for a rotation
+	// (roll about Z, then pitch about X, then yaw about Y)
+	XMFLOAT3 GetPitchYawRoll(FXMVECTOR quaternion)
+	{
+		XMFLOAT4X4 m;
+		XMStoreFloat4x4(&m, XMMatrixRotationQuaternion(quaternion));
+		float sinPitch = fmaxf(-1.0f, fminf(1.0f, -m._32));
+		float pitch = asinf(sinPitch);
+
+		// Straight up or down, yaw and roll turn about the same axis
+		if (fabsf(sinPitch) > 0.9999f)
+			return XMFLOAT3(pitch, atan2f(-m._13, m._11), 0.0f);
+		return XMFLOAT3(pitch, atan2f(m._31, m._33), atan2f(m._12, m._22));
+	}
+}
+
+namespace GltfLoader
+{
+	Scene Load(const char* glbFile, const LoadOptions& options)
+	{
+		Scene scene;
+		scene.File = std::make_shared<MappedFile>(glbFile);
+		if (!scene.File->IsOpen())
+			throw std::invalid_argument("Error opening file: Invalid file path or file is inaccessible");
+
+		// A 12 byte header, then the JSON chunk and an optional binary one
+		const unsigned char* data = (const unsigned char*)scene.File->GetData();
+		size_t size = scene.File->GetSize();
+		uint32_t header[3] = {};
+		if (size >= sizeof(header))
+			memcpy(header, data, sizeof(header));
+		if (header[0] != GlbMagic || header[1] != 2 || header[2] > size)
+			throw std::invalid_argument("Error loading glTF: Not a version 2 binary glTF (.glb) file");
+
+		const char* json = nullptr;
+		size_t jsonSize = 0;
+		const unsigned char* bin = nullptr;
+		size_t binSize = 0;
+		for (size_t offset = sizeof(header); offset + 8 <= header[2];)
+		{
+			uint32_t chunk[2];
+			memcpy(chunk, data + offset, sizeof(chunk));
+			offset += sizeof(chunk);
+			if (chunk[0] > header[2] - offset)
+				throw std::invalid_argument("Error loading glTF: A chunk runs past the end of the file");
+
+			if (chunk[1] == JsonChunkType && !json)
+			{
+				json = (const char*)data + offset;
+				jsonSize = chunk[0];
+			}
+			else if (chunk[1] == BinChunkType && !bin)
+			{
+				bin = data + offset;
+				binSize = chunk[0];
+			}
+			offset += chunk[0];
+		}
+		if (!json)
+			throw std::invalid_argument("Error loading glTF: The file has no JSON chunk");
+		scene.LoadStats.BinaryBytes = binSize;
+
+		JsonValue document = JsonParser(json, jsonSize).ParseDocument();
+
+		// Images, either in the binary chunk or next to the file
+		std::string directory = glbFile;
+		size_t slash = directory.find_last_of("/\\");
+		directory.erase(slash == std::string::npos ? 0 : slash + 1);
+		const std::vector<JsonValue>& views = document.GetArray("bufferViews");
+		for (const JsonValue& imageJson : document.GetArray("images"))
+		{
+			Image image;
+			image.MimeType = imageJson.GetString("mimeType");
+			int view = imageJson.GetInt("bufferView", -1);
+			std::string uri = imageJson.GetString("uri");
+			if (view >= 0 && view < (int)views.size() && bin)
+			{
+				size_t viewOffset = (size_t)views[view].GetInt("byteOffset", 0);
+				size_t viewLength = (size_t)views[view].GetInt("byteLength", 0);
+				if (viewOffset > binSize || viewLength > binSize - viewOffset)
+					throw std::invalid_argument("Error loading glTF: An image is out of range of its buffer");
+				image.Data = (const char*)bin + viewOffset;
+				image.Size = viewLength;
+			}
+			else if (!uri.empty() && uri.compare(0, 5, "data:") != 0)
+				image.Path = directory + uri;
+			scene.Images.push_back(image);
+		}
+
+		// Materials name textures, which in turn name images
+		const std::vector<JsonValue>& textures = document.GetArray("textures");
+		auto getImage = [&](const JsonValue& material, const char* key) {
+			const JsonValue* texture = material.Find(key);
+			int index = texture ? texture->GetInt("index", -1) : -1;
+			int image = index >= 0 && index < (int)textures.size() ? textures[index].GetInt("source", -1) : -1;
+			return image < (int)scene.Images.size() ? image : -1;
+		};
+		for (const JsonValue& materialJson : document.GetArray("materials"))
+		{
+			MaterialDesc material;
+			material.Name = materialJson.GetString("name");
+			material.DoubleSided = materialJson.GetBool("doubleSided", false);
+			materialJson.GetFloats("emissiveFactor", &material.Emissive.x, 3);
+			material.NormalImage = getImage(materialJson, "normalTexture");
+			if (const JsonValue* pbr = materialJson.Find("pbrMetallicRoughness"))
+			{
+				pbr->GetFloats("baseColorFactor", &material.BaseColor.x, 4);
+				material.Metallic = pbr->GetFloat("metallicFactor", 1.0f);
+				material.Roughness = pbr->GetFloat("roughnessFactor", 1.0f);
+				material.BaseColorImage = getImage(*pbr, "baseColorTexture");
+				material.MetallicRoughnessImage = getImage(*pbr, "metallicRoughnessTexture");
+			}
+			scene.Materials.push_back(material);
+		}
+
+		for (const JsonValue& meshJson : document.GetArray("meshes"))
+		{
+			MeshDesc mesh;
+			mesh.Name = meshJson.GetString("name");
+			for (const JsonValue& primitiveJson : meshJson.GetArray("primitives"))
+			{
+				int mode = primitiveJson.GetInt("mode", Triangles);
+				if (mode != Triangles && mode != TriangleStrip && mode != TriangleFan)
+					continue;
+
+				mesh.Primitives.emplace_back();
+				LoadPrimitive(document, primitiveJson, bin, binSize, options, mesh.Primitives.back(), scene.LoadStats);
+				if (mesh.Primitives.back().Material >= (int)scene.Materials.size())
+					mesh.Primitives.back().Material = -1;
+				scene.LoadStats.PrimitiveCount++;
+			}
+			scene.Meshes.push_back(std::move(mesh));
+		}
+
+		// Nodes only list their children, so parents are found first
+		const std::vector<JsonValue>& nodes = document.GetArray("nodes");
+		scene.Nodes.resize(nodes.size());
+		for (size_t n = 0; n < nodes.size(); n++)
+		{
+			scene.Nodes[n].Name = nodes[n].GetString("name");
+			scene.Nodes[n].Mesh = nodes[n].GetInt("mesh", -1);
+			if (scene.Nodes[n].Mesh >= (int)scene.Meshes.size())
+				scene.Nodes[n].Mesh = -1;
+			for (const JsonValue& child : nodes[n].GetArray("children"))
+			{
+				int c = (int)child.Number;
+				if (c < 0 || c >= (int)nodes.size() || scene.Nodes[c].Parent >= 0 || c == (int)n)
+					throw std::invalid_argument("Error loading glTF: The node hierarchy isn't a tree");
+				scene.Nodes[c].Parent = (int)n;
+			}
+		}
+
+		// The Z mirror goes on both sides of each world matrix to move
+		// it into left-handed space, then once more on the object side
+		// since the vertices weren't converted, which leaves W * mirror
+		XMMATRIX mirror = options.ConvertToLeftHanded ? XMMatrixScaling(1, 1, -1) : XMMatrixIdentity();
+		for (size_t n = 0; n < nodes.size(); n++)
+		{
+			XMMATRIX world = GetLocalMatrix(nodes[n]);
+			size_t depth = 0;
+			for (int parent = scene.Nodes[n].Parent; parent >= 0; parent = scene.Nodes[parent].Parent)
+			{
+				if (++depth > nodes.size())
+					throw std::invalid_argument("Error loading glTF: The node hierarchy isn't a tree");
+				world = world * GetLocalMatrix(nodes[parent]);
+			}
+
+			Node& node = scene.Nodes[n];
+			XMStoreFloat4x4(&node.World, world * mirror);
+
+			XMVECTOR scale, rotation, translation;
+			XMMatrixDecompose(&scale, &rotation, &translation, mirror * world * mirror);
+			XMStoreFloat3(&node.Position, translation);
+			XMStoreFloat4(&node.Rotation, rotation);
+			XMStoreFloat3(&node.Scale, XMVectorMultiply(scale, XMVectorSet(1, 1, options.ConvertToLeftHanded ? -1.0f : 1.0f, 1)));
+			node.PitchYawRoll = GetPitchYawRoll(rotation);
+		}
+		return scene;
+	}
+}
@@ -0,0 +1,146 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstddef>
+#include "Vertex.h"
+#include "MappedFile.h"
+#include "MeshTangents.h"
+
+// --------------------------------------------------------
+// Loads binary glTF 2.0 (.glb) files into meshes, nodes
+// and materials ready for Mesh, Transform and Material
+//
+// - The file is memory mapped, and the binary chunk is
+//   never copied: a primitive whose vertices are already
+//   laid out like Vertex (one interleaved buffer view with
+//   a 48 byte stride, all floats) points straight into the
+//   mapping, and so can be handed to Mesh::CreateBuffers()
+// - Other primitives are converted in a single strided pass
+//   per attribute, reading from the mapping, and only the
+//   attributes they actually have (missing normals are
+//   generated, and missing tangents come from MeshTangents)
+// - Vertices stay in the file's right-handed space, even
+//   when converting to DirectX's left-handed space: the Z
+//   flip goes into every node's scale instead (so Scale.z
+//   is negative), and only the winding of the indices is
+//   reversed
+// - 32-bit indices are also used in place when there's no
+//   winding to reverse; smaller ones are widened
+// - Node hierarchies are flattened into world transforms,
+//   and every primitive of a mesh becomes a submesh
+// - Only the .glb's own binary chunk is supported as a
+//   buffer (no external .bin files or data uris), and
+//   sparse accessors aren't supported
+// - Points and lines are skipped; strips and fans become
+//   triangle lists
+// --------------------------------------------------------
+namespace GltfLoader
+{
+	struct LoadOptions
+	{
+		// Mirror Z into the node transforms and reverse the winding
+		// of every triangle, for DirectX's left-handed space (when
+		// false, indices are used in place too, but front faces are
+		// counter-clockwise)
+		bool ConvertToLeftHanded = true;
+
+		// For primitives without tangents
+		MeshTangents::Mode TangentMode = MeshTangents::Mode::MikkTSpace;
+	};
+
+	struct Primitive
+	{
+		// Either inside the mapped file or in the converted arrays
+		// below, valid as long as the scene is (moving a primitive
+		// keeps them valid, but a copy still points at the original)
+		const Vertex* Vertices = nullptr;
+		unsigned int VertexCount = 0;
+		const unsigned int* Indices = nullptr;
+		unsigned int IndexCount = 0;
+
+		// Only filled in when the file's data couldn't be used in place
+		std::vector<Vertex> ConvertedVertices;
+		std::vector<unsigned int> ConvertedIndices;
+
+		int Material = -1;	// Into Scene::Materials (-1 for the default material)
+
+		// Axis-aligned bounds of the positions, in the file's space
+		DirectX::XMFLOAT3 BoundsMin = DirectX::XMFLOAT3(0, 0, 0);
+		DirectX::XMFLOAT3 BoundsMax = DirectX::XMFLOAT3(0, 0, 0);
+	};
+
+	struct MeshDesc
+	{
+		std::string Name;
+		std::vector<Primitive> Primitives;	// Triangle primitives only
+	};
+
+	// The metallic-roughness material model's parameters, with
+	// textures as indices into Scene::Images (-1 when there's none)
+	struct MaterialDesc
+	{
+		std::string Name;
+		DirectX::XMFLOAT4 BaseColor = DirectX::XMFLOAT4(1, 1, 1, 1);
+		float Metallic = 1.0f;
+		float Roughness = 1.0f;
+		DirectX::XMFLOAT3 Emissive = DirectX::XMFLOAT3(0, 0, 0);
+		int BaseColorImage = -1;
+		int MetallicRoughnessImage = -1;	// Roughness in green, metalness in blue
+		int NormalImage = -1;
+		bool DoubleSided = false;
+	};
+
+	// An encoded (png or jpeg) image, either inside the mapped file
+	// or in a file of its own next to the .glb
+	struct Image
+	{
+		const char* Data = nullptr;
+		size_t Size = 0;
+		std::string MimeType;
+		std::string Path;	// When Data is null (the .glb's directory, plus the image's uri)
+	};
+
+	struct Node
+	{
+		std::string Name;
+		int Parent = -1;
+		int Mesh = -1;	// Into Scene::Meshes
+
+		// The world transform (parents already applied), split up
+		// for Transform, with the rotation also as pitch/yaw/roll
+		DirectX::XMFLOAT3 Position = DirectX::XMFLOAT3(0, 0, 0);
+		DirectX::XMFLOAT4 Rotation = DirectX::XMFLOAT4(0, 0, 0, 1);
+		DirectX::XMFLOAT3 PitchYawRoll = DirectX::XMFLOAT3(0, 0, 0);
+		DirectX::XMFLOAT3 Scale = DirectX::XMFLOAT3(1, 1, 1);
+		DirectX::XMFLOAT4X4 World;
+	};
+
+	struct Stats
+	{
+		unsigned int PrimitiveCount;
+		unsigned int InPlaceVertexPrimitives;	// Vertices used straight from the mapping
+		unsigned int InPlaceIndexPrimitives;	// Indices used straight from the mapping
+		unsigned int ConvertedAttributes;		// Attribute streams copied or decoded
+		unsigned int GeneratedNormals;			// Primitives without normals
+		unsigned int GeneratedTangents;			// Primitives without tangents
+		size_t BinaryBytes;						// Size of the binary chunk
+		size_t ConvertedBytes;					// Memory taken by converted vertices and indices
+	};
+
+	struct Scene
+	{
+		std::vector<MeshDesc> Meshes;
+		std::vector<MaterialDesc> Materials;
+		std::vector<Image> Images;
+		std::vector<Node> Nodes;	// Every node, in the file's order
+		Stats LoadStats = {};
+
+		// Keeps the mapping (and so every in-place pointer) alive
+		std::shared_ptr<MappedFile> File;
+	};
+
+	// Throws std::invalid_argument if the file can't be opened, isn't
+	// a version 2 .glb, or has data out of range of its buffers
+	Scene Load(const char* glbFile, const LoadOptions& options = LoadOptions());
+}
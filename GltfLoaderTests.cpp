@@ -0,0 +1,318 @@
+#include "Tests.h"
+#include "GltfLoader.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	const char* damagedFile = "GltfLoaderTests.glb";
+
+	// The sample scene, from the project directory (where the tests
+	// run from Visual Studio) or from next to the executable
+	std::string FindCrates()
+	{
+		for (const char* path : { "Assets/crates.glb", "../../Assets/crates.glb" })
+		{
+			if (std::ifstream(path).is_open())
+				return path;
+		}
+		return "Assets/crates.glb";
+	}
+
+	std::vector<char> ReadFile(const std::string& path)
+	{
+		std::ifstream in(path, std::ios::binary);
+		return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	}
+
+	void WriteFile(const std::vector<char>& bytes)
+	{
+		std::ofstream out(damagedFile, std::ios::binary | std::ios::trunc);
+		out.write(bytes.data(), bytes.size());
+	}
+
+	// --------------------------------------------------------
+	// The crates' JSON and binary chunks, pulled apart so they
+	// can be damaged and put back together
+	// --------------------------------------------------------
+	struct Glb
+	{
+		std::string Json;
+		std::vector<char> Bin;
+
+		// A .glb of the chunks, padded as the spec asks
+		std::vector<char> Build() const
+		{
+			std::string json = Json;
+			json.resize((json.size() + 3) & ~(size_t)3, ' ');
+			std::vector<char> bin = Bin;
+			bin.resize((bin.size() + 3) & ~(size_t)3, 0);
+
+			// The 12 byte header and each chunk's length and type
+			uint32_t header[5] = { 0x46546C67, 2, (uint32_t)(28 + json.size() + bin.size()), (uint32_t)json.size(), 0x4E4F534A };
+			uint32_t binHeader[2] = { (uint32_t)bin.size(), 0x004E4942 };
+			std::vector<char> bytes(header[2]);
+			memcpy(bytes.data(), header, sizeof(header));
+			memcpy(bytes.data() + 20, json.data(), json.size());
+			memcpy(bytes.data() + 20 + json.size(), binHeader, sizeof(binHeader));
+			memcpy(bytes.data() + 28 + json.size(), bin.data(), bin.size());
+			return bytes;
+		}
+
+		// The same JSON with one piece of text swapped for another
+		Glb Replace(const std::string& from, const std::string& to) const
+		{
+			Glb copy = *this;
+			size_t at = copy.Json.find(from);
+			if (at == std::string::npos)
+				throw std::logic_error("The text to replace isn't in the JSON: " + from);
+			copy.Json.replace(at, from.size(), to);
+			return copy;
+		}
+	};
+
+	Glb SplitGlb(const std::vector<char>& bytes)
+	{
+		Glb glb;
+		uint32_t jsonLength, binLength;
+		memcpy(&jsonLength, bytes.data() + 12, 4);
+		glb.Json.assign(bytes.data() + 20, jsonLength);
+		memcpy(&binLength, bytes.data() + 20 + jsonLength, 4);
+		const char* bin = bytes.data() + 28 + jsonLength;
+		glb.Bin.assign(bin, bin + binLength);
+		return glb;
+	}
+
+	// Whether loading the bytes throws invalid_argument (as a bad
+	// file should), rather than loading or reading out of bounds
+	bool Rejects(const std::vector<char>& bytes, const GltfLoader::LoadOptions& options = GltfLoader::LoadOptions())
+	{
+		WriteFile(bytes);
+		try
+		{
+			GltfLoader::Load(damagedFile, options);
+		}
+		catch (const std::invalid_argument&)
+		{
+			return true;
+		}
+		return false;
+	}
+
+	bool Near(const XMFLOAT3& a, float x, float y, float z)
+	{
+		return Tests::Near(a.x, x, 1e-5f) && Tests::Near(a.y, y, 1e-5f) && Tests::Near(a.z, z, 1e-5f);
+	}
+
+	// A point through a node's world matrix
+	XMFLOAT3 Transform(const GltfLoader::Node& node, float x, float y, float z)
+	{
+		XMFLOAT3 result;
+		XMStoreFloat3(&result, XMVector3TransformCoord(XMVectorSet(x, y, z, 1), XMLoadFloat4x4(&node.World)));
+		return result;
+	}
+}
+
+// --------------------------------------------------------
+// The crates: a parent turned 30 degrees about Y, with two
+// crates (two primitives sharing one interleaved vertex
+// buffer that matches Vertex) and a pyramid (positions and
+// normalized 16-bit uvs, and 16-bit indices)
+// --------------------------------------------------------
+TEST(GltfLoaderLoadsCrates)
+{
+	std::string path = FindCrates();
+	GltfLoader::Scene scene = GltfLoader::Load(path.c_str());
+	CHECK(scene.Meshes.size() == 2 && scene.Materials.size() == 3 && scene.Images.size() == 1 && scene.Nodes.size() == 4);
+	if (scene.Meshes.size() != 2 || scene.Nodes.size() != 4)
+		return;
+
+	// The crate's vertices are used in place, and only the pyramid is converted
+	const GltfLoader::Stats& stats = scene.LoadStats;
+	CHECK(stats.PrimitiveCount == 3);
+	CHECK(stats.BinaryBytes == 1672);
+	CHECK(stats.InPlaceVertexPrimitives == 2);
+	CHECK(stats.InPlaceIndexPrimitives == 0);
+	CHECK(stats.ConvertedAttributes == 2);
+	CHECK(stats.GeneratedNormals == 1 && stats.GeneratedTangents == 1);
+
+	const GltfLoader::MeshDesc& crate = scene.Meshes[0];
+	const GltfLoader::MeshDesc& pyramid = scene.Meshes[1];
+	CHECK(crate.Primitives.size() == 2 && pyramid.Primitives.size() == 1);
+	if (crate.Primitives.size() != 2 || pyramid.Primitives.size() != 1)
+		return;
+	const char* mapping = scene.File->GetData();
+	for (const GltfLoader::Primitive& primitive : crate.Primitives)
+	{
+		CHECK(primitive.Vertices == (const Vertex*)(mapping + scene.File->GetSize() - 1672));
+		CHECK(primitive.ConvertedVertices.empty() && primitive.VertexCount == 24);
+	}
+	CHECK(crate.Primitives[0].IndexCount == 6 && crate.Primitives[1].IndexCount == 30);
+	CHECK(crate.Primitives[0].Material == 0 && crate.Primitives[1].Material == 1);
+	CHECK(pyramid.Primitives[0].Vertices == pyramid.Primitives[0].ConvertedVertices.data());
+	CHECK(pyramid.Primitives[0].VertexCount >= 16 && pyramid.Primitives[0].IndexCount == 18);
+	CHECK(Near(pyramid.Primitives[0].BoundsMin, -0.5f, 0.0f, -0.5f) && Near(pyramid.Primitives[0].BoundsMax, 0.5f, 1.0f, 0.5f));
+
+	bool uvsInRange = true;
+	for (unsigned int v = 0; v < pyramid.Primitives[0].VertexCount; v++)
+	{
+		const XMFLOAT2& uv = pyramid.Primitives[0].Vertices[v].UV;
+		uvsInRange = uvsInRange && uv.x >= 0.0f && uv.x <= 1.0f && uv.y >= 0.0f && uv.y <= 1.0f;
+	}
+	CHECK(uvsInRange);
+
+	CHECK(scene.Materials[1].BaseColorImage == 0 && scene.Materials[0].BaseColorImage == -1);
+	CHECK(scene.Images[0].Data == mapping + scene.File->GetSize() - 1672 + 1588 && scene.Images[0].Size == 84);
+	CHECK(scene.Images[0].MimeType == "image/png");
+
+	// World matrices: the parent's translation and 30 degree turn
+	// applied to each child, then Z mirrored into left-handed space
+	const float c30 = cosf(XMConvertToRadians(30.0f));
+	const float s30 = sinf(XMConvertToRadians(30.0f));
+	const GltfLoader::Node& parent = scene.Nodes[0];
+	const GltfLoader::Node& first = scene.Nodes[1];
+	const GltfLoader::Node& second = scene.Nodes[2];
+	const GltfLoader::Node& third = scene.Nodes[3];
+	CHECK(parent.Parent == -1 && first.Parent == 0 && second.Parent == 0 && third.Parent == 0);
+	CHECK(parent.Mesh == -1 && first.Mesh == 0 && second.Mesh == 0 && third.Mesh == 1);
+	CHECK(first.Name == "Crate" && third.Name == "Pyramid");
+
+	CHECK(Near(parent.Position, 0.0f, -2.0f, -6.0f));
+	CHECK(Near(first.Position, -1.5f * c30, -1.5f, -(6.0f + 1.5f * s30)));
+	CHECK(Near(second.Position, -1.5f * s30, -1.5f, -(6.0f - 1.5f * c30)));
+	CHECK(Near(third.Position, 1.5f * c30, -2.0f, -(6.0f - 1.5f * s30)));
+	CHECK(Near(first.Scale, 1.0f, 1.0f, -1.0f));
+	CHECK(Near(second.Scale, 0.8f, 0.8f, -0.8f));
+	CHECK(Near(third.Scale, 1.0f, 1.5f, -1.0f));
+
+	// A crate corner in the file's space lands where the same point
+	// does in the parent's frame, mirrored
+	XMFLOAT3 corner = Transform(first, 0.5f, 0.5f, 0.5f);
+	CHECK(Near(corner, -1.0f * c30 + 0.5f * s30, -1.0f, -(6.0f + 1.0f * s30 + 0.5f * c30)));
+	XMFLOAT3 apex = Transform(third, 0.0f, 1.0f, 0.0f);
+	CHECK(Near(apex, 1.5f * c30, -0.5f, -(6.0f - 1.5f * s30)));
+
+	// The second crate's 20 degree turn adds to its parent's, and
+	// mirroring Z turns it the other way
+	CHECK(Tests::Near(second.PitchYawRoll.y, XMConvertToRadians(-50.0f), 1e-4f));
+	CHECK(Tests::Near(second.PitchYawRoll.x, 0.0f, 1e-4f) && Tests::Near(second.PitchYawRoll.z, 0.0f, 1e-4f));
+}
+
+// --------------------------------------------------------
+// Without the conversion, the crate's 32-bit indices are
+// also used in place, and the winding is the file's (which
+// the conversion reverses)
+// --------------------------------------------------------
+TEST(GltfLoaderKeepsRightHandedDataInPlace)
+{
+	std::string path = FindCrates();
+	GltfLoader::LoadOptions options;
+	options.ConvertToLeftHanded = false;
+	GltfLoader::Scene rightHanded = GltfLoader::Load(path.c_str(), options);
+	GltfLoader::Scene leftHanded = GltfLoader::Load(path.c_str());
+	CHECK(rightHanded.LoadStats.InPlaceVertexPrimitives == 2);
+	CHECK(rightHanded.LoadStats.InPlaceIndexPrimitives == 2);
+	if (rightHanded.Meshes.size() != 2 || leftHanded.Meshes.size() != 2)
+		return;
+
+	const char* bin = rightHanded.File->GetData() + rightHanded.File->GetSize() - 1672;
+	const GltfLoader::Primitive& lid = rightHanded.Meshes[0].Primitives[0];
+	const GltfLoader::Primitive& sides = rightHanded.Meshes[0].Primitives[1];
+	CHECK(lid.Indices == (const unsigned int*)(bin + 1152) && lid.ConvertedIndices.empty());
+	CHECK(sides.Indices == (const unsigned int*)(bin + 1152 + 24));
+
+	bool reversed = true;
+	for (size_t m = 0; m < 2; m++)
+	{
+		for (size_t p = 0; p < rightHanded.Meshes[m].Primitives.size(); p++)
+		{
+			const GltfLoader::Primitive& a = rightHanded.Meshes[m].Primitives[p];
+			const GltfLoader::Primitive& b = leftHanded.Meshes[m].Primitives[p];
+			reversed = reversed && a.IndexCount == b.IndexCount;
+			for (unsigned int i = 0; reversed && i < a.IndexCount; i += 3)
+			{
+				reversed = a.Indices[i] == b.Indices[i] &&
+					a.Indices[i + 1] == b.Indices[i + 2] && a.Indices[i + 2] == b.Indices[i + 1];
+			}
+		}
+	}
+	CHECK(reversed);
+
+	// World matrices aren't mirrored either
+	CHECK(Near(rightHanded.Nodes[1].Scale, 1.0f, 1.0f, 1.0f));
+	CHECK(Near(rightHanded.Nodes[0].Position, 0.0f, -2.0f, 6.0f));
+}
+
+// --------------------------------------------------------
+// Damaged files throw instead of reading past the mapping:
+// chunk lengths that don't fit, and accessors, buffer views
+// and indices that reach past what they point into
+// --------------------------------------------------------
+TEST(GltfLoaderRejectsDamagedFiles)
+{
+	std::vector<char> original = ReadFile(FindCrates());
+	CHECK(original.size() == 4200);
+	if (original.size() != 4200)
+		return;
+	Glb glb = SplitGlb(original);
+
+	// Rebuilt as it was, it still loads
+	CHECK(!Rejects(glb.Build()));
+
+	// Cut short, and chunk lengths past the end of the file
+	CHECK(Rejects(std::vector<char>(original.begin(), original.begin() + 3000)));
+	CHECK(Rejects(std::vector<char>(original.begin(), original.begin() + 8)));
+	std::vector<char> bytes = original;
+	uint32_t huge = 0xFFFFFFF0;
+	memcpy(bytes.data() + 12, &huge, 4);
+	CHECK(Rejects(bytes));
+	bytes = original;
+	memcpy(bytes.data() + 20 + glb.Json.size(), &huge, 4);
+	CHECK(Rejects(bytes));
+
+	// A binary chunk shorter than its buffer views
+	Glb shortBin = glb;
+	shortBin.Bin.resize(1200);
+	CHECK(Rejects(shortBin.Build()));
+
+	// Accessor offsets and strides that run past their views, views past
+	// the chunk, and offsets that are negative
+	CHECK(Rejects(glb.Replace("\"bufferView\":1,\"byteOffset\":24", "\"bufferView\":1,\"byteOffset\":40").Build()));
+	CHECK(Rejects(glb.Replace("\"bufferView\":0,\"byteOffset\":32", "\"bufferView\":0,\"byteOffset\":1120").Build()));
+	CHECK(Rejects(glb.Replace("\"byteStride\":48", "\"byteStride\":52").Build()));
+	CHECK(Rejects(glb.Replace("\"byteStride\":48", "\"byteStride\":256").Build()));
+	CHECK(Rejects(glb.Replace("\"byteOffset\":1552,\"byteLength\":36", "\"byteOffset\":1652,\"byteLength\":36").Build()));
+	CHECK(Rejects(glb.Replace("\"byteOffset\":1588,\"byteLength\":84", "\"byteOffset\":1588,\"byteLength\":85").Build()));
+	CHECK(Rejects(glb.Replace("\"bufferView\":0,\"byteOffset\":12", "\"bufferView\":0,\"byteOffset\":-4").Build()));
+	CHECK(Rejects(glb.Replace("\"count\":16,\"type\":\"VEC3\"", "\"count\":17,\"type\":\"VEC3\"").Build()));
+
+	// Indices past the vertices, both converted and (when the file's
+	// handedness is kept) in place
+	Glb badIndex = glb;
+	uint32_t index = 24;
+	memcpy(badIndex.Bin.data() + 1152 + 4, &index, 4);
+	CHECK(Rejects(badIndex.Build()));
+	GltfLoader::LoadOptions rightHanded;
+	rightHanded.ConvertToLeftHanded = false;
+	CHECK(!Rejects(glb.Build(), rightHanded));
+	CHECK(Rejects(badIndex.Build(), rightHanded));
+	Glb badShortIndex = glb;
+	uint16_t shortIndex = 16;
+	memcpy(badShortIndex.Bin.data() + 1552, &shortIndex, 2);
+	CHECK(Rejects(badShortIndex.Build()));
+
+	// And a node hierarchy with a cycle
+	CHECK(Rejects(glb.Replace("\"children\":[1,2,3]", "\"children\":[0,2,3]").Build()));
+	CHECK(Rejects(glb.Replace("\"children\":[1,2,3]", "\"children\":[1,2,9]").Build()));
+
+	std::remove(damagedFile);
+}
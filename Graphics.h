@@ -4,6 +4,7 @@
 #include <d3d11.h>
 #include <string>
 #include <wrl/client.h>
+#include "CommandBuffer.h"
 
 #pragma comment(lib, "d3d11.lib")
 #pragma comment(lib, "dxgi.lib")
@@ -21,6 +22,10 @@ namespace Graphics
 	inline Microsoft::WRL::ComPtr<ID3D11RenderTargetView> BackBufferRTV;
 	inline Microsoft::WRL::ComPtr<ID3D11DepthStencilView> DepthBufferDSV;
 
+	// Everything a frame draws is recorded here, and executed by
+	// a backend once the frame is complete
+	inline CommandBuffer Commands;
+
 	// --- FUNCTIONS ---
 
 	// Getters
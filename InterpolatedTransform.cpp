@@ -0,0 +1,103 @@
+#include "InterpolatedTransform.h"
+
+using namespace DirectX;
+
+// Anonymous namespace for the helpers, which are private to this file
+namespace
+{
+	bool Equal(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return a.x == b.x && a.y == b.y && a.z == b.z;
+	}
+
+	bool Equal(const TransformState& a, const TransformState& b)
+	{
+		return Equal(a.Position, b.Position) && Equal(a.Scale, b.Scale) &&
+			a.Rotation.x == b.Rotation.x && a.Rotation.y == b.Rotation.y &&
+			a.Rotation.z == b.Rotation.z && a.Rotation.w == b.Rotation.w;
+	}
+}
+
+InterpolatedTransform::InterpolatedTransform(std::shared_ptr<Transform> transform) :
+	transform(transform)
+{
+	applied = ReadTransform();
+	previous = applied;
+	current = applied;
+	restingState = applied;
+	resting = true;
+}
+
+std::shared_ptr<Transform> InterpolatedTransform::GetTransform()
+{
+	return transform;
+}
+
+void InterpolatedTransform::BeginStep()
+{
+	AdoptOutsideChanges();
+	previous = current;
+}
+
+TransformState& InterpolatedTransform::GetState()
+{
+	return current;
+}
+
+void InterpolatedTransform::Rotate(float pitch, float yaw, float roll)
+{
+	XMVECTOR rotation = XMQuaternionMultiply(
+		XMQuaternionRotationRollPitchYaw(pitch, yaw, roll),
+		XMLoadFloat4(&current.Rotation));
+	XMStoreFloat4(&current.Rotation, XMQuaternionNormalize(rotation));
+}
+
+void InterpolatedTransform::Apply(float alpha)
+{
+	AdoptOutsideChanges();
+
+	// Nothing to blend, and the Transform is already there (so it
+	// isn't marked as moved for no reason)
+	bool still = Equal(previous, current);
+	if (still && resting && Equal(current, restingState))
+		return;
+
+	XMFLOAT3 position, scale;
+	XMFLOAT4 rotation;
+	XMStoreFloat3(&position, XMVectorLerp(XMLoadFloat3(&previous.Position), XMLoadFloat3(&current.Position), alpha));
+	XMStoreFloat4(&rotation, XMQuaternionSlerp(XMLoadFloat4(&previous.Rotation), XMLoadFloat4(&current.Rotation), alpha));
+	XMStoreFloat3(&scale, XMVectorLerp(XMLoadFloat3(&previous.Scale), XMLoadFloat3(&current.Scale), alpha));
+	transform->SetPosition(position);
+	transform->SetRotation(rotation);
+	transform->SetScale(scale);
+
+	// Read back rather than kept as is, since the rotation is
+	// renormalized on the way in
+	applied = ReadTransform();
+	resting = still;
+	restingState = current;
+}
+
+TransformState InterpolatedTransform::ReadTransform()
+{
+	TransformState state;
+	state.Position = transform->GetPosition();
+	state.Rotation = transform->GetRotation();
+	state.Scale = transform->GetScale();
+	return state;
+}
+
+// If the Transform isn't how Apply() left it, whatever changed it
+// wins, and both states jump there so there's nothing to blend
+void InterpolatedTransform::AdoptOutsideChanges()
+{
+	TransformState state = ReadTransform();
+	if (Equal(state, applied))
+		return;
+
+	applied = state;
+	previous = state;
+	current = state;
+	resting = true;
+	restingState = state;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <DirectXMath.h>
+#include <memory>
+#include "Transform.h"
+
+// Where one simulation step leaves a transform (relative to
+// its parent, like Transform's own position, rotation and scale)
+struct TransformState
+{
+	DirectX::XMFLOAT3 Position;
+	DirectX::XMFLOAT4 Rotation;	// Quaternion
+	DirectX::XMFLOAT3 Scale;
+};
+
+// --------------------------------------------------------
+// A transform's simulated state at the last two fixed steps
+// (see FixedTimestep), with the Transform itself, which is
+// what gets drawn, set to a blend of the two each frame
+//
+// - The simulation only reads and changes the current state,
+//   never the Transform, so it ends up the same however the
+//   steps happen to line up with frames
+// - Position and scale are interpolated linearly, and the
+//   rotation spherically
+// - Changes made to the Transform from outside (like the UI)
+//   are noticed and become the simulated state, rather than
+//   being overwritten
+// --------------------------------------------------------
+class InterpolatedTransform
+{
+public:
+	InterpolatedTransform(std::shared_ptr<Transform> transform);
+
+	std::shared_ptr<Transform> GetTransform();
+
+	// Before each step, so the current state becomes the previous one
+	void BeginStep();
+
+	// The state the step in progress changes
+	TransformState& GetState();
+
+	// Like Transform::Rotate(), but to the current state
+	void Rotate(float pitch, float yaw, float roll);
+
+	// Sets the Transform alpha of the way from the previous state
+	// to the current one (see FixedTimestep::GetAlpha())
+	void Apply(float alpha);
+
+private:
+	std::shared_ptr<Transform> transform;
+	TransformState previous;
+	TransformState current;
+	TransformState applied;	// What Apply() last left the Transform with
+
+	// Set once the Transform has been given restingState with
+	// nothing to blend, so Apply() can leave it alone until
+	// something moves
+	bool resting;
+	TransformState restingState;
+
+	TransformState ReadTransform();
+	void AdoptOutsideChanges();
+};
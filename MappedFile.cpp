@@ -0,0 +1,114 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const char* fileName) :
+	data(nullptr),
+	size(0),
+	isOpen(false),
+	fileHandle(INVALID_HANDLE_VALUE),
+	mappingHandle(nullptr)
+{
+	fileHandle = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return;
+
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(fileHandle, &fileSize))
+		return;
+
+	// Empty files can't be mapped, but they are still valid files
+	isOpen = true;
+	size = (size_t)fileSize.QuadPart;
+	if (size == 0)
+		return;
+
+	mappingHandle = CreateFileMappingA(fileHandle, 0, PAGE_READONLY, 0, 0, 0);
+	if (!mappingHandle)
+	{
+		isOpen = false;
+		size = 0;
+		return;
+	}
+
+	data = (const char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (!data)
+	{
+		isOpen = false;
+		size = 0;
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	if (data) UnmapViewOfFile(data);
+	if (mappingHandle) CloseHandle(mappingHandle);
+	if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+}
+
+#else
+
+MappedFile::MappedFile(const char* fileName) :
+	data(nullptr),
+	size(0),
+	isOpen(false),
+	fileDescriptor(-1)
+{
+	fileDescriptor = open(fileName, O_RDONLY);
+	if (fileDescriptor < 0)
+		return;
+
+	struct stat fileInfo = {};
+	if (fstat(fileDescriptor, &fileInfo) != 0)
+		return;
+
+	// Empty files can't be mapped, but they are still valid files
+	isOpen = true;
+	size = (size_t)fileInfo.st_size;
+	if (size == 0)
+		return;
+
+	void* view = mmap(0, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	if (view == MAP_FAILED)
+	{
+		isOpen = false;
+		size = 0;
+		return;
+	}
+
+	// We read front to back, so let the kernel read ahead aggressively
+	madvise(view, size, MADV_SEQUENTIAL);
+	data = (const char*)view;
+}
+
+MappedFile::~MappedFile()
+{
+	if (data) munmap((void*)data, size);
+	if (fileDescriptor >= 0) close(fileDescriptor);
+}
+
+#endif
+
+bool MappedFile::IsOpen()
+{
+	return isOpen;
+}
+
+const char* MappedFile::GetData()
+{
+	return data;
+}
+
+size_t MappedFile::GetSize()
+{
+	return size;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+
+// --------------------------------------------------------
+// A read-only view of an entire file mapped into memory
+//
+// - Uses CreateFileMapping/MapViewOfFile on Windows and
+//   mmap everywhere else
+// - The view stays valid for the lifetime of the object
+// --------------------------------------------------------
+class MappedFile
+{
+public:
+	MappedFile(const char* fileName);
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete; // Mappings are not shareable
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool IsOpen();
+	const char* GetData();
+	size_t GetSize();
+
+private:
+	const char* data;
+	size_t size;
+	bool isOpen;
+
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int fileDescriptor;
+#endif
+};
@@ -36,6 +36,11 @@ std::shared_ptr<SimpleVertexShader> Material::GetVertexShader()
     return simpleVertexShader;
 }
 
+std::shared_ptr<SimpleVertexShader> Material::GetPackedVertexShader()
+{
+    return packedVertexShader;
+}
+
 std::shared_ptr<SimplePixelShader> Material::GetPixelShader()
 {
     return simplePixelShader;
@@ -71,6 +76,11 @@ void Material::SetVertexShader(std::shared_ptr<SimpleVertexShader> simpleVertexS
     this->simpleVertexShader = simpleVertexShader;
 }
 
+void Material::SetPackedVertexShader(std::shared_ptr<SimpleVertexShader> packedVertexShader)
+{
+    this->packedVertexShader = packedVertexShader;
+}
+
 void Material::SetPixelShader(std::shared_ptr<SimplePixelShader> simplePixelShader)
 {
     this->simplePixelShader = simplePixelShader;
@@ -15,6 +15,7 @@ public:
 	// Getters
 	DirectX::XMFLOAT4 GetColorTint();
 	std::shared_ptr<SimpleVertexShader> GetVertexShader();
+	std::shared_ptr<SimpleVertexShader> GetPackedVertexShader();
 	std::shared_ptr<SimplePixelShader> GetPixelShader();
 	DirectX::XMFLOAT2 GetUVScale();
 	DirectX::XMFLOAT2 GetUVOffset();
@@ -24,6 +25,7 @@ public:
 	// Setters
 	void SetColorTint(DirectX::XMFLOAT4 colorTint);
 	void SetVertexShader(std::shared_ptr<SimpleVertexShader> simpleVertexShader);
+	void SetPackedVertexShader(std::shared_ptr<SimpleVertexShader> packedVertexShader);
 	void SetPixelShader(std::shared_ptr<SimplePixelShader> simplePixelShader);
 	void SetUVScale(DirectX::XMFLOAT2 scale);
 	void SetUVOffset(DirectX::XMFLOAT2 offset);
@@ -35,6 +37,7 @@ private:
 	DirectX::XMFLOAT2 uvOffset;
 	float roughness;
 	std::shared_ptr<SimpleVertexShader> simpleVertexShader;
+	std::shared_ptr<SimpleVertexShader> packedVertexShader; // Same shader for meshes using PackedVertex
 	std::shared_ptr<SimplePixelShader> simplePixelShader;
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> textureSRVs;
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11SamplerState>> samplers;
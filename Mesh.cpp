@@ -1,344 +1,496 @@
 #include "Mesh.h"
+#include "ObjLoader.h"
+#include "MeshCache.h"
+#include "MappedFile.h"
+#include "Camera.h"
+#include <d3dcompiler.h>
 #include <vector>
-#include <fstream>
+#include <string>
 #include <stdexcept>
+#include <cstddef>
+#include <cmath>
+#include <cstring>
+#include <chrono>
 #include "DirectXMath.h"
 
 using namespace DirectX;
 
+// Projected radius (as a fraction of half the screen height) at or
+// above which LOD 0 is drawn; each later LOD takes over once the
+// mesh is half as big on screen as it was for the one before
+static const float fullDetailScreenSize = 0.5f;
+
+// Radius of the sphere around the center of a bounding box
+static float CalculateBoundingRadius(XMFLOAT3 boundsMin, XMFLOAT3 boundsMax)
+{
+	return XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&boundsMax), XMLoadFloat3(&boundsMin)))) * 0.5f;
+}
+
 Mesh::Mesh(Vertex vertices[], unsigned int indices[], int numVertices, int numIndices) {
 
 	this->numIndices = numIndices;
 	this->numVertices = numVertices;
-	CreateBuffers(vertices,indices,numVertices,numVertices);
+	this->numSourceVertices = numVertices;
+
+	this->boundsMin = numVertices > 0 ? vertices[0].Position : XMFLOAT3(0, 0, 0);
+	this->boundsMax = boundsMin;
+	for (int i = 1; i < numVertices; i++)
+	{
+		XMStoreFloat3(&boundsMin, XMVectorMin(XMLoadFloat3(&boundsMin), XMLoadFloat3(&vertices[i].Position)));
+		XMStoreFloat3(&boundsMax, XMVectorMax(XMLoadFloat3(&boundsMax), XMLoadFloat3(&vertices[i].Position)));
+	}
+
+	this->cacheStats.Before = MeshOptimizer::AnalyzeVertexCache(indices, numIndices, numVertices);
+	this->cacheStats.After = cacheStats.Before;
+	this->lods.push_back({ 0, (unsigned int)numIndices, 0.0f });
+	this->boundingRadius = CalculateBoundingRadius(boundsMin, boundsMax);
+	this->vertexFormat = VertexFormat::Full;
+	this->quantization = VertexPacking::GetQuantization(boundsMin, boundsMax);
+	this->visibleClusterCount = 0;
+	this->clusterCullTime = 0.0;
+	SetSubmeshes({ { std::string(), lods } }, {}, "");
+
+	CreateBuffers(vertices,indices,numVertices,numIndices);
+	CreateBvh(vertices, indices, nullptr);
 	
 }
-Mesh::Mesh(const char* objFile)
+Mesh::Mesh(const char* objFile, const ObjLoader::LoadOptions& options, VertexFormat format)
 {
-	// Author: Chris Cascioli
-// Purpose: Basic .OBJ 3D model loading, supporting positions, uvs and normals
-// 
-// - You are allowed to directly copy/paste this into your code base
-//   for assignments, given that you clearly cite that this is not
-//   code of your own design.
-
-// *************************************
-//      IMPLEMENTATION NOTES (1/2)
-//
-//  - You'll need to #include both
-//      <fstream> and <stdexcept>
-//
-//  - This is code you will need to 
-//      integrate into a function or
-//      constructor of your own making
-//
-//  - There is MORE TO DO after pasting 
-//      this code in - see the bottom for
-//      what to do *after* including 
-//      this code in your mesh class
-//
-// *************************************
-
-// File input object
-	std::ifstream obj(objFile);
-
-	// Check for successful open
-	if (!obj.is_open())
+	this->vertexFormat = format;
+	this->visibleClusterCount = 0;
+	this->clusterCullTime = 0.0;
+
+	MappedFile source(objFile);
+	if (!source.IsOpen())
 		throw std::invalid_argument("Error opening file: Invalid file path or file is inaccessible");
 
-	// Variables used while reading the file
-	std::vector<DirectX::XMFLOAT3> positions;	// Positions from the file
-	std::vector<DirectX::XMFLOAT3> normals;		// Normals from the file
-	std::vector<DirectX::XMFLOAT2> uvs;		// UVs from the file
-	std::vector<Vertex> verts;		// Verts we're assembling
-	std::vector<UINT> indices;		// Indices of these verts
-	int vertCounter = 0;			// Count of vertices
-	int indexCounter = 0;			// Count of indices
-	char chars[100];			// String for line reading
-
-	// Still have data left?
-	while (obj.good())
-	{
-		// Get the line (100 characters should be more than enough)
-		obj.getline(chars, 100);
+	uint64_t sourceSize = source.GetSize();
+	uint64_t sourceHash = MeshCache::HashBytes(source.GetData(), source.GetSize());
+	std::string cacheFile = MeshCache::GetCachePath(objFile);
 
-		// Check the type of line
-		if (chars[0] == 'v' && chars[1] == 'n')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			DirectX::XMFLOAT3 norm;
-			sscanf_s(
-				chars,
-				"vn %f %f %f",
-				&norm.x, &norm.y, &norm.z);
-
-			// Add to the list of normals
-			normals.push_back(norm);
-		}
-		else if (chars[0] == 'v' && chars[1] == 't')
+	// A valid cache already holds the final vertices (tangents
+	// included), so the mapped data goes straight to the GPU
+	{
+		MappedFile cache(cacheFile.c_str());
+		const MeshCache::Header* header = MeshCache::Validate(cache.GetData(), cache.GetSize(), sourceSize, sourceHash, options);
+		if (header)
 		{
-			// Read the 2 numbers directly into an XMFLOAT2
-			DirectX::XMFLOAT2 uv;
-			sscanf_s(
-				chars,
-				"vt %f %f",
-				&uv.x, &uv.y);
-
-			// Add to the list of uv's
-			uvs.push_back(uv);
+			this->numVertices = (int)header->VertexCount;
+			this->numSourceVertices = (int)header->SourceVertexCount;
+			this->boundsMin = header->BoundsMin;
+			this->boundsMax = header->BoundsMax;
+			this->boundingRadius = CalculateBoundingRadius(boundsMin, boundsMax);
+			this->quantization = VertexPacking::GetQuantization(boundsMin, boundsMax);
+			this->cacheStats = header->CacheStats;
+			this->lods.assign(MeshCache::GetLods(header), MeshCache::GetLods(header) + header->LodCount);
+			this->numIndices = (int)lods[0].IndexCount;
+
+			std::vector<ObjLoader::Submesh> cachedSubmeshes;
+			std::vector<std::string> materialLibraries;
+			MeshCache::GetSubmeshes(header, cachedSubmeshes, materialLibraries);
+			SetSubmeshes(cachedSubmeshes, materialLibraries, objFile);
+
+			CreateBuffers(MeshCache::GetVertices(header), MeshCache::GetIndices(header), numVertices, (int)header->IndexCount);
+			SetClusters(MeshCache::GetClusters(header), header->ClusterCount, MeshCache::GetIndices(header));
+			if (options.BuildBvh)
+				CreateBvh(MeshCache::GetVertices(header), MeshCache::GetIndices(header), MeshBvh::GetBvhPath(objFile).c_str());
+			return;
 		}
-		else if (chars[0] == 'v')
+	}
+
+	// Otherwise parse the file into welded verts (with tangents) and
+	// indices, which are already converted to DirectX's left-handed space
+	ObjLoader::MeshData data = ObjLoader::Parse(source.GetData(), source.GetSize(), options);
+	if (data.Vertices.empty() || data.Indices.empty())
+		throw std::invalid_argument("Error loading OBJ: File has no triangles");
+
+	this->numVertices = (int)data.Vertices.size();
+	this->numSourceVertices = (int)data.SourceVertexCount;
+	this->boundsMin = data.BoundsMin;
+	this->boundsMax = data.BoundsMax;
+	this->boundingRadius = CalculateBoundingRadius(boundsMin, boundsMax);
+	this->quantization = VertexPacking::GetQuantization(boundsMin, boundsMax);
+	this->cacheStats = data.CacheStats;
+	this->lods = data.Lods;
+	this->numIndices = (int)lods[0].IndexCount;
+	SetSubmeshes(data.Submeshes, data.MaterialLibraries, objFile);
+
+	CreateBuffers(data.Vertices.data(), data.Indices.data(), numVertices, (int)data.Indices.size());
+	SetClusters(data.Clusters.data(), data.Clusters.size(), data.Indices.data());
+	if (options.BuildBvh)
+		CreateBvh(data.Vertices.data(), data.Indices.data(), MeshBvh::GetBvhPath(objFile).c_str());
+
+	// Failing to write the cache just means we parse again next time
+	MeshCache::Write(cacheFile.c_str(), sourceSize, sourceHash, options, data);
+}
+Mesh::Mesh(const MeshChunks::Header* header, unsigned int chunk, const char* chunkFile, VertexFormat format)
+{
+	if (!MeshChunks::ValidateChunk(header, chunk))
+		throw std::invalid_argument("Error loading chunk: Chunk doesn't exist or its indices are out of range");
+
+	const MeshChunks::Chunk& data = MeshChunks::GetChunks(header)[chunk];
+	this->vertexFormat = format;
+	this->visibleClusterCount = 0;
+	this->clusterCullTime = 0.0;
+	this->numVertices = (int)data.VertexCount;
+	this->numSourceVertices = (int)data.VertexCount;
+	this->numIndices = (int)data.IndexCount;
+	this->boundsMin = data.BoundsMin;
+	this->boundsMax = data.BoundsMax;
+	this->boundingRadius = CalculateBoundingRadius(boundsMin, boundsMax);
+	this->quantization = VertexPacking::GetQuantization(boundsMin, boundsMax);
+
+	// The converter already optimized the chunk, so there's no
+	// before and after, and chunks only have the full detail LOD
+	const unsigned int* indices = MeshChunks::GetIndices(header, data);
+	this->cacheStats.Before = MeshOptimizer::AnalyzeVertexCache(indices, numIndices, numVertices);
+	this->cacheStats.After = cacheStats.Before;
+	this->lods.push_back({ 0, (unsigned int)numIndices, 0.0f });
+
+	std::vector<std::string> materialLibraries;
+	std::vector<std::string> materials;
+	MeshChunks::GetStrings(header, materialLibraries, materials);
+	std::vector<ObjLoader::Submesh> chunkSubmeshes;
+	const MeshChunks::Submesh* submeshes = MeshChunks::GetSubmeshes(header) + data.SubmeshStart;
+	for (uint32_t s = 0; s < data.SubmeshCount; s++)
+		chunkSubmeshes.push_back({ materials[submeshes[s].Material], { { submeshes[s].IndexStart, submeshes[s].IndexCount, 0.0f } } });
+	if (chunkSubmeshes.empty())
+		chunkSubmeshes.push_back({ std::string(), lods });
+	SetSubmeshes(chunkSubmeshes, materialLibraries, chunkFile);
+
+	CreateBuffers(MeshChunks::GetVertices(header, data), indices, numVertices, numIndices);
+	CreateBvh(MeshChunks::GetVertices(header, data), indices, nullptr);
+}
+// --------------------------------------------------------
+// Uploads a glTF mesh's primitives as one mesh, copying as
+// little as possible
+// - A single primitive goes straight to CreateBuffers()
+// - Primitives that share their vertices (one accessor, or
+//   ranges that follow one another in the file) still use
+//   them in place, and only the indices are joined
+// --------------------------------------------------------
+Mesh::Mesh(const GltfLoader::Scene& scene, int mesh, VertexFormat format)
+{
+	if (mesh < 0 || mesh >= (int)scene.Meshes.size() || scene.Meshes[mesh].Primitives.empty())
+		throw std::invalid_argument("Error loading glTF mesh: Mesh doesn't exist or has no triangles");
+
+	const std::vector<GltfLoader::Primitive>& primitives = scene.Meshes[mesh].Primitives;
+	this->vertexFormat = format;
+	this->visibleClusterCount = 0;
+	this->clusterCullTime = 0.0;
+
+	// Where each primitive's vertices start, if they can be shared
+	bool sameVertices = true;
+	bool adjacentVertices = true;
+	std::vector<unsigned int> baseVertices;
+	unsigned int vertexCount = 0;
+	for (const GltfLoader::Primitive& primitive : primitives)
+	{
+		sameVertices = sameVertices && primitive.Vertices == primitives[0].Vertices && primitive.VertexCount == primitives[0].VertexCount;
+		adjacentVertices = adjacentVertices && primitive.Vertices == primitives[0].Vertices + vertexCount;
+		baseVertices.push_back(vertexCount);
+		vertexCount += primitive.VertexCount;
+	}
+	if (sameVertices)
+	{
+		baseVertices.assign(primitives.size(), 0);
+		vertexCount = primitives[0].VertexCount;
+	}
+
+	std::vector<Vertex> joinedVertices;
+	const Vertex* vertices = primitives[0].Vertices;
+	if (!sameVertices && !adjacentVertices)
+	{
+		for (const GltfLoader::Primitive& primitive : primitives)
+			joinedVertices.insert(joinedVertices.end(), primitive.Vertices, primitive.Vertices + primitive.VertexCount);
+		vertices = joinedVertices.data();
+	}
+
+	std::vector<unsigned int> joinedIndices;
+	const unsigned int* indices = primitives[0].Indices;
+	std::vector<ObjLoader::Submesh> primitiveSubmeshes;
+	unsigned int indexCount = 0;
+	for (size_t p = 0; p < primitives.size(); p++)
+	{
+		const GltfLoader::Primitive& primitive = primitives[p];
+		if (primitives.size() > 1)
 		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			DirectX::XMFLOAT3 pos;
-			sscanf_s(
-				chars,
-				"v %f %f %f",
-				&pos.x, &pos.y, &pos.z);
-
-			// Add to the positions
-			positions.push_back(pos);
+			for (unsigned int i = 0; i < primitive.IndexCount; i++)
+				joinedIndices.push_back(primitive.Indices[i] + baseVertices[p]);
 		}
-		else if (chars[0] == 'f')
+
+		std::string material = primitive.Material >= 0 ? scene.Materials[primitive.Material].Name : std::string();
+		primitiveSubmeshes.push_back({ material, { { indexCount, primitive.IndexCount, 0.0f } } });
+		indexCount += primitive.IndexCount;
+
+		XMVECTOR primitiveMin = XMLoadFloat3(&primitive.BoundsMin);
+		XMVECTOR primitiveMax = XMLoadFloat3(&primitive.BoundsMax);
+		XMStoreFloat3(&boundsMin, p == 0 ? primitiveMin : XMVectorMin(XMLoadFloat3(&boundsMin), primitiveMin));
+		XMStoreFloat3(&boundsMax, p == 0 ? primitiveMax : XMVectorMax(XMLoadFloat3(&boundsMax), primitiveMax));
+	}
+	if (primitives.size() > 1)
+		indices = joinedIndices.data();
+
+	this->numVertices = (int)vertexCount;
+	this->numSourceVertices = (int)vertexCount;
+	this->numIndices = (int)indexCount;
+	this->boundingRadius = CalculateBoundingRadius(boundsMin, boundsMax);
+	this->quantization = VertexPacking::GetQuantization(boundsMin, boundsMax);
+	this->cacheStats.Before = MeshOptimizer::AnalyzeVertexCache(indices, numIndices, numVertices);
+	this->cacheStats.After = cacheStats.Before;
+	this->lods.push_back({ 0, indexCount, 0.0f });
+	SetSubmeshes(primitiveSubmeshes, {}, "");
+
+	CreateBuffers(vertices, indices, numVertices, numIndices);
+	CreateBvh(vertices, indices, nullptr);
+}
+void Mesh::CreateBuffers(const Vertex vertices[], const unsigned int indices[], int numVertices, int numIndices)
+{
+	// An empty range can't be allocated or drawn, so an empty mesh
+	// is a mistake by the caller rather than something to upload
+	if (!vertices || !indices || numVertices <= 0 || numIndices <= 0)
+		throw std::invalid_argument("Error creating mesh: Mesh has no vertices or indices");
+
+	prepared = false;
+
+	// Packed meshes convert their vertices first, which relies on
+	// the quantization (from the bounds) already being set
+	std::vector<PackedVertex> packedVertices;
+	if (vertexFormat == VertexFormat::Packed)
+	{
+		packedVertices.resize(numVertices);
+		for (int i = 0; i < numVertices; i++)
+			packedVertices[i] = VertexPacking::Pack(vertices[i], quantization);
+	}
+
+	// Rather than a VERTEX BUFFER and INDEX BUFFER of its own, the mesh
+	// gets a range of each in one of the arena's shared pages
+	// - Indices stay relative to the mesh's first vertex, and draws
+	//   pass the range's base vertex to DrawIndexed() instead
+	// - Consecutive draws of meshes in the same page then skip
+	//   rebinding the input assembler entirely
+	// - A mesh that already had buffers gives its old ranges back
+	if (arena)
+		arena->Free(allocation);
+	arena = MeshArena::GetShared();
+	allocation = arena->Allocate(
+		packedVertices.empty() ? (const void*)vertices : packedVertices.data(),
+		GetVertexStride(),
+		(unsigned int)numVertices,
+		indices,
+		(unsigned int)numIndices);
+	drawIndexStart = allocation.StartIndex;
+}
+
+// --------------------------------------------------------
+// Keeps the submesh table and looks up each submesh's material
+// in the .mtl libraries (named relative to the .obj file)
+// - A library that's missing or can't be read only leaves its
+//   submeshes with default materials, since the geometry is fine
+// --------------------------------------------------------
+void Mesh::SetSubmeshes(const std::vector<ObjLoader::Submesh>& submeshes, const std::vector<std::string>& materialLibraries, const char* objFile)
+{
+	this->submeshes = submeshes;
+	this->drawRanges.resize(submeshes.size());
+
+	std::string directory = objFile;
+	size_t slash = directory.find_last_of("/\\");
+	directory.erase(slash == std::string::npos ? 0 : slash + 1);
+
+	std::vector<MtlLoader::MaterialDescription> materials;
+	for (const std::string& library : materialLibraries)
+	{
+		try
 		{
-			// Read the face indices into an array
-			// NOTE: This assumes the given obj file contains
-			//  vertex positions, uv coordinates AND normals.
-			unsigned int i[12];
-			int numbersRead = sscanf_s(
-				chars,
-				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
-				&i[0], &i[1], &i[2],
-				&i[3], &i[4], &i[5],
-				&i[6], &i[7], &i[8],
-				&i[9], &i[10], &i[11]);
-
-			// If we only got the first number, chances are the OBJ
-			// file has no UV coordinates.  This isn't great, but we
-			// still want to load the model without crashing, so we
-			// need to re-read a different pattern (in which we assume
-			// there are no UVs denoted for any of the vertices)
-			if (numbersRead == 1)
-			{
-				// Re-read with a different pattern
-				numbersRead = sscanf_s(
-					chars,
-					"f %d//%d %d//%d %d//%d %d//%d",
-					&i[0], &i[2],
-					&i[3], &i[5],
-					&i[6], &i[8],
-					&i[9], &i[11]);
-
-				// The following indices are where the UVs should 
-				// have been, so give them a valid value
-				i[1] = 1;
-				i[4] = 1;
-				i[7] = 1;
-				i[10] = 1;
-
-				// If we have no UVs, create a single UV coordinate
-				// that will be used for all vertices
-				if (uvs.size() == 0)
-					uvs.push_back(DirectX::XMFLOAT2(0, 0));
-			}
-
-			// - Create the verts by looking up
-			//    corresponding data from vectors
-			// - OBJ File indices are 1-based, so
-			//    they need to be adusted
-			Vertex v1;
-			v1.Position = positions[i[0] - 1];
-			v1.UV = uvs[i[1] - 1];
-			v1.Normal = normals[i[2] - 1];
-
-			Vertex v2;
-			v2.Position = positions[i[3] - 1];
-			v2.UV = uvs[i[4] - 1];
-			v2.Normal = normals[i[5] - 1];
-
-			Vertex v3;
-			v3.Position = positions[i[6] - 1];
-			v3.UV = uvs[i[7] - 1];
-			v3.Normal = normals[i[8] - 1];
-
-			// The model is most likely in a right-handed space,
-			// especially if it came from Maya.  We want to convert
-			// to a left-handed space for DirectX.  This means we 
-			// need to:
-			//  - Invert the Z position
-			//  - Invert the normal's Z
-			//  - Flip the winding order
-			// We also need to flip the UV coordinate since DirectX
-			// defines (0,0) as the top left of the texture, and many
-			// 3D modeling packages use the bottom left as (0,0)
-
-			// Flip the UV's since they're probably "upside down"
-			v1.UV.y = 1.0f - v1.UV.y;
-			v2.UV.y = 1.0f - v2.UV.y;
-			v3.UV.y = 1.0f - v3.UV.y;
-
-			// Flip Z (LH vs. RH)
-			v1.Position.z *= -1.0f;
-			v2.Position.z *= -1.0f;
-			v3.Position.z *= -1.0f;
-
-			// Flip normal's Z
-			v1.Normal.z *= -1.0f;
-			v2.Normal.z *= -1.0f;
-			v3.Normal.z *= -1.0f;
-
-			// Add the verts to the vector (flipping the winding order)
-			verts.push_back(v1);
-			verts.push_back(v3);
-			verts.push_back(v2);
-			vertCounter += 3;
-
-			// Add three more indices
-			indices.push_back(indexCounter); indexCounter += 1;
-			indices.push_back(indexCounter); indexCounter += 1;
-			indices.push_back(indexCounter); indexCounter += 1;
-
-			// Was there a 4th face?
-			// - 12 numbers read means 4 faces WITH uv's
-			// - 8 numbers read means 4 faces WITHOUT uv's
-			if (numbersRead == 12 || numbersRead == 8)
-			{
-				// Make the last vertex
-				Vertex v4;
-				v4.Position = positions[i[9] - 1];
-				v4.UV = uvs[i[10] - 1];
-				v4.Normal = normals[i[11] - 1];
-
-				// Flip the UV, Z pos and normal's Z
-				v4.UV.y = 1.0f - v4.UV.y;
-				v4.Position.z *= -1.0f;
-				v4.Normal.z *= -1.0f;
-
-				// Add a whole triangle (flipping the winding order)
-				verts.push_back(v1);
-				verts.push_back(v4);
-				verts.push_back(v3);
-				vertCounter += 3;
-
-				// Add three more indices
-				indices.push_back(indexCounter); indexCounter += 1;
-				indices.push_back(indexCounter); indexCounter += 1;
-				indices.push_back(indexCounter); indexCounter += 1;
-			}
+			std::vector<MtlLoader::MaterialDescription> loaded = MtlLoader::Load((directory + library).c_str());
+			materials.insert(materials.end(), loaded.begin(), loaded.end());
 		}
+		catch (const std::invalid_argument&) {}
 	}
 
-	// Close the file and create the actual buffers
-	obj.close();
-
-	// *************************************
-	//      IMPLEMENTATION NOTES (2/2)
-	//
-	// - At this point, "verts" is a std::vector 
-	//     of Vertex structs, and can be used
-	//     to create your mesh's vertex buffer
-	//
-	// - NOTE: Use &verts[0] for the address of 
-	//     the first vertx, NOT JUST &verts
-	//
-	// - The vector "indices" is similar. It's 
-	//     a std::vector of unsigned ints and
-	//     can be used to create the index 
-	//     buffer (again, &indices[0] is the 
-	//     address of the first integer)
-	//
-	// - Make sure your mesh class actually SAVES
-	//     the number of vertices and indices, or
-	//     drawing may have unintended problems.
-	//     - "vertCounter" is the number of vertices
-	//     - "indexCounter" is the number of indices
-	//
-	// - If you dig into the code, you may notice 
-	//     that  "vertCounter" and "indexCounter" 
-	//     end up being the same.  Recall that OBJs 
-	//     do not index entire vertices, making
-	//     it complex to detect duplicate vertices.
-	//     This also means an index buffer isn't
-	//     doing much for us.  We could try to 
-	//     detect duplicate vertices ourselves, 
-	//     but at that point it would be better 
-	//     to use a more sophisticated mesh loading
-	//     library like TinyOBJLoader or 
-	//     The Open Asset Importer Library, both
-	//     of which are unnecessary for now.
-	//
-	// *************************************
-	
-	this->numVertices = vertCounter;
-	this->numIndices = indexCounter;
-	CalculateTangents(&verts[0], vertCounter, &indices[0],  indexCounter);
-	CreateBuffers(&verts[0], &indices[0], vertCounter, indexCounter);
+	this->submeshMaterials.clear();
+	for (const ObjLoader::Submesh& submesh : submeshes)
+	{
+		const MtlLoader::MaterialDescription* material = MtlLoader::Find(materials, submesh.Material);
+		this->submeshMaterials.push_back(material ? *material : MtlLoader::MaterialDescription());
+		this->submeshMaterials.back().Name = submesh.Material;
+	}
 }
-void Mesh::CreateBuffers(Vertex vertices[], unsigned int indices[], int numVertices, int numIndices)
+
+// --------------------------------------------------------
+// Builds the BVH over LOD 0, or reads it from bvhFile (when
+// given) if the file was built from these exact vertices
+// and indices
+// - The key is the hash of the final data rather than of the
+//   source file, so changing load options that change the
+//   geometry also rebuilds the tree
+// --------------------------------------------------------
+void Mesh::CreateBvh(const Vertex vertices[], const unsigned int indices[], const char* bvhFile)
 {
-	// Create a VERTEX BUFFER
-	// - This holds the vertex data of triangles for a single object
-	// - This buffer is created on the GPU, which is where the data needs to
-	//    be if we want the GPU to act on it (as in: draw it to the screen)
+	const unsigned int* lodIndices = indices + lods[0].IndexStart;
+	size_t vertexBytes = (size_t)numVertices * sizeof(Vertex);
+	size_t indexBytes = (size_t)lods[0].IndexCount * sizeof(unsigned int);
+	if (!bvhFile)
 	{
-		// First, we need to describe the buffer we want Direct3D to make on the GPU
-		//  - Note that this variable is created on the stack since we only need it once
-		//  - After the buffer is created, this description variable is unnecessary
-		D3D11_BUFFER_DESC vbd = {};
-		vbd.Usage = D3D11_USAGE_IMMUTABLE;	// Will NEVER change
-		vbd.ByteWidth = sizeof(Vertex) * numVertices;       // number of vertices in the buffer
-		vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER; // Tells Direct3D this is a vertex buffer
-		vbd.CPUAccessFlags = 0;	// Note: We cannot access the data from C++ (this is good)
-		vbd.MiscFlags = 0;
-		vbd.StructureByteStride = 0;
-
-		// Create the proper struct to hold the initial vertex data
-		// - This is how we initially fill the buffer with data
-		// - Essentially, we're specifying a pointer to the data to copy
-		D3D11_SUBRESOURCE_DATA initialVertexData = {};
-		initialVertexData.pSysMem = vertices; // pSysMem = Pointer to System Memory
-
-		// Actually create the buffer on the GPU with the initial data
-		// - Once we do this, we'll NEVER CHANGE DATA IN THE BUFFER AGAIN
-		Graphics::Device->CreateBuffer(&vbd, &initialVertexData, vertexBuffer.GetAddressOf());
+		bvh = MeshBvh::Build(vertices, lodIndices, lods[0].IndexCount);
+		return;
 	}
 
-	// Create an INDEX BUFFER
-	// - This holds indices to elements in the vertex buffer
-	// - This is most useful when vertices are shared among neighboring triangles
-	// - This buffer is created on the GPU, which is where the data needs to
-	//    be if we want the GPU to act on it (as in: draw it to the screen)
+	uint64_t dataSize = vertexBytes + indexBytes;
+	uint64_t dataHash = MeshCache::HashBytes((const char*)vertices, vertexBytes) ^
+		(MeshCache::HashBytes((const char*)lodIndices, indexBytes) * 0x9E3779B97F4A7C15ull);
+	if (MeshBvh::Read(bvhFile, dataSize, dataHash, MeshBvh::Options(), bvh))
+		return;
+
+	// As with the cache, failing to write only costs a rebuild next time
+	bvh = MeshBvh::Build(vertices, lodIndices, lods[0].IndexCount);
+	MeshBvh::Write(bvhFile, dataSize, dataHash, MeshBvh::Options(), bvh);
+}
+
+// --------------------------------------------------------
+// Keeps what cluster culling needs on the CPU, along with a
+// dynamic index buffer big enough for all of LOD 0
+// --------------------------------------------------------
+void Mesh::SetClusters(const MeshClusters::Cluster* clusters, size_t clusterCount, const unsigned int* indices)
+{
+	if (clusterCount == 0)
+		return;
+
+	this->clusters.assign(clusters, clusters + clusterCount);
+	this->clusterIndices.assign(indices + lods[0].IndexStart, indices + lods[0].IndexStart + lods[0].IndexCount);
+	this->visibleIndices.reserve(clusterIndices.size());
+	this->visibleClusterCount = (int)clusterCount;
+
+	// Cluster index starts are relative to the whole index buffer
+	for (MeshClusters::Cluster& cluster : this->clusters)
+		cluster.IndexStart -= lods[0].IndexStart;
+
+	// Clusters never cross submeshes, and are stored in submesh order
+	size_t cluster = 0;
+	this->submeshClusterStarts.clear();
+	for (const ObjLoader::Submesh& submesh : submeshes)
 	{
-		// Describe the buffer, as we did above, with two major differences
-		//  - Byte Width (3 unsigned integers vs. 3 whole vertices)
-		//  - Bind Flag (used as an index buffer instead of a vertex buffer) 
-		D3D11_BUFFER_DESC ibd = {};
-		ibd.Usage = D3D11_USAGE_IMMUTABLE;	// Will NEVER change
-		ibd.ByteWidth = sizeof(unsigned int) * numIndices;	// number of indices in the buffer
-		ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;	// Tells Direct3D this is an index buffer
-		ibd.CPUAccessFlags = 0;	// Note: We cannot access the data from C++ (this is good)
-		ibd.MiscFlags = 0;
-		ibd.StructureByteStride = 0;
-
-		// Specify the initial data for this buffer, similar to above
-		D3D11_SUBRESOURCE_DATA initialIndexData = {};
-		initialIndexData.pSysMem = indices; // pSysMem = Pointer to System Memory
-
-		// Actually create the buffer with the initial data
-		// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
-		Graphics::Device->CreateBuffer(&ibd, &initialIndexData, indexBuffer.GetAddressOf());
+		this->submeshClusterStarts.push_back((unsigned int)cluster);
+		unsigned int submeshEnd = submesh.Lods[0].IndexStart + submesh.Lods[0].IndexCount - lods[0].IndexStart;
+		while (cluster < clusterCount && this->clusters[cluster].IndexStart < submeshEnd)
+			cluster++;
 	}
+	this->submeshClusterStarts.push_back((unsigned int)clusterCount);
+
+	D3D11_BUFFER_DESC ibd = {};
+	ibd.Usage = D3D11_USAGE_DYNAMIC;	// Rewritten by the CPU every culled draw
+	ibd.ByteWidth = sizeof(unsigned int) * (UINT)clusterIndices.size();
+	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	ibd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	Graphics::Device->CreateBuffer(&ibd, 0, visibleIndexBuffer.GetAddressOf());
 }
 void Mesh::Draw() {
+	DrawLod(0);
+}
+
+// --------------------------------------------------------
+// Draws whichever LOD suits the mesh's size on screen, with
+// clusters culled when that's the full detail mesh
+// --------------------------------------------------------
+void Mesh::Draw(std::shared_ptr<Camera> camera, DirectX::XMFLOAT4X4 worldMatrix) {
+	PrepareDraw(camera, worldMatrix);
+	DrawSubmeshes(0, (int)submeshes.size());
+}
+
+void Mesh::PrepareDraw(std::shared_ptr<Camera> camera, DirectX::XMFLOAT4X4 worldMatrix) {
+	XMFLOAT4X4 view = camera->GetView();
+	XMFLOAT4X4 proj = camera->GetProj();
+	bool current = prepared &&
+		memcmp(&worldMatrix, &preparedWorld, sizeof(XMFLOAT4X4)) == 0 &&
+		memcmp(&view, &preparedView, sizeof(XMFLOAT4X4)) == 0 &&
+		memcmp(&proj, &preparedProj, sizeof(XMFLOAT4X4)) == 0;
+	if (!current)
+	{
+		int lod = SelectLod(camera, worldMatrix);
+		bool culled = lod == 0 && !clusters.empty() && CullClusters(camera, worldMatrix);
+		if (!culled)
+		{
+			for (size_t i = 0; i < submeshes.size(); i++)
+				drawRanges[i] = submeshes[i].Lods[lod];
+		}
+
+		prepared = true;
+		preparedCulled = culled;
+		preparedWorld = worldMatrix;
+		preparedView = view;
+		preparedProj = proj;
+	}
+
+	// Culled ranges are in the mesh's own dynamic index buffer
+	arena->Bind(allocation, preparedCulled ? visibleIndexBuffer.Get() : nullptr);
+	drawIndexStart = preparedCulled ? 0 : allocation.StartIndex;
+}
+
+// --------------------------------------------------------
+// Consecutive submeshes are also consecutive in every LOD
+// (and after culling), so any run of them is a single draw
+// --------------------------------------------------------
+void Mesh::DrawSubmeshes(int firstSubmesh, int submeshCount) {
+	const MeshSimplifier::LodRange& first = drawRanges[firstSubmesh];
+	const MeshSimplifier::LodRange& last = drawRanges[firstSubmesh + submeshCount - 1];
+	UINT indexCount = last.IndexStart + last.IndexCount - first.IndexStart;
+	if (indexCount > 0)
+		Graphics::Commands.DrawIndexed(indexCount, drawIndexStart + first.IndexStart, (INT)allocation.BaseVertex);
+}
+
+// --------------------------------------------------------
+// Culls clusters against the camera in object space, and
+// packs each submesh's survivors into one compacted index
+// range, in submesh order
+// - The frustum comes from world * view * projection, and
+//   the camera is moved into object space, so the clusters
+//   never need transforming
+// - Returns false when nothing was culled, since the
+//   immutable buffer already has it all
+// --------------------------------------------------------
+bool Mesh::CullClusters(std::shared_ptr<Camera> camera, DirectX::XMFLOAT4X4 worldMatrix) {
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	XMFLOAT4X4 view = camera->GetView();
+	XMFLOAT4X4 proj = camera->GetProj();
+	XMMATRIX world = XMLoadFloat4x4(&worldMatrix);
+	Frustum frustum = Frustum::FromMatrix(world * XMLoadFloat4x4(&view) * XMLoadFloat4x4(&proj));
+
+	XMFLOAT3 cameraPos = camera->GetPosition();
+	XMFLOAT3 localCameraPos;
+	XMStoreFloat3(&localCameraPos, XMVector3Transform(XMLoadFloat3(&cameraPos), XMMatrixInverse(0, world)));
+
+	visibleIndices.clear();
+	visibleClusterCount = 0;
+	for (size_t i = 0; i < submeshes.size(); i++)
+	{
+		unsigned int rangeStart = (unsigned int)visibleIndices.size();
+		unsigned int first = submeshClusterStarts[i];
+		visibleClusterCount += (int)MeshClusters::Cull(
+			clusters.data() + first, submeshClusterStarts[i + 1] - first,
+			clusterIndices.data(), frustum, localCameraPos, visibleIndices);
+		drawRanges[i] = { rangeStart, (unsigned int)visibleIndices.size() - rangeStart, 0.0f };
+	}
+
+	bool allVisible = visibleClusterCount == (int)clusters.size();
+	if (!allVisible && !visibleIndices.empty())
+	{
+		// The buffer is dynamic, so the backend maps it and discards what was there
+		Graphics::Commands.UpdateBuffer(visibleIndexBuffer.Get(), visibleIndices.data(), (unsigned int)(sizeof(unsigned int) * visibleIndices.size()));
+	}
+	clusterCullTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	return !allVisible;
+}
+
+void Mesh::DrawLod(int lod) {
 	// Set buffers in the input assembler (IA) stage
 	//  - Do this ONCE PER OBJECT, since each object may have different geometry
 	//  - For this demo, this step *could* simply be done once during Init()
 	//  - However, this needs to be done between EACH DrawIndexed() call
 	//     when drawing different geometry, so it's here as an example
-	UINT stride = sizeof(Vertex);
-	UINT offset = 0;
-	Graphics::Context->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
-	Graphics::Context->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+	//  - Meshes share buffers through the arena, so this only binds
+	//     anything when the previous draw used a different page
+	arena->Bind(allocation);
 
 	// Tell Direct3D to draw
 	//  - Begins the rendering pipeline on the GPU
@@ -346,102 +498,74 @@ void Mesh::Draw() {
 	//  - This will use all currently set Direct3D resources (shaders, buffers, etc)
 	//  - DrawIndexed() uses the currently set INDEX BUFFER to look up corresponding
 	//     vertices in the currently set VERTEX BUFFER
-	Graphics::Context->DrawIndexed(
-		numIndices,     // The number of indices to use (we could draw a subset if we wanted)
-		0,     // Offset to the first index we want to use
-		0);    // Offset to add to each index when looking up vertices
+	//  - Every LOD lives in the same index buffer, so we draw just its subset
+	Graphics::Commands.DrawIndexed(
+		lods[lod].IndexCount,     // The number of indices to use
+		allocation.StartIndex + lods[lod].IndexStart,     // Offset to the first index we want to use
+		(INT)allocation.BaseVertex);    // Offset to add to each index when looking up vertices
 
 }
-Mesh::~Mesh() {
 
+// --------------------------------------------------------
+// Picks an LOD from the mesh's projected size, using the
+// bounding sphere scaled by the world matrix
+// --------------------------------------------------------
+int Mesh::SelectLod(std::shared_ptr<Camera> camera, DirectX::XMFLOAT4X4 worldMatrix) {
+	if (lods.size() == 1)
+		return 0;
+
+	XMMATRIX world = XMLoadFloat4x4(&worldMatrix);
+	XMVECTOR localCenter = XMVectorScale(XMVectorAdd(XMLoadFloat3(&boundsMin), XMLoadFloat3(&boundsMax)), 0.5f);
+	XMVECTOR center = XMVector3Transform(localCenter, world);
+
+	// Largest axis scale, so the sphere stays around the mesh
+	float scale = fmaxf(XMVectorGetX(XMVector3Length(world.r[0])),
+		fmaxf(XMVectorGetX(XMVector3Length(world.r[1])), XMVectorGetX(XMVector3Length(world.r[2]))));
+	float radius = boundingRadius * scale;
+
+	XMFLOAT3 cameraPos = camera->GetPosition();
+	float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(center, XMLoadFloat3(&cameraPos))));
+	if (distance <= radius)
+		return 0;
+
+	// Fraction of half the screen's height covered by the sphere
+	float screenSize = radius / (distance * tanf(camera->GetFov() * 0.5f));
+	if (screenSize >= fullDetailScreenSize)
+		return 0;
+
+	int lod = (int)log2f(fullDetailScreenSize / screenSize);
+	return lod < (int)lods.size() ? lod : (int)lods.size() - 1;
 }
-
 // --------------------------------------------------------
-// Author: Chris Cascioli
-// Purpose: Calculates the tangents of the vertices in a mesh
-// 
-// - You are allowed to directly copy/paste this into your code base
-//   for assignments, given that you clearly cite that this is not
-//   code of your own design.
-//
-// - Code originally adapted from: http://www.terathon.com/code/tangent.html
-//   - Updated version now found here: http://foundationsofgameenginedev.com/FGED2-sample.pdf
-//   - See listing 7.4 in section 7.5 (page 9 of the PDF)
-//
-// - Note: For this code to work, your Vertex format must
-//         contain an XMFLOAT3 called Tangent
-//
-// - Be sure to call this BEFORE creating your D3D vertex/index buffers
+// Describes PackedVertex to the input assembler
+// - Reflection can't be used here, since the shader sees
+//   floats that are stored as unorm, half and snorm values
 // --------------------------------------------------------
-void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
+Microsoft::WRL::ComPtr<ID3D11InputLayout> Mesh::CreatePackedInputLayout(LPCWSTR vertexShaderFile)
 {
-	// Reset tangents
-	for (int i = 0; i < numVerts; i++)
-	{
-		verts[i].Tangent = DirectX::XMFLOAT3(0, 0, 0);
-	}
+	Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout;
+	Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob;
+	if (FAILED(D3DReadFileToBlob(vertexShaderFile, shaderBlob.GetAddressOf())))
+		return inputLayout;
 
-	// Calculate tangents one whole triangle at a time
-	for (int i = 0; i < numIndices;)
+	D3D11_INPUT_ELEMENT_DESC inputElements[] =
 	{
-		// Grab indices and vertices of first triangle
-		unsigned int i1 = indices[i++];
-		unsigned int i2 = indices[i++];
-		unsigned int i3 = indices[i++];
-		Vertex* v1 = &verts[i1];
-		Vertex* v2 = &verts[i2];
-		Vertex* v3 = &verts[i3];
-
-		// Calculate vectors relative to triangle positions
-		float x1 = v2->Position.x - v1->Position.x;
-		float y1 = v2->Position.y - v1->Position.y;
-		float z1 = v2->Position.z - v1->Position.z;
-
-		float x2 = v3->Position.x - v1->Position.x;
-		float y2 = v3->Position.y - v1->Position.y;
-		float z2 = v3->Position.z - v1->Position.z;
-
-		// Do the same for vectors relative to triangle uv's
-		float s1 = v2->UV.x - v1->UV.x;
-		float t1 = v2->UV.y - v1->UV.y;
-
-		float s2 = v3->UV.x - v1->UV.x;
-		float t2 = v3->UV.y - v1->UV.y;
-
-		// Create vectors for tangent calculation
-		float r = 1.0f / (s1 * t2 - s2 * t1);
-
-		float tx = (t2 * x1 - t1 * x2) * r;
-		float ty = (t2 * y1 - t1 * y2) * r;
-		float tz = (t2 * z1 - t1 * z2) * r;
-
-		// Adjust tangents of each vert of the triangle
-		v1->Tangent.x += tx;
-		v1->Tangent.y += ty;
-		v1->Tangent.z += tz;
-
-		v2->Tangent.x += tx;
-		v2->Tangent.y += ty;
-		v2->Tangent.z += tz;
-
-		v3->Tangent.x += tx;
-		v3->Tangent.y += ty;
-		v3->Tangent.z += tz;
-	}
-
-	// Ensure all of the tangents are orthogonal to the normals
-	for (int i = 0; i < numVerts; i++)
-	{
-		// Grab the two vectors
-		XMVECTOR normal = XMLoadFloat3(&verts[i].Normal);
-		XMVECTOR tangent = XMLoadFloat3(&verts[i].Tangent);
-
-		// Use Gram-Schmidt orthonormalize to ensure
-		// the normal and tangent are exactly 90 degrees apart
-		tangent = XMVector3Normalize(
-			tangent - normal * XMVector3Dot(normal, tangent));
+		{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, offsetof(PackedVertex, Position), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, offsetof(PackedVertex, UV), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, offsetof(PackedVertex, Normal), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TANGENT", 0, DXGI_FORMAT_R16G16_SNORM, 0, offsetof(PackedVertex, Tangent), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	};
+
+	Graphics::Device->CreateInputLayout(
+		inputElements,
+		ARRAYSIZE(inputElements),
+		shaderBlob->GetBufferPointer(),
+		shaderBlob->GetBufferSize(),
+		inputLayout.GetAddressOf());
+	return inputLayout;
+}
 
-		// Store the tangent
-		XMStoreFloat3(&verts[i].Tangent, tangent);
-	}
-}
\ No newline at end of file
+Mesh::~Mesh() {
+	if (arena)
+		arena->Free(allocation);
+}
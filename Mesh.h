@@ -1,26 +1,88 @@
 #pragma once
 #include <d3d11.h>
 #include <wrl/client.h>
+#include <memory>
+#include <vector>
 #include "Graphics.h"
 #include "Vertex.h"
+#include "ObjLoader.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "VertexPacking.h"
+#include "MeshClusters.h"
+#include "MtlLoader.h"
+#include "MeshChunks.h"
+#include "MeshArena.h"
+#include "GltfLoader.h"
+#include "MeshBvh.h"
+
+class Camera;
 
 class Mesh
 {
 	private :
-		Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
-		Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
+		// Vertices and indices live in the shared arena's pages
+		std::shared_ptr<MeshArena> arena;
+		MeshArena::Allocation allocation;
+		unsigned int drawIndexStart;	// Added to the draw ranges, set by PrepareDraw()
 		int numIndices;
 		int numVertices;
+		int numSourceVertices;
+		DirectX::XMFLOAT3 boundsMin;
+		DirectX::XMFLOAT3 boundsMax;
+		MeshOptimizer::Stats cacheStats;
+		std::vector<MeshSimplifier::LodRange> lods;
+		float boundingRadius;
+		VertexFormat vertexFormat;
+		VertexPacking::Quantization quantization;
+
+		// Submeshes share the buffers, each with a range in every LOD
+		std::vector<ObjLoader::Submesh> submeshes;
+		std::vector<MtlLoader::MaterialDescription> submeshMaterials;	// One per submesh
+		std::vector<MeshSimplifier::LodRange> drawRanges;	// Per submesh, set by PrepareDraw()
+
+		// What the last PrepareDraw() was for, so preparing the same
+		// entity again from the same camera (once per material, when a
+		// render queue sorts by material) keeps the ranges it has
+		bool prepared;
+		bool preparedCulled;
+		DirectX::XMFLOAT4X4 preparedWorld;
+		DirectX::XMFLOAT4X4 preparedView;
+		DirectX::XMFLOAT4X4 preparedProj;
+
+		// Cluster culling (only used when the mesh was loaded with clusters)
+		std::vector<MeshClusters::Cluster> clusters;
+		std::vector<unsigned int> submeshClusterStarts;	// First cluster of each submesh, then the total
+		std::vector<unsigned int> clusterIndices;	// CPU copy of LOD 0
+		std::vector<unsigned int> visibleIndices;	// Rebuilt by every culled draw
+		Microsoft::WRL::ComPtr<ID3D11Buffer> visibleIndexBuffer;
+		int visibleClusterCount;
+		double clusterCullTime;
+
+		// Triangles of LOD 0 for ray queries, with ids relative to its first index
+		MeshBvh::Tree bvh;
+
+		void SetSubmeshes(const std::vector<ObjLoader::Submesh>& submeshes, const std::vector<std::string>& materialLibraries, const char* objFile);
+		void SetClusters(const MeshClusters::Cluster* clusters, size_t clusterCount, const unsigned int* indices);
+		bool CullClusters(std::shared_ptr<Camera> camera, DirectX::XMFLOAT4X4 worldMatrix);
+		void CreateBvh(const Vertex vertices[], const unsigned int indices[], const char* bvhFile);
 
 	public:
+		// The arena page's buffers, which other meshes share (see
+		// GetArenaAllocation() for this mesh's ranges)
 		Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer() {
-			return vertexBuffer;
+			return arena->GetVertexBuffer(allocation);
 		}
 
 		Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer() {
-			return indexBuffer;
+			return arena->GetIndexBuffer(allocation);
 		}
 
+		const MeshArena::Allocation& GetArenaAllocation() {
+			return allocation;
+		}
+
+		// Index count of the full detail mesh (LOD 0)
 		int GetIndexCount() {
 			return numIndices;
 		}
@@ -29,11 +91,130 @@ class Mesh
 			return numVertices;
 		}
 
+		// Vertex count before welding (same as GetVertexCount()
+		// for meshes that weren't loaded from a file)
+		int GetSourceVertexCount() {
+			return numSourceVertices;
+		}
+
+		// Axis-aligned bounds in object space
+		DirectX::XMFLOAT3 GetBoundsMin() {
+			return boundsMin;
+		}
+
+		DirectX::XMFLOAT3 GetBoundsMax() {
+			return boundsMax;
+		}
+
+		// Vertex cache behavior of the index buffer before and
+		// after it was optimized for the GPU
+		MeshOptimizer::Stats GetCacheStats() {
+			return cacheStats;
+		}
+
+		// Levels of detail in the index buffer (always at least one)
+		int GetLodCount() {
+			return (int)lods.size();
+		}
+
+		MeshSimplifier::LodRange GetLod(int lod) {
+			return lods[lod];
+		}
+
+		// Submeshes split the mesh by material, and all share the same
+		// buffers (there's always at least one)
+		int GetSubmeshCount() {
+			return (int)submeshes.size();
+		}
+
+		const ObjLoader::Submesh& GetSubmesh(int submesh) {
+			return submeshes[submesh];
+		}
+
+		// The submesh's material as described by the mesh's .mtl files
+		// (defaults, named after the submesh, if none describes it)
+		const MtlLoader::MaterialDescription& GetSubmeshMaterial(int submesh) {
+			return submeshMaterials[submesh];
+		}
+
+		// Object space sphere around the bounding box center
+		float GetBoundingRadius() {
+			return boundingRadius;
+		}
+
+		// Packed meshes need a vertex shader that decodes PackedVertex,
+		// using the quantization to restore object space positions
+		VertexFormat GetVertexFormat() {
+			return vertexFormat;
+		}
+
+		VertexPacking::Quantization GetQuantization() {
+			return quantization;
+		}
+
+		unsigned int GetVertexStride() {
+			return vertexFormat == VertexFormat::Packed ? sizeof(PackedVertex) : sizeof(Vertex);
+		}
+
+		// Clusters of LOD 0, culled against the camera whenever it
+		// draws at full detail (zero if the mesh has none)
+		int GetClusterCount() {
+			return (int)clusters.size();
+		}
+
+		// Clusters that survived culling in the most recent culled draw
+		int GetVisibleClusterCount() {
+			return visibleClusterCount;
+		}
+
+		// Milliseconds the most recent culled draw spent culling and
+		// building its index range
+		double GetClusterCullTime() {
+			return clusterCullTime;
+		}
+
+		// BVH over the triangles of LOD 0 in object space (empty when the
+		// mesh was loaded without one), whose triangle ids count from
+		// GetLod(0).IndexStart
+		const MeshBvh::Tree& GetBvh() {
+			return bvh;
+		}
+
+		// Input layout for PackedVertex, checked against a compiled (.cso) vertex shader
+		static Microsoft::WRL::ComPtr<ID3D11InputLayout> CreatePackedInputLayout(LPCWSTR vertexShaderFile);
+
 		Mesh(Vertex vertices[], unsigned int indices[], int numVertices, int numIndices);
-		Mesh(const char* fileName);
-		void CreateBuffers(Vertex vertices[], unsigned int indices[], int numVertices, int numIndices);
+		Mesh(const Mesh&) = delete;	// Each mesh frees its own arena ranges
+		Mesh& operator=(const Mesh&) = delete;
+		Mesh(const char* fileName, const ObjLoader::LoadOptions& options = ObjLoader::LoadOptions(), VertexFormat format = VertexFormat::Full);
+
+		// One chunk of a mapped and validated .meshchunks file, so models
+		// too big to load whole can be uploaded a chunk at a time (the
+		// file's name locates its material libraries)
+		Mesh(const MeshChunks::Header* header, unsigned int chunk, const char* chunkFile, VertexFormat format = VertexFormat::Full);
+
+		// One mesh of a loaded .glb, with a submesh per primitive (named
+		// after the primitive's material), whose vertices go to the GPU
+		// straight from the file when they're laid out like Vertex
+		Mesh(const GltfLoader::Scene& scene, int mesh, VertexFormat format = VertexFormat::Full);
+
+		// Throws std::invalid_argument for a mesh with no vertices or indices
+		void CreateBuffers(const Vertex vertices[], const unsigned int indices[], int numVertices, int numIndices);
+
+		// Draws are recorded into Graphics::Commands, like the binds
+		// before them
 		void Draw();
+		void Draw(std::shared_ptr<Camera> camera, DirectX::XMFLOAT4X4 worldMatrix);
+		void DrawLod(int lod);
+
+		// Picks the LOD (culling clusters at full detail) and binds the
+		// buffers once, so each material's submeshes can then be drawn
+		// with DrawSubmeshes() without rebinding anything
+		// - Only binds when called again with the same camera and world
+		//   matrix as last time
+		void PrepareDraw(std::shared_ptr<Camera> camera, DirectX::XMFLOAT4X4 worldMatrix);
+		void DrawSubmeshes(int firstSubmesh, int submeshCount);
+		int SelectLod(std::shared_ptr<Camera> camera, DirectX::XMFLOAT4X4 worldMatrix);
 		~Mesh();
-		void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
 };
 
@@ -0,0 +1,272 @@
+#include "MeshArena.h"
+#include "Graphics.h"
+
+// Anonymous namespace for the free range helpers, which are
+// private to this file
+namespace
+{
+	// Takes count from the first free range big enough, and returns
+	// false if there isn't one
+	bool TakeRange(std::map<unsigned int, unsigned int>& freeRanges, unsigned int count, unsigned int& start)
+	{
+		if (count == 0)
+		{
+			start = 0;
+			return true;
+		}
+
+		for (auto range = freeRanges.begin(); range != freeRanges.end(); range++)
+		{
+			if (range->second < count)
+				continue;
+
+			start = range->first;
+			unsigned int remaining = range->second - count;
+			freeRanges.erase(range);
+			if (remaining > 0)
+				freeRanges[start + count] = remaining;
+			return true;
+		}
+		return false;
+	}
+
+	// Returns a range, merging it with the free ranges on either side
+	void ReturnRange(std::map<unsigned int, unsigned int>& freeRanges, unsigned int start, unsigned int count)
+	{
+		if (count == 0)
+			return;
+
+		auto next = freeRanges.lower_bound(start);
+		if (next != freeRanges.end() && start + count == next->first)
+		{
+			count += next->second;
+			next = freeRanges.erase(next);
+		}
+		if (next != freeRanges.begin())
+		{
+			auto previous = std::prev(next);
+			if (previous->first + previous->second == start)
+			{
+				previous->second += count;
+				return;
+			}
+		}
+		freeRanges[start] = count;
+	}
+
+	void AddFreeSpace(const std::map<unsigned int, unsigned int>& freeRanges, uint64_t& total, uint64_t& largest)
+	{
+		for (const auto& range : freeRanges)
+		{
+			total += range.second;
+			largest = range.second > largest ? range.second : largest;
+		}
+	}
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> CreatePageBuffer(ID3D11Device* device, unsigned int byteWidth, UINT bindFlags)
+	{
+		// Default usage rather than immutable, since meshes arrive
+		// (and leave) one at a time over the page's life
+		D3D11_BUFFER_DESC desc = {};
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.ByteWidth = byteWidth;
+		desc.BindFlags = bindFlags;
+
+		Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+		device->CreateBuffer(&desc, 0, buffer.GetAddressOf());
+		return buffer;
+	}
+
+	void UpdateRange(ID3D11DeviceContext* context, ID3D11Buffer* buffer, unsigned int byteOffset, unsigned int byteCount, const void* data)
+	{
+		if (byteCount == 0)
+			return;
+
+		D3D11_BOX box = {};
+		box.left = byteOffset;
+		box.right = byteOffset + byteCount;
+		box.bottom = 1;
+		box.back = 1;
+		context->UpdateSubresource(buffer, 0, &box, data, 0, 0);
+	}
+}
+
+MeshArena::MeshArena(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	unsigned int pageVertexBytes,
+	unsigned int pageIndexCount) :
+	device(device),
+	context(context),
+	pageVertexBytes(pageVertexBytes),
+	pageIndexCount(pageIndexCount),
+	allocationCount(0),
+	boundVertexPage(-1),
+	boundIndexPage(-1),
+	pageBinds(0),
+	skippedBinds(0)
+{
+}
+
+std::shared_ptr<MeshArena> MeshArena::GetShared()
+{
+	static std::shared_ptr<MeshArena> shared;
+	if (!shared)
+		shared = std::make_shared<MeshArena>(Graphics::Device, Graphics::Context);
+	return shared;
+}
+
+MeshArena::Allocation MeshArena::Allocate(const void* vertices, unsigned int vertexStride, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount)
+{
+	Allocation allocation;
+	if (vertexCount == 0 && indexCount == 0)
+		return allocation;
+
+	// First fit, page by page, where both ranges have room
+	for (size_t p = 0; p < pages.size() && allocation.Page < 0; p++)
+	{
+		Page& page = pages[p];
+		if (page.VertexStride != vertexStride)
+			continue;
+
+		unsigned int baseVertex;
+		unsigned int startIndex;
+		if (!TakeRange(page.FreeVertices, vertexCount, baseVertex))
+			continue;
+		if (!TakeRange(page.FreeIndices, indexCount, startIndex))
+		{
+			ReturnRange(page.FreeVertices, baseVertex, vertexCount);
+			continue;
+		}
+		allocation = { (int)p, baseVertex, vertexCount, startIndex, indexCount };
+	}
+
+	if (allocation.Page < 0)
+	{
+		int p = AddPage(vertexStride, vertexCount, indexCount);
+		allocation = { p, 0, vertexCount, 0, indexCount };
+		TakeRange(pages[p].FreeVertices, vertexCount, allocation.BaseVertex);
+		TakeRange(pages[p].FreeIndices, indexCount, allocation.StartIndex);
+	}
+
+	if (context)
+	{
+		Page& page = pages[allocation.Page];
+		UpdateRange(context.Get(), page.VertexBuffer.Get(), allocation.BaseVertex * vertexStride, vertexCount * vertexStride, vertices);
+		UpdateRange(context.Get(), page.IndexBuffer.Get(), allocation.StartIndex * sizeof(unsigned int), indexCount * sizeof(unsigned int), indices);
+	}
+	allocationCount++;
+	return allocation;
+}
+
+void MeshArena::Free(const Allocation& allocation)
+{
+	if (allocation.Page < 0 || allocation.Page >= (int)pages.size())
+		return;
+
+	// Pages stay around once made, since meshes tend to be replaced
+	// by others of a similar size
+	Page& page = pages[allocation.Page];
+	ReturnRange(page.FreeVertices, allocation.BaseVertex, allocation.VertexCount);
+	ReturnRange(page.FreeIndices, allocation.StartIndex, allocation.IndexCount);
+	allocationCount--;
+}
+
+void MeshArena::Bind(const Allocation& allocation, ID3D11Buffer* indexBuffer)
+{
+	if (allocation.Page < 0)
+		return;
+
+	bool vertexChange = boundVertexPage != allocation.Page;
+	bool indexChange = indexBuffer || boundIndexPage != allocation.Page;
+	if (!vertexChange && !indexChange)
+	{
+		skippedBinds++;
+		return;
+	}
+
+	pageBinds++;
+	Page& page = pages[allocation.Page];
+	if (vertexChange && context)
+		Graphics::Commands.SetVertexBuffer(0, page.VertexBuffer.Get(), page.VertexStride, 0);
+	if (indexChange && context)
+		Graphics::Commands.SetIndexBuffer(indexBuffer ? indexBuffer : page.IndexBuffer.Get());
+
+	boundVertexPage = allocation.Page;
+	boundIndexPage = indexBuffer ? -1 : allocation.Page;
+}
+
+void MeshArena::BeginFrame()
+{
+	boundVertexPage = -1;
+	boundIndexPage = -1;
+	pageBinds = 0;
+	skippedBinds = 0;
+}
+
+Microsoft::WRL::ComPtr<ID3D11Buffer> MeshArena::GetVertexBuffer(const Allocation& allocation)
+{
+	return allocation.Page < 0 ? nullptr : pages[allocation.Page].VertexBuffer;
+}
+
+Microsoft::WRL::ComPtr<ID3D11Buffer> MeshArena::GetIndexBuffer(const Allocation& allocation)
+{
+	return allocation.Page < 0 ? nullptr : pages[allocation.Page].IndexBuffer;
+}
+
+MeshArena::Stats MeshArena::GetStats()
+{
+	Stats stats = {};
+	stats.PageCount = (unsigned int)pages.size();
+	stats.AllocationCount = allocationCount;
+	stats.PageBinds = pageBinds;
+	stats.SkippedBinds = skippedBinds;
+
+	// Fragmentation is measured per page, since free space in two
+	// pages could never have been one range anyway
+	uint64_t freeVertexBytes = 0;
+	uint64_t freeIndexBytes = 0;
+	float vertexFragmentation = 0.0f;
+	float indexFragmentation = 0.0f;
+	for (const Page& page : pages)
+	{
+		uint64_t freeVertices = 0, largestVertices = 0;
+		uint64_t freeIndices = 0, largestIndices = 0;
+		AddFreeSpace(page.FreeVertices, freeVertices, largestVertices);
+		AddFreeSpace(page.FreeIndices, freeIndices, largestIndices);
+
+		stats.VertexBytes += (uint64_t)page.VertexCapacity * page.VertexStride;
+		stats.IndexBytes += (uint64_t)page.IndexCapacity * sizeof(unsigned int);
+		stats.FreeRangeCount += (unsigned int)(page.FreeVertices.size() + page.FreeIndices.size());
+		freeVertexBytes += freeVertices * page.VertexStride;
+		freeIndexBytes += freeIndices * sizeof(unsigned int);
+
+		// Each page counts by how much free space it has
+		if (freeVertices > 0)
+			vertexFragmentation += (1.0f - (float)largestVertices / freeVertices) * freeVertices * page.VertexStride;
+		if (freeIndices > 0)
+			indexFragmentation += (1.0f - (float)largestIndices / freeIndices) * freeIndices * sizeof(unsigned int);
+	}
+	stats.VertexBytesUsed = stats.VertexBytes - freeVertexBytes;
+	stats.IndexBytesUsed = stats.IndexBytes - freeIndexBytes;
+	stats.VertexFragmentation = freeVertexBytes > 0 ? vertexFragmentation / freeVertexBytes : 0.0f;
+	stats.IndexFragmentation = freeIndexBytes > 0 ? indexFragmentation / freeIndexBytes : 0.0f;
+	return stats;
+}
+
+int MeshArena::AddPage(unsigned int vertexStride, unsigned int vertexCount, unsigned int indexCount)
+{
+	Page page;
+	page.VertexStride = vertexStride;
+	page.VertexCapacity = pageVertexBytes / vertexStride > vertexCount ? pageVertexBytes / vertexStride : vertexCount;
+	page.IndexCapacity = pageIndexCount > indexCount ? pageIndexCount : indexCount;
+	page.FreeVertices[0] = page.VertexCapacity;
+	page.FreeIndices[0] = page.IndexCapacity;
+	if (device)
+	{
+		page.VertexBuffer = CreatePageBuffer(device.Get(), page.VertexCapacity * vertexStride, D3D11_BIND_VERTEX_BUFFER);
+		page.IndexBuffer = CreatePageBuffer(device.Get(), page.IndexCapacity * sizeof(unsigned int), D3D11_BIND_INDEX_BUFFER);
+	}
+	pages.push_back(page);
+	return (int)pages.size() - 1;
+}
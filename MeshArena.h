@@ -0,0 +1,121 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+// --------------------------------------------------------
+// Suballocates the vertices and indices of static meshes
+// out of a few large buffers, so drawing one mesh after
+// another only rebinds the input assembler when the next
+// mesh lives in a different page
+//
+// - A page is one vertex buffer and one index buffer; each
+//   mesh gets a range of both, and draws with its range's
+//   base vertex and start index
+// - Pages only hold vertices of a single stride (full and
+//   packed meshes never share one), and a mesh bigger than
+//   a page gets a page of its own size
+// - Freed ranges are merged with their neighbors and reused
+//   first-fit, and the stats report how scattered the free
+//   space has become
+// - Without a device (null) only the bookkeeping runs, so
+//   the allocator works in tools and tests with no GPU
+// --------------------------------------------------------
+class MeshArena
+{
+public:
+	// Where a mesh lives (Page is -1 for an empty allocation)
+	struct Allocation
+	{
+		int Page = -1;
+		unsigned int BaseVertex = 0;	// In vertices of the page's stride
+		unsigned int VertexCount = 0;
+		unsigned int StartIndex = 0;
+		unsigned int IndexCount = 0;
+	};
+
+	struct Stats
+	{
+		unsigned int PageCount;
+		unsigned int AllocationCount;
+		uint64_t VertexBytes;			// Reserved by pages
+		uint64_t VertexBytesUsed;		// Handed out to meshes
+		uint64_t IndexBytes;
+		uint64_t IndexBytesUsed;
+		unsigned int FreeRangeCount;	// Separate free ranges, vertices and indices together
+
+		// 0 when each page's free space is one range, approaching 1 as
+		// it splits into many small ones (1 - largest / total free)
+		float VertexFragmentation;
+		float IndexFragmentation;
+
+		// Since the last BeginFrame()
+		unsigned int PageBinds;			// Binds that changed the input assembler
+		unsigned int SkippedBinds;		// Binds of the page that was already bound
+	};
+
+	// Page sizes for meshes that fit (larger ones get their own page)
+	static const unsigned int DefaultPageVertexBytes = 16 << 20;
+	static const unsigned int DefaultPageIndexCount = 4 << 20;
+
+	MeshArena(
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		unsigned int pageVertexBytes = DefaultPageVertexBytes,
+		unsigned int pageIndexCount = DefaultPageIndexCount);
+
+	// The arena every Mesh uses, created on first use from Graphics
+	static std::shared_ptr<MeshArena> GetShared();
+
+	// Copies the vertices (of the given stride) and 32-bit indices
+	// into the first page with room for both, adding a page if none
+	// has any
+	Allocation Allocate(const void* vertices, unsigned int vertexStride, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount);
+	void Free(const Allocation& allocation);
+
+	// Binds the allocation's page, unless it's already bound (by
+	// recording into Graphics::Commands)
+	// - An index buffer of the caller's own (such as one rewritten
+	//   every frame) can stand in for the page's, and is always bound
+	void Bind(const Allocation& allocation, ID3D11Buffer* indexBuffer = nullptr);
+
+	// Forgets what's bound (anything else may have changed it since),
+	// and restarts the bind counts
+	void BeginFrame();
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer(const Allocation& allocation);
+	Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer(const Allocation& allocation);
+	Stats GetStats();
+
+private:
+	struct Page
+	{
+		Microsoft::WRL::ComPtr<ID3D11Buffer> VertexBuffer;
+		Microsoft::WRL::ComPtr<ID3D11Buffer> IndexBuffer;
+		unsigned int VertexStride;
+		unsigned int VertexCapacity;
+		unsigned int IndexCapacity;
+
+		// Free ranges by start, in vertices and indices
+		std::map<unsigned int, unsigned int> FreeVertices;
+		std::map<unsigned int, unsigned int> FreeIndices;
+	};
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	unsigned int pageVertexBytes;
+	unsigned int pageIndexCount;
+	std::vector<Page> pages;
+	unsigned int allocationCount;
+
+	// What the input assembler has bound (-1 when unknown)
+	int boundVertexPage;
+	int boundIndexPage;
+	unsigned int pageBinds;
+	unsigned int skippedBinds;
+
+	int AddPage(unsigned int vertexStride, unsigned int vertexCount, unsigned int indexCount);
+};
@@ -0,0 +1,160 @@
+#include "Tests.h"
+#include "MeshArena.h"
+
+#include <random>
+#include <vector>
+
+// --------------------------------------------------------
+// Every arena here has no device, so only the bookkeeping
+// runs: the ranges, pages, stats and bind counts
+// --------------------------------------------------------
+
+namespace
+{
+	bool Overlaps(unsigned int startA, unsigned int countA, unsigned int startB, unsigned int countB)
+	{
+		return countA > 0 && countB > 0 && startA < startB + countB && startB < startA + countA;
+	}
+
+	// Whether any two live allocations share vertices or indices
+	bool AnyOverlap(const std::vector<MeshArena::Allocation>& live)
+	{
+		for (size_t a = 0; a < live.size(); a++)
+		{
+			for (size_t b = a + 1; b < live.size(); b++)
+			{
+				if (live[a].Page != live[b].Page)
+					continue;
+				if (Overlaps(live[a].BaseVertex, live[a].VertexCount, live[b].BaseVertex, live[b].VertexCount) ||
+					Overlaps(live[a].StartIndex, live[a].IndexCount, live[b].StartIndex, live[b].IndexCount))
+					return true;
+			}
+		}
+		return false;
+	}
+}
+
+TEST(MeshArenaAllocatesAndMergesRanges)
+{
+	// Pages of 1000 vertices (of 48 bytes) and 3000 indices
+	MeshArena arena(nullptr, nullptr, 48 * 1000, 3000);
+
+	MeshArena::Allocation a = arena.Allocate(nullptr, 48, 400, nullptr, 1200);
+	MeshArena::Allocation b = arena.Allocate(nullptr, 48, 400, nullptr, 1200);
+	MeshArena::Allocation c = arena.Allocate(nullptr, 48, 400, nullptr, 1200);
+	CHECK(a.Page == 0 && b.Page == 0);
+	CHECK(a.BaseVertex == 0 && b.BaseVertex == 400);
+	CHECK(a.StartIndex == 0 && b.StartIndex == 1200);
+	CHECK(c.Page == 1);
+
+	MeshArena::Stats stats = arena.GetStats();
+	CHECK(stats.PageCount == 2);
+	CHECK(stats.AllocationCount == 3);
+	CHECK(stats.VertexBytes == 2 * 48 * 1000);
+	CHECK(stats.VertexBytesUsed == 3 * 48 * 400);
+	CHECK(stats.IndexBytesUsed == 3 * 4 * 1200);
+
+	// Freeing the first range splits page 0's free space in two...
+	arena.Free(a);
+	stats = arena.GetStats();
+	CHECK(stats.AllocationCount == 2);
+	CHECK(stats.VertexFragmentation > 0.0f);
+
+	// ...which first fit then reuses...
+	MeshArena::Allocation d = arena.Allocate(nullptr, 48, 300, nullptr, 900);
+	CHECK(d.Page == 0 && d.BaseVertex == 0 && d.StartIndex == 0);
+
+	// ...and freeing everything merges back to one range per buffer
+	arena.Free(b);
+	arena.Free(c);
+	arena.Free(d);
+	stats = arena.GetStats();
+	CHECK(stats.AllocationCount == 0);
+	CHECK(stats.VertexBytesUsed == 0 && stats.IndexBytesUsed == 0);
+	CHECK(stats.FreeRangeCount == 4);
+	CHECK(stats.VertexFragmentation == 0.0f && stats.IndexFragmentation == 0.0f);
+}
+
+TEST(MeshArenaSeparatesStridesAndLargeMeshes)
+{
+	MeshArena arena(nullptr, nullptr, 48 * 1000, 3000);
+
+	MeshArena::Allocation full = arena.Allocate(nullptr, 48, 100, nullptr, 300);
+	MeshArena::Allocation packed = arena.Allocate(nullptr, 20, 100, nullptr, 300);
+	CHECK(full.Page != packed.Page);
+
+	// Too big for a page, so it gets one of its own size
+	MeshArena::Allocation large = arena.Allocate(nullptr, 48, 5000, nullptr, 12000);
+	CHECK(large.Page >= 0 && large.Page != full.Page && large.Page != packed.Page);
+	CHECK(large.BaseVertex == 0 && large.StartIndex == 0);
+
+	// Nothing to allocate isn't given a page
+	MeshArena::Allocation empty = arena.Allocate(nullptr, 48, 0, nullptr, 0);
+	CHECK(empty.Page == -1);
+	CHECK(arena.GetStats().AllocationCount == 3);
+}
+
+// Random allocations and frees never hand out the same space twice
+TEST(MeshArenaChurnNeverOverlaps)
+{
+	MeshArena arena(nullptr, nullptr, 48 * 1000, 3000);
+	std::vector<MeshArena::Allocation> live;
+	std::mt19937 random(1);
+	uint64_t liveVertices = 0;
+	for (int i = 0; i < 20000; i++)
+	{
+		if (live.size() < 40 && random() % 3 != 0)
+		{
+			unsigned int vertexCount = random() % 300;
+			unsigned int indexCount = random() % 900;
+			live.push_back(arena.Allocate(nullptr, 48, vertexCount, nullptr, indexCount));
+		}
+		else if (!live.empty())
+		{
+			size_t k = random() % live.size();
+			arena.Free(live[k]);
+			live.erase(live.begin() + k);
+		}
+	}
+	CHECK(!AnyOverlap(live));
+
+	for (const MeshArena::Allocation& allocation : live)
+		liveVertices += allocation.VertexCount;
+	CHECK(arena.GetStats().VertexBytesUsed == liveVertices * 48);
+
+	for (const MeshArena::Allocation& allocation : live)
+		arena.Free(allocation);
+	MeshArena::Stats stats = arena.GetStats();
+	CHECK(stats.VertexBytesUsed == 0 && stats.IndexBytesUsed == 0);
+	CHECK(stats.FreeRangeCount == stats.PageCount * 2);
+}
+
+TEST(MeshArenaSkipsRebindingTheBoundPage)
+{
+	MeshArena arena(nullptr, nullptr, 48 * 1000, 3000);
+	MeshArena::Allocation a = arena.Allocate(nullptr, 48, 10, nullptr, 30);
+	MeshArena::Allocation b = arena.Allocate(nullptr, 48, 10, nullptr, 30);
+	MeshArena::Allocation other = arena.Allocate(nullptr, 20, 10, nullptr, 30);
+
+	arena.BeginFrame();
+	arena.Bind(a);
+	arena.Bind(b);
+	arena.Bind(a);
+	MeshArena::Stats stats = arena.GetStats();
+	CHECK(stats.PageBinds == 1);
+	CHECK(stats.SkippedBinds == 2);
+
+	// A page change, then a caller's own index buffer, always bind
+	int indexBuffer = 0;
+	arena.Bind(other);
+	arena.Bind(other, (ID3D11Buffer*)&indexBuffer);
+	arena.Bind(other);
+	stats = arena.GetStats();
+	CHECK(stats.PageBinds == 4);
+	CHECK(stats.SkippedBinds == 2);
+
+	// A new frame forgets what was bound
+	arena.BeginFrame();
+	arena.Bind(other);
+	CHECK(arena.GetStats().PageBinds == 1);
+}
@@ -0,0 +1,640 @@
+#include "MeshBvh.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+
+using namespace DirectX;
+
+// Anonymous namespace for the build and traversal helpers, which
+// are private to this file
+namespace
+{
+	// Deeper nodes always become leaves, which keeps the traversal
+	// stacks a fixed size
+	const unsigned int MaxDepth = 64;
+	const unsigned int MaxBins = 64;
+
+	// Cost of visiting a node, relative to testing one triangle
+	const float TraversalCost = 1.0f;
+
+	struct FileHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t NodeSize;			// sizeof(Node) and sizeof(Triangle) when written
+		uint32_t TriangleSize;
+		uint32_t MaxLeafTriangles;	// Build options the tree was made with
+		uint32_t BinCount;
+		uint64_t SourceSize;
+		uint64_t SourceHash;
+		uint32_t NodeCount;
+		uint32_t TriangleCount;
+	};
+
+	// Half the surface area of a box, which is all the SAH needs
+	float HalfArea(FXMVECTOR boundsMin, FXMVECTOR boundsMax)
+	{
+		XMFLOAT3 size;
+		XMStoreFloat3(&size, XMVectorMax(XMVectorSubtract(boundsMax, boundsMin), XMVectorZero()));
+		return size.x * size.y + size.y * size.z + size.z * size.x;
+	}
+
+	// Zero direction components become tiny ones, so their inverses
+	// are huge rather than infinite (infinity times zero is NaN)
+	XMVECTOR GetInverseDirection(FXMVECTOR direction)
+	{
+		XMVECTOR tiny = XMVectorReplicate(1e-30f);
+		XMVECTOR safe = XMVectorSelect(direction, tiny, XMVectorLess(XMVectorAbs(direction), tiny));
+		return XMVectorReciprocal(safe);
+	}
+
+	// Entry distance of a ray into a node's box, or FLT_MAX if it
+	// misses or enters beyond maxDistance
+	float IntersectBox(const MeshBvh::Node& node, FXMVECTOR origin, FXMVECTOR inverseDirection, float maxDistance)
+	{
+		XMVECTOR t0 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&node.BoundsMin), origin), inverseDirection);
+		XMVECTOR t1 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&node.BoundsMax), origin), inverseDirection);
+		XMFLOAT3 nearest, farthest;
+		XMStoreFloat3(&nearest, XMVectorMin(t0, t1));
+		XMStoreFloat3(&farthest, XMVectorMax(t0, t1));
+		float enter = fmaxf(fmaxf(nearest.x, nearest.y), fmaxf(nearest.z, 0.0f));
+		float exit = fminf(fminf(farthest.x, farthest.y), fminf(farthest.z, maxDistance));
+		return enter <= exit ? enter : FLT_MAX;
+	}
+
+	// Moller-Trumbore, from either side, updating hit when closer
+	bool IntersectTriangle(const MeshBvh::Triangle& triangle, FXMVECTOR origin, FXMVECTOR direction, MeshBvh::Hit& hit)
+	{
+		XMVECTOR edge1 = XMLoadFloat3(&triangle.Edge1);
+		XMVECTOR edge2 = XMLoadFloat3(&triangle.Edge2);
+		XMVECTOR p = XMVector3Cross(direction, edge2);
+		float determinant = XMVectorGetX(XMVector3Dot(edge1, p));
+		if (fabsf(determinant) < 1e-12f)
+			return false;
+
+		float inverse = 1.0f / determinant;
+		XMVECTOR toOrigin = XMVectorSubtract(origin, XMLoadFloat3(&triangle.V0));
+		float u = XMVectorGetX(XMVector3Dot(toOrigin, p)) * inverse;
+		if (u < 0.0f || u > 1.0f)
+			return false;
+
+		XMVECTOR q = XMVector3Cross(toOrigin, edge1);
+		float v = XMVectorGetX(XMVector3Dot(direction, q)) * inverse;
+		if (v < 0.0f || u + v > 1.0f)
+			return false;
+
+		float distance = XMVectorGetX(XMVector3Dot(edge2, q)) * inverse;
+		if (distance < 0.0f || distance >= hit.Distance)
+			return false;
+
+		hit.Distance = distance;
+		hit.Triangle = triangle.Id;
+		hit.U = u;
+		hit.V = v;
+		return true;
+	}
+
+	// --------------------------------------------------------
+	// Four rays in structure-of-arrays form, one per lane
+	// - Lanes of rays that don't exist start with a negative
+	//   distance limit, so they never enter a box
+	// --------------------------------------------------------
+	struct Packet
+	{
+		XMVECTOR OriginX, OriginY, OriginZ;
+		XMVECTOR DirectionX, DirectionY, DirectionZ;
+		XMVECTOR InverseX, InverseY, InverseZ;
+		XMVECTOR MaxDistance;
+
+		// Closest hits so far
+		XMVECTOR Triangle;	// Ids, as integer lanes
+		XMVECTOR U, V;
+	};
+
+	// Lanes of the packet that enter the box (all bits set), and
+	// their entry distances
+	XMVECTOR IntersectBox4(const MeshBvh::Node& node, const Packet& packet, XMVECTOR& enter)
+	{
+		XMVECTOR x0 = XMVectorMultiply(XMVectorSubtract(XMVectorReplicate(node.BoundsMin.x), packet.OriginX), packet.InverseX);
+		XMVECTOR x1 = XMVectorMultiply(XMVectorSubtract(XMVectorReplicate(node.BoundsMax.x), packet.OriginX), packet.InverseX);
+		XMVECTOR y0 = XMVectorMultiply(XMVectorSubtract(XMVectorReplicate(node.BoundsMin.y), packet.OriginY), packet.InverseY);
+		XMVECTOR y1 = XMVectorMultiply(XMVectorSubtract(XMVectorReplicate(node.BoundsMax.y), packet.OriginY), packet.InverseY);
+		XMVECTOR z0 = XMVectorMultiply(XMVectorSubtract(XMVectorReplicate(node.BoundsMin.z), packet.OriginZ), packet.InverseZ);
+		XMVECTOR z1 = XMVectorMultiply(XMVectorSubtract(XMVectorReplicate(node.BoundsMax.z), packet.OriginZ), packet.InverseZ);
+
+		enter = XMVectorMax(XMVectorMax(XMVectorMin(x0, x1), XMVectorMin(y0, y1)), XMVectorMax(XMVectorMin(z0, z1), XMVectorZero()));
+		XMVECTOR exit = XMVectorMin(XMVectorMin(XMVectorMax(x0, x1), XMVectorMax(y0, y1)), XMVectorMin(XMVectorMax(z0, z1), packet.MaxDistance));
+		return XMVectorLessOrEqual(enter, exit);
+	}
+
+	// The same test as IntersectTriangle(), for every lane at once
+	void IntersectTriangle4(const MeshBvh::Triangle& triangle, Packet& packet)
+	{
+		XMVECTOR edge1X = XMVectorReplicate(triangle.Edge1.x);
+		XMVECTOR edge1Y = XMVectorReplicate(triangle.Edge1.y);
+		XMVECTOR edge1Z = XMVectorReplicate(triangle.Edge1.z);
+		XMVECTOR edge2X = XMVectorReplicate(triangle.Edge2.x);
+		XMVECTOR edge2Y = XMVectorReplicate(triangle.Edge2.y);
+		XMVECTOR edge2Z = XMVectorReplicate(triangle.Edge2.z);
+
+		// p = direction x edge2
+		XMVECTOR pX = XMVectorSubtract(XMVectorMultiply(packet.DirectionY, edge2Z), XMVectorMultiply(packet.DirectionZ, edge2Y));
+		XMVECTOR pY = XMVectorSubtract(XMVectorMultiply(packet.DirectionZ, edge2X), XMVectorMultiply(packet.DirectionX, edge2Z));
+		XMVECTOR pZ = XMVectorSubtract(XMVectorMultiply(packet.DirectionX, edge2Y), XMVectorMultiply(packet.DirectionY, edge2X));
+		XMVECTOR determinant = XMVectorMultiplyAdd(edge1X, pX, XMVectorMultiplyAdd(edge1Y, pY, XMVectorMultiply(edge1Z, pZ)));
+		XMVECTOR valid = XMVectorGreaterOrEqual(XMVectorAbs(determinant), XMVectorReplicate(1e-12f));
+		XMVECTOR inverse = XMVectorReciprocal(determinant);
+
+		XMVECTOR toOriginX = XMVectorSubtract(packet.OriginX, XMVectorReplicate(triangle.V0.x));
+		XMVECTOR toOriginY = XMVectorSubtract(packet.OriginY, XMVectorReplicate(triangle.V0.y));
+		XMVECTOR toOriginZ = XMVectorSubtract(packet.OriginZ, XMVectorReplicate(triangle.V0.z));
+		XMVECTOR u = XMVectorMultiply(XMVectorMultiplyAdd(toOriginX, pX, XMVectorMultiplyAdd(toOriginY, pY, XMVectorMultiply(toOriginZ, pZ))), inverse);
+
+		// q = toOrigin x edge1
+		XMVECTOR qX = XMVectorSubtract(XMVectorMultiply(toOriginY, edge1Z), XMVectorMultiply(toOriginZ, edge1Y));
+		XMVECTOR qY = XMVectorSubtract(XMVectorMultiply(toOriginZ, edge1X), XMVectorMultiply(toOriginX, edge1Z));
+		XMVECTOR qZ = XMVectorSubtract(XMVectorMultiply(toOriginX, edge1Y), XMVectorMultiply(toOriginY, edge1X));
+		XMVECTOR v = XMVectorMultiply(XMVectorMultiplyAdd(packet.DirectionX, qX, XMVectorMultiplyAdd(packet.DirectionY, qY, XMVectorMultiply(packet.DirectionZ, qZ))), inverse);
+		XMVECTOR distance = XMVectorMultiply(XMVectorMultiplyAdd(edge2X, qX, XMVectorMultiplyAdd(edge2Y, qY, XMVectorMultiply(edge2Z, qZ))), inverse);
+
+		XMVECTOR zero = XMVectorZero();
+		valid = XMVectorAndInt(valid, XMVectorGreaterOrEqual(u, zero));
+		valid = XMVectorAndInt(valid, XMVectorGreaterOrEqual(v, zero));
+		valid = XMVectorAndInt(valid, XMVectorLessOrEqual(XMVectorAdd(u, v), XMVectorSplatOne()));
+		valid = XMVectorAndInt(valid, XMVectorGreaterOrEqual(distance, zero));
+		valid = XMVectorAndInt(valid, XMVectorLess(distance, packet.MaxDistance));
+
+		packet.MaxDistance = XMVectorSelect(packet.MaxDistance, distance, valid);
+		packet.Triangle = XMVectorSelect(packet.Triangle, XMVectorReplicateInt(triangle.Id), valid);
+		packet.U = XMVectorSelect(packet.U, u, valid);
+		packet.V = XMVectorSelect(packet.V, v, valid);
+	}
+
+	// Smallest entry distance among the lanes that enter
+	float GetNearestEntry(FXMVECTOR enter, FXMVECTOR active)
+	{
+		XMFLOAT4 distances;
+		XMStoreFloat4(&distances, XMVectorSelect(XMVectorReplicate(FLT_MAX), enter, active));
+		return fminf(fminf(distances.x, distances.y), fminf(distances.z, distances.w));
+	}
+
+	struct Bin
+	{
+		XMVECTOR BoundsMin;
+		XMVECTOR BoundsMax;
+		unsigned int Count;
+	};
+}
+
+namespace MeshBvh
+{
+	// --------------------------------------------------------
+	// Splits nodes top down, trying BinCount planes per axis
+	// through the spread of triangle centroids and keeping
+	// whichever has the lowest surface area cost
+	// - Triangle order is a permutation that's partitioned
+	//   in place, so every node is one range of it
+	// - Nodes that can't be split any cheaper than testing
+	//   their triangles stay leaves
+	// --------------------------------------------------------
+	Tree Build(const Vertex* vertices, const unsigned int* indices, size_t indexCount, const Options& options)
+	{
+		Tree tree;
+		unsigned int triangleCount = (unsigned int)(indexCount / 3);
+		if (triangleCount == 0)
+			return tree;
+
+		unsigned int binCount = std::min(std::max(options.BinCount, 2u), MaxBins);
+		unsigned int maxLeaf = std::max(options.MaxLeafTriangles, 1u);
+
+		// Every triangle's bounds and centroid, for the splits
+		std::vector<XMFLOAT3> boundsMins(triangleCount);
+		std::vector<XMFLOAT3> boundsMaxs(triangleCount);
+		std::vector<XMFLOAT3> centroids(triangleCount);
+		std::vector<unsigned int> order(triangleCount);
+		for (unsigned int t = 0; t < triangleCount; t++)
+		{
+			XMVECTOR a = XMLoadFloat3(&vertices[indices[t * 3]].Position);
+			XMVECTOR b = XMLoadFloat3(&vertices[indices[t * 3 + 1]].Position);
+			XMVECTOR c = XMLoadFloat3(&vertices[indices[t * 3 + 2]].Position);
+			XMVECTOR boundsMin = XMVectorMin(a, XMVectorMin(b, c));
+			XMVECTOR boundsMax = XMVectorMax(a, XMVectorMax(b, c));
+			XMStoreFloat3(&boundsMins[t], boundsMin);
+			XMStoreFloat3(&boundsMaxs[t], boundsMax);
+			XMStoreFloat3(&centroids[t], XMVectorScale(XMVectorAdd(boundsMin, boundsMax), 0.5f));
+			order[t] = t;
+		}
+
+		// Pending nodes, each with its depth
+		tree.Nodes.reserve(triangleCount * 2 / maxLeaf + 1);
+		tree.Nodes.push_back({ XMFLOAT3(), 0, XMFLOAT3(), triangleCount });
+		std::vector<std::pair<unsigned int, unsigned int>> pending = { { 0, 1 } };
+		while (!pending.empty())
+		{
+			unsigned int nodeIndex = pending.back().first;
+			unsigned int depth = pending.back().second;
+			pending.pop_back();
+
+			unsigned int start = tree.Nodes[nodeIndex].Start;
+			unsigned int count = tree.Nodes[nodeIndex].Count;
+			XMVECTOR boundsMin = XMVectorReplicate(FLT_MAX);
+			XMVECTOR boundsMax = XMVectorReplicate(-FLT_MAX);
+			XMVECTOR centroidMin = boundsMin;
+			XMVECTOR centroidMax = boundsMax;
+			for (unsigned int i = start; i < start + count; i++)
+			{
+				boundsMin = XMVectorMin(boundsMin, XMLoadFloat3(&boundsMins[order[i]]));
+				boundsMax = XMVectorMax(boundsMax, XMLoadFloat3(&boundsMaxs[order[i]]));
+				centroidMin = XMVectorMin(centroidMin, XMLoadFloat3(&centroids[order[i]]));
+				centroidMax = XMVectorMax(centroidMax, XMLoadFloat3(&centroids[order[i]]));
+			}
+			XMStoreFloat3(&tree.Nodes[nodeIndex].BoundsMin, boundsMin);
+			XMStoreFloat3(&tree.Nodes[nodeIndex].BoundsMax, boundsMax);
+			if (count <= maxLeaf || depth >= MaxDepth)
+				continue;
+
+			// Best plane on any axis, as a bin boundary
+			XMFLOAT3 low, extent;
+			XMStoreFloat3(&low, centroidMin);
+			XMStoreFloat3(&extent, XMVectorSubtract(centroidMax, centroidMin));
+			float bestCost = FLT_MAX;
+			int bestAxis = -1;
+			unsigned int bestSplit = 0;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				float axisLow = (&low.x)[axis];
+				float axisExtent = (&extent.x)[axis];
+				if (axisExtent <= 0.0f)
+					continue;
+
+				Bin bins[MaxBins];
+				for (unsigned int b = 0; b < binCount; b++)
+					bins[b] = { XMVectorReplicate(FLT_MAX), XMVectorReplicate(-FLT_MAX), 0 };
+				float scale = binCount / axisExtent;
+				for (unsigned int i = start; i < start + count; i++)
+				{
+					unsigned int t = order[i];
+					unsigned int b = std::min((unsigned int)(((&centroids[t].x)[axis] - axisLow) * scale), binCount - 1);
+					bins[b].BoundsMin = XMVectorMin(bins[b].BoundsMin, XMLoadFloat3(&boundsMins[t]));
+					bins[b].BoundsMax = XMVectorMax(bins[b].BoundsMax, XMLoadFloat3(&boundsMaxs[t]));
+					bins[b].Count++;
+				}
+
+				// Sweep from the right for the right side's areas, then
+				// from the left to cost every plane
+				float rightAreas[MaxBins];
+				unsigned int rightCounts[MaxBins];
+				XMVECTOR rightMin = XMVectorReplicate(FLT_MAX);
+				XMVECTOR rightMax = XMVectorReplicate(-FLT_MAX);
+				unsigned int rightCount = 0;
+				for (unsigned int b = binCount - 1; b > 0; b--)
+				{
+					rightMin = XMVectorMin(rightMin, bins[b].BoundsMin);
+					rightMax = XMVectorMax(rightMax, bins[b].BoundsMax);
+					rightCount += bins[b].Count;
+					rightAreas[b] = HalfArea(rightMin, rightMax);
+					rightCounts[b] = rightCount;
+				}
+
+				XMVECTOR leftMin = XMVectorReplicate(FLT_MAX);
+				XMVECTOR leftMax = XMVectorReplicate(-FLT_MAX);
+				unsigned int leftCount = 0;
+				for (unsigned int b = 1; b < binCount; b++)
+				{
+					leftMin = XMVectorMin(leftMin, bins[b - 1].BoundsMin);
+					leftMax = XMVectorMax(leftMax, bins[b - 1].BoundsMax);
+					leftCount += bins[b - 1].Count;
+					if (leftCount == 0 || rightCounts[b] == 0)
+						continue;
+
+					float cost = HalfArea(leftMin, leftMax) * leftCount + rightAreas[b] * rightCounts[b];
+					if (cost < bestCost)
+					{
+						bestCost = cost;
+						bestAxis = axis;
+						bestSplit = b;
+					}
+				}
+			}
+
+			// Splitting has to beat testing every triangle here
+			float area = HalfArea(boundsMin, boundsMax);
+			if (bestAxis < 0 || (area > 0.0f && TraversalCost + bestCost / area >= (float)count))
+				continue;
+
+			float axisLow = (&low.x)[bestAxis];
+			float scale = binCount / (&extent.x)[bestAxis];
+			unsigned int* middle = std::partition(order.data() + start, order.data() + start + count, [&](unsigned int t) {
+				return std::min((unsigned int)(((&centroids[t].x)[bestAxis] - axisLow) * scale), binCount - 1) < bestSplit;
+			});
+			unsigned int leftCount = (unsigned int)(middle - (order.data() + start));
+
+			unsigned int firstChild = (unsigned int)tree.Nodes.size();
+			tree.Nodes[nodeIndex].Start = firstChild;
+			tree.Nodes[nodeIndex].Count = 0;
+			tree.Nodes.push_back({ XMFLOAT3(), start, XMFLOAT3(), leftCount });
+			tree.Nodes.push_back({ XMFLOAT3(), start + leftCount, XMFLOAT3(), count - leftCount });
+			pending.push_back({ firstChild, depth + 1 });
+			pending.push_back({ firstChild + 1, depth + 1 });
+		}
+
+		// Triangles are stored in leaf order, ready to test
+		tree.Triangles.resize(triangleCount);
+		for (unsigned int i = 0; i < triangleCount; i++)
+		{
+			unsigned int t = order[i];
+			XMVECTOR v0 = XMLoadFloat3(&vertices[indices[t * 3]].Position);
+			Triangle& triangle = tree.Triangles[i];
+			XMStoreFloat3(&triangle.V0, v0);
+			XMStoreFloat3(&triangle.Edge1, XMVectorSubtract(XMLoadFloat3(&vertices[indices[t * 3 + 1]].Position), v0));
+			XMStoreFloat3(&triangle.Edge2, XMVectorSubtract(XMLoadFloat3(&vertices[indices[t * 3 + 2]].Position), v0));
+			triangle.Id = t;
+		}
+		return tree;
+	}
+
+	// --------------------------------------------------------
+	// Depth first, nearer child first, skipping any node that
+	// starts beyond the closest hit so far
+	// --------------------------------------------------------
+	bool Intersect(const Tree& tree, const Ray& ray, Hit& hit)
+	{
+		if (tree.Nodes.empty())
+			return false;
+
+		XMVECTOR origin = XMLoadFloat3(&ray.Origin);
+		XMVECTOR direction = XMLoadFloat3(&ray.Direction);
+		XMVECTOR inverseDirection = GetInverseDirection(direction);
+
+		// Searching within the closer of the two limits
+		Hit closest = hit;
+		closest.Distance = fminf(hit.Distance, ray.MaxDistance);
+		bool found = false;
+		if (IntersectBox(tree.Nodes[0], origin, inverseDirection, closest.Distance) == FLT_MAX)
+			return false;
+
+		// Pending nodes, with the entry distances they were found at
+		std::pair<unsigned int, float> stack[MaxDepth + 1];
+		unsigned int stackSize = 0;
+		stack[stackSize++] = { 0, 0.0f };
+		while (stackSize > 0)
+		{
+			std::pair<unsigned int, float> entry = stack[--stackSize];
+			if (entry.second >= closest.Distance)
+				continue;
+
+			const Node& node = tree.Nodes[entry.first];
+			if (node.Count > 0)
+			{
+				for (unsigned int i = node.Start; i < node.Start + node.Count; i++)
+					found |= IntersectTriangle(tree.Triangles[i], origin, direction, closest);
+				continue;
+			}
+
+			float near0 = IntersectBox(tree.Nodes[node.Start], origin, inverseDirection, closest.Distance);
+			float near1 = IntersectBox(tree.Nodes[node.Start + 1], origin, inverseDirection, closest.Distance);
+			unsigned int first = near0 <= near1 ? node.Start : node.Start + 1;
+			unsigned int second = near0 <= near1 ? node.Start + 1 : node.Start;
+			float firstNear = fminf(near0, near1);
+			float secondNear = fmaxf(near0, near1);
+			if (secondNear != FLT_MAX)
+				stack[stackSize++] = { second, secondNear };
+			if (firstNear != FLT_MAX)
+				stack[stackSize++] = { first, firstNear };
+		}
+
+		if (found)
+			hit = closest;
+		return found;
+	}
+
+	// --------------------------------------------------------
+	// The packet visits a node if any of its rays enters it,
+	// and each ray only keeps hits closer than its own best
+	// - Children are visited in the order of their nearest
+	//   entry among the rays
+	// --------------------------------------------------------
+	void Intersect4(const Tree& tree, const Ray rays[4], Hit hits[4])
+	{
+		if (tree.Nodes.empty())
+			return;
+
+		XMFLOAT4 origins[3], directions[3], maxDistances;
+		for (int lane = 0; lane < 4; lane++)
+		{
+			(&origins[0].x)[lane] = rays[lane].Origin.x;
+			(&origins[1].x)[lane] = rays[lane].Origin.y;
+			(&origins[2].x)[lane] = rays[lane].Origin.z;
+			(&directions[0].x)[lane] = rays[lane].Direction.x;
+			(&directions[1].x)[lane] = rays[lane].Direction.y;
+			(&directions[2].x)[lane] = rays[lane].Direction.z;
+			(&maxDistances.x)[lane] = fminf(rays[lane].MaxDistance, hits[lane].Distance);
+		}
+
+		Packet packet;
+		packet.OriginX = XMLoadFloat4(&origins[0]);
+		packet.OriginY = XMLoadFloat4(&origins[1]);
+		packet.OriginZ = XMLoadFloat4(&origins[2]);
+		packet.DirectionX = XMLoadFloat4(&directions[0]);
+		packet.DirectionY = XMLoadFloat4(&directions[1]);
+		packet.DirectionZ = XMLoadFloat4(&directions[2]);
+		packet.InverseX = GetInverseDirection(packet.DirectionX);
+		packet.InverseY = GetInverseDirection(packet.DirectionY);
+		packet.InverseZ = GetInverseDirection(packet.DirectionZ);
+		packet.MaxDistance = XMLoadFloat4(&maxDistances);
+		packet.Triangle = XMVectorReplicateInt(UINT32_MAX);
+		packet.U = XMVectorZero();
+		packet.V = XMVectorZero();
+
+		XMVECTOR enter;
+		XMVECTOR none = XMVectorFalseInt();
+		if (XMVector4EqualInt(IntersectBox4(tree.Nodes[0], packet, enter), none))
+			return;
+
+		std::pair<unsigned int, float> stack[MaxDepth + 1];
+		unsigned int stackSize = 0;
+		stack[stackSize++] = { 0, 0.0f };
+		while (stackSize > 0)
+		{
+			std::pair<unsigned int, float> entry = stack[--stackSize];
+			const Node& node = tree.Nodes[entry.first];
+
+			// Hits since the node was pushed may have put it out of reach
+			if (XMVector4EqualInt(XMVectorLessOrEqual(XMVectorReplicate(entry.second), packet.MaxDistance), none))
+				continue;
+
+			if (node.Count > 0)
+			{
+				for (unsigned int i = node.Start; i < node.Start + node.Count; i++)
+					IntersectTriangle4(tree.Triangles[i], packet);
+				continue;
+			}
+
+			XMVECTOR enter0, enter1;
+			XMVECTOR active0 = IntersectBox4(tree.Nodes[node.Start], packet, enter0);
+			XMVECTOR active1 = IntersectBox4(tree.Nodes[node.Start + 1], packet, enter1);
+			bool visit0 = !XMVector4EqualInt(active0, none);
+			bool visit1 = !XMVector4EqualInt(active1, none);
+			float near0 = visit0 ? GetNearestEntry(enter0, active0) : FLT_MAX;
+			float near1 = visit1 ? GetNearestEntry(enter1, active1) : FLT_MAX;
+			bool firstIs0 = near0 <= near1;
+			if (firstIs0 ? visit1 : visit0)
+				stack[stackSize++] = { firstIs0 ? node.Start + 1 : node.Start, firstIs0 ? near1 : near0 };
+			if (firstIs0 ? visit0 : visit1)
+				stack[stackSize++] = { firstIs0 ? node.Start : node.Start + 1, firstIs0 ? near0 : near1 };
+		}
+
+		// Only lanes that found something closer change their hits
+		XMFLOAT4 distances, u, v;
+		XMUINT4 triangles;
+		XMStoreFloat4(&distances, packet.MaxDistance);
+		XMStoreFloat4(&u, packet.U);
+		XMStoreFloat4(&v, packet.V);
+		XMStoreUInt4(&triangles, packet.Triangle);
+		for (int lane = 0; lane < 4; lane++)
+		{
+			unsigned int triangle = (&triangles.x)[lane];
+			if (triangle == UINT32_MAX)
+				continue;
+			hits[lane].Distance = (&distances.x)[lane];
+			hits[lane].Triangle = triangle;
+			hits[lane].U = (&u.x)[lane];
+			hits[lane].V = (&v.x)[lane];
+		}
+	}
+
+	void Intersect(const Tree& tree, const Ray* rays, size_t rayCount, Hit* hits)
+	{
+		for (size_t first = 0; first < rayCount; first += 4)
+		{
+			size_t count = std::min(rayCount - first, (size_t)4);
+			if (count == 4)
+			{
+				Intersect4(tree, rays + first, hits + first);
+				continue;
+			}
+
+			// The last few rays are padded with ones that can't hit
+			Ray packetRays[4];
+			Hit packetHits[4];
+			for (size_t lane = 0; lane < 4; lane++)
+			{
+				packetRays[lane] = lane < count ? rays[first + lane] : Ray{ XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 1), -1.0f };
+				packetHits[lane] = lane < count ? hits[first + lane] : Hit();
+			}
+			Intersect4(tree, packetRays, packetHits);
+			for (size_t lane = 0; lane < count; lane++)
+				hits[first + lane] = packetHits[lane];
+		}
+	}
+
+	std::string GetBvhPath(const char* sourceFile)
+	{
+		std::string path = sourceFile;
+		size_t dot = path.find_last_of('.');
+		size_t slash = path.find_last_of("/\\");
+		if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+			path.erase(dot);
+		return path + ".meshbvh";
+	}
+
+	// --------------------------------------------------------
+	// Copies a tree out of a mapped file, after making sure
+	// every node stays within the file, every child comes
+	// after its parent (so there are no cycles) and no leaf
+	// is deeper than traversal can handle
+	// --------------------------------------------------------
+	bool Read(const char* bvhFile, uint64_t sourceSize, uint64_t sourceHash, const Options& options, Tree& tree)
+	{
+		MappedFile file(bvhFile);
+		const char* data = file.GetData();
+		size_t length = file.GetSize();
+		if (!data || length < sizeof(FileHeader))
+			return false;
+
+		FileHeader header;
+		memcpy(&header, data, sizeof(FileHeader));
+		if (header.Magic != Magic ||
+			header.Version != Version ||
+			header.NodeSize != sizeof(Node) ||
+			header.TriangleSize != sizeof(Triangle) ||
+			header.MaxLeafTriangles != options.MaxLeafTriangles ||
+			header.BinCount != options.BinCount ||
+			header.SourceSize != sourceSize ||
+			header.SourceHash != sourceHash ||
+			sizeof(FileHeader) + (uint64_t)header.NodeCount * sizeof(Node) + (uint64_t)header.TriangleCount * sizeof(Triangle) != length)
+			return false;
+
+		std::vector<Node> nodes(header.NodeCount);
+		std::vector<Triangle> triangles(header.TriangleCount);
+		memcpy(nodes.data(), data + sizeof(FileHeader), nodes.size() * sizeof(Node));
+		memcpy(triangles.data(), data + sizeof(FileHeader) + nodes.size() * sizeof(Node), triangles.size() * sizeof(Triangle));
+
+		std::vector<unsigned int> depths(nodes.size(), 0);
+		for (size_t n = 0; n < nodes.size(); n++)
+		{
+			const Node& node = nodes[n];
+			if (node.Count > 0)
+			{
+				if ((uint64_t)node.Start + node.Count > triangles.size())
+					return false;
+				continue;
+			}
+			if (node.Start <= n || (uint64_t)node.Start + 1 >= nodes.size() || depths[n] >= MaxDepth)
+				return false;
+			depths[node.Start] = depths[node.Start + 1] = depths[n] + 1;
+		}
+		for (const Triangle& triangle : triangles)
+		{
+			if (triangle.Id >= header.TriangleCount)
+				return false;
+		}
+
+		tree.Nodes = std::move(nodes);
+		tree.Triangles = std::move(triangles);
+		return true;
+	}
+
+	bool Write(const char* bvhFile, uint64_t sourceSize, uint64_t sourceHash, const Options& options, const Tree& tree)
+	{
+		FileHeader header = {};
+		header.Magic = Magic;
+		header.Version = Version;
+		header.NodeSize = sizeof(Node);
+		header.TriangleSize = sizeof(Triangle);
+		header.MaxLeafTriangles = options.MaxLeafTriangles;
+		header.BinCount = options.BinCount;
+		header.SourceSize = sourceSize;
+		header.SourceHash = sourceHash;
+		header.NodeCount = (uint32_t)tree.Nodes.size();
+		header.TriangleCount = (uint32_t)tree.Triangles.size();
+
+		// Written to a temporary file first, like MeshCache::Write()
+		std::string tempFile = std::string(bvhFile) + ".tmp";
+		{
+			std::ofstream out(tempFile, std::ios::binary | std::ios::trunc);
+			if (!out.is_open())
+				return false;
+
+			out.write((const char*)&header, sizeof(FileHeader));
+			out.write((const char*)tree.Nodes.data(), tree.Nodes.size() * sizeof(Node));
+			out.write((const char*)tree.Triangles.data(), tree.Triangles.size() * sizeof(Triangle));
+			if (!out.good())
+			{
+				out.close();
+				remove(tempFile.c_str());
+				return false;
+			}
+		}
+
+		remove(bvhFile);
+		if (rename(tempFile.c_str(), bvhFile) != 0)
+		{
+			remove(tempFile.c_str());
+			return false;
+		}
+		return true;
+	}
+}
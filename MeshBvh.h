@@ -0,0 +1,108 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <cfloat>
+#include <DirectXMath.h>
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Bounding volume hierarchy over a mesh's triangles, for
+// ray queries on the CPU (picking, line of sight, etc.)
+//
+// - Built top down with the surface area heuristic, using
+//   binned centroids, so each split is linear in the number
+//   of triangles
+// - Nodes are 32 bytes with both children next to each
+//   other, and leaf triangles are stored in leaf order with
+//   their edges precomputed, so traversal never touches the
+//   mesh's own vertices or indices
+// - Rays can be traced one at a time, as packets of four
+//   that traverse together (one SIMD lane per ray, using
+//   DirectXMath), or as a stream that's cut into packets
+// - Triangles are hit from either side
+// - Trees can be written next to the source file and read
+//   back instead of rebuilding, like MeshCache
+// - Has no dependency on Direct3D
+// --------------------------------------------------------
+namespace MeshBvh
+{
+	const uint32_t Magic = 0x4856424D; // "MBVH"
+	const uint32_t Version = 1;
+
+	struct Options
+	{
+		// Nodes with this many triangles or fewer always become leaves
+		unsigned int MaxLeafTriangles = 4;
+
+		// Centroid bins tried per axis at each split
+		unsigned int BinCount = 16;
+	};
+
+	struct Node
+	{
+		DirectX::XMFLOAT3 BoundsMin;
+		unsigned int Start;		// First child (the second follows it), or first triangle of a leaf
+		DirectX::XMFLOAT3 BoundsMax;
+		unsigned int Count;		// Triangles in a leaf (zero for inner nodes)
+	};
+
+	// A triangle as the ray test wants it
+	struct Triangle
+	{
+		DirectX::XMFLOAT3 V0;
+		DirectX::XMFLOAT3 Edge1;	// V1 - V0
+		DirectX::XMFLOAT3 Edge2;	// V2 - V0
+		unsigned int Id;			// Triangle index within the indices the tree was built from
+	};
+
+	struct Tree
+	{
+		std::vector<Node> Nodes;	// Root first (empty for a mesh with no triangles)
+		std::vector<Triangle> Triangles;
+	};
+
+	// Distances are in multiples of Direction, which doesn't need
+	// to be normalized (so a transformed ray keeps its distances)
+	struct Ray
+	{
+		DirectX::XMFLOAT3 Origin;
+		DirectX::XMFLOAT3 Direction;
+		float MaxDistance = FLT_MAX;
+	};
+
+	struct Hit
+	{
+		float Distance = FLT_MAX;
+		unsigned int Triangle = UINT32_MAX;	// UINT32_MAX when nothing was hit
+		float U = 0.0f;						// Barycentrics of V1 and V2
+		float V = 0.0f;
+	};
+
+	// Builds a tree over the triangles of the first indexCount indices
+	Tree Build(const Vertex* vertices, const unsigned int* indices, size_t indexCount, const Options& options = Options());
+
+	// Closest hit within the ray's distance, if it's closer than the
+	// one already in hit (returns whether hit changed)
+	bool Intersect(const Tree& tree, const Ray& ray, Hit& hit);
+
+	// The same for four rays at once, which traverse the tree together
+	// (best when they start close and point the same way)
+	void Intersect4(const Tree& tree, const Ray rays[4], Hit hits[4]);
+
+	// Any number of rays, four at a time, in the order given
+	void Intersect(const Tree& tree, const Ray* rays, size_t rayCount, Hit* hits);
+
+	// Path of the tree file that sits next to a source file
+	// (e.g. "Assets/cube.obj" -> "Assets/cube.meshbvh")
+	std::string GetBvhPath(const char* sourceFile);
+
+	// Reads a tree written for this exact source (as with MeshCache,
+	// by size and hash) and the same options, returning false if
+	// there isn't one or it can't be used
+	bool Read(const char* bvhFile, uint64_t sourceSize, uint64_t sourceHash, const Options& options, Tree& tree);
+
+	// Writes (or replaces) a tree file, returning false on failure
+	bool Write(const char* bvhFile, uint64_t sourceSize, uint64_t sourceHash, const Options& options, const Tree& tree);
+}
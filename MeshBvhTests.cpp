@@ -0,0 +1,490 @@
+#include "Tests.h"
+#include "MeshBvh.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	const char* bvhFile = "MeshBvhTests.meshbvh";
+
+	// Triangles of random sizes and orientations scattered
+	// through a box, overlapping each other
+	void MakeSoup(unsigned int triangleCount, unsigned int seed, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+	{
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<float> position(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> size(0.02f, 0.3f);
+		for (unsigned int t = 0; t < triangleCount; t++)
+		{
+			XMFLOAT3 center(position(random), position(random), position(random));
+			float scale = size(random);
+			for (int k = 0; k < 3; k++)
+			{
+				Vertex v = {};
+				v.Position = XMFLOAT3(
+					center.x + position(random) * scale,
+					center.y + position(random) * scale,
+					center.z + position(random) * scale);
+				indices.push_back((unsigned int)vertices.size());
+				vertices.push_back(v);
+			}
+		}
+	}
+
+	// A closed, lumpy sphere of rings x segments
+	void MakeLumpySphere(int rings, int segments, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+	{
+		for (int r = 0; r <= rings; r++)
+		{
+			float theta = XM_PI * r / rings;
+			for (int s = 0; s < segments; s++)
+			{
+				float phi = XM_2PI * s / segments;
+				float radius = 1.0f + 0.1f * sinf(theta * 5.0f) * sinf(phi * 7.0f);
+				Vertex v = {};
+				v.Position = XMFLOAT3(radius * sinf(theta) * cosf(phi), radius * cosf(theta), radius * sinf(theta) * sinf(phi));
+				vertices.push_back(v);
+			}
+		}
+		for (int r = 0; r < rings; r++)
+		{
+			for (int s = 0; s < segments; s++)
+			{
+				unsigned int a = r * segments + s;
+				unsigned int b = r * segments + (s + 1) % segments;
+				indices.insert(indices.end(), { a, b, a + segments, b, b + segments, a + segments });
+			}
+		}
+	}
+
+	// Random rays from around the box, some limited in distance
+	// and some along the axes (so with zero direction components)
+	std::vector<MeshBvh::Ray> MakeRays(unsigned int rayCount, unsigned int seed)
+	{
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::vector<MeshBvh::Ray> rays(rayCount);
+		for (unsigned int r = 0; r < rayCount; r++)
+		{
+			MeshBvh::Ray& ray = rays[r];
+			ray.Origin = XMFLOAT3(unit(random) * 1.5f, unit(random) * 1.5f, unit(random) * 1.5f);
+			ray.Direction = XMFLOAT3(unit(random), unit(random), unit(random));
+			if (r % 7 == 0)
+				ray.Direction = XMFLOAT3(0.0f, 0.0f, r % 2 ? 2.0f : -1.0f);
+			if (r % 5 == 0)
+				ray.MaxDistance = 0.5f + unit(random) * 0.4f;
+		}
+		return rays;
+	}
+
+	// Every triangle against the ray, in doubles, as the answer
+	// the trees should agree with
+	MeshBvh::Hit BruteForce(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const MeshBvh::Ray& ray)
+	{
+		MeshBvh::Hit hit;
+		double closest = ray.MaxDistance;
+		const double o[3] = { ray.Origin.x, ray.Origin.y, ray.Origin.z };
+		const double d[3] = { ray.Direction.x, ray.Direction.y, ray.Direction.z };
+		for (size_t t = 0; t < indices.size() / 3; t++)
+		{
+			const XMFLOAT3& a = vertices[indices[t * 3]].Position;
+			const XMFLOAT3& b = vertices[indices[t * 3 + 1]].Position;
+			const XMFLOAT3& c = vertices[indices[t * 3 + 2]].Position;
+			double e1[3] = { (double)b.x - a.x, (double)b.y - a.y, (double)b.z - a.z };
+			double e2[3] = { (double)c.x - a.x, (double)c.y - a.y, (double)c.z - a.z };
+			double p[3] = { d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0] };
+			double determinant = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+			if (fabs(determinant) < 1e-12)
+				continue;
+			double s[3] = { o[0] - a.x, o[1] - a.y, o[2] - a.z };
+			double u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) / determinant;
+			double q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+			double v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) / determinant;
+			double distance = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) / determinant;
+			if (u < 0.0 || v < 0.0 || u + v > 1.0 || distance < 0.0 || distance >= closest)
+				continue;
+			closest = distance;
+			hit.Distance = (float)distance;
+			hit.Triangle = (unsigned int)t;
+			hit.U = (float)u;
+			hit.V = (float)v;
+		}
+		return hit;
+	}
+
+	// --------------------------------------------------------
+	// Whether two answers for the same ray agree: both miss,
+	// or both hit the same triangle at the same distance
+	// - Rays through an edge, or that just reach a triangle at
+	//   the end of their range, can reasonably go either way
+	//   with float rounding, so a hit on one side only (or on
+	//   another triangle at the same distance) is counted as a
+	//   close call instead, for the caller to keep rare
+	// --------------------------------------------------------
+	bool Agree(const MeshBvh::Hit& a, const MeshBvh::Hit& b, unsigned int& closeCalls)
+	{
+		bool aHit = a.Triangle != UINT32_MAX;
+		bool bHit = b.Triangle != UINT32_MAX;
+		if (aHit != bHit)
+		{
+			closeCalls++;
+			return true;
+		}
+		if (!aHit)
+			return true;
+		if (!Tests::Near(a.Distance, b.Distance, 1e-4f * (1.0f + a.Distance)))
+			return false;
+		closeCalls += a.Triangle != b.Triangle;
+		return true;
+	}
+
+	// Each leaf's triangles inside its bounds, children inside their
+	// parent's, and every triangle in exactly one leaf
+	// - V0 + an edge can round a little past the corner it came from
+	bool IsValidTree(const MeshBvh::Tree& tree, size_t triangleCount)
+	{
+		std::vector<unsigned int> seen(triangleCount, 0);
+		auto inside = [](const XMFLOAT3& point, const MeshBvh::Node& node) {
+			const float e = 1e-6f;
+			return point.x >= node.BoundsMin.x - e && point.y >= node.BoundsMin.y - e && point.z >= node.BoundsMin.z - e &&
+				point.x <= node.BoundsMax.x + e && point.y <= node.BoundsMax.y + e && point.z <= node.BoundsMax.z + e;
+		};
+		for (const MeshBvh::Node& node : tree.Nodes)
+		{
+			if (node.Count == 0)
+			{
+				if (node.Start + 1 >= tree.Nodes.size())
+					return false;
+				for (unsigned int c = node.Start; c < node.Start + 2; c++)
+				{
+					if (!inside(tree.Nodes[c].BoundsMin, node) || !inside(tree.Nodes[c].BoundsMax, node))
+						return false;
+				}
+				continue;
+			}
+
+			for (unsigned int i = node.Start; i < node.Start + node.Count; i++)
+			{
+				const MeshBvh::Triangle& triangle = tree.Triangles[i];
+				XMFLOAT3 v1, v2;
+				XMStoreFloat3(&v1, XMLoadFloat3(&triangle.V0) + XMLoadFloat3(&triangle.Edge1));
+				XMStoreFloat3(&v2, XMLoadFloat3(&triangle.V0) + XMLoadFloat3(&triangle.Edge2));
+				if (triangle.Id >= triangleCount || !inside(triangle.V0, node) || !inside(v1, node) || !inside(v2, node))
+					return false;
+				seen[triangle.Id]++;
+			}
+		}
+		return std::all_of(seen.begin(), seen.end(), [](unsigned int count) { return count == 1; });
+	}
+
+	std::vector<char> ReadFile(const char* path)
+	{
+		std::ifstream in(path, std::ios::binary);
+		return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	}
+
+	void WriteFile(const char* path, const std::vector<char>& bytes)
+	{
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		out.write(bytes.data(), bytes.size());
+	}
+
+	double Seconds(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+}
+
+// --------------------------------------------------------
+// Single rays through trees of a few leaf sizes find the same
+// closest hits as testing every triangle
+// --------------------------------------------------------
+TEST(MeshBvhHitsMatchBruteForce)
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeSoup(3000, 1, vertices, indices);
+	std::vector<MeshBvh::Ray> rays = MakeRays(2000, 2);
+
+	unsigned int leafSizes[] = { 1, 4, 16 };
+	for (unsigned int leafSize : leafSizes)
+	{
+		MeshBvh::Options options;
+		options.MaxLeafTriangles = leafSize;
+		MeshBvh::Tree tree = MeshBvh::Build(vertices.data(), indices.data(), indices.size(), options);
+		CHECK(IsValidTree(tree, indices.size() / 3));
+		CHECK(tree.Nodes.size() > 1);
+
+		unsigned int closeCalls = 0;
+		unsigned int hitCount = 0;
+		bool agree = true;
+		bool returns = true;
+		for (const MeshBvh::Ray& ray : rays)
+		{
+			MeshBvh::Hit expected = BruteForce(vertices, indices, ray);
+			MeshBvh::Hit hit;
+			bool found = MeshBvh::Intersect(tree, ray, hit);
+			returns = returns && found == (hit.Triangle != UINT32_MAX);
+			agree = agree && Agree(expected, hit, closeCalls);
+			hitCount += found;
+
+			// Barycentrics put the hit where the distance says
+			if (found)
+			{
+				const MeshBvh::Triangle* triangle = nullptr;
+				for (const MeshBvh::Triangle& t : tree.Triangles)
+					triangle = t.Id == hit.Triangle ? &t : triangle;
+				XMVECTOR onTriangle = XMLoadFloat3(&triangle->V0) +
+					XMLoadFloat3(&triangle->Edge1) * hit.U + XMLoadFloat3(&triangle->Edge2) * hit.V;
+				XMVECTOR onRay = XMLoadFloat3(&ray.Origin) + XMLoadFloat3(&ray.Direction) * hit.Distance;
+				agree = agree && XMVectorGetX(XMVector3Length(onTriangle - onRay)) < 1e-4f;
+			}
+		}
+		CHECK(agree);
+		CHECK(closeCalls < 4);
+		CHECK(returns);
+		CHECK(hitCount > rays.size() / 4 && hitCount < rays.size());
+	}
+
+	// A hit that's already closer than anything the ray reaches stays
+	MeshBvh::Tree tree = MeshBvh::Build(vertices.data(), indices.data(), indices.size());
+	bool kept = true;
+	for (const MeshBvh::Ray& ray : rays)
+	{
+		MeshBvh::Hit hit = BruteForce(vertices, indices, ray);
+		if (hit.Triangle == UINT32_MAX)
+			continue;
+		MeshBvh::Hit closer;
+		closer.Distance = hit.Distance * 0.5f;
+		closer.Triangle = 12345;
+		kept = kept && !MeshBvh::Intersect(tree, ray, closer) && closer.Triangle == 12345;
+	}
+	CHECK(kept);
+
+	// Trees over nothing, and over triangles that all share a centroid
+	MeshBvh::Tree empty = MeshBvh::Build(vertices.data(), indices.data(), 0);
+	MeshBvh::Hit none;
+	CHECK(empty.Nodes.empty() && !MeshBvh::Intersect(empty, rays[0], none));
+
+	std::vector<unsigned int> stacked;
+	for (int i = 0; i < 100; i++)
+		stacked.insert(stacked.end(), { 0, 1, 2 });
+	MeshBvh::Tree same = MeshBvh::Build(vertices.data(), stacked.data(), stacked.size());
+	CHECK(IsValidTree(same, 100));
+	MeshBvh::Ray ray;
+	XMStoreFloat3(&ray.Origin, (XMLoadFloat3(&vertices[0].Position) + XMLoadFloat3(&vertices[1].Position) + XMLoadFloat3(&vertices[2].Position)) / 3.0f + XMVectorSet(0, 0, -5, 0));
+	ray.Direction = XMFLOAT3(0, 0, 1);
+	MeshBvh::Hit stackedHit;
+	CHECK(MeshBvh::Intersect(same, ray, stackedHit) && stackedHit.Triangle < 100);
+}
+
+// --------------------------------------------------------
+// Packets of four and streams of any length agree with the
+// same rays traced one at a time, whether the rays in a
+// packet are scattered or start together like a camera's
+// --------------------------------------------------------
+TEST(MeshBvhPacketsMatchSingleRays)
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeLumpySphere(40, 80, vertices, indices);
+	MakeSoup(500, 3, vertices, indices);
+	MeshBvh::Tree tree = MeshBvh::Build(vertices.data(), indices.data(), indices.size());
+
+	// Scattered rays, then a grid of rays from one point
+	std::vector<MeshBvh::Ray> rays = MakeRays(1001, 4);
+	for (int y = 0; y < 32; y++)
+	{
+		for (int x = 0; x < 32; x++)
+		{
+			MeshBvh::Ray ray;
+			ray.Origin = XMFLOAT3(0.2f, 0.3f, -3.0f);
+			ray.Direction = XMFLOAT3((x - 15.5f) / 48.0f, (y - 15.5f) / 48.0f, 1.0f);
+			rays.push_back(ray);
+		}
+	}
+
+	std::vector<MeshBvh::Hit> single(rays.size());
+	unsigned int hitCount = 0;
+	for (size_t r = 0; r < rays.size(); r++)
+		hitCount += MeshBvh::Intersect(tree, rays[r], single[r]);
+	CHECK(hitCount > rays.size() / 2);
+
+	// Fours, with hits given some starting distances (which only closer hits replace)
+	unsigned int closeCalls = 0;
+	bool agree = true;
+	for (size_t first = 0; first + 4 <= rays.size(); first += 4)
+	{
+		MeshBvh::Hit hits[4];
+		if (first % 8 == 0 && single[first + 1].Triangle != UINT32_MAX)
+		{
+			hits[1].Distance = single[first + 1].Distance * 0.5f;
+			hits[1].Triangle = 12345;
+		}
+		MeshBvh::Intersect4(tree, &rays[first], hits);
+		for (int lane = 0; lane < 4; lane++)
+		{
+			if (hits[lane].Triangle == 12345)
+				agree = agree && hits[lane].Distance == single[first + lane].Distance * 0.5f;
+			else
+				agree = agree && Agree(single[first + lane], hits[lane], closeCalls);
+		}
+	}
+	CHECK(agree);
+
+	// The stream, with a last packet of one ray
+	std::vector<MeshBvh::Hit> stream(rays.size());
+	MeshBvh::Intersect(tree, rays.data(), rays.size(), stream.data());
+	agree = true;
+	for (size_t r = 0; r < rays.size(); r++)
+	{
+		agree = agree && Agree(single[r], stream[r], closeCalls);
+		agree = agree && (stream[r].Triangle == UINT32_MAX ||
+			(Tests::Near(stream[r].U, single[r].U, 1e-3f) && Tests::Near(stream[r].V, single[r].V, 1e-3f)));
+	}
+	CHECK(agree);
+	CHECK(closeCalls < 4);
+}
+
+// --------------------------------------------------------
+// Trees come back from their files exactly as written, but
+// only for the same source and options, and never from a
+// file that's been cut short or damaged
+// --------------------------------------------------------
+TEST(MeshBvhFilesRoundTrip)
+{
+	CHECK(MeshBvh::GetBvhPath("Assets/cube.obj") == "Assets/cube.meshbvh");
+	CHECK(MeshBvh::GetBvhPath("Assets.v2/cube") == "Assets.v2/cube.meshbvh");
+
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeSoup(500, 5, vertices, indices);
+	MeshBvh::Options options;
+	MeshBvh::Tree tree = MeshBvh::Build(vertices.data(), indices.data(), indices.size(), options);
+	const uint64_t size = 1234;
+	const uint64_t hash = 0x0123456789ABCDEFull;
+	CHECK(MeshBvh::Write(bvhFile, size, hash, options, tree));
+
+	MeshBvh::Tree read;
+	CHECK(MeshBvh::Read(bvhFile, size, hash, options, read));
+	CHECK(read.Nodes.size() == tree.Nodes.size() && read.Triangles.size() == tree.Triangles.size());
+	CHECK(read.Nodes.size() == tree.Nodes.size() && memcmp(read.Nodes.data(), tree.Nodes.data(), tree.Nodes.size() * sizeof(MeshBvh::Node)) == 0);
+	CHECK(read.Triangles.size() == tree.Triangles.size() && memcmp(read.Triangles.data(), tree.Triangles.data(), tree.Triangles.size() * sizeof(MeshBvh::Triangle)) == 0);
+
+	// Another source, or other build options
+	MeshBvh::Tree rejected;
+	MeshBvh::Options otherLeaves = options;
+	otherLeaves.MaxLeafTriangles++;
+	MeshBvh::Options otherBins = options;
+	otherBins.BinCount++;
+	CHECK(!MeshBvh::Read(bvhFile, size, hash + 1, options, rejected));
+	CHECK(!MeshBvh::Read(bvhFile, size + 1, hash, options, rejected));
+	CHECK(!MeshBvh::Read(bvhFile, size, hash, otherLeaves, rejected));
+	CHECK(!MeshBvh::Read(bvhFile, size, hash, otherBins, rejected));
+	CHECK(rejected.Nodes.empty() && rejected.Triangles.empty());
+
+	// Damaged copies of the file: cut short, a child pointing back at
+	// its parent, a leaf past the triangles, and a bad triangle id
+	std::vector<char> bytes = ReadFile(bvhFile);
+	CHECK(!bytes.empty());
+	if (bytes.empty())
+		return;
+	size_t nodesOffset = bytes.size() - tree.Nodes.size() * sizeof(MeshBvh::Node) - tree.Triangles.size() * sizeof(MeshBvh::Triangle);
+	size_t trianglesOffset = bytes.size() - tree.Triangles.size() * sizeof(MeshBvh::Triangle);
+	size_t leaf = std::find_if(tree.Nodes.begin(), tree.Nodes.end(), [](const MeshBvh::Node& n) { return n.Count > 0; }) - tree.Nodes.begin();
+
+	WriteFile(bvhFile, std::vector<char>(bytes.begin(), bytes.end() - 1));
+	CHECK(!MeshBvh::Read(bvhFile, size, hash, options, rejected));
+
+	std::vector<char> damaged = bytes;
+	((MeshBvh::Node*)(damaged.data() + nodesOffset))[0].Start = 0;
+	WriteFile(bvhFile, damaged);
+	CHECK(!MeshBvh::Read(bvhFile, size, hash, options, rejected));
+
+	damaged = bytes;
+	((MeshBvh::Node*)(damaged.data() + nodesOffset))[leaf].Count = (unsigned int)tree.Triangles.size() + 1;
+	WriteFile(bvhFile, damaged);
+	CHECK(!MeshBvh::Read(bvhFile, size, hash, options, rejected));
+
+	damaged = bytes;
+	((MeshBvh::Triangle*)(damaged.data() + trianglesOffset))[3].Id = (unsigned int)tree.Triangles.size();
+	WriteFile(bvhFile, damaged);
+	CHECK(!MeshBvh::Read(bvhFile, size, hash, options, rejected));
+	CHECK(rejected.Nodes.empty() && rejected.Triangles.empty());
+
+	// And the undamaged file still reads
+	WriteFile(bvhFile, bytes);
+	CHECK(MeshBvh::Read(bvhFile, size, hash, options, read));
+	std::remove(bvhFile);
+	CHECK(!MeshBvh::Read(bvhFile, size, hash, options, read));
+}
+
+// --------------------------------------------------------
+// Rays per second on a ~1M triangle mesh, traced one at a
+// time, as packets of camera rays and as a scattered stream
+// --------------------------------------------------------
+BENCHMARK(MeshBvhRaysPerSecond)
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeLumpySphere(500, 1000, vertices, indices);
+	printf("  %zu triangles\n", indices.size() / 3);
+
+	std::chrono::high_resolution_clock::time_point buildStart = std::chrono::high_resolution_clock::now();
+	MeshBvh::Tree tree = MeshBvh::Build(vertices.data(), indices.data(), indices.size());
+	printf("  Build: %.1f ms, %zu nodes\n", Seconds(buildStart) * 1000.0, tree.Nodes.size());
+
+	// A 512 x 512 camera looking at the sphere, and the same number
+	// of rays from random points towards random points
+	const int resolution = 512;
+	std::vector<MeshBvh::Ray> cameraRays;
+	for (int y = 0; y < resolution; y++)
+	{
+		for (int x = 0; x < resolution; x++)
+		{
+			MeshBvh::Ray ray;
+			ray.Origin = XMFLOAT3(0.0f, 0.0f, -3.0f);
+			ray.Direction = XMFLOAT3((x + 0.5f) / resolution - 0.5f, (y + 0.5f) / resolution - 0.5f, 1.0f);
+			cameraRays.push_back(ray);
+		}
+	}
+	std::vector<MeshBvh::Ray> randomRays = MakeRays((unsigned int)cameraRays.size(), 6);
+	for (MeshBvh::Ray& ray : randomRays)
+		ray.MaxDistance = FLT_MAX;
+
+	struct Run { const char* Name; const std::vector<MeshBvh::Ray>* Rays; bool Stream; };
+	Run runs[] =
+	{
+		{ "Camera, single rays", &cameraRays, false },
+		{ "Camera, stream of packets", &cameraRays, true },
+		{ "Random, single rays", &randomRays, false },
+		{ "Random, stream of packets", &randomRays, true },
+	};
+	std::vector<MeshBvh::Hit> hits(cameraRays.size());
+	for (const Run& run : runs)
+	{
+		const std::vector<MeshBvh::Ray>& rays = *run.Rays;
+		std::fill(hits.begin(), hits.end(), MeshBvh::Hit());
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		if (run.Stream)
+			MeshBvh::Intersect(tree, rays.data(), rays.size(), hits.data());
+		else
+		{
+			for (size_t r = 0; r < rays.size(); r++)
+				MeshBvh::Intersect(tree, rays[r], hits[r]);
+		}
+		double seconds = Seconds(start);
+		size_t hitCount = std::count_if(hits.begin(), hits.end(), [](const MeshBvh::Hit& h) { return h.Triangle != UINT32_MAX; });
+		printf("  %-28s %6.2f Mrays/s (%zu of %zu hit)\n", run.Name, rays.size() / seconds / 1e6, hitCount, rays.size());
+	}
+}
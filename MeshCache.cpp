@@ -0,0 +1,293 @@
+#include "MeshCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+	const uint32_t flagWeldVertices = 1 << 0;
+	const uint32_t flagOptimizeVertexCache = 1 << 1;
+	const uint32_t flagBuildClusters = 1 << 2;
+	const uint32_t flagMikkTSpace = 1 << 3;
+	const uint32_t lodCountShift = 8;		// Requested LOD count lives in bits 8-15
+
+	// Keeps the vertex and index arrays 16-byte aligned in the file
+	const uint64_t dataAlignment = 16;
+
+	uint64_t AlignUp(uint64_t value)
+	{
+		return (value + dataAlignment - 1) & ~(dataAlignment - 1);
+	}
+
+	uint32_t GetFlags(const ObjLoader::LoadOptions& options)
+	{
+		return (options.WeldVertices ? flagWeldVertices : 0) |
+			(options.OptimizeVertexCache ? flagOptimizeVertexCache : 0) |
+			(options.BuildClusters ? flagBuildClusters : 0) |
+			(options.TangentMode == MeshTangents::Mode::MikkTSpace ? flagMikkTSpace : 0) |
+			((options.LodCount & 0xFF) << lodCountShift);
+	}
+}
+
+namespace MeshCache
+{
+	std::string GetCachePath(const char* sourceFile)
+	{
+		std::string path = sourceFile;
+		size_t dot = path.find_last_of('.');
+		size_t slash = path.find_last_of("/\\");
+		if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+			path.erase(dot);
+		return path + ".meshbin";
+	}
+
+	// --------------------------------------------------------
+	// Mixes eight bytes at a time, so hashing is far cheaper
+	// than reading the file in the first place
+	// --------------------------------------------------------
+	uint64_t HashBytes(const char* data, size_t length)
+	{
+		const uint64_t multiplier = 0xFF51AFD7ED558CCDull;
+		uint64_t hash = 0x9E3779B97F4A7C15ull ^ (length * multiplier);
+
+		size_t i = 0;
+		for (; i + 8 <= length; i += 8)
+		{
+			uint64_t word;
+			memcpy(&word, data + i, 8);
+			hash = (hash ^ word) * multiplier;
+			hash ^= hash >> 32;
+		}
+
+		uint64_t tail = 0;
+		if (i < length)
+			memcpy(&tail, data + i, length - i);
+		hash = (hash ^ tail) * multiplier;
+		hash ^= hash >> 29;
+		hash *= 0xC4CEB9FE1A85EC53ull;
+		hash ^= hash >> 32;
+		return hash;
+	}
+
+	const Header* Validate(const char* data, size_t length, uint64_t sourceSize, uint64_t sourceHash, const ObjLoader::LoadOptions& options)
+	{
+		if (!data || length < sizeof(Header))
+			return nullptr;
+
+		const Header* header = (const Header*)data;
+		if (header->Magic != Magic ||
+			header->Version != Version ||
+			header->VertexStride != sizeof(Vertex) ||
+			header->Flags != GetFlags(options) ||
+			header->WeldEpsilon != options.WeldEpsilon ||
+			(options.BuildClusters && header->MaxClusterVertices != options.MaxClusterVertices) ||
+			(options.BuildClusters && header->MaxClusterTriangles != options.MaxClusterTriangles) ||
+			header->SourceSize != sourceSize ||
+			header->SourceHash != sourceHash)
+			return nullptr;
+
+		// Make sure a truncated file can't send us past the mapping
+		uint64_t vertexBytes = (uint64_t)header->VertexCount * sizeof(Vertex);
+		uint64_t indexBytes = (uint64_t)header->IndexCount * sizeof(unsigned int);
+		uint64_t lodBytes = (uint64_t)header->LodCount * sizeof(MeshSimplifier::LodRange);
+		uint64_t clusterBytes = (uint64_t)header->ClusterCount * sizeof(MeshClusters::Cluster);
+		uint64_t submeshLodBytes = (uint64_t)header->SubmeshCount * header->LodCount * sizeof(MeshSimplifier::LodRange);
+		if (header->VertexOffset < sizeof(Header) ||
+			header->VertexOffset + vertexBytes > length ||
+			header->IndexOffset < header->VertexOffset + vertexBytes ||
+			header->IndexOffset + indexBytes > length ||
+			header->LodCount == 0 ||
+			header->LodOffset < header->IndexOffset + indexBytes ||
+			header->LodOffset + lodBytes > length ||
+			header->ClusterOffset < header->LodOffset + lodBytes ||
+			header->ClusterOffset + clusterBytes > length ||
+			header->SubmeshCount == 0 ||
+			header->SubmeshLodOffset < header->ClusterOffset + clusterBytes ||
+			header->SubmeshLodOffset + submeshLodBytes > length ||
+			header->StringOffset < header->SubmeshLodOffset + submeshLodBytes ||
+			header->StringOffset + header->StringSize > length)
+			return nullptr;
+
+		// Every LOD has to stay within the index buffer
+		const MeshSimplifier::LodRange* lods = GetLods(header);
+		for (uint32_t i = 0; i < header->LodCount; i++)
+		{
+			if ((uint64_t)lods[i].IndexStart + lods[i].IndexCount > header->IndexCount)
+				return nullptr;
+		}
+
+		// And every index within the vertices, or a damaged cache
+		// would have the GPU read past the mesh's vertex range
+		const unsigned int* indices = GetIndices(header);
+		for (uint32_t i = 0; i < header->IndexCount; i++)
+		{
+			if (indices[i] >= header->VertexCount)
+				return nullptr;
+		}
+
+		// And every cluster within the full detail LOD
+		const MeshClusters::Cluster* clusters = GetClusters(header);
+		for (uint32_t i = 0; i < header->ClusterCount; i++)
+		{
+			if (clusters[i].IndexStart < lods[0].IndexStart ||
+				(uint64_t)clusters[i].IndexStart + clusters[i].IndexCount > (uint64_t)lods[0].IndexStart + lods[0].IndexCount)
+				return nullptr;
+		}
+
+		// Submeshes have to tile each LOD in order, since whole
+		// LODs are also drawn as one range
+		const MeshSimplifier::LodRange* submeshLods = GetSubmeshLods(header);
+		for (uint32_t lod = 0; lod < header->LodCount; lod++)
+		{
+			uint64_t next = lods[lod].IndexStart;
+			for (uint32_t s = 0; s < header->SubmeshCount; s++)
+			{
+				const MeshSimplifier::LodRange& range = submeshLods[s * header->LodCount + lod];
+				if (range.IndexStart != next)
+					return nullptr;
+				next += range.IndexCount;
+			}
+			if (next != (uint64_t)lods[lod].IndexStart + lods[lod].IndexCount)
+				return nullptr;
+		}
+
+		// Every string has to be terminated inside the table
+		const char* strings = (const char*)header + header->StringOffset;
+		uint64_t terminators = 0;
+		for (uint32_t i = 0; i < header->StringSize; i++)
+			terminators += (strings[i] == '\0');
+		if (terminators != (uint64_t)header->LibraryCount + header->SubmeshCount ||
+			(header->StringSize > 0 && strings[header->StringSize - 1] != '\0'))
+			return nullptr;
+
+		return header;
+	}
+
+	const Vertex* GetVertices(const Header* header)
+	{
+		return (const Vertex*)((const char*)header + header->VertexOffset);
+	}
+
+	const unsigned int* GetIndices(const Header* header)
+	{
+		return (const unsigned int*)((const char*)header + header->IndexOffset);
+	}
+
+	const MeshSimplifier::LodRange* GetLods(const Header* header)
+	{
+		return (const MeshSimplifier::LodRange*)((const char*)header + header->LodOffset);
+	}
+
+	const MeshClusters::Cluster* GetClusters(const Header* header)
+	{
+		return (const MeshClusters::Cluster*)((const char*)header + header->ClusterOffset);
+	}
+
+	const MeshSimplifier::LodRange* GetSubmeshLods(const Header* header)
+	{
+		return (const MeshSimplifier::LodRange*)((const char*)header + header->SubmeshLodOffset);
+	}
+
+	void GetSubmeshes(const Header* header, std::vector<ObjLoader::Submesh>& submeshes, std::vector<std::string>& materialLibraries)
+	{
+		const MeshSimplifier::LodRange* submeshLods = GetSubmeshLods(header);
+		const char* strings = (const char*)header + header->StringOffset;
+
+		materialLibraries.clear();
+		for (uint32_t i = 0; i < header->LibraryCount; i++)
+		{
+			materialLibraries.push_back(strings);
+			strings += materialLibraries.back().size() + 1;
+		}
+
+		submeshes.resize(header->SubmeshCount);
+		for (uint32_t s = 0; s < header->SubmeshCount; s++)
+		{
+			submeshes[s].Material = strings;
+			strings += submeshes[s].Material.size() + 1;
+			submeshes[s].Lods.assign(submeshLods + s * header->LodCount, submeshLods + (s + 1) * header->LodCount);
+		}
+	}
+
+	bool Write(const char* cacheFile, uint64_t sourceSize, uint64_t sourceHash, const ObjLoader::LoadOptions& options, const ObjLoader::MeshData& mesh)
+	{
+		Header header = {};
+		header.Magic = Magic;
+		header.Version = Version;
+		header.VertexStride = sizeof(Vertex);
+		header.Flags = GetFlags(options);
+		header.WeldEpsilon = options.WeldEpsilon;
+		header.VertexCount = (uint32_t)mesh.Vertices.size();
+		header.IndexCount = (uint32_t)mesh.Indices.size();
+		header.LodCount = (uint32_t)mesh.Lods.size();
+		header.ClusterCount = (uint32_t)mesh.Clusters.size();
+		header.MaxClusterVertices = options.BuildClusters ? options.MaxClusterVertices : 0;
+		header.MaxClusterTriangles = options.BuildClusters ? options.MaxClusterTriangles : 0;
+		header.SourceVertexCount = mesh.SourceVertexCount;
+		header.SourceSize = sourceSize;
+		header.SourceHash = sourceHash;
+		header.BoundsMin = mesh.BoundsMin;
+		header.BoundsMax = mesh.BoundsMax;
+		header.CacheStats = mesh.CacheStats;
+		header.VertexOffset = AlignUp(sizeof(Header));
+		header.IndexOffset = AlignUp(header.VertexOffset + mesh.Vertices.size() * sizeof(Vertex));
+		header.LodOffset = AlignUp(header.IndexOffset + mesh.Indices.size() * sizeof(unsigned int));
+		header.ClusterOffset = AlignUp(header.LodOffset + mesh.Lods.size() * sizeof(MeshSimplifier::LodRange));
+
+		// Submesh ranges are stored submesh by submesh, and their names
+		// follow the library paths in one table of C strings
+		std::vector<MeshSimplifier::LodRange> submeshLods;
+		std::string strings;
+		for (const std::string& library : mesh.MaterialLibraries)
+			strings.append(library.c_str(), library.size() + 1);
+		for (const ObjLoader::Submesh& submesh : mesh.Submeshes)
+		{
+			submeshLods.insert(submeshLods.end(), submesh.Lods.begin(), submesh.Lods.end());
+			strings.append(submesh.Material.c_str(), submesh.Material.size() + 1);
+		}
+		header.SubmeshCount = (uint32_t)mesh.Submeshes.size();
+		header.LibraryCount = (uint32_t)mesh.MaterialLibraries.size();
+		header.StringSize = (uint32_t)strings.size();
+		header.SubmeshLodOffset = AlignUp(header.ClusterOffset + mesh.Clusters.size() * sizeof(MeshClusters::Cluster));
+		header.StringOffset = header.SubmeshLodOffset + submeshLods.size() * sizeof(MeshSimplifier::LodRange);
+
+		// Write to a temporary file first, so a crash (or another
+		// instance loading the same mesh) never sees half a file
+		std::string tempFile = std::string(cacheFile) + ".tmp";
+		{
+			std::ofstream out(tempFile, std::ios::binary | std::ios::trunc);
+			if (!out.is_open())
+				return false;
+
+			const char padding[dataAlignment] = {};
+			out.write((const char*)&header, sizeof(Header));
+			out.write(padding, header.VertexOffset - sizeof(Header));
+			out.write((const char*)mesh.Vertices.data(), mesh.Vertices.size() * sizeof(Vertex));
+			out.write(padding, header.IndexOffset - header.VertexOffset - mesh.Vertices.size() * sizeof(Vertex));
+			out.write((const char*)mesh.Indices.data(), mesh.Indices.size() * sizeof(unsigned int));
+			out.write(padding, header.LodOffset - header.IndexOffset - mesh.Indices.size() * sizeof(unsigned int));
+			out.write((const char*)mesh.Lods.data(), mesh.Lods.size() * sizeof(MeshSimplifier::LodRange));
+			out.write(padding, header.ClusterOffset - header.LodOffset - mesh.Lods.size() * sizeof(MeshSimplifier::LodRange));
+			out.write((const char*)mesh.Clusters.data(), mesh.Clusters.size() * sizeof(MeshClusters::Cluster));
+			out.write(padding, header.SubmeshLodOffset - header.ClusterOffset - mesh.Clusters.size() * sizeof(MeshClusters::Cluster));
+			out.write((const char*)submeshLods.data(), submeshLods.size() * sizeof(MeshSimplifier::LodRange));
+			out.write(strings.data(), strings.size());
+			if (!out.good())
+			{
+				out.close();
+				remove(tempFile.c_str());
+				return false;
+			}
+		}
+
+		// rename() won't replace an existing file on Windows
+		remove(cacheFile);
+		if (rename(tempFile.c_str(), cacheFile) != 0)
+		{
+			remove(tempFile.c_str());
+			return false;
+		}
+		return true;
+	}
+}
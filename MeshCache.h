@@ -0,0 +1,84 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <DirectXMath.h>
+#include "Vertex.h"
+#include "ObjLoader.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshClusters.h"
+
+// --------------------------------------------------------
+// Binary cache of fully processed meshes (.meshbin files)
+//
+// - Holds the final vertex array (tangents included), the
+//   indices of every LOD, the LOD, submesh and cluster tables
+//   and the bounds, laid out so a memory-mapped file can be
+//   handed straight to Mesh::CreateBuffers()
+// - Each file records the size and hash of the source file
+//   and the load options it was built with, and is ignored
+//   if any of those no longer match
+// --------------------------------------------------------
+namespace MeshCache
+{
+	const uint32_t Magic = 0x4248534D; // "MSHB"
+	const uint32_t Version = 6;
+
+	struct Header
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t VertexStride;		// sizeof(Vertex) when the file was written
+		uint32_t Flags;				// Load options that change the output
+		float WeldEpsilon;
+		uint32_t VertexCount;
+		uint32_t IndexCount;		// All LODs together
+		uint32_t LodCount;
+		uint32_t ClusterCount;
+		uint32_t SubmeshCount;
+		uint32_t LibraryCount;		// Material libraries named by the source file
+		uint32_t StringSize;		// Bytes in the string table
+		uint32_t MaxClusterVertices;	// Cluster limits the file was built with
+		uint32_t MaxClusterTriangles;
+		uint32_t SourceVertexCount;
+		uint64_t SourceSize;
+		uint64_t SourceHash;
+		DirectX::XMFLOAT3 BoundsMin;
+		DirectX::XMFLOAT3 BoundsMax;
+		MeshOptimizer::Stats CacheStats;
+		uint64_t VertexOffset;		// Byte offsets from the start of the file
+		uint64_t IndexOffset;
+		uint64_t LodOffset;
+		uint64_t ClusterOffset;
+		uint64_t SubmeshLodOffset;	// LodCount ranges for each submesh in turn
+		uint64_t StringOffset;		// Library paths, then submesh material names (each NUL terminated)
+	};
+
+	// Path of the cache file that sits next to a source file
+	// (e.g. "Assets/cube.obj" -> "Assets/cube.meshbin")
+	std::string GetCachePath(const char* sourceFile);
+
+	// Fast 64-bit hash of the source file's contents
+	uint64_t HashBytes(const char* data, size_t length);
+
+	// Returns the header if the mapped cache file is complete (every
+	// offset, range and index in bounds) and was built from this
+	// exact source with these options, or null if it should be rebuilt
+	const Header* Validate(const char* data, size_t length, uint64_t sourceSize, uint64_t sourceHash, const ObjLoader::LoadOptions& options);
+
+	// Pointers into a validated cache file
+	const Vertex* GetVertices(const Header* header);
+	const unsigned int* GetIndices(const Header* header);
+	const MeshSimplifier::LodRange* GetLods(const Header* header);
+	const MeshClusters::Cluster* GetClusters(const Header* header);
+	const MeshSimplifier::LodRange* GetSubmeshLods(const Header* header);
+
+	// Copies the submesh table and material library names out of a
+	// validated cache file
+	void GetSubmeshes(const Header* header, std::vector<ObjLoader::Submesh>& submeshes, std::vector<std::string>& materialLibraries);
+
+	// Writes (or replaces) a cache file, returning false on failure
+	bool Write(const char* cacheFile, uint64_t sourceSize, uint64_t sourceHash, const ObjLoader::LoadOptions& options, const ObjLoader::MeshData& mesh);
+}
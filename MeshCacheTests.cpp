@@ -0,0 +1,62 @@
+#include "Tests.h"
+#include "MeshCache.h"
+#include "MappedFile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	const char* cacheFile = "MeshCacheTests.meshbin";
+
+	const char* quad =
+		"v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+		"vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+		"vn 0 0 1\n"
+		"f 1/1/1 2/2/1 3/3/1 4/4/1\n";
+
+	// The whole cache file, so it can be damaged in memory
+	std::vector<char> ReadCache()
+	{
+		MappedFile file(cacheFile);
+		if (!file.IsOpen())
+			return {};
+		return std::vector<char>(file.GetData(), file.GetData() + file.GetSize());
+	}
+}
+
+TEST(MeshCacheRejectsOutOfRangeIndices)
+{
+	ObjLoader::LoadOptions options;
+	options.BuildBvh = false;
+	ObjLoader::MeshData mesh = ObjLoader::Parse(quad, strlen(quad), options);
+	uint64_t hash = MeshCache::HashBytes(quad, strlen(quad));
+	CHECK(MeshCache::Write(cacheFile, strlen(quad), hash, options, mesh));
+
+	std::vector<char> cache = ReadCache();
+	std::remove(cacheFile);
+	CHECK(!cache.empty());
+	if (cache.empty())
+		return;
+
+	const MeshCache::Header* header = MeshCache::Validate(cache.data(), cache.size(), strlen(quad), hash, options);
+	CHECK(header != nullptr);
+	if (!header)
+		return;
+	CHECK(header->VertexCount == mesh.Vertices.size());
+
+	// The last index, then the first, pointing one past the vertices
+	unsigned int* indices = (unsigned int*)(cache.data() + header->IndexOffset);
+	unsigned int vertexCount = header->VertexCount;
+	unsigned int indexCount = header->IndexCount;
+
+	indices[indexCount - 1] = vertexCount;
+	CHECK(MeshCache::Validate(cache.data(), cache.size(), strlen(quad), hash, options) == nullptr);
+
+	indices[indexCount - 1] = vertexCount - 1;
+	CHECK(MeshCache::Validate(cache.data(), cache.size(), strlen(quad), hash, options) != nullptr);
+
+	indices[0] = 0xFFFFFFFF;
+	CHECK(MeshCache::Validate(cache.data(), cache.size(), strlen(quad), hash, options) == nullptr);
+}
@@ -0,0 +1,134 @@
+#include "MeshChunks.h"
+
+namespace MeshChunks
+{
+	std::string GetChunkPath(const char* sourceFile)
+	{
+		std::string path = sourceFile;
+		size_t dot = path.find_last_of('.');
+		size_t slash = path.find_last_of("/\\");
+		if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+			path.erase(dot);
+		return path + ".meshchunks";
+	}
+
+	const Header* Validate(const char* data, size_t length)
+	{
+		if (!data || length < sizeof(Header))
+			return nullptr;
+
+		const Header* header = (const Header*)data;
+		if (header->Magic != Magic ||
+			header->Version != Version ||
+			header->VertexStride != sizeof(Vertex))
+			return nullptr;
+
+		// Make sure a truncated file can't send us past the mapping
+		uint64_t chunkBytes = (uint64_t)header->ChunkCount * sizeof(Chunk);
+		uint64_t submeshBytes = (uint64_t)header->SubmeshCount * sizeof(Submesh);
+		if (header->ChunkOffset < sizeof(Header) ||
+			header->ChunkOffset + chunkBytes > length ||
+			header->SubmeshOffset < header->ChunkOffset + chunkBytes ||
+			header->SubmeshOffset + submeshBytes > length ||
+			header->StringOffset < header->SubmeshOffset + submeshBytes ||
+			header->StringOffset + header->StringSize > length)
+			return nullptr;
+
+		// Every chunk's arrays have to sit before the tables, and its
+		// submeshes have to tile its indices with known materials
+		const Chunk* chunks = GetChunks(header);
+		const Submesh* submeshes = GetSubmeshes(header);
+		uint64_t vertexCount = 0;
+		uint64_t indexCount = 0;
+		for (uint32_t c = 0; c < header->ChunkCount; c++)
+		{
+			const Chunk& chunk = chunks[c];
+			if (chunk.VertexOffset < sizeof(Header) ||
+				chunk.VertexOffset + (uint64_t)chunk.VertexCount * sizeof(Vertex) > header->ChunkOffset ||
+				chunk.IndexOffset < sizeof(Header) ||
+				chunk.IndexOffset + (uint64_t)chunk.IndexCount * sizeof(unsigned int) > header->ChunkOffset ||
+				(uint64_t)chunk.SubmeshStart + chunk.SubmeshCount > header->SubmeshCount)
+				return nullptr;
+
+			uint64_t next = 0;
+			for (uint32_t s = chunk.SubmeshStart; s < chunk.SubmeshStart + chunk.SubmeshCount; s++)
+			{
+				if (submeshes[s].IndexStart != next || submeshes[s].Material >= header->MaterialCount)
+					return nullptr;
+				next += submeshes[s].IndexCount;
+			}
+			if (next != chunk.IndexCount)
+				return nullptr;
+
+			vertexCount += chunk.VertexCount;
+			indexCount += chunk.IndexCount;
+		}
+		if (vertexCount != header->VertexCount || indexCount != header->IndexCount)
+			return nullptr;
+
+		// Every string has to be terminated inside the table
+		const char* strings = (const char*)header + header->StringOffset;
+		uint64_t terminators = 0;
+		for (uint32_t i = 0; i < header->StringSize; i++)
+			terminators += (strings[i] == '\0');
+		if (terminators != (uint64_t)header->LibraryCount + header->MaterialCount ||
+			(header->StringSize > 0 && strings[header->StringSize - 1] != '\0'))
+			return nullptr;
+
+		return header;
+	}
+
+	bool ValidateChunk(const Header* header, uint32_t chunk)
+	{
+		if (chunk >= header->ChunkCount)
+			return false;
+
+		const Chunk& c = GetChunks(header)[chunk];
+		const unsigned int* indices = GetIndices(header, c);
+		for (uint32_t i = 0; i < c.IndexCount; i++)
+		{
+			if (indices[i] >= c.VertexCount)
+				return false;
+		}
+		return true;
+	}
+
+	const Chunk* GetChunks(const Header* header)
+	{
+		return (const Chunk*)((const char*)header + header->ChunkOffset);
+	}
+
+	const Submesh* GetSubmeshes(const Header* header)
+	{
+		return (const Submesh*)((const char*)header + header->SubmeshOffset);
+	}
+
+	const Vertex* GetVertices(const Header* header, const Chunk& chunk)
+	{
+		return (const Vertex*)((const char*)header + chunk.VertexOffset);
+	}
+
+	const unsigned int* GetIndices(const Header* header, const Chunk& chunk)
+	{
+		return (const unsigned int*)((const char*)header + chunk.IndexOffset);
+	}
+
+	void GetStrings(const Header* header, std::vector<std::string>& materialLibraries, std::vector<std::string>& materials)
+	{
+		const char* strings = (const char*)header + header->StringOffset;
+
+		materialLibraries.clear();
+		for (uint32_t i = 0; i < header->LibraryCount; i++)
+		{
+			materialLibraries.push_back(strings);
+			strings += materialLibraries.back().size() + 1;
+		}
+
+		materials.clear();
+		for (uint32_t i = 0; i < header->MaterialCount; i++)
+		{
+			materials.push_back(strings);
+			strings += materials.back().size() + 1;
+		}
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <DirectXMath.h>
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Spatially chunked meshes (.meshchunks files), written by
+// the offline MeshConverter for models too big to load as
+// one OBJ
+//
+// - Each chunk is a self-contained little mesh (its own
+//   vertices, 32-bit indices, bounds and per-material
+//   submeshes), so the runtime can map the file and upload
+//   only the chunks it wants, one at a time
+// - Chunks hold triangles that are close together in space,
+//   so their bounds are tight enough to cull
+// - Vertex and index arrays are 16-byte aligned in the file,
+//   and the tables (chunks, submeshes, strings) sit after
+//   all of them, so the file can be written front to back
+// --------------------------------------------------------
+namespace MeshChunks
+{
+	const uint32_t Magic = 0x4B48434D; // "MCHK"
+	const uint32_t Version = 1;
+
+	struct Header
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t VertexStride;		// sizeof(Vertex) when the file was written
+		uint32_t ChunkCount;
+		uint32_t SubmeshCount;		// All chunks together
+		uint32_t MaterialCount;
+		uint32_t LibraryCount;		// Material libraries named by the source file
+		uint32_t StringSize;		// Bytes in the string table
+		uint64_t VertexCount;		// All chunks together
+		uint64_t IndexCount;
+		DirectX::XMFLOAT3 BoundsMin;
+		DirectX::XMFLOAT3 BoundsMax;
+		uint64_t ChunkOffset;		// Byte offsets from the start of the file
+		uint64_t SubmeshOffset;
+		uint64_t StringOffset;		// Library paths, then material names (each NUL terminated)
+	};
+
+	struct Chunk
+	{
+		DirectX::XMFLOAT3 BoundsMin;
+		DirectX::XMFLOAT3 BoundsMax;
+		uint32_t VertexCount;
+		uint32_t IndexCount;
+		uint32_t SubmeshStart;		// The chunk's submeshes, in the submesh table
+		uint32_t SubmeshCount;
+		uint64_t VertexOffset;
+		uint64_t IndexOffset;
+	};
+
+	// Triangles of one chunk that share a material (a chunk's
+	// submeshes tile its indices in order)
+	struct Submesh
+	{
+		uint32_t Material;			// Index into the material names
+		uint32_t IndexStart;		// Within the chunk's indices
+		uint32_t IndexCount;
+	};
+
+	// Path of the chunk file that sits next to a source file
+	// (e.g. "Assets/city.obj" -> "Assets/city.meshchunks")
+	std::string GetChunkPath(const char* sourceFile);
+
+	// Returns the header if the mapped file's tables are complete and
+	// consistent, or null if it can't be used
+	// - Only the tables are checked, so this stays cheap for huge files;
+	//   ValidateChunk() checks a chunk's indices before it's used
+	const Header* Validate(const char* data, size_t length);
+	bool ValidateChunk(const Header* header, uint32_t chunk);
+
+	// Pointers into a validated file
+	const Chunk* GetChunks(const Header* header);
+	const Submesh* GetSubmeshes(const Header* header);
+	const Vertex* GetVertices(const Header* header, const Chunk& chunk);
+	const unsigned int* GetIndices(const Header* header, const Chunk& chunk);
+
+	// Copies the material library paths (as written in the source
+	// file) and material names out of a validated file
+	void GetStrings(const Header* header, std::vector<std::string>& materialLibraries, std::vector<std::string>& materials);
+}
@@ -0,0 +1,315 @@
+#include "MeshClusters.h"
+#include "MeshOptimizer.h"
+
+#include <cmath>
+#include <climits>
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	// Normals can spread up to ~84 degrees from the cone's axis
+	// before backface culling the cluster isn't worth trying
+	const float minConeDot = 0.1f;
+
+	// --------------------------------------------------------
+	// Fills in the bounding sphere and normal cone of a cluster,
+	// given the first of its IndexCount indices
+	// --------------------------------------------------------
+	void CalculateBounds(MeshClusters::Cluster& cluster, const Vertex* vertices, const unsigned int* clusterIndices)
+	{
+		const unsigned int* first = clusterIndices;
+		const unsigned int* last = first + cluster.IndexCount;
+
+		// Sphere around the center of the cluster's bounding box
+		XMVECTOR boundsMin = XMLoadFloat3(&vertices[*first].Position);
+		XMVECTOR boundsMax = boundsMin;
+		for (const unsigned int* i = first; i < last; i++)
+		{
+			XMVECTOR p = XMLoadFloat3(&vertices[*i].Position);
+			boundsMin = XMVectorMin(boundsMin, p);
+			boundsMax = XMVectorMax(boundsMax, p);
+		}
+		XMVECTOR center = XMVectorScale(XMVectorAdd(boundsMin, boundsMax), 0.5f);
+		XMVECTOR radius = XMVectorZero();
+		for (const unsigned int* i = first; i < last; i++)
+			radius = XMVectorMax(radius, XMVector3Length(XMVectorSubtract(XMLoadFloat3(&vertices[*i].Position), center)));
+		XMStoreFloat3(&cluster.Center, center);
+		cluster.Radius = XMVectorGetX(radius);
+
+		// Front faces are clockwise in left-handed space, so the
+		// cross product of the first two edges points out of them
+		std::vector<XMFLOAT3> normals;
+		std::vector<XMFLOAT3> corners;
+		XMVECTOR normalSum = XMVectorZero();
+		for (const unsigned int* i = first; i + 2 < last; i += 3)
+		{
+			XMVECTOR p0 = XMLoadFloat3(&vertices[i[0]].Position);
+			XMVECTOR p1 = XMLoadFloat3(&vertices[i[1]].Position);
+			XMVECTOR p2 = XMLoadFloat3(&vertices[i[2]].Position);
+			XMVECTOR normal = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+			if (XMVectorGetX(XMVector3LengthSq(normal)) == 0.0f)
+				continue;
+
+			normal = XMVector3Normalize(normal);
+			normalSum = XMVectorAdd(normalSum, normal);
+			normals.emplace_back();
+			corners.emplace_back();
+			XMStoreFloat3(&normals.back(), normal);
+			XMStoreFloat3(&corners.back(), p0);
+		}
+
+		cluster.ConeApex = cluster.Center;
+		cluster.ConeAxis = XMFLOAT3(0, 0, 0);
+		cluster.ConeCutoff = 2.0f;
+		if (normals.empty() || XMVectorGetX(XMVector3LengthSq(normalSum)) == 0.0f)
+			return;
+
+		// The widest angle between the average normal and any other
+		XMVECTOR axis = XMVector3Normalize(normalSum);
+		float minDot = 1.0f;
+		for (const XMFLOAT3& n : normals)
+			minDot = fminf(minDot, XMVectorGetX(XMVector3Dot(axis, XMLoadFloat3(&n))));
+		XMStoreFloat3(&cluster.ConeAxis, axis);
+		if (minDot <= minConeDot)
+			return;
+
+		// Slide the apex back along the axis until it's behind every
+		// triangle's plane, so the test holds for nearby cameras too
+		float maxT = 0.0f;
+		for (size_t i = 0; i < normals.size(); i++)
+		{
+			XMVECTOR n = XMLoadFloat3(&normals[i]);
+			float distance = XMVectorGetX(XMVector3Dot(XMVectorSubtract(center, XMLoadFloat3(&corners[i])), n));
+			float t = distance / XMVectorGetX(XMVector3Dot(axis, n));
+			maxT = fmaxf(maxT, t);
+		}
+		XMStoreFloat3(&cluster.ConeApex, XMVectorSubtract(center, XMVectorScale(axis, maxT)));
+
+		// Sine of the spread, since the test is against the cone's complement
+		cluster.ConeCutoff = sqrtf(1.0f - minDot * minDot);
+	}
+}
+
+namespace MeshClusters
+{
+	// --------------------------------------------------------
+	// Grows one cluster at a time from the first triangle not
+	// yet used, always adding the neighboring triangle that
+	// brings in the fewest new vertices (and, between equals,
+	// the one facing closest to the cluster's average normal)
+	// - Neighbors are found through shared positions, so
+	//   clusters grow across UV and normal seams
+	// - Once a cluster runs out of neighbors, the next unused
+	//   triangle in the original order is taken instead, which
+	//   keeps small separate pieces from making tiny clusters
+	// --------------------------------------------------------
+	std::vector<Cluster> Build(
+		const Vertex* vertices,
+		size_t vertexCount,
+		unsigned int* indices,
+		unsigned int indexStart,
+		unsigned int indexCount,
+		unsigned int maxVertices,
+		unsigned int maxTriangles)
+	{
+		std::vector<Cluster> clusters;
+		unsigned int triangleCount = indexCount / 3;
+		if (maxVertices < 3 || maxTriangles < 1 || triangleCount == 0)
+			return clusters;
+
+		const unsigned int* source = indices + indexStart;
+
+		// Triangles around each position, packed into one array
+		std::vector<unsigned int> groups = MeshOptimizer::BuildPositionGroups(vertices, vertexCount);
+		std::vector<unsigned int> adjacencyStart(vertexCount + 1, 0);
+		for (unsigned int i = 0; i < triangleCount * 3; i++)
+			adjacencyStart[groups[source[i]] + 1]++;
+		for (size_t v = 0; v < vertexCount; v++)
+			adjacencyStart[v + 1] += adjacencyStart[v];
+		std::vector<unsigned int> adjacency(triangleCount * 3);
+		{
+			std::vector<unsigned int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+			for (unsigned int i = 0; i < triangleCount * 3; i++)
+				adjacency[fill[groups[source[i]]]++] = i / 3;
+		}
+
+		std::vector<XMFLOAT3> faceNormals(triangleCount);
+		for (unsigned int t = 0; t < triangleCount; t++)
+		{
+			XMVECTOR p0 = XMLoadFloat3(&vertices[source[t * 3]].Position);
+			XMVECTOR p1 = XMLoadFloat3(&vertices[source[t * 3 + 1]].Position);
+			XMVECTOR p2 = XMLoadFloat3(&vertices[source[t * 3 + 2]].Position);
+			XMStoreFloat3(&faceNormals[t], XMVector3Normalize(XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0))));
+		}
+
+		// Which cluster last used each vertex (plus one, so zero
+		// means none yet), so counting new vertices is O(1), and
+		// the same for positions visited and triangles queued
+		std::vector<unsigned int> lastCluster(vertexCount, 0);
+		std::vector<unsigned int> lastVisited(vertexCount, 0);
+		std::vector<unsigned int> lastCandidate(triangleCount, 0);
+		std::vector<bool> used(triangleCount, false);
+		std::vector<unsigned int> ordered;
+		ordered.reserve(triangleCount * 3);
+		std::vector<unsigned int> candidates;
+		std::vector<unsigned int> localIndices;
+		std::vector<unsigned int> localToVertex;
+		std::vector<unsigned int> localVertex(vertexCount, UINT_MAX);
+
+		unsigned int nextSeed = 0;
+		while (ordered.size() < triangleCount * 3)
+		{
+			while (used[nextSeed])
+				nextSeed++;
+
+			Cluster cluster = {};
+			cluster.IndexStart = indexStart + (unsigned int)ordered.size();
+			unsigned int stamp = (unsigned int)clusters.size() + 1;
+			XMVECTOR normalSum = XMVectorZero();
+			candidates.clear();
+
+			unsigned int triangle = nextSeed;
+			while (true)
+			{
+				// Add the triangle, and its neighbors as candidates
+				used[triangle] = true;
+				normalSum = XMVectorAdd(normalSum, XMLoadFloat3(&faceNormals[triangle]));
+				for (int corner = 0; corner < 3; corner++)
+				{
+					unsigned int v = source[triangle * 3 + corner];
+					ordered.push_back(v);
+					if (lastCluster[v] == stamp)
+						continue;
+
+					lastCluster[v] = stamp;
+					cluster.VertexCount++;
+
+					// Each position's neighbors only need adding once
+					unsigned int group = groups[v];
+					if (lastVisited[group] == stamp)
+						continue;
+					lastVisited[group] = stamp;
+					for (unsigned int a = adjacencyStart[group]; a < adjacencyStart[group + 1]; a++)
+					{
+						unsigned int t = adjacency[a];
+						if (!used[t] && lastCandidate[t] != stamp)
+						{
+							lastCandidate[t] = stamp;
+							candidates.push_back(t);
+						}
+					}
+				}
+				cluster.IndexCount += 3;
+				if (cluster.IndexCount / 3 >= maxTriangles)
+					break;
+
+				// Pick the best neighbor that still fits
+				XMVECTOR averageNormal = XMVector3Normalize(normalSum);
+				unsigned int best = UINT_MAX;
+				float bestScore = 0.0f;
+				size_t kept = 0;
+				for (size_t c = 0; c < candidates.size(); c++)
+				{
+					unsigned int t = candidates[c];
+					if (used[t])
+						continue;
+					candidates[kept++] = t;
+
+					unsigned int newVertices =
+						(lastCluster[source[t * 3]] != stamp) +
+						(lastCluster[source[t * 3 + 1]] != stamp) +
+						(lastCluster[source[t * 3 + 2]] != stamp);
+					if (cluster.VertexCount + newVertices > maxVertices)
+						continue;
+
+					float facing = XMVectorGetX(XMVector3Dot(averageNormal, XMLoadFloat3(&faceNormals[t])));
+					float score = newVertices + (1.0f - facing);
+					if (best == UINT_MAX || score < bestScore || (score == bestScore && t < best))
+					{
+						best = t;
+						bestScore = score;
+					}
+				}
+				candidates.resize(kept);
+
+				// Fall back to the next unused triangle once the cluster
+				// has no neighbors left (but not when they just don't fit)
+				if (best == UINT_MAX)
+				{
+					if (!candidates.empty())
+						break;
+					while (nextSeed < triangleCount && used[nextSeed])
+						nextSeed++;
+					if (nextSeed == triangleCount || cluster.VertexCount + 3 > maxVertices)
+						break;
+					best = nextSeed;
+				}
+				triangle = best;
+			}
+
+			// Growing the cluster loses the vertex cache order, so put it
+			// back within the cluster (using local vertex numbers, so the
+			// optimizer's per-vertex arrays stay small)
+			unsigned int* clusterIndices = ordered.data() + (cluster.IndexStart - indexStart);
+			localIndices.assign(cluster.IndexCount, 0);
+			localToVertex.clear();
+			for (unsigned int i = 0; i < cluster.IndexCount; i++)
+			{
+				unsigned int v = clusterIndices[i];
+				if (localVertex[v] == UINT_MAX)
+				{
+					localVertex[v] = (unsigned int)localToVertex.size();
+					localToVertex.push_back(v);
+				}
+				localIndices[i] = localVertex[v];
+			}
+			MeshOptimizer::OptimizeVertexCache(localIndices, localToVertex.size());
+			for (unsigned int i = 0; i < cluster.IndexCount; i++)
+				clusterIndices[i] = localToVertex[localIndices[i]];
+			for (unsigned int v : localToVertex)
+				localVertex[v] = UINT_MAX;
+
+			CalculateBounds(cluster, vertices, clusterIndices);
+			clusters.push_back(cluster);
+		}
+
+		// Clusters are contiguous in the reordered triangles
+		std::copy(ordered.begin(), ordered.end(), indices + indexStart);
+		return clusters;
+	}
+
+	bool IsBackFacing(const Cluster& cluster, XMFLOAT3 cameraPosition)
+	{
+		// The camera has to sit in the cone behind the apex, which is
+		// the cone test against the direction from camera to apex
+		XMVECTOR toApex = XMVectorSubtract(XMLoadFloat3(&cluster.ConeApex), XMLoadFloat3(&cameraPosition));
+		XMVECTOR axis = XMLoadFloat3(&cluster.ConeAxis);
+		float dot = XMVectorGetX(XMVector3Dot(toApex, axis));
+		return dot >= cluster.ConeCutoff * XMVectorGetX(XMVector3Length(toApex));
+	}
+
+	unsigned int Cull(
+		const Cluster* clusters,
+		size_t clusterCount,
+		const unsigned int* indices,
+		const Frustum& frustum,
+		XMFLOAT3 cameraPosition,
+		std::vector<unsigned int>& visibleIndices)
+	{
+		unsigned int visibleCount = 0;
+		for (size_t i = 0; i < clusterCount; i++)
+		{
+			const Cluster& cluster = clusters[i];
+			if (cluster.ConeCutoff <= 1.0f && IsBackFacing(cluster, cameraPosition))
+				continue;
+			if (!frustum.IntersectsSphere(cluster.Center, cluster.Radius))
+				continue;
+
+			visibleIndices.insert(visibleIndices.end(), indices + cluster.IndexStart, indices + cluster.IndexStart + cluster.IndexCount);
+			visibleCount++;
+		}
+		return visibleCount;
+	}
+}
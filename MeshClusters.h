@@ -0,0 +1,70 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <DirectXMath.h>
+#include "Vertex.h"
+#include "Frustum.h"
+
+// --------------------------------------------------------
+// Splits a mesh into small clusters (meshlets) that can be
+// culled on the CPU before drawing
+//
+// - Clusters grow across shared edges up to a vertex and
+//   triangle limit, and their triangles are then moved next
+//   to each other so each one is a single index range
+// - Each cluster has a bounding sphere for frustum culling
+//   and a normal cone for rejecting clusters that face
+//   entirely away from the camera
+// - Has no dependency on Direct3D
+// --------------------------------------------------------
+namespace MeshClusters
+{
+	const unsigned int DefaultMaxVertices = 64;
+	const unsigned int DefaultMaxTriangles = 124;
+
+	struct Cluster
+	{
+		unsigned int IndexStart;
+		unsigned int IndexCount;
+		unsigned int VertexCount;		// Unique vertices used by the cluster
+
+		// Object space bounding sphere
+		DirectX::XMFLOAT3 Center;
+		float Radius;
+
+		// Every triangle faces away from cameras inside the cone
+		// behind the apex, which is where the cone test passes
+		// - A cutoff above 1 means the normals spread too far
+		//   for the cluster to ever be rejected this way
+		DirectX::XMFLOAT3 ConeApex;
+		float ConeCutoff;
+		DirectX::XMFLOAT3 ConeAxis;
+	};
+
+	// Clusters the triangles in [indexStart, indexStart + indexCount),
+	// reordering them so every cluster is contiguous
+	std::vector<Cluster> Build(
+		const Vertex* vertices,
+		size_t vertexCount,
+		unsigned int* indices,
+		unsigned int indexStart,
+		unsigned int indexCount,
+		unsigned int maxVertices = DefaultMaxVertices,
+		unsigned int maxTriangles = DefaultMaxTriangles);
+
+	// True if every triangle in the cluster is back facing
+	// from this (object space) camera position
+	bool IsBackFacing(const Cluster& cluster, DirectX::XMFLOAT3 cameraPosition);
+
+	// Appends the indices of every cluster that may be visible to
+	// visibleIndices and returns how many clusters that was
+	// - The frustum and camera position must be in the same
+	//   (object) space as the clusters
+	unsigned int Cull(
+		const Cluster* clusters,
+		size_t clusterCount,
+		const unsigned int* indices,
+		const Frustum& frustum,
+		DirectX::XMFLOAT3 cameraPosition,
+		std::vector<unsigned int>& visibleIndices);
+}
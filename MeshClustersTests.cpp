@@ -0,0 +1,287 @@
+#include "Tests.h"
+#include "MeshClusters.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	// --------------------------------------------------------
+	// A unit sphere of rings x segments, with a UV seam (the
+	// first and last column share positions) and single
+	// triangles at the poles, facing out (clockwise), or in
+	// (like a sky dome, where the apex has to move back)
+	// --------------------------------------------------------
+	void MakeSphere(int rings, int segments, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, bool inward = false)
+	{
+		for (int r = 0; r <= rings; r++)
+		{
+			float theta = XM_PI * r / rings;
+			for (int s = 0; s <= segments; s++)
+			{
+				float phi = XM_2PI * (s % segments) / segments;
+				Vertex v = {};
+				v.Position = XMFLOAT3(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+				v.UV = XMFLOAT2(s / (float)segments, r / (float)rings);
+				v.Normal = v.Position;
+				vertices.push_back(v);
+			}
+		}
+
+		auto add = [&](unsigned int a, unsigned int b, unsigned int c)
+		{
+			XMVECTOR p0 = XMLoadFloat3(&vertices[a].Position);
+			XMVECTOR p1 = XMLoadFloat3(&vertices[b].Position);
+			XMVECTOR p2 = XMLoadFloat3(&vertices[c].Position);
+			XMVECTOR normal = XMVector3Cross(p1 - p0, p2 - p0);
+			if ((XMVectorGetX(XMVector3Dot(normal, p0 + p1 + p2)) < 0.0f) != inward)
+				std::swap(b, c);
+			indices.insert(indices.end(), { a, b, c });
+		};
+		unsigned int row = segments + 1;
+		for (int r = 0; r < rings; r++)
+		{
+			for (int s = 0; s < segments; s++)
+			{
+				unsigned int a = r * row + s;
+				if (r != 0)
+					add(a, a + 1, a + row);
+				if (r != rings - 1)
+					add(a + 1, a + row + 1, a + row);
+			}
+		}
+	}
+
+	// The triangle with its lowest index first, keeping the winding
+	std::vector<unsigned int> SortedTriangles(const unsigned int* indices, size_t count)
+	{
+		std::vector<unsigned int> triangles(indices, indices + count);
+		for (size_t i = 0; i < count; i += 3)
+		{
+			while (triangles[i] > triangles[i + 1] || triangles[i] > triangles[i + 2])
+				std::rotate(&triangles[i], &triangles[i + 1], &triangles[i + 3]);
+		}
+		std::vector<unsigned int> order(count / 3);
+		for (size_t t = 0; t < order.size(); t++)
+			order[t] = (unsigned int)t;
+		std::sort(order.begin(), order.end(), [&](unsigned int x, unsigned int y)
+			{ return std::lexicographical_compare(&triangles[x * 3], &triangles[x * 3 + 3], &triangles[y * 3], &triangles[y * 3 + 3]); });
+		std::vector<unsigned int> sorted;
+		for (unsigned int t : order)
+			sorted.insert(sorted.end(), &triangles[t * 3], &triangles[t * 3 + 3]);
+		return sorted;
+	}
+
+	bool InsideFrustum(const Frustum& frustum, XMVECTOR point)
+	{
+		for (const XMFLOAT4& plane : frustum.Planes)
+		{
+			if (XMVectorGetX(XMPlaneDotCoord(XMLoadFloat4(&plane), point)) <= 1e-4f)
+				return false;
+		}
+		return true;
+	}
+}
+
+// Every cluster stays within the vertex and triangle limits, and its sphere holds it
+TEST(MeshClustersStayWithinLimits)
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeSphere(40, 60, vertices, indices);
+
+	std::vector<MeshClusters::Cluster> clusters =
+		MeshClusters::Build(vertices.data(), vertices.size(), indices.data(), 0, (unsigned int)indices.size());
+	CHECK(clusters.size() >= indices.size() / 3 / MeshClusters::DefaultMaxTriangles);
+
+	unsigned int tooBig = 0;
+	unsigned int miscounted = 0;
+	unsigned int outside = 0;
+	for (const MeshClusters::Cluster& cluster : clusters)
+	{
+		std::vector<unsigned int> used(indices.begin() + cluster.IndexStart, indices.begin() + cluster.IndexStart + cluster.IndexCount);
+		std::sort(used.begin(), used.end());
+		size_t unique = std::unique(used.begin(), used.end()) - used.begin();
+		tooBig += unique > MeshClusters::DefaultMaxVertices || cluster.IndexCount > MeshClusters::DefaultMaxTriangles * 3;
+		miscounted += unique != cluster.VertexCount || cluster.IndexCount == 0 || cluster.IndexCount % 3 != 0;
+		for (unsigned int v : used)
+		{
+			XMVECTOR offset = XMLoadFloat3(&vertices[v].Position) - XMLoadFloat3(&cluster.Center);
+			outside += XMVectorGetX(XMVector3Length(offset)) > cluster.Radius + 1e-5f;
+		}
+	}
+	CHECK(tooBig == 0);
+	CHECK(miscounted == 0);
+	CHECK(outside == 0);
+
+	// Smaller limits are kept too
+	std::vector<MeshClusters::Cluster> small =
+		MeshClusters::Build(vertices.data(), vertices.size(), indices.data(), 0, (unsigned int)indices.size(), 16, 20);
+	unsigned int tooBigSmall = 0;
+	for (const MeshClusters::Cluster& cluster : small)
+		tooBigSmall += cluster.VertexCount > 16 || cluster.IndexCount > 20 * 3;
+	CHECK(tooBigSmall == 0);
+	CHECK(small.size() > clusters.size());
+}
+
+// --------------------------------------------------------
+// The clusters of LOD0 cover its index range end to end,
+// hold the same triangles (windings kept) and leave the
+// indices either side of it (other LODs) alone
+// --------------------------------------------------------
+TEST(MeshClustersTileTheirRange)
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> lod0;
+	MakeSphere(30, 45, vertices, lod0);
+
+	std::vector<unsigned int> before = { 0, 1, 2, 2, 1, 3 };
+	std::vector<unsigned int> after(lod0.begin(), lod0.begin() + 300);
+	std::vector<unsigned int> indices = before;
+	indices.insert(indices.end(), lod0.begin(), lod0.end());
+	indices.insert(indices.end(), after.begin(), after.end());
+	unsigned int start = (unsigned int)before.size();
+
+	std::vector<MeshClusters::Cluster> clusters =
+		MeshClusters::Build(vertices.data(), vertices.size(), indices.data(), start, (unsigned int)lod0.size());
+	CHECK(!clusters.empty());
+
+	unsigned int next = start;
+	unsigned int gaps = 0;
+	for (const MeshClusters::Cluster& cluster : clusters)
+	{
+		gaps += cluster.IndexStart != next;
+		next = cluster.IndexStart + cluster.IndexCount;
+	}
+	CHECK(gaps == 0);
+	CHECK(next == start + lod0.size());
+
+	CHECK(std::equal(before.begin(), before.end(), indices.begin()));
+	CHECK(std::equal(after.begin(), after.end(), indices.begin() + start + lod0.size()));
+	CHECK(SortedTriangles(&indices[start], lod0.size()) == SortedTriangles(lod0.data(), lod0.size()));
+}
+
+// --------------------------------------------------------
+// Culling never drops anything that could be seen: from
+// random cameras inside and outside a sphere, facing out and
+// then in, no cluster the cone or the frustum test rejects
+// has a front facing triangle with a corner inside the
+// frustum
+// --------------------------------------------------------
+TEST(MeshClustersCullOnlyHiddenTriangles)
+{
+	for (int inward = 0; inward < 2; inward++)
+	{
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices;
+		MakeSphere(40, 60, vertices, indices, inward != 0);
+		std::vector<MeshClusters::Cluster> clusters =
+			MeshClusters::Build(vertices.data(), vertices.size(), indices.data(), 0, (unsigned int)indices.size());
+
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> distance(0.0f, 6.0f);
+		std::uniform_real_distribution<float> fov(0.3f, 1.5f);
+		unsigned int coneRejects = 0;
+		unsigned int frustumRejects = 0;
+		unsigned int wrong = 0;
+		for (int camera = 0; camera < 200; camera++)
+		{
+			XMVECTOR position = XMVector3Normalize(XMVectorSet(unit(random), unit(random), unit(random), 0)) * distance(random);
+			XMVECTOR target = XMVectorSet(unit(random), unit(random), unit(random), 0) * 0.8f;
+			XMMATRIX view = XMMatrixLookAtLH(position, target, XMVectorSet(0, 1, 0, 0));
+			XMMATRIX proj = XMMatrixPerspectiveFovLH(fov(random), 16.0f / 9.0f, 0.01f, 100.0f);
+			Frustum frustum = Frustum::FromMatrix(view * proj);
+			XMFLOAT3 cameraPosition;
+			XMStoreFloat3(&cameraPosition, position);
+
+			for (const MeshClusters::Cluster& cluster : clusters)
+			{
+				bool backFacing = cluster.ConeCutoff <= 1.0f && MeshClusters::IsBackFacing(cluster, cameraPosition);
+				bool outside = !frustum.IntersectsSphere(cluster.Center, cluster.Radius);
+				coneRejects += backFacing;
+				frustumRejects += outside;
+				if (!backFacing && !outside)
+					continue;
+
+				for (unsigned int i = cluster.IndexStart; i < cluster.IndexStart + cluster.IndexCount; i += 3)
+				{
+					XMVECTOR p0 = XMLoadFloat3(&vertices[indices[i]].Position);
+					XMVECTOR p1 = XMLoadFloat3(&vertices[indices[i + 1]].Position);
+					XMVECTOR p2 = XMLoadFloat3(&vertices[indices[i + 2]].Position);
+					XMVECTOR normal = XMVector3Normalize(XMVector3Cross(p1 - p0, p2 - p0));
+					bool front = XMVectorGetX(XMVector3Dot(normal, position - p0)) > 1e-4f;
+					bool inside = InsideFrustum(frustum, p0) || InsideFrustum(frustum, p1) || InsideFrustum(frustum, p2);
+					wrong += (backFacing && front) || (outside && inside);
+				}
+			}
+
+			// What Cull() lists is exactly what passes both tests
+			std::vector<unsigned int> visible;
+			unsigned int visibleCount = MeshClusters::Cull(clusters.data(), clusters.size(), indices.data(), frustum, cameraPosition, visible);
+			unsigned int expected = 0;
+			size_t expectedIndices = 0;
+			for (const MeshClusters::Cluster& cluster : clusters)
+			{
+				if ((cluster.ConeCutoff > 1.0f || !MeshClusters::IsBackFacing(cluster, cameraPosition)) &&
+					frustum.IntersectsSphere(cluster.Center, cluster.Radius))
+				{
+					expected++;
+					expectedIndices += cluster.IndexCount;
+				}
+			}
+			CHECK(visibleCount == expected);
+			CHECK(visible.size() == expectedIndices);
+		}
+		CHECK(wrong == 0);
+
+		// Both tests actually rejected clusters along the way
+		CHECK(coneRejects > 0);
+		CHECK(frustumRejects > 0);
+	}
+}
+
+// Milliseconds to cluster a sphere of about 1M triangles, and to cull it
+BENCHMARK(MeshClustersThroughput)
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeSphere(500, 1000, vertices, indices);
+
+	std::chrono::high_resolution_clock::time_point buildStart = std::chrono::high_resolution_clock::now();
+	std::vector<MeshClusters::Cluster> clusters =
+		MeshClusters::Build(vertices.data(), vertices.size(), indices.data(), 0, (unsigned int)indices.size());
+	std::chrono::high_resolution_clock::time_point buildEnd = std::chrono::high_resolution_clock::now();
+
+	// A camera close enough that both tests have work to do
+	XMVECTOR position = XMVectorSet(0.0f, 0.5f, -2.0f, 0.0f);
+	XMMATRIX view = XMMatrixLookAtLH(position, XMVectorSet(0.3f, 0.0f, 0.0f, 0.0f), XMVectorSet(0, 1, 0, 0));
+	XMMATRIX proj = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.01f, 100.0f);
+	Frustum frustum = Frustum::FromMatrix(view * proj);
+	XMFLOAT3 cameraPosition;
+	XMStoreFloat3(&cameraPosition, position);
+
+	const int repeats = 20;
+	std::vector<unsigned int> visible;
+	visible.reserve(indices.size());
+	unsigned int visibleCount = 0;
+	std::chrono::high_resolution_clock::time_point cullStart = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < repeats; r++)
+	{
+		visible.clear();
+		visibleCount = MeshClusters::Cull(clusters.data(), clusters.size(), indices.data(), frustum, cameraPosition, visible);
+	}
+	std::chrono::high_resolution_clock::time_point cullEnd = std::chrono::high_resolution_clock::now();
+
+	printf("  %zu triangles in %zu clusters: build %.1f ms, cull %.3f ms (%u clusters, %zu triangles visible)\n",
+		indices.size() / 3, clusters.size(),
+		std::chrono::duration<double, std::milli>(buildEnd - buildStart).count(),
+		std::chrono::duration<double, std::milli>(cullEnd - cullStart).count() / repeats,
+		visibleCount, visible.size() / 3);
+	CHECK(visibleCount > 0 && visibleCount < clusters.size());
+}
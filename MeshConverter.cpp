@@ -0,0 +1,669 @@
+#include "MeshConverter.h"
+#include "ExternalSort.h"
+#include "MeshChunks.h"
+#include "MeshOptimizer.h"
+#include "ObjLoader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX	// Keeps std::min and std::max usable
+#include <Windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace DirectX;
+
+// Anonymous namespace for the temporary records and steps, which
+// are private to this file
+namespace
+{
+	// A face corner as written in the OBJ (corner = triangle * 3 + c)
+	struct CornerRecord
+	{
+		uint64_t Corner;
+		int32_t Position;
+		int32_t UV;
+		int32_t Normal;
+	};
+
+	// A welded vertex, filled in one join at a time
+	struct VertexRecord
+	{
+		uint64_t VertexId;
+		int32_t UV;
+		int32_t Normal;
+		Vertex Data;
+	};
+
+	struct CornerVertex
+	{
+		uint64_t Corner;
+		uint64_t VertexId;
+	};
+
+	struct CornerPosition
+	{
+		uint64_t Corner;
+		uint64_t VertexId;
+		XMFLOAT3 Position;
+	};
+
+	struct TriangleRecord
+	{
+		uint64_t Key;			// Morton code of the centroid
+		uint64_t Triangle;		// File order, which keeps equal keys deterministic
+		uint64_t VertexIds[3];
+		uint32_t Material;
+	};
+
+	// A corner's place in the output (slot = chunk triangle * 3 + c)
+	struct ChunkCorner
+	{
+		uint64_t VertexId;
+		uint32_t Chunk;
+		uint32_t Slot;
+	};
+
+	struct ChunkVertex
+	{
+		uint32_t Chunk;
+		uint32_t Slot;
+		uint64_t VertexId;
+		Vertex Data;
+	};
+
+	// Rough bytes a chunk needs per triangle while it's being finished
+	// (its corners as read, its vertices, indices and the weld table)
+	const size_t chunkBytesPerTriangle = 3 * (sizeof(ChunkVertex) + sizeof(Vertex) + sizeof(unsigned int) + 32);
+
+	// Keeps the vertex and index arrays 16-byte aligned in the file
+	const uint64_t dataAlignment = 16;
+
+	uint64_t AlignUp(uint64_t value)
+	{
+		return (value + dataAlignment - 1) & ~(dataAlignment - 1);
+	}
+
+	// --------------------------------------------------------
+	// Names temporary files after the output, and removes them
+	// again however the conversion ends
+	// --------------------------------------------------------
+	class TempFiles
+	{
+	public:
+		TempFiles(const std::string& prefix) : prefix(prefix) {}
+		~TempFiles()
+		{
+			for (const std::string& name : names)
+				remove(name.c_str());
+		}
+
+		std::string Get(const char* name)
+		{
+			names.push_back(prefix + "." + name + ".tmp");
+			return names.back();
+		}
+
+		// Frees the disk space of a file that's no longer needed
+		void Remove(const std::string& name)
+		{
+			remove(name.c_str());
+		}
+
+	private:
+		std::string prefix;
+		std::vector<std::string> names;
+	};
+
+	// --------------------------------------------------------
+	// Writes everything the streamed OBJ hands over straight
+	// to disk, one file per kind of element
+	// --------------------------------------------------------
+	class ObjWriter : public ObjLoader::StreamHandler
+	{
+	public:
+		ExternalSort::RecordWriter<XMFLOAT3> Positions;
+		ExternalSort::RecordWriter<XMFLOAT2> UVs;
+		ExternalSort::RecordWriter<XMFLOAT3> Normals;
+		ExternalSort::RecordWriter<CornerRecord> Corners;
+		ExternalSort::RecordWriter<uint32_t> Materials;	// One per triangle
+		uint64_t TriangleCount = 0;
+
+		ObjWriter(const std::string& positionFile, const std::string& uvFile, const std::string& normalFile, const std::string& cornerFile, const std::string& materialFile)
+			: Positions(positionFile), UVs(uvFile), Normals(normalFile), Corners(cornerFile), Materials(materialFile)
+		{
+		}
+
+		void AddPositions(const XMFLOAT3* positions, size_t count) override { Positions.Write(positions, count); }
+		void AddUVs(const XMFLOAT2* uvs, size_t count) override { UVs.Write(uvs, count); }
+		void AddNormals(const XMFLOAT3* normals, size_t count) override { Normals.Write(normals, count); }
+
+		void AddTriangles(const ObjLoader::StreamTriangle* triangles, size_t count) override
+		{
+			for (size_t t = 0; t < count; t++)
+			{
+				for (int c = 0; c < 3; c++)
+					Corners.Write({ TriangleCount * 3 + c, triangles[t].Positions[c], triangles[t].UVs[c], triangles[t].Normals[c] });
+				Materials.Write(triangles[t].Material);
+				TriangleCount++;
+			}
+		}
+
+		void Close()
+		{
+			Positions.Close();
+			UVs.Close();
+			Normals.Close();
+			Corners.Close();
+			Materials.Close();
+		}
+	};
+
+	// Reads element after element of a file that's walked in
+	// increasing index order, as sorted joins do
+	template <typename T>
+	class SequentialLookup
+	{
+	public:
+		SequentialLookup(const std::string& fileName) : reader(fileName), index(-1), value() {}
+
+		const T& Get(int64_t target)
+		{
+			while (index < target)
+			{
+				if (!reader.Read(value))
+					throw std::runtime_error("Error reading temporary file: Element missing");
+				index++;
+			}
+			return value;
+		}
+
+	private:
+		ExternalSort::RecordReader<T> reader;
+		int64_t index;
+		T value;
+	};
+
+	// Spreads the low 21 bits out to every third bit
+	uint64_t SpreadBits(uint64_t x)
+	{
+		x &= 0x1FFFFF;
+		x = (x | (x << 32)) & 0x001F00000000FFFFull;
+		x = (x | (x << 16)) & 0x001F0000FF0000FFull;
+		x = (x | (x << 8)) & 0x100F00F00F00F00Full;
+		x = (x | (x << 4)) & 0x10C30C30C30C30C3ull;
+		x = (x | (x << 2)) & 0x1249249249249249ull;
+		return x;
+	}
+
+	// 63-bit Morton code of a point within the bounds
+	// - Every axis is scaled by the largest extent, so flat models
+	//   still get cells that are cubes (and compact chunks)
+	uint64_t MortonCode(XMFLOAT3 point, XMFLOAT3 boundsMin, XMFLOAT3 boundsMax)
+	{
+		float extent = fmaxf(fmaxf(boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y), boundsMax.z - boundsMin.z);
+		float scale = (extent > 0.0f) ? (float)((1 << 21) - 1) / extent : 0.0f;
+		auto quantize = [&](float value, float low)
+		{
+			return (uint64_t)fminf(fmaxf((value - low) * scale, 0.0f), (float)((1 << 21) - 1));
+		};
+		return SpreadBits(quantize(point.x, boundsMin.x)) |
+			(SpreadBits(quantize(point.y, boundsMin.y)) << 1) |
+			(SpreadBits(quantize(point.z, boundsMin.z)) << 2);
+	}
+
+	// --------------------------------------------------------
+	// Fills in one element of every vertex: the vertices are
+	// sorted by that element's index, so the element file is
+	// read front to back alongside them
+	// - apply(vertex, element) gets null where the OBJ left the
+	//   element out
+	// --------------------------------------------------------
+	template <typename T, typename GetIndex, typename Apply>
+	void JoinElements(const std::string& vertexFile, const std::string& sortedFile, const std::string& elementFile, GetIndex getIndex, Apply apply, size_t sortBudget)
+	{
+		ExternalSort::Sort<VertexRecord>(vertexFile, sortedFile, [&](const VertexRecord& a, const VertexRecord& b)
+		{
+			return std::make_pair(getIndex(a), a.VertexId) < std::make_pair(getIndex(b), b.VertexId);
+		}, sortBudget);
+
+		ExternalSort::RecordReader<VertexRecord> in(sortedFile);
+		ExternalSort::RecordWriter<VertexRecord> out(vertexFile);
+		SequentialLookup<T> elements(elementFile);
+		VertexRecord vertex;
+		while (in.Read(vertex))
+		{
+			int32_t index = getIndex(vertex);
+			apply(vertex, index >= 0 ? &elements.Get(index) : nullptr);
+			out.Write(vertex);
+		}
+		out.Close();
+	}
+
+	void Write(std::ofstream& out, const void* data, uint64_t size)
+	{
+		out.write((const char*)data, (std::streamsize)size);
+	}
+
+	void Pad(std::ofstream& out, uint64_t& offset)
+	{
+		const char padding[dataAlignment] = {};
+		uint64_t aligned = AlignUp(offset);
+		Write(out, padding, aligned - offset);
+		offset = aligned;
+	}
+}
+
+namespace MeshConverter
+{
+	size_t GetPeakMemoryUsage()
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters = {};
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return 0;
+		return counters.PeakWorkingSetSize;
+#else
+		rusage usage = {};
+		if (getrusage(RUSAGE_SELF, &usage) != 0)
+			return 0;
+		return (size_t)usage.ru_maxrss * 1024;	// Kilobytes on Linux
+#endif
+	}
+
+	Stats Convert(const char* objFile, const char* outputFile, const Options& options)
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+		auto log = [&](const std::string& message)
+		{
+			if (!options.Log)
+				return;
+			double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+			char elapsed[32];
+			snprintf(elapsed, sizeof(elapsed), "[%7.1fs] ", seconds);
+			options.Log(elapsed + message);
+		};
+
+		// Half the budget goes to each sort, and the rest covers
+		// the file buffers around it
+		size_t budget = std::max<size_t>(options.MemoryBudget, 16 << 20);
+		size_t sortBudget = budget / 2;
+		size_t streamBuffer = std::min<size_t>(std::max<size_t>(budget / 8, 1 << 20), 256 << 20);
+		size_t maxChunkTriangles = std::max<size_t>(1, std::min<size_t>(options.MaxChunkTriangles, budget / chunkBytesPerTriangle));
+
+		std::string tempPrefix = outputFile;
+		if (!options.TempDirectory.empty())
+		{
+			size_t slash = tempPrefix.find_last_of("/\\");
+			char last = options.TempDirectory.back();
+			tempPrefix = options.TempDirectory + (last == '/' || last == '\\' ? "" : "/") +
+				tempPrefix.substr(slash == std::string::npos ? 0 : slash + 1);
+		}
+		TempFiles temp(tempPrefix);
+		Stats stats = {};
+
+		// Stream the OBJ to disk
+		std::string positionFile = temp.Get("positions");
+		std::string uvFile = temp.Get("uvs");
+		std::string normalFile = temp.Get("normals");
+		std::string cornerFile = temp.Get("corners");
+		std::string materialFile = temp.Get("materials");
+		ObjLoader::StreamInfo info;
+		{
+			ObjWriter writer(positionFile, uvFile, normalFile, cornerFile, materialFile);
+			info = ObjLoader::Stream(objFile, writer, streamBuffer, options.MaxThreads);
+			writer.Close();
+			stats.PositionCount = writer.Positions.GetCount();
+			stats.TriangleCount = writer.TriangleCount;
+		}
+		log("Read " + std::to_string(stats.PositionCount) + " positions and " + std::to_string(stats.TriangleCount) + " triangles");
+
+		// Weld: corners sorted by position/uv/normal put identical
+		// triplets next to each other, and positions in file order
+		std::string sortedCornerFile = temp.Get("corners_sorted");
+		std::string vertexFile = temp.Get("vertices");
+		std::string cornerVertexFile = temp.Get("corner_vertices");
+		XMFLOAT3 boundsMin(0, 0, 0);
+		XMFLOAT3 boundsMax(0, 0, 0);
+		{
+			ExternalSort::Sort<CornerRecord>(cornerFile, sortedCornerFile, [](const CornerRecord& a, const CornerRecord& b)
+			{
+				return std::tie(a.Position, a.UV, a.Normal, a.Corner) < std::tie(b.Position, b.UV, b.Normal, b.Corner);
+			}, sortBudget);
+			temp.Remove(cornerFile);
+
+			ExternalSort::RecordReader<CornerRecord> corners(sortedCornerFile);
+			SequentialLookup<XMFLOAT3> positions(positionFile);
+			ExternalSort::RecordWriter<VertexRecord> vertices(vertexFile);
+			ExternalSort::RecordWriter<CornerVertex> cornerVertices(cornerVertexFile);
+
+			CornerRecord corner;
+			CornerRecord previous = {};
+			uint64_t vertexCount = 0;
+			while (corners.Read(corner))
+			{
+				if (vertexCount == 0 || corner.Position != previous.Position || corner.UV != previous.UV || corner.Normal != previous.Normal)
+				{
+					VertexRecord vertex = {};
+					vertex.VertexId = vertexCount;
+					vertex.UV = corner.UV;
+					vertex.Normal = corner.Normal;
+					vertex.Data.Position = (corner.Position >= 0) ? positions.Get(corner.Position) : XMFLOAT3(0, 0, 0);
+					vertex.Data.Tangent = XMFLOAT4(0, 0, 0, 1);
+					vertices.Write(vertex);
+
+					XMFLOAT3 p = vertex.Data.Position;
+					boundsMin = (vertexCount == 0) ? p : XMFLOAT3(fminf(boundsMin.x, p.x), fminf(boundsMin.y, p.y), fminf(boundsMin.z, p.z));
+					boundsMax = (vertexCount == 0) ? p : XMFLOAT3(fmaxf(boundsMax.x, p.x), fmaxf(boundsMax.y, p.y), fmaxf(boundsMax.z, p.z));
+					vertexCount++;
+				}
+				cornerVertices.Write({ corner.Corner, vertexCount - 1 });
+				previous = corner;
+			}
+			vertices.Close();
+			cornerVertices.Close();
+			stats.WeldedVertexCount = vertexCount;
+		}
+		temp.Remove(sortedCornerFile);
+		temp.Remove(positionFile);
+		log("Welded " + std::to_string(stats.WeldedVertexCount) + " vertices");
+
+		// Look up uvs, then normals (missing ones get the same
+		// defaults as a loaded OBJ, with V already flipped)
+		std::string vertexSortedFile = temp.Get("vertices_sorted");
+		JoinElements<XMFLOAT2>(vertexFile, vertexSortedFile, uvFile,
+			[](const VertexRecord& v) { return v.UV; },
+			[](VertexRecord& v, const XMFLOAT2* uv) { v.Data.UV = uv ? *uv : XMFLOAT2(0, 1); },
+			sortBudget);
+		temp.Remove(uvFile);
+		JoinElements<XMFLOAT3>(vertexFile, vertexSortedFile, normalFile,
+			[](const VertexRecord& v) { return v.Normal; },
+			[](VertexRecord& v, const XMFLOAT3* normal) { v.Data.Normal = normal ? *normal : XMFLOAT3(0, 0, 0); },
+			sortBudget);
+		temp.Remove(normalFile);
+
+		// Back in id order, so later joins can walk the vertices
+		// alongside anything else sorted by vertex
+		ExternalSort::Sort<VertexRecord>(vertexFile, vertexSortedFile, [](const VertexRecord& a, const VertexRecord& b)
+		{
+			return a.VertexId < b.VertexId;
+		}, sortBudget);
+		temp.Remove(vertexFile);
+		log("Looked up uvs and normals");
+
+		// Give each corner its vertex's position, then put corners back
+		// in triangle order to key every triangle by its centroid
+		std::string cornerPositionFile = temp.Get("corner_positions");
+		std::string cornerPositionSortedFile = temp.Get("corner_positions_sorted");
+		std::string triangleFile = temp.Get("triangles");
+		{
+			ExternalSort::RecordReader<CornerVertex> cornerVertices(cornerVertexFile);
+			SequentialLookup<VertexRecord> vertices(vertexSortedFile);
+			ExternalSort::RecordWriter<CornerPosition> out(cornerPositionFile);
+			CornerVertex corner;
+			while (cornerVertices.Read(corner))
+				out.Write({ corner.Corner, corner.VertexId, vertices.Get((int64_t)corner.VertexId).Data.Position });
+			out.Close();
+		}
+		temp.Remove(cornerVertexFile);
+		ExternalSort::Sort<CornerPosition>(cornerPositionFile, cornerPositionSortedFile, [](const CornerPosition& a, const CornerPosition& b)
+		{
+			return a.Corner < b.Corner;
+		}, sortBudget);
+		temp.Remove(cornerPositionFile);
+		{
+			ExternalSort::RecordReader<CornerPosition> corners(cornerPositionSortedFile);
+			ExternalSort::RecordReader<uint32_t> materials(materialFile);
+			ExternalSort::RecordWriter<TriangleRecord> out(triangleFile);
+			for (uint64_t t = 0; t < stats.TriangleCount; t++)
+			{
+				TriangleRecord triangle = {};
+				triangle.Triangle = t;
+				XMVECTOR centroid = XMVectorZero();
+				for (int c = 0; c < 3; c++)
+				{
+					CornerPosition corner;
+					if (!corners.Read(corner) || corner.Corner != t * 3 + c)
+						throw std::runtime_error("Error reading temporary file: Corner missing");
+					triangle.VertexIds[c] = corner.VertexId;
+					centroid = XMVectorAdd(centroid, XMLoadFloat3(&corner.Position));
+				}
+				if (!materials.Read(triangle.Material))
+					throw std::runtime_error("Error reading temporary file: Material missing");
+
+				XMFLOAT3 center;
+				XMStoreFloat3(&center, XMVectorScale(centroid, 1.0f / 3.0f));
+				triangle.Key = MortonCode(center, boundsMin, boundsMax);
+				out.Write(triangle);
+			}
+			out.Close();
+		}
+		temp.Remove(cornerPositionSortedFile);
+		temp.Remove(materialFile);
+
+		// Cut the triangles into chunks along the Morton curve, and
+		// note where each corner's vertex goes in the output
+		std::string triangleSortedFile = temp.Get("triangles_sorted");
+		std::string chunkCornerFile = temp.Get("chunk_corners");
+		std::string chunkCornerSortedFile = temp.Get("chunk_corners_sorted");
+		std::string chunkMaterialFile = temp.Get("chunk_materials");
+		std::vector<uint32_t> chunkTriangleCounts;
+		ExternalSort::Sort<TriangleRecord>(triangleFile, triangleSortedFile, [](const TriangleRecord& a, const TriangleRecord& b)
+		{
+			return std::tie(a.Key, a.Triangle) < std::tie(b.Key, b.Triangle);
+		}, sortBudget);
+		temp.Remove(triangleFile);
+		{
+			ExternalSort::RecordReader<TriangleRecord> triangles(triangleSortedFile);
+			ExternalSort::RecordWriter<ChunkCorner> corners(chunkCornerFile);
+			ExternalSort::RecordWriter<uint32_t> materials(chunkMaterialFile);
+			TriangleRecord triangle;
+			while (triangles.Read(triangle))
+			{
+				if (chunkTriangleCounts.empty() || chunkTriangleCounts.back() == maxChunkTriangles)
+					chunkTriangleCounts.push_back(0);
+				uint32_t chunk = (uint32_t)chunkTriangleCounts.size() - 1;
+				uint32_t slot = chunkTriangleCounts.back()++ * 3;
+				for (uint32_t c = 0; c < 3; c++)
+					corners.Write({ triangle.VertexIds[c], chunk, slot + c });
+				materials.Write(triangle.Material);
+			}
+			corners.Close();
+			materials.Close();
+		}
+		temp.Remove(triangleSortedFile);
+		stats.ChunkCount = (uint32_t)chunkTriangleCounts.size();
+
+		// Fetch every corner's vertex, then put them in output order
+		{
+			ExternalSort::Sort<ChunkCorner>(chunkCornerFile, chunkCornerSortedFile, [](const ChunkCorner& a, const ChunkCorner& b)
+			{
+				return std::tie(a.VertexId, a.Chunk, a.Slot) < std::tie(b.VertexId, b.Chunk, b.Slot);
+			}, sortBudget);
+			temp.Remove(chunkCornerFile);
+
+			ExternalSort::RecordReader<ChunkCorner> corners(chunkCornerSortedFile);
+			SequentialLookup<VertexRecord> vertices(vertexSortedFile);
+			ExternalSort::RecordWriter<ChunkVertex> out(chunkCornerFile);
+			ChunkCorner corner;
+			while (corners.Read(corner))
+				out.Write({ corner.Chunk, corner.Slot, corner.VertexId, vertices.Get((int64_t)corner.VertexId).Data });
+			out.Close();
+		}
+		temp.Remove(chunkCornerSortedFile);
+		temp.Remove(vertexSortedFile);
+		ExternalSort::Sort<ChunkVertex>(chunkCornerFile, chunkCornerSortedFile, [](const ChunkVertex& a, const ChunkVertex& b)
+		{
+			return std::tie(a.Chunk, a.Slot) < std::tie(b.Chunk, b.Slot);
+		}, sortBudget);
+		temp.Remove(chunkCornerFile);
+		log("Sorted triangles into " + std::to_string(stats.ChunkCount) + " chunks");
+
+		// Finish each chunk in memory and write it out
+		MeshChunks::Header header = {};
+		header.Magic = MeshChunks::Magic;
+		header.Version = MeshChunks::Version;
+		header.VertexStride = sizeof(Vertex);
+		header.ChunkCount = stats.ChunkCount;
+		header.MaterialCount = (uint32_t)info.Materials.size();
+		header.LibraryCount = (uint32_t)info.MaterialLibraries.size();
+		header.BoundsMin = boundsMin;
+		header.BoundsMax = boundsMax;
+
+		std::vector<MeshChunks::Chunk> chunks;
+		std::vector<MeshChunks::Submesh> submeshes;
+		std::string tempOutput = std::string(outputFile) + ".tmp";
+		{
+			std::ofstream out(tempOutput, std::ios::binary | std::ios::trunc);
+			if (!out.is_open())
+				throw std::runtime_error("Error creating output file: " + tempOutput);
+
+			uint64_t offset = sizeof(MeshChunks::Header);
+			Write(out, &header, sizeof(MeshChunks::Header));
+			Pad(out, offset);
+
+			ExternalSort::RecordReader<ChunkVertex> corners(chunkCornerSortedFile);
+			ExternalSort::RecordReader<uint32_t> materials(chunkMaterialFile);
+			MeshTangents::Options tangentOptions;
+			tangentOptions.TangentMode = options.TangentMode;
+			tangentOptions.MaxThreads = options.MaxThreads;
+
+			std::vector<Vertex> vertices;
+			std::vector<unsigned int> indices;
+			std::vector<unsigned int> cornerVertices;
+			std::vector<uint32_t> triangleMaterials;
+			std::vector<unsigned int> partSizes;
+			for (uint32_t c = 0; c < stats.ChunkCount; c++)
+			{
+				// Corners of the same welded vertex share its id, so
+				// the chunk only keeps one copy of each
+				uint32_t triangleCount = chunkTriangleCounts[c];
+				std::unordered_map<uint64_t, unsigned int> welds;
+				welds.reserve((size_t)triangleCount * 3);
+				vertices.clear();
+				cornerVertices.resize((size_t)triangleCount * 3);
+				for (uint32_t i = 0; i < triangleCount * 3; i++)
+				{
+					ChunkVertex corner;
+					if (!corners.Read(corner) || corner.Chunk != c || corner.Slot != i)
+						throw std::runtime_error("Error reading temporary file: Chunk corner missing");
+
+					auto inserted = welds.insert({ corner.VertexId, (unsigned int)vertices.size() });
+					if (inserted.second)
+						vertices.push_back(corner.Data);
+					cornerVertices[i] = inserted.first->second;
+				}
+				welds = {};
+
+				// One submesh per material, in material order, keeping
+				// the Morton order of the triangles within each
+				triangleMaterials.resize(triangleCount);
+				for (uint32_t t = 0; t < triangleCount; t++)
+				{
+					if (!materials.Read(triangleMaterials[t]))
+						throw std::runtime_error("Error reading temporary file: Material missing");
+				}
+				std::vector<uint32_t> order(triangleCount);
+				for (uint32_t t = 0; t < triangleCount; t++)
+					order[t] = t;
+				std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return triangleMaterials[a] < triangleMaterials[b]; });
+
+				indices.clear();
+				partSizes.clear();
+				MeshChunks::Chunk chunk = {};
+				chunk.SubmeshStart = (uint32_t)submeshes.size();
+				for (uint32_t t : order)
+				{
+					uint32_t material = triangleMaterials[t];
+					if (chunk.SubmeshCount == 0 || submeshes.back().Material != material)
+					{
+						submeshes.push_back({ material, (uint32_t)indices.size(), 0 });
+						partSizes.push_back(0);
+						chunk.SubmeshCount++;
+					}
+					indices.insert(indices.end(), { cornerVertices[t * 3], cornerVertices[t * 3 + 1], cornerVertices[t * 3 + 2] });
+					submeshes.back().IndexCount += 3;
+					partSizes.back() += 3;
+				}
+
+				// Same processing as a loaded OBJ, within the chunk
+				MeshTangents::Generate(vertices, indices, indices.size(), tangentOptions);
+				if (options.OptimizeVertexCache)
+					MeshOptimizer::Optimize(vertices, indices, partSizes);
+
+				chunk.BoundsMin = vertices.empty() ? XMFLOAT3(0, 0, 0) : vertices[0].Position;
+				chunk.BoundsMax = chunk.BoundsMin;
+				for (const Vertex& v : vertices)
+				{
+					chunk.BoundsMin = XMFLOAT3(fminf(chunk.BoundsMin.x, v.Position.x), fminf(chunk.BoundsMin.y, v.Position.y), fminf(chunk.BoundsMin.z, v.Position.z));
+					chunk.BoundsMax = XMFLOAT3(fmaxf(chunk.BoundsMax.x, v.Position.x), fmaxf(chunk.BoundsMax.y, v.Position.y), fmaxf(chunk.BoundsMax.z, v.Position.z));
+				}
+
+				chunk.VertexCount = (uint32_t)vertices.size();
+				chunk.IndexCount = (uint32_t)indices.size();
+				chunk.VertexOffset = offset;
+				Write(out, vertices.data(), vertices.size() * sizeof(Vertex));
+				offset += vertices.size() * sizeof(Vertex);
+				Pad(out, offset);
+				chunk.IndexOffset = offset;
+				Write(out, indices.data(), indices.size() * sizeof(unsigned int));
+				offset += indices.size() * sizeof(unsigned int);
+				Pad(out, offset);
+				chunks.push_back(chunk);
+
+				header.VertexCount += chunk.VertexCount;
+				header.IndexCount += chunk.IndexCount;
+			}
+
+			// Then the tables, and the finished header over the placeholder
+			std::string strings;
+			for (const std::string& library : info.MaterialLibraries)
+				strings.append(library.c_str(), library.size() + 1);
+			for (const std::string& material : info.Materials)
+				strings.append(material.c_str(), material.size() + 1);
+			header.SubmeshCount = (uint32_t)submeshes.size();
+			header.StringSize = (uint32_t)strings.size();
+			header.ChunkOffset = offset;
+			header.SubmeshOffset = header.ChunkOffset + chunks.size() * sizeof(MeshChunks::Chunk);
+			header.StringOffset = header.SubmeshOffset + submeshes.size() * sizeof(MeshChunks::Submesh);
+			Write(out, chunks.data(), chunks.size() * sizeof(MeshChunks::Chunk));
+			Write(out, submeshes.data(), submeshes.size() * sizeof(MeshChunks::Submesh));
+			Write(out, strings.data(), strings.size());
+			out.seekp(0);
+			Write(out, &header, sizeof(MeshChunks::Header));
+			if (!out.good())
+			{
+				out.close();
+				remove(tempOutput.c_str());
+				throw std::runtime_error("Error writing output file: " + tempOutput);
+			}
+		}
+
+		// rename() won't replace an existing file on Windows
+		remove(outputFile);
+		if (rename(tempOutput.c_str(), outputFile) != 0)
+		{
+			remove(tempOutput.c_str());
+			throw std::runtime_error(std::string("Error replacing output file: ") + outputFile);
+		}
+
+		stats.VertexCount = header.VertexCount;
+		stats.Seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+		stats.PeakMemory = GetPeakMemoryUsage();
+		log("Wrote " + std::to_string(stats.VertexCount) + " vertices in " + std::to_string(stats.ChunkCount) + " chunks");
+		return stats;
+	}
+}
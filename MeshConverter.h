@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include "MeshTangents.h"
+
+// --------------------------------------------------------
+// Converts .OBJ files of any size into .meshchunks files
+// (see MeshChunks), in bounded memory
+//
+// - The OBJ is streamed through ObjLoader::Stream(), and
+//   every element and triangle goes straight to temporary
+//   files on disk
+// - Welding, the lookups of each vertex's uv and normal and
+//   the grouping of triangles into chunks are all joins of
+//   sorted files (see ExternalSort), so no step ever holds
+//   more than the memory budget
+// - Triangles are sorted along a Morton curve through their
+//   centroids and cut into chunks, which keeps each chunk
+//   spatially compact
+// - Each chunk then fits in memory and gets the same
+//   treatment as a loaded OBJ: tangents (MeshTangents),
+//   material submeshes and vertex cache optimization
+//   (MeshOptimizer)
+// - Vertices on chunk borders are duplicated into every
+//   chunk that uses them, and tangents only see the
+//   triangles of their own chunk
+// --------------------------------------------------------
+namespace MeshConverter
+{
+	struct Options
+	{
+		// Rough upper limit on the memory the conversion uses, in bytes
+		// (the OBJ parsing buffer, the sort buffers and one chunk)
+		size_t MemoryBudget = (size_t)1 << 30;
+
+		// Largest chunk, in triangles (lowered if a chunk of this
+		// size wouldn't fit in the memory budget)
+		unsigned int MaxChunkTriangles = 65536;
+
+		// Where temporary files go (empty uses the output's directory);
+		// expect them to need a few times the size of the OBJ
+		std::string TempDirectory;
+
+		// Upper limit on threads for parsing and tangents (zero uses
+		// one per hardware thread)
+		unsigned int MaxThreads = 0;
+
+		MeshTangents::Mode TangentMode = MeshTangents::Mode::MikkTSpace;
+		bool OptimizeVertexCache = true;
+
+		// Receives a line of progress after each step (may be empty)
+		std::function<void(const std::string&)> Log;
+	};
+
+	struct Stats
+	{
+		uint64_t PositionCount;		// Positions in the OBJ
+		uint64_t TriangleCount;		// After splitting faces
+		uint64_t WeldedVertexCount;	// Unique position/uv/normal triplets
+		uint64_t VertexCount;		// Written, including chunk border copies and tangent splits
+		uint32_t ChunkCount;
+		double Seconds;
+		size_t PeakMemory;			// Peak resident memory of the whole process, in bytes
+	};
+
+	// Throws std::invalid_argument if the OBJ can't be read, or
+	// std::runtime_error if a temporary or output file can't be written
+	Stats Convert(const char* objFile, const char* outputFile, const Options& options = Options());
+
+	// Peak resident memory (working set) of this process so far, in bytes
+	size_t GetPeakMemoryUsage();
+}
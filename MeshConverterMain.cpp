@@ -0,0 +1,89 @@
+#include "MeshConverter.h"
+#include "MeshChunks.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <string>
+
+// --------------------------------------------------------
+// Command line front end for MeshConverter, built as its
+// own console program (MeshConverter.vcxproj)
+//
+// MeshConverter input.obj [output.meshchunks] [options]
+// --------------------------------------------------------
+
+static void PrintUsage()
+{
+	printf(
+		"Usage: MeshConverter input.obj [output.meshchunks] [options]\n"
+		"  --memory MB            Memory budget (default 1024)\n"
+		"  --chunk-triangles N    Largest chunk, in triangles (default 65536)\n"
+		"  --temp DIRECTORY       Where temporary files go (default: next to the output)\n"
+		"  --threads N            Thread limit (default: one per hardware thread)\n"
+		"  --fast-tangents        Skip MikkTSpace-compatible tangents\n"
+		"  --no-optimize          Skip vertex cache optimization\n");
+}
+
+int main(int argc, char* argv[])
+{
+	MeshConverter::Options options;
+	options.Log = [](const std::string& message) { printf("%s\n", message.c_str()); };
+
+	const char* input = nullptr;
+	const char* output = nullptr;
+	for (int i = 1; i < argc; i++)
+	{
+		// Options that take a value need one after them
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--memory") == 0 && hasValue)
+			options.MemoryBudget = (size_t)strtoull(argv[++i], nullptr, 10) << 20;
+		else if (strcmp(argv[i], "--chunk-triangles") == 0 && hasValue)
+			options.MaxChunkTriangles = (unsigned int)strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "--temp") == 0 && hasValue)
+			options.TempDirectory = argv[++i];
+		else if (strcmp(argv[i], "--threads") == 0 && hasValue)
+			options.MaxThreads = (unsigned int)strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "--fast-tangents") == 0)
+			options.TangentMode = MeshTangents::Mode::Fast;
+		else if (strcmp(argv[i], "--no-optimize") == 0)
+			options.OptimizeVertexCache = false;
+		else if (argv[i][0] != '-' && !input)
+			input = argv[i];
+		else if (argv[i][0] != '-' && !output)
+			output = argv[i];
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+	if (!input || options.MaxChunkTriangles == 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	std::string outputFile = output ? output : MeshChunks::GetChunkPath(input);
+	try
+	{
+		MeshConverter::Stats stats = MeshConverter::Convert(input, outputFile.c_str(), options);
+		printf("%s: %llu triangles, %llu welded vertices -> %u chunks, %llu vertices\n",
+			outputFile.c_str(),
+			(unsigned long long)stats.TriangleCount,
+			(unsigned long long)stats.WeldedVertexCount,
+			stats.ChunkCount,
+			(unsigned long long)stats.VertexCount);
+		printf("%.1f seconds, peak memory %.1f MB (budget %.1f MB)\n",
+			stats.Seconds,
+			stats.PeakMemory / (1024.0 * 1024.0),
+			options.MemoryBudget / (1024.0 * 1024.0));
+	}
+	catch (const std::exception& e)
+	{
+		fprintf(stderr, "MeshConverter: %s\n", e.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,214 @@
+#include "Tests.h"
+#include "MeshConverter.h"
+#include "MeshChunks.h"
+#include "ObjLoader.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace
+{
+	const char* objFile = "MeshConverterTests.obj";
+	const char* chunkFile = "MeshConverterTests.meshchunks";
+
+	// --------------------------------------------------------
+	// A bumpy size x size grid of quads, with uvs and normals,
+	// and three materials in bands (one used twice, so its
+	// triangles aren't all together in the file)
+	// --------------------------------------------------------
+	void WriteGridObj(int size)
+	{
+		std::ofstream out(objFile, std::ios::trunc);
+		out << "mtllib grid.mtl\n";
+		for (int z = 0; z <= size; z++)
+		{
+			for (int x = 0; x <= size; x++)
+			{
+				out << "v " << x * 0.5f << " " << ((x * 7 + z * 3) % 5) * 0.1f << " " << z * 0.5f << "\n";
+				out << "vt " << x / (float)size << " " << z / (float)size << "\n";
+				out << "vn " << ((x + z) % 3) * 0.1f << " 1 0\n";
+			}
+		}
+
+		const char* materials[] = { "stone", "grass", "stone", "water" };
+		int row = size + 1;
+		for (int z = 0; z < size; z++)
+		{
+			if (z % (size / 4) == 0)
+				out << "usemtl " << materials[z / (size / 4)] << "\n";
+			for (int x = 0; x < size; x++)
+			{
+				int a = z * row + x + 1;
+				int corners[4] = { a, a + 1, a + row + 1, a + row };
+				out << "f";
+				for (int corner : corners)
+					out << " " << corner << "/" << corner << "/" << corner;
+				out << "\n";
+			}
+		}
+	}
+
+	// A triangle's corners (position, uv and normal) and material,
+	// starting from its smallest corner so rotations compare equal
+	typedef std::tuple<float, float, float, float, float, float, float, float> Corner;
+	typedef std::tuple<std::string, Corner, Corner, Corner> Triangle;
+
+	Corner GetCorner(const Vertex& v)
+	{
+		return Corner(v.Position.x, v.Position.y, v.Position.z, v.UV.x, v.UV.y, v.Normal.x, v.Normal.y, v.Normal.z);
+	}
+
+	Triangle MakeTriangle(const std::string& material, const Vertex& a, const Vertex& b, const Vertex& c)
+	{
+		Corner corners[3] = { GetCorner(a), GetCorner(b), GetCorner(c) };
+		int first = (int)(std::min_element(corners, corners + 3) - corners);
+		return Triangle(material, corners[first], corners[(first + 1) % 3], corners[(first + 2) % 3]);
+	}
+
+	std::vector<char> ReadFile(const char* path)
+	{
+		std::ifstream in(path, std::ios::binary);
+		return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	}
+}
+
+// --------------------------------------------------------
+// Chunks of at most 16 triangles hold exactly the triangles
+// (with their materials) that loading the OBJ gives, and
+// every chunk is spatially compact and self-contained
+// --------------------------------------------------------
+TEST(MeshConverterMatchesObjLoader)
+{
+	const int size = 16;
+	WriteGridObj(size);
+
+	MeshConverter::Options options;
+	options.MemoryBudget = 16 << 20;
+	options.MaxChunkTriangles = 16;
+	options.TangentMode = MeshTangents::Mode::Fast;
+	MeshConverter::Stats stats = MeshConverter::Convert(objFile, chunkFile, options);
+	CHECK(stats.PositionCount == (size + 1) * (size + 1));
+	CHECK(stats.TriangleCount == size * size * 2);
+	CHECK(stats.WeldedVertexCount == (size + 1) * (size + 1));
+	CHECK(stats.ChunkCount >= size * size * 2 / 16);
+
+	std::vector<char> file = ReadFile(chunkFile);
+	const MeshChunks::Header* header = MeshChunks::Validate(file.data(), file.size());
+	CHECK(header != nullptr);
+	if (!header)
+		return;
+	CHECK(header->ChunkCount == stats.ChunkCount);
+	CHECK(header->IndexCount == stats.TriangleCount * 3);
+	CHECK(header->VertexCount == stats.VertexCount);
+
+	std::vector<std::string> libraries, materials;
+	MeshChunks::GetStrings(header, libraries, materials);
+	CHECK(libraries == std::vector<std::string>({ "grid.mtl" }));
+
+	// Every chunk's triangles, through its submeshes
+	std::vector<Triangle> converted;
+	const MeshChunks::Chunk* chunks = MeshChunks::GetChunks(header);
+	const MeshChunks::Submesh* submeshes = MeshChunks::GetSubmeshes(header);
+	bool withinBounds = true;
+	for (uint32_t c = 0; c < header->ChunkCount; c++)
+	{
+		const MeshChunks::Chunk& chunk = chunks[c];
+		CHECK(MeshChunks::ValidateChunk(header, c));
+		CHECK(chunk.IndexCount > 0 && chunk.IndexCount <= 16 * 3);
+		const Vertex* vertices = MeshChunks::GetVertices(header, chunk);
+		const unsigned int* indices = MeshChunks::GetIndices(header, chunk);
+		for (uint32_t v = 0; v < chunk.VertexCount; v++)
+		{
+			const DirectX::XMFLOAT3& p = vertices[v].Position;
+			withinBounds = withinBounds &&
+				p.x >= chunk.BoundsMin.x && p.y >= chunk.BoundsMin.y && p.z >= chunk.BoundsMin.z &&
+				p.x <= chunk.BoundsMax.x && p.y <= chunk.BoundsMax.y && p.z <= chunk.BoundsMax.z;
+		}
+		for (uint32_t s = chunk.SubmeshStart; s < chunk.SubmeshStart + chunk.SubmeshCount; s++)
+		{
+			const MeshChunks::Submesh& submesh = submeshes[s];
+			for (uint32_t i = submesh.IndexStart; i < submesh.IndexStart + submesh.IndexCount; i += 3)
+			{
+				converted.push_back(MakeTriangle(materials[submesh.Material],
+					vertices[indices[i]], vertices[indices[i + 1]], vertices[indices[i + 2]]));
+			}
+		}
+	}
+	CHECK(withinBounds);
+
+	// The same OBJ, loaded whole
+	ObjLoader::LoadOptions loadOptions;
+	loadOptions.LodCount = 1;
+	loadOptions.OptimizeVertexCache = false;
+	loadOptions.TangentMode = MeshTangents::Mode::Fast;
+	loadOptions.BuildBvh = false;
+	ObjLoader::MeshData mesh = ObjLoader::Load(objFile, loadOptions);
+	CHECK(mesh.MaterialLibraries == libraries);
+	std::vector<Triangle> loaded;
+	for (const ObjLoader::Submesh& submesh : mesh.Submeshes)
+	{
+		const MeshSimplifier::LodRange& range = submesh.Lods[0];
+		for (unsigned int i = range.IndexStart; i < range.IndexStart + range.IndexCount; i += 3)
+		{
+			loaded.push_back(MakeTriangle(submesh.Material,
+				mesh.Vertices[mesh.Indices[i]], mesh.Vertices[mesh.Indices[i + 1]], mesh.Vertices[mesh.Indices[i + 2]]));
+		}
+	}
+
+	std::sort(converted.begin(), converted.end());
+	std::sort(loaded.begin(), loaded.end());
+	CHECK(converted.size() == (size_t)size * size * 2);
+	CHECK(converted == loaded);
+
+	std::sort(materials.begin(), materials.end());
+	CHECK(materials == std::vector<std::string>({ "grass", "stone", "water" }));
+
+	std::remove(objFile);
+	std::remove(chunkFile);
+}
+
+// --------------------------------------------------------
+// Validate() only checks the tables, so an index past its
+// chunk's vertices has to be caught by ValidateChunk(),
+// without condemning the chunks around it
+// --------------------------------------------------------
+TEST(MeshChunksRejectOutOfRangeIndices)
+{
+	WriteGridObj(8);
+	MeshConverter::Options options;
+	options.MemoryBudget = 16 << 20;
+	options.MaxChunkTriangles = 16;
+	MeshConverter::Convert(objFile, chunkFile, options);
+	std::vector<char> file = ReadFile(chunkFile);
+	std::remove(objFile);
+	std::remove(chunkFile);
+
+	const MeshChunks::Header* header = MeshChunks::Validate(file.data(), file.size());
+	CHECK(header != nullptr);
+	if (!header)
+		return;
+	CHECK(header->ChunkCount >= 3);
+	CHECK(!MeshChunks::ValidateChunk(header, header->ChunkCount));
+
+	const MeshChunks::Chunk& chunk = MeshChunks::GetChunks(header)[1];
+	unsigned int* indices = (unsigned int*)(file.data() + chunk.IndexOffset);
+	unsigned int original = indices[chunk.IndexCount - 1];
+
+	indices[chunk.IndexCount - 1] = chunk.VertexCount;
+	CHECK(MeshChunks::Validate(file.data(), file.size()) == header);
+	CHECK(!MeshChunks::ValidateChunk(header, 1));
+	CHECK(MeshChunks::ValidateChunk(header, 0) && MeshChunks::ValidateChunk(header, 2));
+
+	indices[chunk.IndexCount - 1] = chunk.VertexCount - 1;
+	CHECK(MeshChunks::ValidateChunk(header, 1));
+
+	indices[chunk.IndexCount - 1] = original;
+	indices[0] = 0xFFFFFFFF;
+	CHECK(!MeshChunks::ValidateChunk(header, 1));
+}
@@ -0,0 +1,264 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+	// --------------------------------------------------------
+	// For each vertex, the list of triangles that use it,
+	// stored as one flat array with per-vertex offsets
+	// --------------------------------------------------------
+	struct TriangleAdjacency
+	{
+		std::vector<unsigned int> Offsets;
+		std::vector<unsigned int> Triangles;
+
+		TriangleAdjacency(const std::vector<unsigned int>& indices, size_t vertexCount)
+		{
+			Offsets.assign(vertexCount + 1, 0);
+			for (unsigned int index : indices)
+				Offsets[index + 1]++;
+			for (size_t v = 0; v < vertexCount; v++)
+				Offsets[v + 1] += Offsets[v];
+
+			std::vector<unsigned int> cursor(Offsets.begin(), Offsets.end() - 1);
+			Triangles.resize(indices.size());
+			for (size_t i = 0; i < indices.size(); i++)
+				Triangles[cursor[indices[i]]++] = (unsigned int)(i / 3);
+		}
+	};
+
+	// --------------------------------------------------------
+	// Finds a new fanning vertex when the current one has no
+	// candidates left: first any recently used vertex that
+	// still has triangles, then the next one in input order
+	// --------------------------------------------------------
+	int SkipDeadEnd(std::vector<unsigned int>& deadEnds, const std::vector<unsigned int>& liveTriangles, size_t& cursor, size_t vertexCount)
+	{
+		while (!deadEnds.empty())
+		{
+			unsigned int v = deadEnds.back();
+			deadEnds.pop_back();
+			if (liveTriangles[v] > 0)
+				return (int)v;
+		}
+
+		for (; cursor < vertexCount; cursor++)
+		{
+			if (liveTriangles[cursor] > 0)
+				return (int)cursor;
+		}
+		return -1;
+	}
+}
+
+namespace MeshOptimizer
+{
+	CacheStats AnalyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize)
+	{
+		// Without a whole triangle there's nothing to divide by
+		CacheStats stats = {};
+		if (indexCount < 3 || vertexCount == 0)
+			return stats;
+
+		// A vertex is in the FIFO if it was added within the last
+		// cacheSize misses, so a timestamp per vertex is enough
+		std::vector<uint64_t> addedAt(vertexCount, 0);
+		uint64_t misses = 0;
+		for (size_t i = 0; i < indexCount; i++)
+		{
+			unsigned int v = indices[i];
+			if (addedAt[v] == 0 || misses - addedAt[v] >= cacheSize)
+			{
+				misses++;
+				addedAt[v] = misses;
+			}
+		}
+
+		// ATVR is relative to the vertices actually referenced
+		size_t usedVertices = 0;
+		for (uint64_t time : addedAt)
+			usedVertices += (time != 0);
+
+		stats.ACMR = (float)misses / (float)(indexCount / 3);
+		stats.ATVR = (float)misses / (float)usedVertices;
+		return stats;
+	}
+
+	// --------------------------------------------------------
+	// Tipsify: emits every triangle around a fanning vertex,
+	// then moves to whichever vertex touched by those triangles
+	// will still be in the cache after its own triangles are
+	// emitted, preferring the oldest one
+	// --------------------------------------------------------
+	void OptimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize)
+	{
+		size_t triangleCount = indices.size() / 3;
+		if (triangleCount == 0 || vertexCount == 0)
+			return;
+
+		TriangleAdjacency adjacency(indices, vertexCount);
+		std::vector<unsigned int> liveTriangles(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++)
+			liveTriangles[v] = adjacency.Offsets[v + 1] - adjacency.Offsets[v];
+
+		std::vector<unsigned int> cacheTime(vertexCount, 0);
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<unsigned int> deadEnds;
+		std::vector<unsigned int> candidates;
+		std::vector<unsigned int> output;
+		output.reserve(indices.size());
+
+		unsigned int time = cacheSize + 1;
+		size_t cursor = 0;
+		int fanning = SkipDeadEnd(deadEnds, liveTriangles, cursor, vertexCount);
+		while (fanning >= 0)
+		{
+			candidates.clear();
+			for (unsigned int a = adjacency.Offsets[fanning]; a < adjacency.Offsets[fanning + 1]; a++)
+			{
+				unsigned int t = adjacency.Triangles[a];
+				if (emitted[t])
+					continue;
+
+				for (int c = 0; c < 3; c++)
+				{
+					unsigned int v = indices[t * 3 + c];
+					output.push_back(v);
+					deadEnds.push_back(v);
+					candidates.push_back(v);
+					liveTriangles[v]--;
+					if (time - cacheTime[v] > cacheSize)
+						cacheTime[v] = time++;
+				}
+				emitted[t] = true;
+			}
+
+			// Best candidate is the oldest one that will still be
+			// cached once its remaining triangles are emitted
+			int next = -1;
+			unsigned int bestPriority = 0;
+			for (unsigned int v : candidates)
+			{
+				if (liveTriangles[v] == 0)
+					continue;
+
+				unsigned int priority = 0;
+				if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize)
+					priority = time - cacheTime[v];
+				if (next < 0 || priority > bestPriority)
+				{
+					bestPriority = priority;
+					next = (int)v;
+				}
+			}
+
+			fanning = (next >= 0) ? next : SkipDeadEnd(deadEnds, liveTriangles, cursor, vertexCount);
+		}
+
+		indices.swap(output);
+	}
+
+	void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+	{
+		const unsigned int unused = 0xFFFFFFFF;
+		std::vector<unsigned int> remap(vertices.size(), unused);
+		std::vector<Vertex> reordered;
+		reordered.reserve(vertices.size());
+
+		for (unsigned int& index : indices)
+		{
+			if (remap[index] == unused)
+			{
+				remap[index] = (unsigned int)reordered.size();
+				reordered.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+
+		vertices.swap(reordered);
+	}
+
+	Stats Optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, unsigned int cacheSize)
+	{
+		return Optimize(vertices, indices, { (unsigned int)indices.size() }, cacheSize);
+	}
+
+	Stats Optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, const std::vector<unsigned int>& partSizes, unsigned int cacheSize)
+	{
+		Stats stats = {};
+		stats.Before = AnalyzeVertexCache(indices.data(), indices.size(), vertices.size(), cacheSize);
+
+		if (partSizes.size() == 1)
+		{
+			OptimizeVertexCache(indices, vertices.size(), cacheSize);
+		}
+		else
+		{
+			// Each part is optimized on its own, since it may be drawn on its own
+			// - Parts are renumbered to only the vertices they use (kept in
+			//   the same order, so the result doesn't change), or every part
+			//   would pay for adjacency over the whole mesh's vertices
+			std::vector<unsigned int> localIndex(vertices.size(), 0);
+			std::vector<unsigned int> used;
+			std::vector<unsigned int> part;
+			size_t start = 0;
+			for (unsigned int size : partSizes)
+			{
+				used.assign(indices.begin() + start, indices.begin() + start + size);
+				std::sort(used.begin(), used.end());
+				used.erase(std::unique(used.begin(), used.end()), used.end());
+				for (size_t v = 0; v < used.size(); v++)
+					localIndex[used[v]] = (unsigned int)v;
+
+				part.resize(size);
+				for (size_t i = 0; i < size; i++)
+					part[i] = localIndex[indices[start + i]];
+				OptimizeVertexCache(part, used.size(), cacheSize);
+				for (size_t i = 0; i < size; i++)
+					indices[start + i] = used[part[i]];
+				start += size;
+			}
+		}
+
+		// Vertices are only renumbered, so the parts don't move
+		OptimizeVertexFetch(vertices, indices);
+
+		stats.After = AnalyzeVertexCache(indices.data(), indices.size(), vertices.size(), cacheSize);
+		return stats;
+	}
+
+	// --------------------------------------------------------
+	// Maps each vertex to the first vertex with exactly the same
+	// position, which joins up the two sides of UV and normal seams
+	// --------------------------------------------------------
+	std::vector<unsigned int> BuildPositionGroups(const Vertex* vertices, size_t vertexCount)
+	{
+		std::unordered_map<uint64_t, std::vector<unsigned int>> buckets;
+		std::vector<unsigned int> groups(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			const DirectX::XMFLOAT3& p = vertices[v].Position;
+			uint32_t bits[3];
+			memcpy(bits, &p, sizeof(bits));
+			uint64_t hash = ((uint64_t)bits[0] * 0x9E3779B97F4A7C15ull) ^ ((uint64_t)bits[1] * 0xC2B2AE3D27D4EB4Full) ^ bits[2];
+
+			groups[v] = (unsigned int)v;
+			std::vector<unsigned int>& bucket = buckets[hash];
+			for (unsigned int other : bucket)
+			{
+				if (memcmp(&vertices[other].Position, &p, sizeof(DirectX::XMFLOAT3)) == 0)
+				{
+					groups[v] = other;
+					break;
+				}
+			}
+			if (groups[v] == v)
+				bucket.push_back((unsigned int)v);
+		}
+		return groups;
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Reorders indexed meshes so the GPU does less work
+//
+// - Triangles are reordered with Tipsify (Sander et al.),
+//   so recently transformed vertices are reused while they
+//   are still in the post-transform cache
+// - Vertices are then reordered by first use, so the input
+//   assembler reads the vertex buffer front to back
+// --------------------------------------------------------
+namespace MeshOptimizer
+{
+	// Size of the simulated post-transform vertex cache
+	const unsigned int DefaultCacheSize = 16;
+
+	struct CacheStats
+	{
+		float ACMR;		// Average cache miss ratio (transformed verts per triangle)
+		float ATVR;		// Average transform to vertex ratio (1.0 is ideal)
+	};
+
+	struct Stats
+	{
+		CacheStats Before;
+		CacheStats After;
+	};
+
+	// Simulates a FIFO vertex cache over the index buffer (zeroed
+	// stats for fewer than three indices or no vertices)
+	CacheStats AnalyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = DefaultCacheSize);
+
+	// Reorders triangles for vertex cache locality (indices only)
+	void OptimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize = DefaultCacheSize);
+
+	// Reorders vertices into the order they're first used, dropping
+	// any that no triangle references, and remaps the indices
+	void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+	// For each vertex, the first vertex with exactly the same position
+	// (vertices split by UV or normal seams end up in one group)
+	std::vector<unsigned int> BuildPositionGroups(const Vertex* vertices, size_t vertexCount);
+
+	// Runs both passes and reports the cache behavior before and after
+	Stats Optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, unsigned int cacheSize = DefaultCacheSize);
+
+	// Same, but triangles only move within each part (runs of
+	// partSizes indices that cover the buffer, such as submeshes),
+	// so every part keeps its place in the index buffer
+	Stats Optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, const std::vector<unsigned int>& partSizes, unsigned int cacheSize = DefaultCacheSize);
+}
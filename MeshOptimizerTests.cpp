@@ -0,0 +1,98 @@
+#include "Tests.h"
+#include "MeshOptimizer.h"
+
+#include <chrono>
+#include <cstdio>
+#include <numeric>
+#include <vector>
+
+TEST(AnalyzeVertexCacheHandlesDegenerateInput)
+{
+	unsigned int indices[] = { 0, 1, 2, 2, 1, 3 };
+
+	// Too few indices for a triangle, or no vertices at all
+	for (size_t count = 0; count < 3; count++)
+	{
+		MeshOptimizer::CacheStats stats = MeshOptimizer::AnalyzeVertexCache(indices, count, 4);
+		CHECK(stats.ACMR == 0.0f);
+		CHECK(stats.ATVR == 0.0f);
+	}
+	MeshOptimizer::CacheStats empty = MeshOptimizer::AnalyzeVertexCache(indices, 6, 0);
+	CHECK(empty.ACMR == 0.0f);
+	CHECK(empty.ATVR == 0.0f);
+
+	// Two triangles sharing an edge miss once per vertex
+	MeshOptimizer::CacheStats stats = MeshOptimizer::AnalyzeVertexCache(indices, 6, 4);
+	CHECK(stats.ACMR == 2.0f);
+	CHECK(stats.ATVR == 1.0f);
+}
+
+namespace
+{
+	// --------------------------------------------------------
+	// A grid of quads split into parts of rows, where each part
+	// only uses its own band of the shared vertices
+	// --------------------------------------------------------
+	void MakePartedGrid(int size, int rowsPerPart, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, std::vector<unsigned int>& partSizes)
+	{
+		vertices.assign((size_t)(size + 1) * (size + 1), Vertex{});
+		for (size_t v = 0; v < vertices.size(); v++)
+			vertices[v].Position = DirectX::XMFLOAT3((float)(v % (size + 1)), 0.0f, (float)(v / (size + 1)));
+
+		unsigned int row = size + 1;
+		for (int z = 0; z < size; z++)
+		{
+			for (int x = 0; x < size; x++)
+			{
+				unsigned int a = z * row + x;
+				indices.insert(indices.end(), { a, a + row, a + row + 1, a, a + row + 1, a + 1 });
+			}
+			if ((z + 1) % rowsPerPart == 0 || z + 1 == size)
+				partSizes.push_back((unsigned int)indices.size() - std::accumulate(partSizes.begin(), partSizes.end(), 0u));
+		}
+	}
+}
+
+// Renumbering each part to its own vertices mustn't change the order it gets
+TEST(OptimizePartsMatchesWholeMeshNumbering)
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<unsigned int> partSizes;
+	MakePartedGrid(48, 5, vertices, indices, partSizes);
+	CHECK(partSizes.size() == 10);
+
+	// What each part's order was before: optimized against every vertex
+	std::vector<unsigned int> expected;
+	size_t start = 0;
+	for (unsigned int size : partSizes)
+	{
+		std::vector<unsigned int> part(indices.begin() + start, indices.begin() + start + size);
+		MeshOptimizer::OptimizeVertexCache(part, vertices.size());
+		expected.insert(expected.end(), part.begin(), part.end());
+		start += size;
+	}
+	std::vector<Vertex> expectedVertices = vertices;
+	MeshOptimizer::OptimizeVertexFetch(expectedVertices, expected);
+
+	MeshOptimizer::Stats stats = MeshOptimizer::Optimize(vertices, indices, partSizes);
+	CHECK(indices == expected);
+	CHECK(vertices.size() == expectedVertices.size());
+	CHECK(stats.After.ACMR <= stats.Before.ACMR);
+}
+
+// Many small parts over a large mesh, which used to cost O(parts x vertices)
+BENCHMARK(OptimizeManyParts)
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<unsigned int> partSizes;
+	MakePartedGrid(1000, 1, vertices, indices, partSizes);
+
+	auto start = std::chrono::steady_clock::now();
+	MeshOptimizer::Stats stats = MeshOptimizer::Optimize(vertices, indices, partSizes);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("  %zu parts, %zu vertices, %zu triangles: %.1f ms (ACMR %.3f -> %.3f)\n",
+		partSizes.size(), vertices.size(), indices.size() / 3, seconds * 1000.0, stats.Before.ACMR, stats.After.ACMR);
+	CHECK(stats.After.ACMR <= stats.Before.ACMR);
+}
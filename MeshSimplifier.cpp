@@ -0,0 +1,438 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+
+using namespace DirectX;
+
+namespace
+{
+	// --------------------------------------------------------
+	// Symmetric 4x4 matrix summing the squared distances to a
+	// set of planes (ax + by + cz + d = 0)
+	// --------------------------------------------------------
+	struct Quadric
+	{
+		float A2, AB, AC, AD;
+		float B2, BC, BD;
+		float C2, CD;
+		float D2;
+
+		void AddPlane(XMFLOAT3 n, float d)
+		{
+			A2 += n.x * n.x; AB += n.x * n.y; AC += n.x * n.z; AD += n.x * d;
+			B2 += n.y * n.y; BC += n.y * n.z; BD += n.y * d;
+			C2 += n.z * n.z; CD += n.z * d;
+			D2 += d * d;
+		}
+
+		void Add(const Quadric& q)
+		{
+			A2 += q.A2; AB += q.AB; AC += q.AC; AD += q.AD;
+			B2 += q.B2; BC += q.BC; BD += q.BD;
+			C2 += q.C2; CD += q.CD;
+			D2 += q.D2;
+		}
+
+		float Evaluate(XMFLOAT3 p) const
+		{
+			float result =
+				A2 * p.x * p.x + B2 * p.y * p.y + C2 * p.z * p.z +
+				2.0f * (AB * p.x * p.y + AC * p.x * p.z + BC * p.y * p.z) +
+				2.0f * (AD * p.x + BD * p.y + CD * p.z) +
+				D2;
+			return std::max(result, 0.0f);
+		}
+	};
+
+	// A candidate collapse of vertex From onto vertex To
+	struct Collapse
+	{
+		float Cost;
+		unsigned int From;
+		unsigned int To;
+
+		bool operator<(const Collapse& other) const
+		{
+			if (Cost != other.Cost) return Cost < other.Cost;
+			if (From != other.From) return From < other.From;
+			return To < other.To;
+		}
+	};
+
+	XMFLOAT3 TriangleNormal(XMFLOAT3 a, XMFLOAT3 b, XMFLOAT3 c)
+	{
+		XMFLOAT3 normal;
+		XMStoreFloat3(&normal, XMVector3Cross(
+			XMVectorSubtract(XMLoadFloat3(&b), XMLoadFloat3(&a)),
+			XMVectorSubtract(XMLoadFloat3(&c), XMLoadFloat3(&a))));
+		return normal;
+	}
+
+	// --------------------------------------------------------
+	// Positions on an edge that only one triangle uses (an open
+	// border), which must not move or the LOD would open holes
+	// - Indexed by position group, so a UV or normal seam (one
+	//   edge shared by two sets of vertices) isn't a border
+	// --------------------------------------------------------
+	std::vector<bool> FindBorderPositions(const std::vector<unsigned int>& groups, const std::vector<unsigned int>& indices)
+	{
+		// Undirected edges between positions, sorted so that
+		// matching edges end up next to each other
+		std::vector<uint64_t> edges;
+		edges.reserve(indices.size());
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			for (int e = 0; e < 3; e++)
+			{
+				uint64_t a = groups[indices[i + e]];
+				uint64_t b = groups[indices[i + (e + 1) % 3]];
+				edges.push_back(a < b ? (a << 32) | b : (b << 32) | a);
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+
+		std::vector<bool> border(groups.size(), false);
+		for (size_t i = 0; i < edges.size();)
+		{
+			size_t j = i + 1;
+			while (j < edges.size() && edges[j] == edges[i])
+				j++;
+			if (j - i == 1)
+			{
+				border[(unsigned int)(edges[i] >> 32)] = true;
+				border[(unsigned int)edges[i]] = true;
+			}
+			i = j;
+		}
+		return border;
+	}
+
+	// Triangles around each vertex, stored as one flat array with per-vertex offsets
+	struct TriangleAdjacency
+	{
+		std::vector<unsigned int> Offsets;
+		std::vector<unsigned int> Triangles;
+
+		void Build(const std::vector<unsigned int>& indices, size_t vertexCount)
+		{
+			Offsets.assign(vertexCount + 1, 0);
+			for (unsigned int index : indices)
+				Offsets[index + 1]++;
+			for (size_t v = 0; v < vertexCount; v++)
+				Offsets[v + 1] += Offsets[v];
+
+			std::vector<unsigned int> cursor(Offsets.begin(), Offsets.end() - 1);
+			Triangles.resize(indices.size());
+			for (size_t i = 0; i < indices.size(); i++)
+				Triangles[cursor[indices[i]]++] = (unsigned int)(i / 3);
+		}
+	};
+
+	// --------------------------------------------------------
+	// Finds the vertex at position group "to" that vertex from
+	// shares an edge with, which is the vertex it can collapse
+	// onto without changing which UVs and normals are used on
+	// that side of any seam (or -1 if there isn't one)
+	// --------------------------------------------------------
+	int FindCollapseTarget(
+		const std::vector<unsigned int>& indices,
+		const TriangleAdjacency& adjacency,
+		const std::vector<unsigned int>& groups,
+		unsigned int from,
+		unsigned int to)
+	{
+		int target = -1;
+		for (unsigned int a = adjacency.Offsets[from]; a < adjacency.Offsets[from + 1]; a++)
+		{
+			const unsigned int* tri = &indices[adjacency.Triangles[a] * 3];
+			for (int c = 0; c < 3; c++)
+			{
+				if (groups[tri[c]] == to && (target < 0 || tri[c] < (unsigned int)target))
+					target = (int)tri[c];
+			}
+		}
+		return target;
+	}
+
+	// --------------------------------------------------------
+	// Checks that moving from onto to won't turn any of the
+	// triangles around from inside out
+	// --------------------------------------------------------
+	bool CollapseFlipsTriangle(
+		const Vertex* vertices,
+		const std::vector<unsigned int>& indices,
+		const TriangleAdjacency& adjacency,
+		unsigned int from,
+		unsigned int to)
+	{
+		for (unsigned int a = adjacency.Offsets[from]; a < adjacency.Offsets[from + 1]; a++)
+		{
+			const unsigned int* tri = &indices[adjacency.Triangles[a] * 3];
+			if (tri[0] == to || tri[1] == to || tri[2] == to)
+				continue;
+
+			XMFLOAT3 before[3];
+			XMFLOAT3 after[3];
+			for (int c = 0; c < 3; c++)
+			{
+				before[c] = vertices[tri[c]].Position;
+				after[c] = vertices[tri[c] == from ? to : tri[c]].Position;
+			}
+
+			XMFLOAT3 n0 = TriangleNormal(before[0], before[1], before[2]);
+			XMFLOAT3 n1 = TriangleNormal(after[0], after[1], after[2]);
+			if (n0.x * n1.x + n0.y * n1.y + n0.z * n1.z <= 0.0f)
+				return true;
+		}
+		return false;
+	}
+}
+
+namespace MeshSimplifier
+{
+	// --------------------------------------------------------
+	// Collapses are between positions rather than vertices, so
+	// every vertex at a seam position moves together, each onto
+	// the vertex on its own side of the seam.  A collapse that
+	// would drag a seam vertex off its seam has no such vertex
+	// for one side, and is skipped.
+	// --------------------------------------------------------
+	std::vector<unsigned int> Simplify(
+		const Vertex* vertices,
+		size_t vertexCount,
+		const std::vector<unsigned int>& indices,
+		size_t targetIndexCount,
+		float maxError,
+		float* resultError)
+	{
+		std::vector<unsigned int> result = indices;
+		std::vector<unsigned int> groups = MeshOptimizer::BuildPositionGroups(vertices, vertexCount);
+		std::vector<bool> border = FindBorderPositions(groups, indices);
+
+		// The vertices at each position, as a flat array with offsets
+		std::vector<unsigned int> memberOffsets(vertexCount + 1, 0);
+		std::vector<unsigned int> members(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++)
+			memberOffsets[groups[v] + 1]++;
+		for (size_t g = 0; g < vertexCount; g++)
+			memberOffsets[g + 1] += memberOffsets[g];
+		{
+			std::vector<unsigned int> cursor(memberOffsets.begin(), memberOffsets.end() - 1);
+			for (size_t v = 0; v < vertexCount; v++)
+				members[cursor[groups[v]]++] = (unsigned int)v;
+		}
+
+		// Each position starts with the planes of the triangles around it
+		std::vector<Quadric> quadrics(vertexCount, Quadric{});
+		for (size_t i = 0; i + 2 < result.size(); i += 3)
+		{
+			XMFLOAT3 p0 = vertices[result[i]].Position;
+			XMFLOAT3 n = TriangleNormal(p0, vertices[result[i + 1]].Position, vertices[result[i + 2]].Position);
+			float length = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+			if (length == 0.0f)
+				continue;
+
+			n = XMFLOAT3(n.x / length, n.y / length, n.z / length);
+			float d = -(n.x * p0.x + n.y * p0.y + n.z * p0.z);
+			for (int c = 0; c < 3; c++)
+				quadrics[groups[result[i + c]]].AddPlane(n, d);
+		}
+
+		float maxCost = (maxError < sqrtf(FLT_MAX)) ? maxError * maxError : FLT_MAX;
+		float worstCost = 0.0f;
+		TriangleAdjacency adjacency;
+		std::vector<Collapse> collapses;
+		std::vector<unsigned int> remap(vertexCount);
+		std::vector<unsigned int> targets;
+		std::vector<bool> touched(vertexCount);
+
+		// Each pass collapses as many independent edges as it can,
+		// cheapest first, then rebuilds the triangle list
+		while (result.size() > targetIndexCount)
+		{
+			adjacency.Build(result, vertexCount);
+
+			collapses.clear();
+			for (size_t i = 0; i < result.size(); i += 3)
+			{
+				for (int e = 0; e < 3; e++)
+				{
+					unsigned int a = groups[result[i + e]];
+					unsigned int b = groups[result[i + (e + 1) % 3]];
+					XMFLOAT3 pa = vertices[a].Position;
+					XMFLOAT3 pb = vertices[b].Position;
+
+					if (!border[a])
+						collapses.push_back({ quadrics[a].Evaluate(pb) + quadrics[b].Evaluate(pb), a, b });
+					if (!border[b])
+						collapses.push_back({ quadrics[a].Evaluate(pa) + quadrics[b].Evaluate(pa), b, a });
+				}
+			}
+			std::sort(collapses.begin(), collapses.end());
+			collapses.erase(std::unique(collapses.begin(), collapses.end(),
+				[](const Collapse& x, const Collapse& y) { return x.From == y.From && x.To == y.To; }),
+				collapses.end());
+
+			// A collapse moves every triangle around its position, so
+			// nothing touching those triangles can collapse again this pass
+			for (size_t v = 0; v < vertexCount; v++)
+				remap[v] = (unsigned int)v;
+			touched.assign(vertexCount, false);
+
+			size_t trianglesToRemove = (result.size() - targetIndexCount + 2) / 3;
+			size_t collapsed = 0;
+			for (const Collapse& collapse : collapses)
+			{
+				if (collapse.Cost > maxCost || trianglesToRemove == 0)
+					break;
+				if (touched[collapse.From] || touched[collapse.To])
+					continue;
+
+				// Every vertex still in use at this position needs a
+				// partner to move onto, and none of the moves can flip
+				bool valid = true;
+				targets.clear();
+				for (unsigned int m = memberOffsets[collapse.From]; m < memberOffsets[collapse.From + 1] && valid; m++)
+				{
+					unsigned int from = members[m];
+					if (adjacency.Offsets[from] == adjacency.Offsets[from + 1])
+						continue;
+
+					int to = FindCollapseTarget(result, adjacency, groups, from, collapse.To);
+					valid = to >= 0 && !CollapseFlipsTriangle(vertices, result, adjacency, from, (unsigned int)to);
+					targets.push_back(from);
+					targets.push_back((unsigned int)to);
+				}
+				if (!valid)
+					continue;
+
+				size_t removed = 0;
+				for (size_t t = 0; t < targets.size(); t += 2)
+				{
+					unsigned int from = targets[t];
+					for (unsigned int a = adjacency.Offsets[from]; a < adjacency.Offsets[from + 1]; a++)
+					{
+						const unsigned int* tri = &result[adjacency.Triangles[a] * 3];
+						bool hasTarget = false;
+						for (int c = 0; c < 3; c++)
+						{
+							hasTarget |= (groups[tri[c]] == collapse.To);
+							touched[groups[tri[c]]] = true;
+						}
+						removed += hasTarget;
+					}
+					remap[from] = targets[t + 1];
+				}
+
+				quadrics[collapse.To].Add(quadrics[collapse.From]);
+				worstCost = std::max(worstCost, collapse.Cost);
+				trianglesToRemove -= std::min(trianglesToRemove, removed);
+				collapsed++;
+			}
+
+			if (collapsed == 0)
+				break;
+
+			// Apply the collapses and drop the triangles that disappeared
+			// (including any left with two corners at the same position)
+			size_t write = 0;
+			for (size_t i = 0; i < result.size(); i += 3)
+			{
+				unsigned int a = remap[result[i]];
+				unsigned int b = remap[result[i + 1]];
+				unsigned int c = remap[result[i + 2]];
+				if (groups[a] == groups[b] || groups[b] == groups[c] || groups[a] == groups[c])
+					continue;
+
+				result[write++] = a;
+				result[write++] = b;
+				result[write++] = c;
+			}
+			result.resize(write);
+		}
+
+		if (resultError)
+			*resultError = sqrtf(worstCost);
+		return result;
+	}
+
+	std::vector<LodRange> BuildLodChain(
+		const std::vector<Vertex>& vertices,
+		std::vector<unsigned int>& indices,
+		unsigned int lodCount,
+		bool optimizeVertexCache,
+		const std::vector<unsigned int>& partSizes,
+		std::vector<LodRange>* partLods)
+	{
+		std::vector<LodRange> lods;
+		lods.push_back({ 0, (unsigned int)indices.size(), 0.0f });
+
+		// Without parts, the whole mesh is the only part
+		std::vector<unsigned int> sizes = partSizes;
+		if (sizes.empty())
+			sizes.push_back((unsigned int)indices.size());
+
+		std::vector<std::vector<unsigned int>> previous(sizes.size());
+		std::vector<LodRange> ranges(sizes.size());
+		unsigned int start = 0;
+		for (size_t p = 0; p < sizes.size(); p++)
+		{
+			previous[p].assign(indices.begin() + start, indices.begin() + start + sizes[p]);
+			ranges[p] = { start, sizes[p], 0.0f };
+			start += sizes[p];
+		}
+		std::vector<LodRange> allRanges = ranges;
+
+		std::vector<std::vector<unsigned int>> level(sizes.size());
+		for (unsigned int i = 1; i < lodCount; i++)
+		{
+			size_t levelCount = 0;
+			std::vector<float> errors(sizes.size());
+			for (size_t p = 0; p < sizes.size(); p++)
+			{
+				float error = 0.0f;
+				size_t target = previous[p].size() / 6 * 3;
+				level[p] = Simplify(vertices.data(), vertices.size(), previous[p], target, FLT_MAX, &error);
+
+				// A part that can't get meaningfully simpler stays as it
+				// was, rather than dropping out of the level
+				if (level[p].empty() || level[p].size() * 4 > previous[p].size() * 3)
+				{
+					level[p] = previous[p];
+					error = 0.0f;
+				}
+				else if (optimizeVertexCache)
+				{
+					MeshOptimizer::OptimizeVertexCache(level[p], vertices.size());
+				}
+
+				// Errors accumulate, since each level starts from the last
+				errors[p] = ranges[p].Error + error;
+				levelCount += level[p].size();
+			}
+
+			// Stop once the mesh as a whole can't get meaningfully simpler
+			if (levelCount == 0 || levelCount * 4 > lods.back().IndexCount * 3)
+				break;
+
+			LodRange lod = { (unsigned int)indices.size(), (unsigned int)levelCount, 0.0f };
+			for (size_t p = 0; p < sizes.size(); p++)
+			{
+				ranges[p] = { (unsigned int)indices.size(), (unsigned int)level[p].size(), errors[p] };
+				lod.Error = std::max(lod.Error, errors[p]);
+				indices.insert(indices.end(), level[p].begin(), level[p].end());
+				previous[p].swap(level[p]);
+			}
+			lods.push_back(lod);
+			allRanges.insert(allRanges.end(), ranges.begin(), ranges.end());
+		}
+
+		if (partLods)
+			*partLods = allRanges;
+		return lods;
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Quadric error metric simplification for building LODs
+//
+// - Works by collapsing edges onto existing vertices, so
+//   every LOD can share the full mesh's vertex buffer
+// - Vertices on UV or normal seams (the same position used
+//   by several vertices) only ever slide along the seam, and
+//   vertices on open borders never move, so LODs don't tear
+//   textures, smear hard edges or open holes
+// - Has no dependency on Direct3D and gives the same result
+//   for the same input every time
+// --------------------------------------------------------
+namespace MeshSimplifier
+{
+	// One level of detail within a shared index buffer
+	struct LodRange
+	{
+		unsigned int IndexStart;
+		unsigned int IndexCount;
+		float Error;		// Object space distance from the full mesh
+	};
+
+	// Returns a simplified copy of indices with at most targetIndexCount
+	// indices (if possible), using only vertices from the same array
+	// - Stops early when no further collapse keeps the error at or
+	//   below maxError
+	std::vector<unsigned int> Simplify(
+		const Vertex* vertices,
+		size_t vertexCount,
+		const std::vector<unsigned int>& indices,
+		size_t targetIndexCount,
+		float maxError,
+		float* resultError = nullptr);
+
+	// Appends up to lodCount - 1 simplified versions of the mesh to
+	// indices (each targeting half the triangles of the last) and
+	// returns the range of every level, the full mesh first
+	// - When partSizes splits the full mesh into consecutive parts
+	//   (such as submeshes), each part is simplified on its own and
+	//   keeps its order within every level, and partLods receives
+	//   each part's range in every level (level by level)
+	std::vector<LodRange> BuildLodChain(
+		const std::vector<Vertex>& vertices,
+		std::vector<unsigned int>& indices,
+		unsigned int lodCount,
+		bool optimizeVertexCache,
+		const std::vector<unsigned int>& partSizes = {},
+		std::vector<LodRange>* partLods = nullptr);
+}
@@ -0,0 +1,330 @@
+#include "Tests.h"
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <map>
+#include <set>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	// --------------------------------------------------------
+	// A grid of size x size quads in the XZ plane, displaced
+	// along Y by bumps of the given height (zero for flat)
+	// --------------------------------------------------------
+	void MakeGrid(int size, float height, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+	{
+		for (int z = 0; z <= size; z++)
+		{
+			for (int x = 0; x <= size; x++)
+			{
+				Vertex v = {};
+				v.Position = XMFLOAT3(x * 0.1f, height * sinf(x * 0.25f) * cosf(z * 0.3f), z * 0.1f);
+				v.Normal = XMFLOAT3(0, 1, 0);
+				vertices.push_back(v);
+			}
+		}
+		unsigned int row = size + 1;
+		for (int z = 0; z < size; z++)
+		{
+			for (int x = 0; x < size; x++)
+			{
+				unsigned int a = z * row + x;
+				indices.insert(indices.end(), { a, a + row, a + row + 1, a, a + row + 1, a + 1 });
+			}
+		}
+	}
+
+	// Closest point on a triangle (Ericson, Real-Time Collision Detection 5.1.5)
+	XMVECTOR ClosestPointOnTriangle(XMVECTOR p, XMVECTOR a, XMVECTOR b, XMVECTOR c)
+	{
+		XMVECTOR ab = b - a;
+		XMVECTOR ac = c - a;
+		XMVECTOR ap = p - a;
+		float d1 = XMVectorGetX(XMVector3Dot(ab, ap));
+		float d2 = XMVectorGetX(XMVector3Dot(ac, ap));
+		if (d1 <= 0.0f && d2 <= 0.0f)
+			return a;
+
+		XMVECTOR bp = p - b;
+		float d3 = XMVectorGetX(XMVector3Dot(ab, bp));
+		float d4 = XMVectorGetX(XMVector3Dot(ac, bp));
+		if (d3 >= 0.0f && d4 <= d3)
+			return b;
+
+		float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+			return a + ab * (d1 / (d1 - d3));
+
+		XMVECTOR cp = p - c;
+		float d5 = XMVectorGetX(XMVector3Dot(ab, cp));
+		float d6 = XMVectorGetX(XMVector3Dot(ac, cp));
+		if (d6 >= 0.0f && d5 <= d6)
+			return c;
+
+		float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+			return a + ac * (d2 / (d2 - d6));
+
+		float va = d3 * d6 - d5 * d4;
+		if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+			return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+		float denominator = 1.0f / (va + vb + vc);
+		return a + ab * (vb * denominator) + ac * (vc * denominator);
+	}
+
+	// --------------------------------------------------------
+	// How far the full mesh strays from a simplified one: the
+	// largest distance from an original vertex to the nearest
+	// simplified triangle
+	// --------------------------------------------------------
+	float MeasureError(const std::vector<Vertex>& vertices, const unsigned int* indices, size_t indexCount)
+	{
+		float worst = 0.0f;
+		for (const Vertex& vertex : vertices)
+		{
+			XMVECTOR p = XMLoadFloat3(&vertex.Position);
+			float nearest = FLT_MAX;
+			for (size_t i = 0; i + 2 < indexCount; i += 3)
+			{
+				XMVECTOR closest = ClosestPointOnTriangle(p,
+					XMLoadFloat3(&vertices[indices[i]].Position),
+					XMLoadFloat3(&vertices[indices[i + 1]].Position),
+					XMLoadFloat3(&vertices[indices[i + 2]].Position));
+				nearest = std::min(nearest, XMVectorGetX(XMVector3Length(p - closest)));
+			}
+			worst = std::max(worst, nearest);
+		}
+		return worst;
+	}
+
+	// --------------------------------------------------------
+	// Whether any triangle faces down (the grids all face up)
+	// - Collapses can leave slivers whose normal lies flat, so
+	//   only a clearly downward normal counts as flipped
+	// --------------------------------------------------------
+	bool HasFlippedTriangle(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices)
+	{
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			XMVECTOR a = XMLoadFloat3(&vertices[indices[i]].Position);
+			XMVECTOR b = XMLoadFloat3(&vertices[indices[i + 1]].Position);
+			XMVECTOR c = XMLoadFloat3(&vertices[indices[i + 2]].Position);
+			if (XMVectorGetY(XMVector3Normalize(XMVector3Cross(b - a, c - a))) < -0.001f)
+				return true;
+		}
+		return false;
+	}
+
+	// --------------------------------------------------------
+	// A grid folded into a ridge along row creaseZ (a hard
+	// edge, so each side has its own normals there) and cut
+	// by a UV seam along column seamX, with every vertex on
+	// those lines split into one copy per side (four where
+	// they cross), sharing positions
+	// - sides receives each vertex's side of the seam (bit 0)
+	//   and of the crease (bit 1); triangles only ever use
+	//   vertices of one side
+	// --------------------------------------------------------
+	void MakeSeamedGrid(int size, int seamX, int creaseZ,
+		std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, std::vector<unsigned int>& sides)
+	{
+		std::vector<int> lookup((size + 1) * (size + 1) * 4, -1);
+		auto corner = [&](int x, int z, unsigned int side)
+		{
+			// Vertices off the lines are the same for any side they touch
+			side &= (x == seamX ? 1 : 0) | (z == creaseZ ? 2 : 0);
+			side |= (x > seamX ? 1 : 0) | (z > creaseZ ? 2 : 0);
+			int& index = lookup[((z * (size + 1)) + x) * 4 + side];
+			if (index < 0)
+			{
+				float slope = (side & 2) ? 0.3f : -0.3f;
+				Vertex v = {};
+				v.Position = XMFLOAT3(x * 0.1f, -0.3f * fabsf((z - creaseZ) * 0.1f), z * 0.1f);
+				v.UV = XMFLOAT2((side & 1) ? x / (float)size + 0.5f : x / (float)size, z / (float)size);
+				XMStoreFloat3(&v.Normal, XMVector3Normalize(XMVectorSet(0, 1, slope, 0)));
+				index = (int)vertices.size();
+				vertices.push_back(v);
+				sides.push_back(side);
+			}
+			return (unsigned int)index;
+		};
+
+		for (int z = 0; z < size; z++)
+		{
+			for (int x = 0; x < size; x++)
+			{
+				unsigned int side = (x >= seamX ? 1 : 0) | (z >= creaseZ ? 2 : 0);
+				unsigned int a = corner(x, z, side);
+				unsigned int b = corner(x, z + 1, side);
+				unsigned int c = corner(x + 1, z + 1, side);
+				unsigned int d = corner(x + 1, z, side);
+				indices.insert(indices.end(), { a, b, c, a, c, d });
+			}
+		}
+	}
+
+	bool IndicesInRange(const std::vector<unsigned int>& indices, size_t vertexCount)
+	{
+		for (unsigned int index : indices)
+		{
+			if (index >= vertexCount)
+				return false;
+		}
+		return true;
+	}
+}
+
+// Coplanar collapses cost nothing, and the border must stay put
+TEST(SimplifyFlatGridHasNoError)
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeGrid(16, 0.0f, vertices, indices);
+
+	float error = -1.0f;
+	std::vector<unsigned int> result = MeshSimplifier::Simplify(vertices.data(), vertices.size(), indices, indices.size() / 4, 0.0f, &error);
+	CHECK(!result.empty());
+	CHECK(result.size() <= indices.size() / 4);
+	CHECK(error == 0.0f);
+	CHECK(IndicesInRange(result, vertices.size()));
+	CHECK(!HasFlippedTriangle(vertices, result));
+
+	// Every corner of the grid is still there
+	const unsigned int corners[] = { 0, 16, 17 * 16, 17 * 17 - 1 };
+	for (unsigned int corner : corners)
+		CHECK(std::find(result.begin(), result.end(), corner) != result.end());
+}
+
+// The error Simplify() reports bounds how far the original strays
+TEST(SimplifyErrorBoundsDistance)
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeGrid(40, 0.2f, vertices, indices);
+
+	const float maxErrors[] = { 0.001f, 0.005f, 0.02f, 0.05f, FLT_MAX };
+	size_t lastSize = indices.size() + 1;
+	for (float maxError : maxErrors)
+	{
+		float error = -1.0f;
+		std::vector<unsigned int> result = MeshSimplifier::Simplify(vertices.data(), vertices.size(), indices, 0, maxError, &error);
+		CHECK(!result.empty());
+		CHECK(error >= 0.0f && error <= maxError);
+		CHECK(MeasureError(vertices, result.data(), result.size()) <= error + 1e-5f);
+		CHECK(IndicesInRange(result, vertices.size()));
+		CHECK(!HasFlippedTriangle(vertices, result));
+
+		// And a looser bound removes more triangles
+		CHECK(result.size() < lastSize);
+		lastSize = result.size();
+	}
+}
+
+// Each level's accumulated error still bounds its distance from the full mesh
+TEST(LodChainErrorBoundsDistance)
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeGrid(40, 0.2f, vertices, indices);
+	size_t fullCount = indices.size();
+
+	std::vector<MeshSimplifier::LodRange> lods = MeshSimplifier::BuildLodChain(vertices, indices, 4, true);
+	CHECK(lods.size() == 4);
+	CHECK(lods[0].IndexStart == 0 && lods[0].IndexCount == fullCount && lods[0].Error == 0.0f);
+	for (size_t i = 1; i < lods.size(); i++)
+	{
+		const MeshSimplifier::LodRange& lod = lods[i];
+		CHECK(lod.IndexStart == lods[i - 1].IndexStart + lods[i - 1].IndexCount);
+		CHECK(lod.IndexCount * 4 <= lods[i - 1].IndexCount * 3);
+		CHECK(lod.Error >= lods[i - 1].Error);
+		CHECK(MeasureError(vertices, &indices[lod.IndexStart], lod.IndexCount) <= lod.Error + 1e-5f);
+	}
+	CHECK(indices.size() == (size_t)lods.back().IndexStart + lods.back().IndexCount);
+	CHECK(IndicesInRange(indices, vertices.size()));
+}
+
+// --------------------------------------------------------
+// Seams survive simplification: each side's outline only
+// runs along the mesh border, the UV seam or the crease, and
+// every edge on the seam or crease still meets its twin on
+// the other side (the other copies of the same positions)
+// --------------------------------------------------------
+TEST(SimplifyKeepsSeamsClosed)
+{
+	const int size = 24;
+	const int seamX = 9;
+	const int creaseZ = 14;
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<unsigned int> sides;
+	MakeSeamedGrid(size, seamX, creaseZ, vertices, indices, sides);
+
+	float error = -1.0f;
+	std::vector<unsigned int> result = MeshSimplifier::Simplify(vertices.data(), vertices.size(), indices, indices.size() / 4, 1e-4f, &error);
+	CHECK(!result.empty());
+	CHECK(result.size() <= indices.size() / 4);
+	CHECK(IndicesInRange(result, vertices.size()));
+
+	// Grid coordinates of a vertex
+	auto gridX = [&](unsigned int i) { return (int)lroundf(vertices[i].Position.x * 10.0f); };
+	auto gridZ = [&](unsigned int i) { return (int)lroundf(vertices[i].Position.z * 10.0f); };
+
+	// No triangle mixes sides (which would tear the UVs or smear the crease)
+	unsigned int mixed = 0;
+	for (size_t i = 0; i < result.size(); i += 3)
+		mixed += sides[result[i]] != sides[result[i + 1]] || sides[result[i]] != sides[result[i + 2]];
+	CHECK(mixed == 0);
+
+	// Edges used once (each side's outline), by vertex, and every
+	// edge at all, by position (as grid coordinates)
+	std::map<std::pair<unsigned int, unsigned int>, int> edgeUses;
+	std::set<std::pair<std::pair<int, int>, std::pair<int, int>>> positionEdges;
+	for (size_t i = 0; i < result.size(); i++)
+	{
+		unsigned int a = result[i];
+		unsigned int b = result[i % 3 == 2 ? i - 2 : i + 1];
+		edgeUses[{ std::min(a, b), std::max(a, b) }]++;
+		positionEdges.insert({ { gridX(a), gridZ(a) }, { gridX(b), gridZ(b) } });
+	}
+
+	unsigned int offLines = 0;
+	unsigned int unmatched = 0;
+	unsigned int seamEdges = 0;
+	for (const auto& edge : edgeUses)
+	{
+		if (edge.second != 1)
+			continue;
+		unsigned int a = edge.first.first;
+		unsigned int b = edge.first.second;
+		int ax = gridX(a), az = gridZ(a), bx = gridX(b), bz = gridZ(b);
+		bool border = (ax == bx && (ax == 0 || ax == size)) || (az == bz && (az == 0 || az == size));
+		bool seam = ax == seamX && bx == seamX;
+		bool crease = az == creaseZ && bz == creaseZ;
+		offLines += !border && !seam && !crease;
+
+		// The twin runs the other way, in the neighboring side's triangle
+		if (!border && (seam || crease))
+		{
+			seamEdges++;
+			unmatched += !positionEdges.count({ { bx, bz }, { ax, az } });
+		}
+	}
+	CHECK(offLines == 0);
+	CHECK(unmatched == 0);
+	CHECK(seamEdges > 0);
+
+	// Seams were simplified too (sliding along their line), not just kept whole
+	std::set<unsigned int> seamVertices;
+	for (unsigned int index : result)
+	{
+		if (gridX(index) == seamX)
+			seamVertices.insert(index);
+	}
+	CHECK(seamVertices.size() < (size_t)(size + 1) * 2);
+}
@@ -0,0 +1,394 @@
+#include "MeshTangents.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+
+using namespace DirectX;
+
+namespace
+{
+	// Work per thread below which starting threads costs more than it saves
+	const size_t minTrianglesPerThread = 32768;
+	const size_t minVerticesPerThread = 16384;
+
+	// --------------------------------------------------------
+	// Runs work(begin, end) over [0, count), split into up to
+	// maxThreads ranges, with the calling thread taking one
+	// --------------------------------------------------------
+	template <typename Work>
+	void ParallelFor(size_t count, size_t minPerThread, unsigned int maxThreads, const Work& work)
+	{
+		size_t threadCount = maxThreads > 0 ? maxThreads : std::max(1u, std::thread::hardware_concurrency());
+		threadCount = std::min(threadCount, std::max<size_t>(1, count / minPerThread));
+
+		std::vector<std::thread> threads;
+		for (size_t i = 1; i < threadCount; i++)
+			threads.emplace_back(work, count * i / threadCount, count * (i + 1) / threadCount);
+		work(0, count / threadCount);
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+
+	// The same vector member of four vertices, transposed so
+	// that x, y and z each hold one component of all four
+	void LoadTransposed(const Vertex* vertices, const unsigned int (&index)[4], XMFLOAT3 Vertex::* member, XMVECTOR& x, XMVECTOR& y, XMVECTOR& z)
+	{
+		XMMATRIX m(
+			XMLoadFloat3(&(vertices[index[0]].*member)),
+			XMLoadFloat3(&(vertices[index[1]].*member)),
+			XMLoadFloat3(&(vertices[index[2]].*member)),
+			XMLoadFloat3(&(vertices[index[3]].*member)));
+		m = XMMatrixTranspose(m);
+		x = m.r[0];
+		y = m.r[1];
+		z = m.r[2];
+	}
+
+	void LoadTransposedUV(const Vertex* vertices, const unsigned int (&index)[4], XMVECTOR& u, XMVECTOR& v)
+	{
+		XMMATRIX m(
+			XMLoadFloat2(&vertices[index[0]].UV),
+			XMLoadFloat2(&vertices[index[1]].UV),
+			XMLoadFloat2(&vertices[index[2]].UV),
+			XMLoadFloat2(&vertices[index[3]].UV));
+		m = XMMatrixTranspose(m);
+		u = m.r[0];
+		v = m.r[1];
+	}
+
+	// Transposes four lanes back and stores them as consecutive XMFLOAT4s,
+	// stride apart (lane 0 at out[0], lane 1 at out[stride], ...)
+	void StoreTransposed(XMFLOAT4A* out, size_t stride, XMVECTOR x, XMVECTOR y, XMVECTOR z, XMVECTOR w)
+	{
+		XMMATRIX m = XMMatrixTranspose(XMMATRIX(x, y, z, w));
+		for (size_t lane = 0; lane < 4; lane++)
+			XMStoreFloat4A(&out[lane * stride], m.r[lane]);
+	}
+
+	XMVECTOR Dot(XMVECTOR ax, XMVECTOR ay, XMVECTOR az, XMVECTOR bx, XMVECTOR by, XMVECTOR bz)
+	{
+		return XMVectorMultiplyAdd(az, bz, XMVectorMultiplyAdd(ay, by, XMVectorMultiply(ax, bx)));
+	}
+
+	// Normalizes four vectors at once, leaving zero length ones at zero
+	void Normalize(XMVECTOR& x, XMVECTOR& y, XMVECTOR& z)
+	{
+		XMVECTOR lengthSq = Dot(x, y, z, x, y, z);
+		XMVECTOR scale = XMVectorSelect(XMVectorReciprocalSqrt(lengthSq), XMVectorZero(), XMVectorEqual(lengthSq, XMVectorZero()));
+		x = XMVectorMultiply(x, scale);
+		y = XMVectorMultiply(y, scale);
+		z = XMVectorMultiply(z, scale);
+	}
+
+	// Removes the normal's part of four vectors and normalizes what's left
+	void ProjectOntoPlane(XMVECTOR& x, XMVECTOR& y, XMVECTOR& z, XMVECTOR nx, XMVECTOR ny, XMVECTOR nz)
+	{
+		XMVECTOR d = Dot(x, y, z, nx, ny, nz);
+		x = XMVectorNegativeMultiplySubtract(nx, d, x);
+		y = XMVectorNegativeMultiplySubtract(ny, d, y);
+		z = XMVectorNegativeMultiplySubtract(nz, d, z);
+		Normalize(x, y, z);
+	}
+
+	// --------------------------------------------------------
+	// Tangents of triangles [begin, end), four at a time, with
+	// lanes past the last triangle repeating it
+	// - Fast mode writes one tangent (w = signed uv area) and
+	//   one bitangent per triangle, both divided by the area
+	// - MikkTSpace mode writes one tangent per corner, already
+	//   projected onto that corner's normal and scaled by its
+	//   angle (w = sign of the uv area)
+	// - Degenerate triangles write zeroes
+	// --------------------------------------------------------
+	void ComputeTriangles(
+		const Vertex* vertices,
+		const unsigned int* indices,
+		size_t triangleCount,
+		size_t begin,
+		size_t end,
+		MeshTangents::Mode mode,
+		XMFLOAT4A* tangents,
+		XMFLOAT4A* bitangents)
+	{
+		const XMVECTOR zero = XMVectorZero();
+		const XMVECTOR one = XMVectorSplatOne();
+		for (size_t t = begin; t < end; t += 4)
+		{
+			unsigned int corners[3][4];
+			for (int lane = 0; lane < 4; lane++)
+			{
+				size_t triangle = std::min(t + lane, triangleCount - 1);
+				for (int k = 0; k < 3; k++)
+					corners[k][lane] = indices[triangle * 3 + k];
+			}
+
+			XMVECTOR px[3], py[3], pz[3], u[3], v[3];
+			for (int k = 0; k < 3; k++)
+			{
+				LoadTransposed(vertices, corners[k], &Vertex::Position, px[k], py[k], pz[k]);
+				LoadTransposedUV(vertices, corners[k], u[k], v[k]);
+			}
+
+			// Edges from the first corner, in position and uv space
+			XMVECTOR e1x = XMVectorSubtract(px[1], px[0]);
+			XMVECTOR e1y = XMVectorSubtract(py[1], py[0]);
+			XMVECTOR e1z = XMVectorSubtract(pz[1], pz[0]);
+			XMVECTOR e2x = XMVectorSubtract(px[2], px[0]);
+			XMVECTOR e2y = XMVectorSubtract(py[2], py[0]);
+			XMVECTOR e2z = XMVectorSubtract(pz[2], pz[0]);
+			XMVECTOR du1 = XMVectorSubtract(u[1], u[0]);
+			XMVECTOR dv1 = XMVectorSubtract(v[1], v[0]);
+			XMVECTOR du2 = XMVectorSubtract(u[2], u[0]);
+			XMVECTOR dv2 = XMVectorSubtract(v[2], v[0]);
+
+			// Scaled by the signed uv area
+			XMVECTOR area = XMVectorNegativeMultiplySubtract(du2, dv1, XMVectorMultiply(du1, dv2));
+			XMVECTOR tx = XMVectorNegativeMultiplySubtract(dv1, e2x, XMVectorMultiply(dv2, e1x));
+			XMVECTOR ty = XMVectorNegativeMultiplySubtract(dv1, e2y, XMVectorMultiply(dv2, e1y));
+			XMVECTOR tz = XMVectorNegativeMultiplySubtract(dv1, e2z, XMVectorMultiply(dv2, e1z));
+			XMVECTOR degenerate = XMVectorEqual(area, zero);
+
+			if (mode == MeshTangents::Mode::Fast)
+			{
+				// Divide out the area, except where there is none
+				XMVECTOR scale = XMVectorSelect(XMVectorDivide(one, area), zero, degenerate);
+				XMVECTOR bx = XMVectorNegativeMultiplySubtract(du2, e1x, XMVectorMultiply(du1, e2x));
+				XMVECTOR by = XMVectorNegativeMultiplySubtract(du2, e1y, XMVectorMultiply(du1, e2y));
+				XMVECTOR bz = XMVectorNegativeMultiplySubtract(du2, e1z, XMVectorMultiply(du1, e2z));
+				StoreTransposed(&tangents[t], 1, XMVectorMultiply(tx, scale), XMVectorMultiply(ty, scale), XMVectorMultiply(tz, scale), XMVectorSelect(area, zero, degenerate));
+				StoreTransposed(&bitangents[t], 1, XMVectorMultiply(bx, scale), XMVectorMultiply(by, scale), XMVectorMultiply(bz, scale), zero);
+				continue;
+			}
+
+			// Unit tangent, flipped back where the area is negative
+			XMVECTOR sign = XMVectorSelect(XMVectorNegate(one), one, XMVectorGreater(area, zero));
+			sign = XMVectorSelect(sign, zero, degenerate);
+			tx = XMVectorMultiply(tx, sign);
+			ty = XMVectorMultiply(ty, sign);
+			tz = XMVectorMultiply(tz, sign);
+			Normalize(tx, ty, tz);
+
+			for (int k = 0; k < 3; k++)
+			{
+				XMVECTOR nx, ny, nz;
+				LoadTransposed(vertices, corners[k], &Vertex::Normal, nx, ny, nz);
+				Normalize(nx, ny, nz);
+
+				// Angle between the corner's edges, within the tangent plane
+				int next = (k + 1) % 3;
+				int previous = (k + 2) % 3;
+				XMVECTOR ax = XMVectorSubtract(px[next], px[k]);
+				XMVECTOR ay = XMVectorSubtract(py[next], py[k]);
+				XMVECTOR az = XMVectorSubtract(pz[next], pz[k]);
+				XMVECTOR bx = XMVectorSubtract(px[previous], px[k]);
+				XMVECTOR by = XMVectorSubtract(py[previous], py[k]);
+				XMVECTOR bz = XMVectorSubtract(pz[previous], pz[k]);
+				ProjectOntoPlane(ax, ay, az, nx, ny, nz);
+				ProjectOntoPlane(bx, by, bz, nx, ny, nz);
+				XMVECTOR angle = XMVectorACos(XMVectorClamp(Dot(ax, ay, az, bx, by, bz), XMVectorNegate(one), one));
+
+				XMVECTOR cx = tx, cy = ty, cz = tz;
+				ProjectOntoPlane(cx, cy, cz, nx, ny, nz);
+				StoreTransposed(&tangents[t * 3 + k], 3, XMVectorMultiply(cx, angle), XMVectorMultiply(cy, angle), XMVectorMultiply(cz, angle), sign);
+			}
+		}
+	}
+
+	// Any unit vector perpendicular to the normal
+	XMVECTOR AnyPerpendicular(XMVECTOR normal)
+	{
+		XMFLOAT3 n;
+		XMStoreFloat3(&n, XMVectorAbs(normal));
+		XMVECTOR axis =
+			n.x <= n.y && n.x <= n.z ? XMVectorSet(1, 0, 0, 0) :
+			n.y <= n.z ? XMVectorSet(0, 1, 0, 0) :
+			XMVectorSet(0, 0, 1, 0);
+		return XMVector3Normalize(XMVectorSubtract(axis, XMVectorMultiply(normal, XMVector3Dot(normal, axis))));
+	}
+
+	// --------------------------------------------------------
+	// Turns four vertices' summed tangents into unit tangents
+	// in the planes of their normals, with the given signs in w
+	// - Lanes whose sum vanishes (or lies along the normal) get
+	//   an arbitrary perpendicular tangent instead
+	// --------------------------------------------------------
+	void FinishTangents(
+		const XMFLOAT4A (&sums)[4],
+		XMVECTOR nx, XMVECTOR ny, XMVECTOR nz,
+		XMVECTOR sign,
+		XMFLOAT4A (&out)[4])
+	{
+		XMMATRIX m = XMMatrixTranspose(XMMATRIX(
+			XMLoadFloat4A(&sums[0]), XMLoadFloat4A(&sums[1]),
+			XMLoadFloat4A(&sums[2]), XMLoadFloat4A(&sums[3])));
+		XMVECTOR tx = m.r[0], ty = m.r[1], tz = m.r[2];
+		ProjectOntoPlane(tx, ty, tz, nx, ny, nz);
+		StoreTransposed(out, 1, tx, ty, tz, sign);
+
+		for (int lane = 0; lane < 4; lane++)
+		{
+			if (out[lane].x == 0.0f && out[lane].y == 0.0f && out[lane].z == 0.0f)
+			{
+				XMVECTOR normal = XMVectorSet(XMVectorGetByIndex(nx, lane), XMVectorGetByIndex(ny, lane), XMVectorGetByIndex(nz, lane), 0);
+				XMStoreFloat4A(&out[lane], XMVectorSetW(AnyPerpendicular(normal), out[lane].w));
+			}
+		}
+	}
+}
+
+namespace MeshTangents
+{
+	size_t Generate(
+		std::vector<Vertex>& vertices,
+		std::vector<unsigned int>& indices,
+		size_t indexCount,
+		const Options& options)
+	{
+		size_t vertexCount = vertices.size();
+		size_t triangleCount = indexCount / 3;
+		bool fast = options.TangentMode == Mode::Fast;
+		if (triangleCount == 0)
+		{
+			for (Vertex& v : vertices)
+				XMStoreFloat4(&v.Tangent, XMVectorSetW(AnyPerpendicular(XMLoadFloat3(&v.Normal)), 1.0f));
+			return 0;
+		}
+
+		// Pass 1: every triangle's (or corner's) tangent, in independent
+		// blocks of four triangles
+		size_t blockCount = (triangleCount + 3) / 4;
+		std::vector<XMFLOAT4A> tangents(blockCount * 4 * (fast ? 1 : 3));
+		std::vector<XMFLOAT4A> bitangents(fast ? blockCount * 4 : 0);
+		ParallelFor(blockCount, minTrianglesPerThread / 4, options.MaxThreads, [&](size_t begin, size_t end) {
+			ComputeTriangles(vertices.data(), indices.data(), triangleCount, begin * 4, end * 4, options.TangentMode, tangents.data(), bitangents.data());
+		});
+
+		// The corners around each vertex, packed into one array
+		std::vector<unsigned int> cornerStart(vertexCount + 1, 0);
+		for (size_t i = 0; i < triangleCount * 3; i++)
+			cornerStart[indices[i] + 1]++;
+		for (size_t v = 0; v < vertexCount; v++)
+			cornerStart[v + 1] += cornerStart[v];
+		std::vector<unsigned int> corners(triangleCount * 3);
+		{
+			std::vector<unsigned int> fill(cornerStart.begin(), cornerStart.end() - 1);
+			for (size_t i = 0; i < triangleCount * 3; i++)
+				corners[fill[indices[i]]++] = (unsigned int)i;
+		}
+
+		// Pass 2: each vertex sums its own corners, so ranges of vertices
+		// never write to the same place, then finishes four at a time
+		std::vector<XMFLOAT4> mirrored(fast ? 0 : vertexCount);
+		std::vector<uint8_t> split(vertexCount, 0);
+		size_t vertexBlockCount = (vertexCount + 3) / 4;
+		ParallelFor(vertexBlockCount, minVerticesPerThread / 4, options.MaxThreads, [&](size_t begin, size_t end) {
+			const XMVECTOR one = XMVectorSplatOne();
+			for (size_t start = begin * 4; start < end * 4; start += 4)
+			{
+				// Lanes past the last vertex repeat it
+				unsigned int lanes[4];
+				for (int lane = 0; lane < 4; lane++)
+					lanes[lane] = (unsigned int)std::min(start + lane, vertexCount - 1);
+
+				XMVECTOR nx, ny, nz;
+				LoadTransposed(vertices.data(), lanes, &Vertex::Normal, nx, ny, nz);
+				Normalize(nx, ny, nz);
+
+				XMFLOAT4A sums[2][4] = {};
+				bool used[2][4] = {};
+				for (int lane = 0; lane < 4; lane++)
+				{
+					XMVECTOR first = XMVectorZero();
+					XMVECTOR second = XMVectorZero();
+					for (unsigned int c = cornerStart[lanes[lane]]; c < cornerStart[lanes[lane] + 1]; c++)
+					{
+						if (fast)
+						{
+							// Tangents and bitangents
+							unsigned int triangle = corners[c] / 3;
+							first = XMVectorAdd(first, XMLoadFloat4A(&tangents[triangle]));
+							second = XMVectorAdd(second, XMLoadFloat4A(&bitangents[triangle]));
+							continue;
+						}
+
+						// Left- and right-handed tangents, kept apart
+						const XMFLOAT4A& corner = tangents[corners[c]];
+						if (corner.w < 0.0f)
+						{
+							first = XMVectorAdd(first, XMLoadFloat4A(&corner));
+							used[0][lane] = true;
+						}
+						else if (corner.w > 0.0f)
+						{
+							second = XMVectorAdd(second, XMLoadFloat4A(&corner));
+							used[1][lane] = true;
+						}
+					}
+					XMStoreFloat4A(&sums[0][lane], first);
+					XMStoreFloat4A(&sums[1][lane], second);
+				}
+
+				size_t laneCount = std::min<size_t>(4, vertexCount - start);
+				if (fast)
+				{
+					// The sign is whichever side of the tangent the summed bitangent is on
+					XMFLOAT4A finished[4];
+					FinishTangents(sums[0], nx, ny, nz, one, finished);
+
+					XMMATRIX t = XMMatrixTranspose(XMMATRIX(
+						XMLoadFloat4A(&finished[0]), XMLoadFloat4A(&finished[1]),
+						XMLoadFloat4A(&finished[2]), XMLoadFloat4A(&finished[3])));
+					XMMATRIX b = XMMatrixTranspose(XMMATRIX(
+						XMLoadFloat4A(&sums[1][0]), XMLoadFloat4A(&sums[1][1]),
+						XMLoadFloat4A(&sums[1][2]), XMLoadFloat4A(&sums[1][3])));
+					XMVECTOR cx = XMVectorNegativeMultiplySubtract(nz, t.r[1], XMVectorMultiply(ny, t.r[2]));
+					XMVECTOR cy = XMVectorNegativeMultiplySubtract(nx, t.r[2], XMVectorMultiply(nz, t.r[0]));
+					XMVECTOR cz = XMVectorNegativeMultiplySubtract(ny, t.r[0], XMVectorMultiply(nx, t.r[1]));
+					XMVECTOR flipped = XMVectorLess(Dot(cx, cy, cz, b.r[0], b.r[1], b.r[2]), XMVectorZero());
+					XMVECTOR sign = XMVectorSelect(one, XMVectorNegate(one), flipped);
+					StoreTransposed(finished, 1, t.r[0], t.r[1], t.r[2], sign);
+
+					for (size_t lane = 0; lane < laneCount; lane++)
+						vertices[start + lane].Tangent = finished[lane];
+					continue;
+				}
+
+				XMFLOAT4A left[4], right[4];
+				FinishTangents(sums[0], nx, ny, nz, XMVectorNegate(one), left);
+				FinishTangents(sums[1], nx, ny, nz, one, right);
+				for (size_t lane = 0; lane < laneCount; lane++)
+				{
+					// Right-handed triangles keep the original vertex if there are any
+					size_t v = start + lane;
+					vertices[v].Tangent = used[1][lane] || !used[0][lane] ? right[lane] : left[lane];
+					if (used[0][lane] && used[1][lane])
+					{
+						mirrored[v] = left[lane];
+						split[v] = 1;
+					}
+				}
+			}
+		});
+
+		// Left-handed corners of split vertices move to a copy
+		size_t added = 0;
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			if (!split[v])
+				continue;
+
+			unsigned int copy = (unsigned int)vertices.size();
+			vertices.push_back(vertices[v]);
+			vertices.back().Tangent = mirrored[v];
+			for (unsigned int c = cornerStart[v]; c < cornerStart[v + 1]; c++)
+			{
+				if (tangents[corners[c]].w < 0.0f)
+					indices[corners[c]] = copy;
+			}
+			added++;
+		}
+		return added;
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Generates per-vertex tangents (xyz) and handedness (w),
+// so the bitangent is w * cross(normal, tangent)
+//
+// - Per-triangle tangents are computed four triangles at a
+//   time from structure-of-arrays copies of the positions
+//   and uvs, using DirectXMath (SSE or NEON, depending on
+//   the platform)
+// - Vertices then gather from their own triangles instead
+//   of triangles scattering into vertices, so both passes
+//   split into independent ranges with no shared writes
+// - Triangles with degenerate uvs are skipped, and vertices
+//   left without a tangent get an arbitrary one that is
+//   perpendicular to the normal
+// --------------------------------------------------------
+namespace MeshTangents
+{
+	enum class Mode
+	{
+		// Sum of each vertex's unnormalized triangle tangents,
+		// made orthogonal to the normal (Lengyel, FGED2 7.5)
+		Fast,
+
+		// Matches what MikkTSpace bakes normal maps with: triangle
+		// tangents are normalized, projected onto the vertex normal
+		// and weighted by the corner angle, and vertices shared by
+		// triangles of opposite handedness (mirrored uvs) are split
+		// - Unlike the reference implementation, triangles around a
+		//   vertex are grouped by handedness alone, not also by
+		//   whether they're connected
+		MikkTSpace
+	};
+
+	struct Options
+	{
+		Mode TangentMode = Mode::MikkTSpace;
+
+		// Upper limit on threads (zero uses one per hardware thread);
+		// small meshes always run on the calling thread
+		unsigned int MaxThreads = 0;
+	};
+
+	// Sets the tangent of every vertex from the triangles in the first
+	// indexCount indices, and returns how many vertices were added
+	// - Split vertices are appended to vertices, and the matching
+	//   corners within the first indexCount indices are remapped
+	size_t Generate(
+		std::vector<Vertex>& vertices,
+		std::vector<unsigned int>& indices,
+		size_t indexCount,
+		const Options& options = Options());
+}
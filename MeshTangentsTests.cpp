@@ -0,0 +1,407 @@
+#include "Tests.h"
+#include "MeshTangents.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	// --------------------------------------------------------
+	// A bumpy size x size grid facing up, with normals from the
+	// surface's slope and uvs stretched unevenly, so tangents
+	// vary from vertex to vertex
+	// - With mirror, u runs backwards past the middle column
+	//   (like a symmetric character's texture), so triangles on
+	//   either side have opposite uv winding
+	// --------------------------------------------------------
+	void MakeGrid(int size, bool mirror, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+	{
+		for (int z = 0; z <= size; z++)
+		{
+			for (int x = 0; x <= size; x++)
+			{
+				float fx = x / (float)size;
+				float fz = z / (float)size;
+				float height = 0.1f * sinf(fx * 7.0f) * cosf(fz * 5.0f);
+				float dx = 0.7f * cosf(fx * 7.0f) * cosf(fz * 5.0f);
+				float dz = -0.5f * sinf(fx * 7.0f) * sinf(fz * 5.0f);
+
+				float mirrored = mirror && x > size / 2 ? 2.0f * (size / 2) / size - fx : fx;
+				float u = mirrored + 0.05f * sinf(fz * 3.0f);
+
+				Vertex v = {};
+				v.Position = XMFLOAT3(fx, height, fz);
+				v.UV = XMFLOAT2(u, 1.0f - fz * fz * 0.5f - fz * 0.5f);
+				XMStoreFloat3(&v.Normal, XMVector3Normalize(XMVectorSet(-dx, 1.0f, -dz, 0.0f)));
+				vertices.push_back(v);
+			}
+		}
+
+		unsigned int row = size + 1;
+		for (int z = 0; z < size; z++)
+		{
+			for (int x = 0; x < size; x++)
+			{
+				unsigned int a = z * row + x;
+				indices.insert(indices.end(), { a, a + row, a + 1, a + 1, a + row, a + row + 1 });
+			}
+		}
+	}
+
+	// --------------------------------------------------------
+	// What Mesh used before MeshTangents, kept to compare
+	// against: each vertex sums its triangles' unnormalized
+	// tangents, then Gram-Schmidt against the normal
+	// - It leaves w alone, and divides by zero on degenerate uvs
+	// --------------------------------------------------------
+	void CalculateTangentsScalar(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
+	{
+		// Reset tangents
+		for (int i = 0; i < numVerts; i++)
+		{
+			verts[i].Tangent.x = 0;
+			verts[i].Tangent.y = 0;
+			verts[i].Tangent.z = 0;
+		}
+
+		// Calculate tangents one whole triangle at a time
+		for (int i = 0; i < numIndices;)
+		{
+			// Grab indices and vertices of first triangle
+			unsigned int i1 = indices[i++];
+			unsigned int i2 = indices[i++];
+			unsigned int i3 = indices[i++];
+			Vertex* v1 = &verts[i1];
+			Vertex* v2 = &verts[i2];
+			Vertex* v3 = &verts[i3];
+
+			// Calculate vectors relative to triangle positions
+			float x1 = v2->Position.x - v1->Position.x;
+			float y1 = v2->Position.y - v1->Position.y;
+			float z1 = v2->Position.z - v1->Position.z;
+
+			float x2 = v3->Position.x - v1->Position.x;
+			float y2 = v3->Position.y - v1->Position.y;
+			float z2 = v3->Position.z - v1->Position.z;
+
+			// Do the same for vectors relative to triangle uv's
+			float s1 = v2->UV.x - v1->UV.x;
+			float t1 = v2->UV.y - v1->UV.y;
+
+			float s2 = v3->UV.x - v1->UV.x;
+			float t2 = v3->UV.y - v1->UV.y;
+
+			// Create vectors for tangent calculation
+			float r = 1.0f / (s1 * t2 - s2 * t1);
+
+			float tx = (t2 * x1 - t1 * x2) * r;
+			float ty = (t2 * y1 - t1 * y2) * r;
+			float tz = (t2 * z1 - t1 * z2) * r;
+
+			// Adjust tangents of each vert of the triangle
+			v1->Tangent.x += tx;
+			v1->Tangent.y += ty;
+			v1->Tangent.z += tz;
+
+			v2->Tangent.x += tx;
+			v2->Tangent.y += ty;
+			v2->Tangent.z += tz;
+
+			v3->Tangent.x += tx;
+			v3->Tangent.y += ty;
+			v3->Tangent.z += tz;
+		}
+
+		// Ensure all of the tangents are orthogonal to the normals
+		for (int i = 0; i < numVerts; i++)
+		{
+			// Grab the two vectors
+			XMVECTOR normal = XMLoadFloat3(&verts[i].Normal);
+			XMVECTOR tangent = XMLoadFloat3((XMFLOAT3*)&verts[i].Tangent);
+
+			// Use Gram-Schmidt orthonormalize to ensure
+			// the normal and tangent are exactly 90 degrees apart
+			tangent = XMVector3Normalize(
+				tangent - normal * XMVector3Dot(normal, tangent));
+
+			// Store the tangent
+			XMStoreFloat3((XMFLOAT3*)&verts[i].Tangent, tangent);
+		}
+	}
+
+	// The handedness a triangle's corners should get at a vertex with the
+	// given normal: the sign of the uv area, flipped if the triangle's
+	// positions wind the other way around the normal
+	float TriangleHandedness(const Vertex& a, const Vertex& b, const Vertex& c, const XMFLOAT3& normal)
+	{
+		float area = (b.UV.x - a.UV.x) * (c.UV.y - a.UV.y) - (c.UV.x - a.UV.x) * (b.UV.y - a.UV.y);
+		XMVECTOR winding = XMVector3Cross(
+			XMLoadFloat3(&b.Position) - XMLoadFloat3(&a.Position),
+			XMLoadFloat3(&c.Position) - XMLoadFloat3(&a.Position));
+		float facing = XMVectorGetX(XMVector3Dot(winding, XMLoadFloat3(&normal)));
+		return (area < 0.0f) == (facing < 0.0f) ? 1.0f : -1.0f;
+	}
+
+	// Finite, unit length, perpendicular to the normal and with w = +-1
+	bool IsValidTangent(const Vertex& v)
+	{
+		const XMFLOAT4& t = v.Tangent;
+		if (!std::isfinite(t.x) || !std::isfinite(t.y) || !std::isfinite(t.z))
+			return false;
+		XMVECTOR tangent = XMLoadFloat4(&t);
+		float length = XMVectorGetX(XMVector3Length(tangent));
+		float dot = XMVectorGetX(XMVector3Dot(tangent, XMVector3Normalize(XMLoadFloat3(&v.Normal))));
+		return Tests::Near(length, 1.0f, 1e-4f) && fabsf(dot) < 1e-4f && (t.w == 1.0f || t.w == -1.0f);
+	}
+
+	double Milliseconds(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+}
+
+// --------------------------------------------------------
+// Fast mode is the old loop's math, four triangles at a time,
+// so the directions should agree to float rounding
+// --------------------------------------------------------
+TEST(MeshTangentsFastMatchesOldLoop)
+{
+	for (int mirror = 0; mirror < 2; mirror++)
+	{
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices;
+		MakeGrid(40, mirror != 0, vertices, indices);
+		std::vector<Vertex> old = vertices;
+		CalculateTangentsScalar(old.data(), (int)old.size(), indices.data(), (int)indices.size());
+
+		MeshTangents::Options options;
+		options.TangentMode = MeshTangents::Mode::Fast;
+		CHECK(MeshTangents::Generate(vertices, indices, indices.size(), options) == 0);
+		CHECK(vertices.size() == old.size());
+
+		float worst = 0.0f;
+		bool valid = true;
+		for (size_t v = 0; v < vertices.size(); v++)
+		{
+			valid = valid && IsValidTangent(vertices[v]);
+			XMVECTOR difference = XMLoadFloat3((XMFLOAT3*)&vertices[v].Tangent) - XMLoadFloat3((XMFLOAT3*)&old[v].Tangent);
+			worst = std::max(worst, XMVectorGetX(XMVector3Length(difference)));
+		}
+		CHECK(valid);
+		CHECK(worst < 1e-4f);
+	}
+}
+
+// --------------------------------------------------------
+// Threads split triangles and vertices into ranges that are
+// computed exactly as they would be on one thread, so the
+// results should match bit for bit
+// --------------------------------------------------------
+TEST(MeshTangentsThreadsMatchOneThread)
+{
+	// Large enough (~180k triangles, ~90k vertices) to split both passes
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeGrid(300, true, vertices, indices);
+
+	MeshTangents::Mode modes[] = { MeshTangents::Mode::Fast, MeshTangents::Mode::MikkTSpace };
+	for (MeshTangents::Mode mode : modes)
+	{
+		MeshTangents::Options options;
+		options.TangentMode = mode;
+		options.MaxThreads = 1;
+		std::vector<Vertex> single = vertices;
+		std::vector<unsigned int> singleIndices = indices;
+		size_t singleAdded = MeshTangents::Generate(single, singleIndices, singleIndices.size(), options);
+
+		options.MaxThreads = 8;
+		std::vector<Vertex> threaded = vertices;
+		std::vector<unsigned int> threadedIndices = indices;
+		size_t threadedAdded = MeshTangents::Generate(threaded, threadedIndices, threadedIndices.size(), options);
+
+		CHECK(threadedAdded == singleAdded);
+		CHECK(threaded.size() == single.size());
+		CHECK(threadedIndices == singleIndices);
+		CHECK(threaded.size() == single.size() && memcmp(threaded.data(), single.data(), single.size() * sizeof(Vertex)) == 0);
+	}
+}
+
+// --------------------------------------------------------
+// Triangles whose uvs are all the same, or in a line, have no
+// tangent of their own; vertices that only touch those still
+// need a usable one, and their neighbours mustn't be poisoned
+// --------------------------------------------------------
+TEST(MeshTangentsDegenerateUVsAreFinite)
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeGrid(8, false, vertices, indices);
+
+	// Collapse the uvs of the first row of quads onto a line, and
+	// every uv of one vertex's triangles onto a single point
+	for (int x = 0; x <= 8; x++)
+		vertices[x].UV = vertices[9 + x].UV = XMFLOAT2(x / 8.0f, 0.5f);
+	for (unsigned int v : { 40u, 39u, 41u, 31u, 49u, 32u, 48u })
+		vertices[v].UV = XMFLOAT2(0.25f, 0.25f);
+
+	// And a triangle that is one vertex three times
+	indices.insert(indices.end(), { 80u, 80u, 80u });
+
+	MeshTangents::Mode modes[] = { MeshTangents::Mode::Fast, MeshTangents::Mode::MikkTSpace };
+	for (MeshTangents::Mode mode : modes)
+	{
+		MeshTangents::Options options;
+		options.TangentMode = mode;
+		std::vector<Vertex> result = vertices;
+		std::vector<unsigned int> resultIndices = indices;
+		MeshTangents::Generate(result, resultIndices, resultIndices.size(), options);
+
+		bool valid = true;
+		for (const Vertex& v : result)
+			valid = valid && IsValidTangent(v);
+		CHECK(valid);
+	}
+
+	// No triangles at all
+	std::vector<unsigned int> none;
+	std::vector<Vertex> lone = vertices;
+	CHECK(MeshTangents::Generate(lone, none, 0) == 0);
+	CHECK(IsValidTangent(lone[0]) && IsValidTangent(lone[40]));
+}
+
+// --------------------------------------------------------
+// w is what flips the bitangent on mirrored uvs: every corner
+// should see the handedness of its own triangle's uv winding
+// - MikkTSpace splits the vertices on the mirror line, so
+//   that holds for every corner; Fast can't, so it only holds
+//   away from the line
+// --------------------------------------------------------
+TEST(MeshTangentsHandednessFollowsUVWinding)
+{
+	const int size = 16;
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeGrid(size, true, vertices, indices);
+
+	// Fast: no splits, and vertices off the mirror line agree with all their triangles
+	{
+		MeshTangents::Options options;
+		options.TangentMode = MeshTangents::Mode::Fast;
+		std::vector<Vertex> result = vertices;
+		std::vector<unsigned int> resultIndices = indices;
+
+		// Some quads wound the other way, which Fast's bitangents see
+		// through (MikkTSpace, like the reference, assumes the winding
+		// agrees with the normals and goes by the uv area alone)
+		for (size_t q = 0; q < resultIndices.size() / 6; q += 3)
+		{
+			std::swap(resultIndices[q * 6 + 1], resultIndices[q * 6 + 2]);
+			std::swap(resultIndices[q * 6 + 4], resultIndices[q * 6 + 5]);
+		}
+		CHECK(MeshTangents::Generate(result, resultIndices, resultIndices.size(), options) == 0);
+
+		unsigned int checked = 0;
+		bool matches = true;
+		for (size_t i = 0; i < resultIndices.size(); i++)
+		{
+			const Vertex& v = result[resultIndices[i]];
+			size_t t = i - i % 3;
+			if (resultIndices[i] % (size + 1) == size / 2)
+				continue;
+			matches = matches && v.Tangent.w == TriangleHandedness(
+				result[resultIndices[t]], result[resultIndices[t + 1]], result[resultIndices[t + 2]], v.Normal);
+			checked++;
+		}
+		CHECK(matches);
+		CHECK(checked > 0);
+	}
+
+	// MikkTSpace: one copy per side of the mirror line, and every corner agrees
+	{
+		std::vector<Vertex> result = vertices;
+		std::vector<unsigned int> resultIndices = indices;
+		CHECK(MeshTangents::Generate(result, resultIndices, resultIndices.size()) == size + 1);
+
+		bool matches = true;
+		unsigned int left = 0;
+		for (size_t i = 0; i < resultIndices.size(); i++)
+		{
+			const Vertex& v = result[resultIndices[i]];
+			size_t t = i - i % 3;
+			matches = matches && v.Tangent.w == TriangleHandedness(
+				result[resultIndices[t]], result[resultIndices[t + 1]], result[resultIndices[t + 2]], v.Normal);
+			left += v.Tangent.w < 0.0f;
+		}
+		CHECK(matches);
+		CHECK(left > 0 && left < resultIndices.size());
+
+		// The copies are the same vertices otherwise
+		bool copies = true;
+		for (size_t v = vertices.size(); v < result.size(); v++)
+		{
+			size_t original = (v - vertices.size()) * (size + 1) + size / 2;
+			copies = copies && memcmp(&result[v], &result[original], offsetof(Vertex, Tangent)) == 0 &&
+				result[v].Tangent.w == -result[original].Tangent.w;
+		}
+		CHECK(copies);
+	}
+}
+
+// --------------------------------------------------------
+// The old scalar loop against both modes, on one thread and
+// on all of them, for a ~1M triangle mesh
+// --------------------------------------------------------
+BENCHMARK(MeshTangentsThroughput)
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeGrid(707, true, vertices, indices);
+	printf("  %zu vertices, %zu triangles\n", vertices.size(), indices.size() / 3);
+
+	const int repeats = 5;
+	double best = 1e30;
+	for (int r = 0; r < repeats; r++)
+	{
+		std::vector<Vertex> result = vertices;
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		CalculateTangentsScalar(result.data(), (int)result.size(), indices.data(), (int)indices.size());
+		best = std::min(best, Milliseconds(start));
+	}
+	printf("  %-28s %8.2f ms\n", "Old scalar loop", best);
+
+	unsigned int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+	struct Run { const char* Name; MeshTangents::Mode TangentMode; unsigned int MaxThreads; };
+	Run runs[] =
+	{
+		{ "Fast, 1 thread", MeshTangents::Mode::Fast, 1 },
+		{ "Fast, all threads", MeshTangents::Mode::Fast, 0 },
+		{ "MikkTSpace, 1 thread", MeshTangents::Mode::MikkTSpace, 1 },
+		{ "MikkTSpace, all threads", MeshTangents::Mode::MikkTSpace, 0 },
+	};
+	for (const Run& run : runs)
+	{
+		MeshTangents::Options options;
+		options.TangentMode = run.TangentMode;
+		options.MaxThreads = run.MaxThreads;
+
+		best = 1e30;
+		for (int r = 0; r < repeats; r++)
+		{
+			std::vector<Vertex> result = vertices;
+			std::vector<unsigned int> resultIndices = indices;
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			MeshTangents::Generate(result, resultIndices, resultIndices.size(), options);
+			best = std::min(best, Milliseconds(start));
+		}
+		printf("  %-28s %8.2f ms\n", run.Name, best);
+	}
+	printf("  (%u hardware threads)\n", hardwareThreads);
+}
@@ -0,0 +1,184 @@
+#include "MtlLoader.h"
+#include "MappedFile.h"
+
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <stdexcept>
+#include <string_view>
+
+using namespace DirectX;
+
+// Anonymous namespace for the line helpers, which are private to this file
+namespace
+{
+	inline bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+	// Splits a line into whitespace separated tokens
+	void Tokenize(std::string_view line, std::vector<std::string_view>& tokens)
+	{
+		tokens.clear();
+		size_t i = 0;
+		while (i < line.size())
+		{
+			while (i < line.size() && IsSpace(line[i]))
+				i++;
+			size_t start = i;
+			while (i < line.size() && !IsSpace(line[i]))
+				i++;
+			if (i > start)
+				tokens.push_back(line.substr(start, i - start));
+		}
+	}
+
+	// Keywords aren't consistently cased between exporters (map_Kd, map_kd)
+	bool KeywordEquals(std::string_view token, const char* keyword)
+	{
+		size_t i = 0;
+		for (; i < token.size() && keyword[i]; i++)
+		{
+			if (tolower((unsigned char)token[i]) != tolower((unsigned char)keyword[i]))
+				return false;
+		}
+		return i == token.size() && !keyword[i];
+	}
+
+	bool ParseFloat(std::string_view token, float& result)
+	{
+		const char* first = token.data() + (!token.empty() && token[0] == '+');
+		return std::from_chars(first, token.data() + token.size(), result).ec == std::errc();
+	}
+
+	float GetFloat(const std::vector<std::string_view>& tokens, size_t index, float fallback)
+	{
+		float value = fallback;
+		if (index < tokens.size() && !ParseFloat(tokens[index], value))
+			value = fallback;
+		return value;
+	}
+
+	// "Kd r g b", where a single value means grey
+	XMFLOAT3 GetColor(const std::vector<std::string_view>& tokens)
+	{
+		float r = GetFloat(tokens, 1, 0.0f);
+		return XMFLOAT3(r, GetFloat(tokens, 2, r), GetFloat(tokens, 3, r));
+	}
+
+	// --------------------------------------------------------
+	// The path of a texture statement, after any options
+	// - Options start with '-' and take numeric (or on/off)
+	//   arguments, so whatever follows those is the path,
+	//   which keeps paths that contain spaces intact
+	// --------------------------------------------------------
+	std::string GetTexturePath(const std::vector<std::string_view>& tokens, const std::string& directory)
+	{
+		size_t i = 1;
+		while (i < tokens.size() && tokens[i].size() > 1 && tokens[i][0] == '-')
+		{
+			i++;
+			float unused;
+			while (i + 1 < tokens.size() && (ParseFloat(tokens[i], unused) || tokens[i] == "on" || tokens[i] == "off"))
+				i++;
+		}
+		if (i >= tokens.size())
+			return std::string();
+
+		// Rebuild the rest of the line from the original text
+		std::string_view last = tokens.back();
+		std::string path(tokens[i].data(), last.data() + last.size() - tokens[i].data());
+		bool absolute = path[0] == '/' || path[0] == '\\' || (path.size() > 1 && path[1] == ':');
+		return absolute ? path : directory + path;
+	}
+}
+
+namespace MtlLoader
+{
+	std::vector<MaterialDescription> Load(const char* mtlFile)
+	{
+		MappedFile file(mtlFile);
+		if (!file.IsOpen())
+			throw std::invalid_argument("Error opening file: Invalid file path or file is inaccessible");
+
+		// Textures are listed relative to the library itself
+		std::string directory = mtlFile;
+		size_t slash = directory.find_last_of("/\\");
+		directory.erase(slash == std::string::npos ? 0 : slash + 1);
+
+		return Parse(file.GetData(), file.GetSize(), directory);
+	}
+
+	std::vector<MaterialDescription> Parse(const char* text, size_t length, const std::string& textureDirectory)
+	{
+		std::vector<MaterialDescription> materials;
+		std::vector<std::string_view> tokens;
+		bool hasRoughness = false;
+
+		std::string_view remaining(text, length);
+		while (!remaining.empty())
+		{
+			size_t newline = remaining.find('\n');
+			std::string_view line = remaining.substr(0, newline);
+			remaining.remove_prefix(newline == std::string_view::npos ? remaining.size() : newline + 1);
+
+			Tokenize(line, tokens);
+			if (tokens.empty() || tokens[0][0] == '#')
+				continue;
+
+			if (KeywordEquals(tokens[0], "newmtl"))
+			{
+				materials.emplace_back();
+				if (tokens.size() > 1)
+					materials.back().Name = std::string(tokens[1].data(), tokens.back().data() + tokens.back().size() - tokens[1].data());
+				hasRoughness = false;
+				continue;
+			}
+
+			// Everything else describes the current material
+			if (materials.empty())
+				throw std::invalid_argument("Error parsing MTL: Material data before the first newmtl");
+			MaterialDescription& material = materials.back();
+
+			if (KeywordEquals(tokens[0], "Kd"))
+				material.DiffuseColor = GetColor(tokens);
+			else if (KeywordEquals(tokens[0], "Ke"))
+				material.EmissiveColor = GetColor(tokens);
+			else if (KeywordEquals(tokens[0], "d"))
+				material.Opacity = GetFloat(tokens, 1, 1.0f);
+			else if (KeywordEquals(tokens[0], "Tr"))
+				material.Opacity = 1.0f - GetFloat(tokens, 1, 0.0f);
+			else if (KeywordEquals(tokens[0], "Pr"))
+			{
+				material.Roughness = GetFloat(tokens, 1, material.Roughness);
+				hasRoughness = true;
+			}
+			else if (KeywordEquals(tokens[0], "Ns") && !hasRoughness)
+			{
+				// Blinn-Phong exponent to roughness, so older files
+				// still get sharper highlights from higher exponents
+				float exponent = fmaxf(GetFloat(tokens, 1, 0.0f), 0.0f);
+				material.Roughness = sqrtf(2.0f / (exponent + 2.0f));
+			}
+			else if (KeywordEquals(tokens[0], "Pm"))
+				material.Metalness = GetFloat(tokens, 1, material.Metalness);
+			else if (KeywordEquals(tokens[0], "map_Kd"))
+				material.DiffuseMap = GetTexturePath(tokens, textureDirectory);
+			else if (KeywordEquals(tokens[0], "norm") || KeywordEquals(tokens[0], "map_Bump") || KeywordEquals(tokens[0], "bump"))
+				material.NormalMap = GetTexturePath(tokens, textureDirectory);
+			else if (KeywordEquals(tokens[0], "map_Pr"))
+				material.RoughnessMap = GetTexturePath(tokens, textureDirectory);
+			else if (KeywordEquals(tokens[0], "map_Pm"))
+				material.MetalnessMap = GetTexturePath(tokens, textureDirectory);
+		}
+		return materials;
+	}
+
+	const MaterialDescription* Find(const std::vector<MaterialDescription>& materials, const std::string& name)
+	{
+		for (const MaterialDescription& material : materials)
+		{
+			if (material.Name == name)
+				return &material;
+		}
+		return nullptr;
+	}
+}
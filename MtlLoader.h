@@ -0,0 +1,44 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <DirectXMath.h>
+
+// --------------------------------------------------------
+// Loads .MTL material libraries (referenced by mtllib in
+// .OBJ files) into plain descriptions, which the game then
+// turns into Materials with shaders and textures
+//
+// - Reads the classic statements (newmtl, Kd, Ke, d, Tr,
+//   Ns, map_Kd, map_Bump/bump/norm) and the common PBR
+//   extension (Pr, Pm, map_Pr, map_Pm)
+// - Texture options such as "-bm 1.0" are skipped, and
+//   texture paths are made relative to the .mtl file's
+//   directory when loading from a file
+// --------------------------------------------------------
+namespace MtlLoader
+{
+	struct MaterialDescription
+	{
+		std::string Name;
+		DirectX::XMFLOAT3 DiffuseColor = DirectX::XMFLOAT3(1, 1, 1);	// Kd
+		DirectX::XMFLOAT3 EmissiveColor = DirectX::XMFLOAT3(0, 0, 0);	// Ke
+		float Opacity = 1.0f;		// d, or 1 - Tr
+		float Roughness = 0.5f;		// Pr, or estimated from the Ns specular exponent
+		float Metalness = 0.0f;		// Pm
+
+		// Texture paths (empty when the material has none)
+		std::string DiffuseMap;		// map_Kd
+		std::string NormalMap;		// norm, map_Bump or bump
+		std::string RoughnessMap;	// map_Pr
+		std::string MetalnessMap;	// map_Pm
+	};
+
+	// Throws std::invalid_argument if the file can't be opened or
+	// a statement comes before the first newmtl
+	std::vector<MaterialDescription> Load(const char* mtlFile);
+	std::vector<MaterialDescription> Parse(const char* text, size_t length, const std::string& textureDirectory = "");
+
+	// Returns the material with this name, or null if there isn't one
+	const MaterialDescription* Find(const std::vector<MaterialDescription>& materials, const std::string& name);
+}
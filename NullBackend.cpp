@@ -0,0 +1,185 @@
+#include "NullBackend.h"
+
+NullBackend::NullBackend()
+{
+	Reset();
+}
+
+void NullBackend::Execute(const CommandBuffer& commands)
+{
+	for (const Command& command : commands.GetCommands())
+	{
+		stats.CommandCount++;
+		switch (command.Type)
+		{
+		case CommandType::SetInputLayout:
+			Bind(inputLayout, command.Resource, stats.ShaderChanges);
+			break;
+		case CommandType::SetVertexShader:
+			Bind(vertexShader, command.Resource, stats.ShaderChanges);
+			break;
+		case CommandType::SetPixelShader:
+			Bind(pixelShader, command.Resource, stats.ShaderChanges);
+			break;
+		case CommandType::SetRasterizerState:
+			Bind(rasterizerState, command.Resource, stats.StateChanges);
+			break;
+		case CommandType::SetDepthStencilState:
+			Bind(depthStencilState, command.Resource, stats.StateChanges);
+			break;
+
+		case CommandType::SetRenderTargets:
+			if (command.Resource == renderTarget && command.DepthStencil == depthStencil)
+			{
+				stats.RedundantBinds++;
+				break;
+			}
+			renderTarget = command.Resource;
+			depthStencil = command.DepthStencil;
+			stats.StateChanges++;
+			break;
+
+		case CommandType::SetViewport:
+		{
+			const float* viewport = (const float*)commands.GetData(command);
+			if (viewport[2] <= 0.0f || viewport[3] <= 0.0f)
+				Error(command, "The viewport is empty");
+			viewportSet = true;
+			stats.StateChanges++;
+			break;
+		}
+
+		case CommandType::SetVertexBuffer:
+			if (CheckSlot(command, CommandBuffer::VertexBufferSlots))
+			{
+				if (command.Resource && command.Arguments[0] == 0)
+					Error(command, "The vertex stride is zero");
+				Bind(vertexBuffers[command.Slot], command.Resource, stats.BufferBinds);
+			}
+			break;
+		case CommandType::SetIndexBuffer:
+			Bind(indexBuffer, command.Resource, stats.BufferBinds);
+			break;
+		case CommandType::SetConstantBuffer:
+			if (CheckSlot(command, CommandBuffer::ConstantBufferSlots))
+				Bind(stages[(int)command.Stage].ConstantBuffers[command.Slot], command.Resource, stats.BufferBinds);
+			break;
+		case CommandType::SetShaderResource:
+			if (CheckSlot(command, CommandBuffer::ShaderResourceSlots))
+				Bind(stages[(int)command.Stage].Resources[command.Slot], command.Resource, stats.ResourceBinds);
+			break;
+		case CommandType::SetSampler:
+			if (CheckSlot(command, CommandBuffer::SamplerSlots))
+				Bind(stages[(int)command.Stage].Samplers[command.Slot], command.Resource, stats.ResourceBinds);
+			break;
+		case CommandType::ClearShaderResources:
+			for (const void*& resource : stages[(int)command.Stage].Resources)
+				resource = nullptr;
+			stats.ResourceBinds++;
+			break;
+
+		case CommandType::UpdateBuffer:
+			if (!command.Resource)
+				Error(command, "The buffer is null");
+			if (command.DataSize == 0)
+				Error(command, "There's no data");
+			stats.UpdateCount++;
+			stats.UpdateBytes += command.DataSize;
+			break;
+		case CommandType::ClearRenderTarget:
+		case CommandType::ClearDepth:
+			if (!command.Resource)
+				Error(command, "The view is null");
+			stats.ClearCount++;
+			break;
+
+		case CommandType::Draw:
+		case CommandType::DrawIndexed:
+			CheckDraw(command);
+			stats.DrawCount++;
+			stats.VertexCount += command.Arguments[0];
+			break;
+
+		default:
+			Error(command, "The command type is unknown");
+			break;
+		}
+	}
+}
+
+NullBackend::Stats NullBackend::GetStats() const
+{
+	return stats;
+}
+
+const std::vector<std::string>& NullBackend::GetErrors() const
+{
+	return errors;
+}
+
+void NullBackend::Reset()
+{
+	inputLayout = nullptr;
+	vertexShader = nullptr;
+	pixelShader = nullptr;
+	rasterizerState = nullptr;
+	depthStencilState = nullptr;
+	renderTarget = nullptr;
+	depthStencil = nullptr;
+	viewportSet = false;
+	for (const void*& buffer : vertexBuffers)
+		buffer = nullptr;
+	indexBuffer = nullptr;
+	stages[0] = {};
+	stages[1] = {};
+
+	stats = {};
+	errors.clear();
+}
+
+void NullBackend::Bind(const void*& bound, const void* resource, unsigned int& changes)
+{
+	if (bound == resource)
+	{
+		stats.RedundantBinds++;
+		return;
+	}
+	bound = resource;
+	changes++;
+}
+
+bool NullBackend::CheckSlot(const Command& command, unsigned int slotCount)
+{
+	if (command.Slot < slotCount)
+		return true;
+	Error(command, "The slot is out of range");
+	return false;
+}
+
+// --------------------------------------------------------
+// A pixel shader isn't required, since depth only passes
+// (like shadow maps) draw without one
+// --------------------------------------------------------
+void NullBackend::CheckDraw(const Command& command)
+{
+	if (!vertexShader)
+		Error(command, "No vertex shader is bound");
+	if (!renderTarget && !depthStencil)
+		Error(command, "No render target or depth stencil is bound");
+	if (!viewportSet)
+		Error(command, "No viewport is set");
+	if (inputLayout && !vertexBuffers[0])
+		Error(command, "The input layout has no vertex buffer to read");
+	if (command.Type == CommandType::DrawIndexed && !indexBuffer)
+		Error(command, "No index buffer is bound");
+}
+
+void NullBackend::Error(const Command& command, const char* message)
+{
+	stats.ErrorCount++;
+	if (errors.size() < MaxErrors)
+	{
+		errors.push_back("Command " + std::to_string(stats.CommandCount - 1) +
+			" (" + CommandBuffer::GetName(command.Type) + "): " + message);
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "CommandBuffer.h"
+
+// --------------------------------------------------------
+// A backend that draws nothing: it follows what each command
+// would bind, counts the work, and reports commands Direct3D
+// would reject or that would draw garbage
+//
+// - Checks slots against Direct3D 11's limits, updates and
+//   clears of nothing, and draws missing a vertex shader, a
+//   target, a viewport, an index buffer (for indexed draws)
+//   or the vertex buffer an input layout reads
+// - Binding what's already bound is counted as redundant
+//   rather than as a change, so the counts show how much a
+//   frame could still save
+// - Like the recording itself, it has no dependency on
+//   Direct3D, so submission can be measured and checked on
+//   machines without a GPU
+// --------------------------------------------------------
+class NullBackend : public CommandBackend
+{
+public:
+	struct Stats
+	{
+		unsigned int CommandCount;
+		unsigned int DrawCount;
+		uint64_t VertexCount;			// Vertices and indices drawn
+		unsigned int ShaderChanges;		// Shaders and input layouts
+		unsigned int StateChanges;		// Rasterizer and depth stencil states, render targets and viewports
+		unsigned int BufferBinds;		// Vertex, index and constant buffers
+		unsigned int ResourceBinds;		// Shader resources and samplers
+		unsigned int RedundantBinds;	// Of anything already bound (not counted above)
+		unsigned int UpdateCount;
+		uint64_t UpdateBytes;
+		unsigned int ClearCount;
+		unsigned int ErrorCount;
+	};
+
+	// Only the first few errors are kept, though all are counted
+	static const unsigned int MaxErrors = 16;
+
+	NullBackend();
+
+	void Execute(const CommandBuffer& commands) override;
+
+	// Since the last Reset()
+	Stats GetStats() const;
+	const std::vector<std::string>& GetErrors() const;
+
+	// Forgets the counts, the errors and everything bound
+	void Reset();
+
+private:
+	struct StageBindings
+	{
+		const void* ConstantBuffers[CommandBuffer::ConstantBufferSlots];
+		const void* Resources[CommandBuffer::ShaderResourceSlots];
+		const void* Samplers[CommandBuffer::SamplerSlots];
+	};
+
+	// What Direct3D would have bound
+	const void* inputLayout;
+	const void* vertexShader;
+	const void* pixelShader;
+	const void* rasterizerState;
+	const void* depthStencilState;
+	const void* renderTarget;
+	const void* depthStencil;
+	bool viewportSet;
+	const void* vertexBuffers[CommandBuffer::VertexBufferSlots];
+	const void* indexBuffer;
+	StageBindings stages[2];
+
+	Stats stats;
+	std::vector<std::string> errors;
+
+	void Bind(const void*& bound, const void* resource, unsigned int& changes);
+	bool CheckSlot(const Command& command, unsigned int slotCount);
+	void CheckDraw(const Command& command);
+	void Error(const Command& command, const char* message);
+};
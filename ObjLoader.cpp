@@ -0,0 +1,952 @@
+#include "ObjLoader.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+using namespace DirectX;
+
+// Anonymous namespace for the tokenizer, which is private to this file
+namespace
+{
+	// Every power of ten up to 10^10 is exactly representable as a float,
+	// which is what makes the fast path in ParseFloat() correctly rounded
+	const float powersOfTen[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+	const uint64_t maxExactMantissa = 1ull << 24;
+
+	// Files are split into chunks of at least this many bytes
+	// before being parsed on multiple threads
+	const size_t minChunkSize = 1 << 20;
+
+	// --------------------------------------------------------
+	// Open-addressing hash table from a resolved (position, uv,
+	// normal) triplet to the index of the vertex built from it
+	// --------------------------------------------------------
+	class WeldTable
+	{
+	public:
+		WeldTable() : count(0) { Resize(1024); }
+
+		// Returns the existing vertex index for this triplet, or
+		// stores and returns newIndex if it hasn't been seen yet
+		unsigned int FindOrInsert(int p, int t, int n, unsigned int newIndex)
+		{
+			if ((count + 1) * 2 > values.size())
+				Resize(values.size() * 2);
+
+			size_t mask = values.size() - 1;
+			size_t slot = Hash(p, t, n) & mask;
+			while (values[slot] != emptySlot)
+			{
+				const int* key = &keys[slot * 3];
+				if (key[0] == p && key[1] == t && key[2] == n)
+					return values[slot];
+				slot = (slot + 1) & mask;
+			}
+
+			keys[slot * 3 + 0] = p;
+			keys[slot * 3 + 1] = t;
+			keys[slot * 3 + 2] = n;
+			values[slot] = newIndex;
+			count++;
+			return newIndex;
+		}
+
+	private:
+		static constexpr unsigned int emptySlot = 0xFFFFFFFF;
+		std::vector<int> keys;
+		std::vector<unsigned int> values;
+		size_t count;
+
+		static size_t Hash(int p, int t, int n)
+		{
+			uint64_t h = (uint64_t)(uint32_t)p * 0x9E3779B97F4A7C15ull;
+			h ^= (uint64_t)(uint32_t)t * 0xC2B2AE3D27D4EB4Full + (h >> 29);
+			h ^= (uint64_t)(uint32_t)n * 0x165667B19E3779F9ull + (h >> 32);
+			return (size_t)(h ^ (h >> 31));
+		}
+
+		void Resize(size_t capacity)
+		{
+			std::vector<int> oldKeys;
+			std::vector<unsigned int> oldValues;
+			oldKeys.swap(keys);
+			oldValues.swap(values);
+
+			keys.resize(capacity * 3);
+			values.assign(capacity, emptySlot);
+			count = 0;
+			for (size_t i = 0; i < oldValues.size(); i++)
+			{
+				if (oldValues[i] != emptySlot)
+					FindOrInsert(oldKeys[i * 3], oldKeys[i * 3 + 1], oldKeys[i * 3 + 2], oldValues[i]);
+			}
+		}
+	};
+
+	// --------------------------------------------------------
+	// Uniform grid used to find earlier positions within the
+	// weld distance of a new one (each cell is epsilon wide,
+	// so only the 27 surrounding cells need to be checked)
+	// --------------------------------------------------------
+	class PositionGrid
+	{
+	public:
+		PositionGrid(float epsilon) : epsilon(epsilon) {}
+
+		// Returns the index of the first earlier position within
+		// epsilon of positions[index], or index itself if none
+		int FindOrInsert(const std::vector<XMFLOAT3>& positions, int index)
+		{
+			const XMFLOAT3& pos = positions[index];
+			int64_t cx = Cell(pos.x);
+			int64_t cy = Cell(pos.y);
+			int64_t cz = Cell(pos.z);
+
+			int best = index;
+			for (int64_t x = cx - 1; x <= cx + 1; x++)
+				for (int64_t y = cy - 1; y <= cy + 1; y++)
+					for (int64_t z = cz - 1; z <= cz + 1; z++)
+					{
+						auto cell = cellHeads.find(CellKey(x, y, z));
+						for (int i = (cell == cellHeads.end()) ? -1 : cell->second; i >= 0; i = next[i])
+						{
+							float dx = positions[i].x - pos.x;
+							float dy = positions[i].y - pos.y;
+							float dz = positions[i].z - pos.z;
+							if (i < best && dx * dx + dy * dy + dz * dz <= epsilon * epsilon)
+								best = i;
+						}
+					}
+
+			// Only unique positions go in the grid, so everything
+			// that welds together shares the same representative
+			if (best == index)
+			{
+				if (next.size() <= (size_t)index)
+					next.resize(index + 1, -1);
+				auto inserted = cellHeads.insert({ CellKey(cx, cy, cz), index });
+				if (!inserted.second)
+				{
+					next[index] = inserted.first->second;
+					inserted.first->second = index;
+				}
+			}
+			return best;
+		}
+
+	private:
+		float epsilon;
+		std::unordered_map<uint64_t, int> cellHeads;
+		std::vector<int> next;
+
+		// Cells past +/-2^40 (far away positions, or a tiny epsilon)
+		// are clamped to the last one before converting, which keeps
+		// the cast defined and still puts neighbors in adjacent cells
+		int64_t Cell(float value) const
+		{
+			const float limit = 1099511627776.0f;
+			float cell = floorf(value / epsilon);
+			cell = (cell > -limit) ? cell : -limit;
+			cell = (cell < limit) ? cell : limit;
+			return (int64_t)cell;
+		}
+
+		static uint64_t CellKey(int64_t x, int64_t y, int64_t z)
+		{
+			return ((uint64_t)(x & 0x1FFFFF) << 42) | ((uint64_t)(y & 0x1FFFFF) << 21) | (uint64_t)(z & 0x1FFFFF);
+		}
+	};
+
+	// One "v/vt/vn" triplet of a face, as written in the file
+	struct FaceCorner
+	{
+		int Position;
+		int UV;
+		int Normal;
+	};
+
+	// --------------------------------------------------------
+	// A face as read by one chunk, along with how many of each
+	// element that chunk had read before it.  Negative indices
+	// are relative to those counts, so they can only be resolved
+	// once the chunks before this one have been counted.
+	// --------------------------------------------------------
+	struct FaceRecord
+	{
+		int CornerCount;
+		int PositionCount;
+		int UVCount;
+		int NormalCount;
+	};
+
+	// A usemtl statement, which applies from the chunk's face
+	// at FaceIndex until the next one (even in a later chunk)
+	struct MaterialSwitch
+	{
+		size_t FaceIndex;
+		std::string Name;
+	};
+
+	// Raw data read from one newline-aligned chunk of the file
+	struct ObjChunk
+	{
+		std::vector<XMFLOAT3> Positions;
+		std::vector<XMFLOAT2> UVs;
+		std::vector<XMFLOAT3> Normals;
+		std::vector<FaceRecord> Faces;
+		std::vector<FaceCorner> Corners;
+		std::vector<MaterialSwitch> Materials;
+		std::vector<std::string> Libraries;
+	};
+
+	// Raw data from every chunk, merged before it's assembled into vertices
+	struct ObjState
+	{
+		std::vector<XMFLOAT3> Positions;
+		std::vector<XMFLOAT2> UVs;
+		std::vector<XMFLOAT3> Normals;
+
+		// Welding data
+		ObjLoader::LoadOptions Options;
+		WeldTable Welds;
+		std::unique_ptr<PositionGrid> Grid;
+		std::vector<int> PositionRemap;
+	};
+
+	inline bool IsDigit(char c) { return (unsigned char)(c - '0') < 10; }
+	inline bool IsSpace(char c) { return c == ' ' || c == '\t'; }
+
+	// --------------------------------------------------------
+	// The scanners below never check for the end of the buffer.
+	// Instead, every range they run over is guaranteed to end
+	// in a '\n', which none of them will step past.
+	// --------------------------------------------------------
+	inline const char* SkipSpaces(const char* p)
+	{
+		while (*p == ' ' || *p == '\t' || *p == '\r') p++;
+		return p;
+	}
+
+	inline const char* SkipLine(const char* p, const char* end)
+	{
+		const char* newline = (const char*)memchr(p, '\n', end - p);
+		return newline ? newline + 1 : end;
+	}
+
+	// --------------------------------------------------------
+	// Fallback for anything the fast path can't handle exactly
+	// (long mantissas, large exponents, inf/nan)
+	// --------------------------------------------------------
+	const char* ParseFloatSlow(const char* start, float& result)
+	{
+		const char* tokenEnd = start;
+		while (!IsSpace(*tokenEnd) && *tokenEnd != '\r' && *tokenEnd != '\n' && *tokenEnd != '/')
+			tokenEnd++;
+
+		// from_chars doesn't accept a leading '+'
+		const char* first = (*start == '+') ? start + 1 : start;
+		result = 0.0f;
+		std::from_chars(first, tokenEnd, result);
+		return tokenEnd;
+	}
+
+	// --------------------------------------------------------
+	// Parses a float, skipping any leading spaces
+	//
+	// - Decimal numbers with up to 7 significant digits and a
+	//   small exponent (which is all OBJ exporters write) are
+	//   done with a single float multiply or divide of two
+	//   exact values, so the result is correctly rounded and
+	//   matches strtof()/sscanf() bit for bit
+	// --------------------------------------------------------
+	const char* ParseFloat(const char* p, float& result)
+	{
+		p = SkipSpaces(p);
+		const char* start = p;
+		bool negative = (*p == '-');
+		p += (*p == '-' || *p == '+');
+
+		uint64_t mantissa = 0;
+		int digits = 0;
+		int exponent = 0;
+		bool exact = true;
+
+		while (IsDigit(*p))
+		{
+			exact &= (mantissa <= maxExactMantissa);
+			mantissa = mantissa * 10 + (*p - '0');
+			digits++;
+			p++;
+		}
+		if (*p == '.')
+		{
+			p++;
+			while (IsDigit(*p))
+			{
+				exact &= (mantissa <= maxExactMantissa);
+				mantissa = mantissa * 10 + (*p - '0');
+				exponent--;
+				digits++;
+				p++;
+			}
+		}
+		if (*p == 'e' || *p == 'E')
+		{
+			// Only consume the exponent if it actually has digits
+			const char* e = p + 1;
+			bool negativeExponent = (*e == '-');
+			e += (*e == '-' || *e == '+');
+			if (IsDigit(*e))
+			{
+				int value = 0;
+				while (IsDigit(*e))
+				{
+					value = value < 10000 ? value * 10 + (*e - '0') : value;
+					e++;
+				}
+				exponent += negativeExponent ? -value : value;
+				p = e;
+			}
+		}
+
+		if (digits == 0 || !exact || mantissa > maxExactMantissa || exponent < -10 || exponent > 10)
+			return ParseFloatSlow(start, result);
+
+		float value = (float)mantissa;
+		value = (exponent < 0) ? value / powersOfTen[-exponent] : value * powersOfTen[exponent];
+		result = negative ? -value : value;
+		return p;
+	}
+
+	// --------------------------------------------------------
+	// Parses a (possibly signed) face index
+	// - An index past INT_MAX can't reference anything, so a
+	//   long run of digits is rejected rather than overflowing
+	// --------------------------------------------------------
+	inline const char* ParseIndex(const char* p, int& result)
+	{
+		bool negative = (*p == '-');
+		p += (*p == '-' || *p == '+');
+
+		int64_t value = 0;
+		while (IsDigit(*p))
+		{
+			value = value * 10 + (*p - '0');
+			if (value > INT_MAX)
+				throw std::invalid_argument("Error parsing OBJ: Face references data that doesn't exist");
+			p++;
+		}
+		result = negative ? -(int)value : (int)value;
+		return p;
+	}
+
+	// --------------------------------------------------------
+	// Converts a 1-based (or negative, relative) OBJ index into
+	// a 0-based index, returning -1 if the index was omitted
+	// - count is how many elements had been read at that point
+	// --------------------------------------------------------
+	inline int ResolveIndex(int index, size_t count)
+	{
+		int resolved = (index > 0) ? index - 1 : (int)count + index;
+		if (index == 0)
+			return -1;
+		if (resolved < 0 || resolved >= (int)count)
+			throw std::invalid_argument("Error parsing OBJ: Face references data that doesn't exist");
+		return resolved;
+	}
+
+	// --------------------------------------------------------
+	// Returns the index of the left-handed vertex built from a
+	// face corner, reusing an earlier one when welding
+	// - Missing UVs default to (0,0) and missing normals to zero
+	// --------------------------------------------------------
+	unsigned int AddVertex(const FaceCorner& corner, const FaceRecord& counts, ObjState& state, ObjLoader::MeshData& mesh)
+	{
+		int p = ResolveIndex(corner.Position, counts.PositionCount);
+		int t = ResolveIndex(corner.UV, counts.UVCount);
+		int n = ResolveIndex(corner.Normal, counts.NormalCount);
+		if (p >= 0 && state.Grid)
+			p = state.PositionRemap[p];
+
+		mesh.SourceVertexCount++;
+		unsigned int index = (unsigned int)mesh.Vertices.size();
+		if (state.Options.WeldVertices)
+		{
+			unsigned int existing = state.Welds.FindOrInsert(p, t, n, index);
+			if (existing != index)
+				return existing;
+		}
+
+		Vertex v = {};
+		v.Position = (p >= 0) ? state.Positions[p] : XMFLOAT3(0, 0, 0);
+		v.UV = (t >= 0) ? state.UVs[t] : XMFLOAT2(0, 0);
+		v.Normal = (n >= 0) ? state.Normals[n] : XMFLOAT3(0, 0, 0);
+		v.Tangent = XMFLOAT4(0, 0, 0, 1);
+
+		// Flip the V coordinate, since DirectX puts (0,0) at the top left,
+		// then flip Z on the position and normal (right to left handed)
+		v.UV.y = 1.0f - v.UV.y;
+		v.Position.z *= -1.0f;
+		v.Normal.z *= -1.0f;
+
+		mesh.Vertices.push_back(v);
+		return index;
+	}
+
+	// --------------------------------------------------------
+	// Turns one face read by a chunk into a fan of triangles
+	// around its first corner, appended to indices
+	// - base holds the element counts of every earlier chunk
+	// --------------------------------------------------------
+	void AddFace(const FaceRecord& face, const FaceCorner* corners, const FaceRecord& base, ObjState& state, ObjLoader::MeshData& mesh, std::vector<unsigned int>& indices)
+	{
+		FaceRecord counts = {};
+		counts.PositionCount = base.PositionCount + face.PositionCount;
+		counts.UVCount = base.UVCount + face.UVCount;
+		counts.NormalCount = base.NormalCount + face.NormalCount;
+
+		// Every triangle re-adds its shared corners, which welding
+		// resolves to the same vertices as the triangle before
+		// - Flip the winding order as well, to match the flipped Z
+		for (int i = 1; i + 1 < face.CornerCount; i++)
+		{
+			unsigned int i1 = AddVertex(corners[0], counts, state, mesh);
+			unsigned int i3 = AddVertex(corners[i + 1], counts, state, mesh);
+			unsigned int i2 = AddVertex(corners[i], counts, state, mesh);
+			indices.insert(indices.end(), { i1, i3, i2 });
+		}
+	}
+
+	const char* ParseFace(const char* p, ObjChunk& chunk)
+	{
+		// Read every "v", "v/vt", "v//vn" or "v/vt/vn" corner
+		size_t firstCorner = chunk.Corners.size();
+		p = SkipSpaces(p);
+		while (IsDigit(*p) || *p == '-' || *p == '+')
+		{
+			FaceCorner corner = {};
+			p = ParseIndex(p, corner.Position);
+			if (*p == '/')
+			{
+				p++;
+				if (*p != '/')
+					p = ParseIndex(p, corner.UV);
+				if (*p == '/')
+					p = ParseIndex(p + 1, corner.Normal);
+			}
+
+			chunk.Corners.push_back(corner);
+			p = SkipSpaces(p);
+		}
+
+		int count = (int)(chunk.Corners.size() - firstCorner);
+		if (count < 3)
+		{
+			chunk.Corners.resize(firstCorner);
+			return p;
+		}
+
+		FaceRecord face = {};
+		face.CornerCount = count;
+		face.PositionCount = (int)chunk.Positions.size();
+		face.UVCount = (int)chunk.UVs.size();
+		face.NormalCount = (int)chunk.Normals.size();
+		chunk.Faces.push_back(face);
+		return p;
+	}
+
+	// --------------------------------------------------------
+	// Reads the rest of the line as one name (material names
+	// can contain spaces), without surrounding whitespace
+	// --------------------------------------------------------
+	const char* ParseName(const char* p, std::string& name)
+	{
+		p = SkipSpaces(p);
+		const char* end = p;
+		while (*end != '\n')
+			end++;
+		const char* last = end;
+		while (last > p && (IsSpace(last[-1]) || last[-1] == '\r'))
+			last--;
+		name.assign(p, last);
+		return end;
+	}
+
+	// "mtllib" can list several files, separated by spaces
+	const char* ParseLibraries(const char* p, ObjChunk& chunk)
+	{
+		p = SkipSpaces(p);
+		while (*p != '\n')
+		{
+			const char* start = p;
+			while (!IsSpace(*p) && *p != '\r' && *p != '\n')
+				p++;
+			chunk.Libraries.emplace_back(start, p);
+			p = SkipSpaces(p);
+		}
+		return p;
+	}
+
+	// --------------------------------------------------------
+	// Parses every line in [begin, end), where end[-1] == '\n'
+	// - Only touches the chunk, so chunks can run in parallel
+	// --------------------------------------------------------
+	void ParseLines(const char* begin, const char* end, ObjChunk& chunk)
+	{
+		const char* p = begin;
+		while (p < end)
+		{
+			p = SkipSpaces(p);
+			if (p[0] == 'v')
+			{
+				if (IsSpace(p[1]))
+				{
+					XMFLOAT3 pos;
+					p = ParseFloat(p + 1, pos.x);
+					p = ParseFloat(p, pos.y);
+					p = ParseFloat(p, pos.z);
+					if (!std::isfinite(pos.x) || !std::isfinite(pos.y) || !std::isfinite(pos.z))
+						throw std::invalid_argument("Error parsing OBJ: Position isn't a finite number");
+					chunk.Positions.push_back(pos);
+				}
+				else if (p[1] == 't' && IsSpace(p[2]))
+				{
+					XMFLOAT2 uv;
+					p = ParseFloat(p + 2, uv.x);
+					p = ParseFloat(p, uv.y);
+					chunk.UVs.push_back(uv);
+				}
+				else if (p[1] == 'n' && IsSpace(p[2]))
+				{
+					XMFLOAT3 norm;
+					p = ParseFloat(p + 2, norm.x);
+					p = ParseFloat(p, norm.y);
+					p = ParseFloat(p, norm.z);
+					chunk.Normals.push_back(norm);
+				}
+			}
+			else if (p[0] == 'f' && IsSpace(p[1]))
+			{
+				p = ParseFace(p + 1, chunk);
+			}
+			else if (strncmp(p, "usemtl", 6) == 0 && IsSpace(p[6]))
+			{
+				chunk.Materials.push_back({ chunk.Faces.size(), std::string() });
+				p = ParseName(p + 6, chunk.Materials.back().Name);
+			}
+			else if (strncmp(p, "mtllib", 6) == 0 && IsSpace(p[6]))
+			{
+				p = ParseLibraries(p + 6, chunk);
+			}
+
+			p = SkipLine(p, end);
+		}
+	}
+
+	// --------------------------------------------------------
+	// Splits [begin, end) into newline-aligned chunks and parses
+	// them on separate threads (end[-1] must be '\n')
+	// --------------------------------------------------------
+	void ParseChunks(const char* begin, const char* end, unsigned int maxThreads, std::vector<ObjChunk>& chunks)
+	{
+		// Small files aren't worth the cost of starting threads
+		size_t length = end - begin;
+		size_t threadCount = maxThreads > 0 ? maxThreads : std::max(1u, std::thread::hardware_concurrency());
+		threadCount = std::min(threadCount, std::max<size_t>(1, length / minChunkSize));
+
+		std::vector<const char*> bounds;
+		bounds.push_back(begin);
+		for (size_t i = 1; i < threadCount; i++)
+		{
+			const char* split = std::max(bounds.back(), begin + length * i / threadCount);
+			bounds.push_back(SkipLine(split, end));
+		}
+		bounds.push_back(end);
+
+		size_t first = chunks.size();
+		chunks.resize(first + threadCount);
+		if (threadCount == 1)
+		{
+			ParseLines(begin, end, chunks[first]);
+			return;
+		}
+
+		// The calling thread takes the first chunk itself
+		std::vector<std::exception_ptr> errors(threadCount);
+		std::vector<std::thread> threads;
+		for (size_t i = 1; i < threadCount; i++)
+		{
+			threads.emplace_back([&, i]() {
+				try { ParseLines(bounds[i], bounds[i + 1], chunks[first + i]); }
+				catch (...) { errors[i] = std::current_exception(); }
+			});
+		}
+
+		try { ParseLines(bounds[0], bounds[1], chunks[first]); }
+		catch (...) { errors[0] = std::current_exception(); }
+
+		for (std::thread& thread : threads)
+			thread.join();
+		for (std::exception_ptr& error : errors)
+		{
+			if (error)
+				std::rethrow_exception(error);
+		}
+	}
+
+	// --------------------------------------------------------
+	// Numbers materials in the order faces first use them, as
+	// usemtl switches them on (switches carry over between
+	// chunks), and collects the mtllib files along the way
+	// --------------------------------------------------------
+	class MaterialGroups
+	{
+	public:
+		std::vector<std::string> Names;
+		std::vector<std::string> Libraries;
+
+		// Calls visit(face, corners, material) for each of the chunk's
+		// faces in order, where material indexes Names
+		template <typename Visitor>
+		void ForEachFace(const ObjChunk& chunk, Visitor visit)
+		{
+			const FaceCorner* corners = chunk.Corners.data();
+			size_t nextSwitch = 0;
+			for (size_t f = 0; f < chunk.Faces.size(); f++)
+			{
+				for (; nextSwitch < chunk.Materials.size() && chunk.Materials[nextSwitch].FaceIndex == f; nextSwitch++)
+					Use(chunk.Materials[nextSwitch].Name);
+
+				// A material only gets a number once a face uses it
+				if (index == SIZE_MAX)
+				{
+					auto inserted = lookup.insert({ current, Names.size() });
+					if (inserted.second)
+						Names.push_back(current);
+					index = inserted.first->second;
+				}
+
+				visit(chunk.Faces[f], corners, index);
+				corners += chunk.Faces[f].CornerCount;
+			}
+
+			for (; nextSwitch < chunk.Materials.size(); nextSwitch++)
+				Use(chunk.Materials[nextSwitch].Name);
+			for (const std::string& library : chunk.Libraries)
+			{
+				if (std::find(Libraries.begin(), Libraries.end(), library) == Libraries.end())
+					Libraries.push_back(library);
+			}
+		}
+
+	private:
+		std::unordered_map<std::string, size_t> lookup;
+		std::string current;
+		size_t index = SIZE_MAX;
+
+		void Use(const std::string& name)
+		{
+			current = name;
+			index = SIZE_MAX;
+		}
+	};
+
+	// --------------------------------------------------------
+	// Converts one chunk of a streamed file to left-handed space
+	// and hands its elements and triangles to the handler
+	// - total holds the element counts of every earlier chunk,
+	//   and is advanced past this one
+	// --------------------------------------------------------
+	void StreamChunk(ObjChunk& chunk, FaceRecord& total, MaterialGroups& groups, ObjLoader::StreamHandler& handler, std::vector<ObjLoader::StreamTriangle>& triangles)
+	{
+		for (XMFLOAT3& position : chunk.Positions)
+			position.z *= -1.0f;
+		for (XMFLOAT2& uv : chunk.UVs)
+			uv.y = 1.0f - uv.y;
+		for (XMFLOAT3& normal : chunk.Normals)
+			normal.z *= -1.0f;
+
+		if (!chunk.Positions.empty())
+			handler.AddPositions(chunk.Positions.data(), chunk.Positions.size());
+		if (!chunk.UVs.empty())
+			handler.AddUVs(chunk.UVs.data(), chunk.UVs.size());
+		if (!chunk.Normals.empty())
+			handler.AddNormals(chunk.Normals.data(), chunk.Normals.size());
+
+		// Same fan (and flipped winding) as AddFace()
+		triangles.clear();
+		groups.ForEachFace(chunk, [&](const FaceRecord& face, const FaceCorner* corners, size_t material)
+		{
+			int positionCount = total.PositionCount + face.PositionCount;
+			int uvCount = total.UVCount + face.UVCount;
+			int normalCount = total.NormalCount + face.NormalCount;
+			for (int i = 1; i + 1 < face.CornerCount; i++)
+			{
+				const FaceCorner* triangle[3] = { &corners[0], &corners[i + 1], &corners[i] };
+				ObjLoader::StreamTriangle result = {};
+				for (int c = 0; c < 3; c++)
+				{
+					result.Positions[c] = ResolveIndex(triangle[c]->Position, positionCount);
+					result.UVs[c] = ResolveIndex(triangle[c]->UV, uvCount);
+					result.Normals[c] = ResolveIndex(triangle[c]->Normal, normalCount);
+				}
+				result.Material = (unsigned int)material;
+				triangles.push_back(result);
+			}
+		});
+		if (!triangles.empty())
+			handler.AddTriangles(triangles.data(), triangles.size());
+
+		total.PositionCount += (int)chunk.Positions.size();
+		total.UVCount += (int)chunk.UVs.size();
+		total.NormalCount += (int)chunk.Normals.size();
+	}
+}
+
+namespace ObjLoader
+{
+	MeshData Load(const char* objFile, const LoadOptions& options)
+	{
+		MappedFile file(objFile);
+		if (!file.IsOpen())
+			throw std::invalid_argument("Error opening file: Invalid file path or file is inaccessible");
+
+		return Parse(file.GetData(), file.GetSize(), options);
+	}
+
+	MeshData Parse(const char* text, size_t length, const LoadOptions& options)
+	{
+		ObjState state;
+		state.Options = options;
+		if (options.WeldVertices && options.WeldEpsilon > 0.0f)
+			state.Grid = std::make_unique<PositionGrid>(options.WeldEpsilon);
+
+		MeshData mesh;
+		if (length == 0)
+			return mesh;
+
+		// Everything up to the last newline can be scanned in place
+		std::vector<ObjChunk> chunks;
+		const char* end = text + length;
+		const char* lastLine = end;
+		while (lastLine > text && lastLine[-1] != '\n')
+			lastLine--;
+		if (lastLine > text)
+			ParseChunks(text, lastLine, options.MaxThreads, chunks);
+
+		// The final line has no newline to stop the scanners, so
+		// give it one in a (tiny) copy
+		if (lastLine < end)
+		{
+			std::string tail(lastLine, end);
+			tail.push_back('\n');
+			chunks.emplace_back();
+			ParseLines(tail.data(), tail.data() + tail.size(), chunks.back());
+		}
+
+		// Prefix sum of each chunk's element counts, which is where
+		// that chunk's data starts in the merged arrays
+		std::vector<FaceRecord> bases(chunks.size());
+		FaceRecord total = {};
+		for (size_t i = 0; i < chunks.size(); i++)
+		{
+			bases[i] = total;
+			total.PositionCount += (int)chunks[i].Positions.size();
+			total.UVCount += (int)chunks[i].UVs.size();
+			total.NormalCount += (int)chunks[i].Normals.size();
+		}
+
+		state.Positions.reserve(total.PositionCount);
+		state.UVs.reserve(total.UVCount);
+		state.Normals.reserve(total.NormalCount);
+		for (ObjChunk& chunk : chunks)
+		{
+			state.Positions.insert(state.Positions.end(), chunk.Positions.begin(), chunk.Positions.end());
+			state.UVs.insert(state.UVs.end(), chunk.UVs.begin(), chunk.UVs.end());
+			state.Normals.insert(state.Normals.end(), chunk.Normals.begin(), chunk.Normals.end());
+			chunk.Positions = std::vector<XMFLOAT3>();
+			chunk.UVs = std::vector<XMFLOAT2>();
+			chunk.Normals = std::vector<XMFLOAT3>();
+		}
+
+		// Epsilon welding depends on the order positions were seen,
+		// so it runs over the merged array
+		if (state.Grid)
+		{
+			state.PositionRemap.resize(state.Positions.size());
+			for (size_t i = 0; i < state.Positions.size(); i++)
+				state.PositionRemap[i] = state.Grid->FindOrInsert(state.Positions, (int)i);
+		}
+
+		// Faces are assembled in file order, so welding (and every
+		// vertex and index) comes out exactly as a serial parse would
+		// - Each material's triangles are collected separately, with
+		//   submeshes made in the order materials are first used
+		std::vector<std::vector<unsigned int>> submeshIndices;
+		MaterialGroups groups;
+		for (size_t i = 0; i < chunks.size(); i++)
+		{
+			groups.ForEachFace(chunks[i], [&](const FaceRecord& face, const FaceCorner* corners, size_t material)
+			{
+				if (material == submeshIndices.size())
+					submeshIndices.emplace_back();
+				AddFace(face, corners, bases[i], state, mesh, submeshIndices[material]);
+			});
+		}
+		for (const std::string& name : groups.Names)
+			mesh.Submeshes.push_back({ name, {} });
+		mesh.MaterialLibraries = groups.Libraries;
+
+		// Submeshes become consecutive ranges of the full mesh
+		if (mesh.Submeshes.empty())
+		{
+			mesh.Submeshes.push_back({ std::string(), {} });
+			submeshIndices.emplace_back();
+		}
+		std::vector<unsigned int> submeshSizes;
+		for (std::vector<unsigned int>& indices : submeshIndices)
+		{
+			submeshSizes.push_back((unsigned int)indices.size());
+			mesh.Indices.insert(mesh.Indices.end(), indices.begin(), indices.end());
+			indices = std::vector<unsigned int>();
+		}
+
+		// Tangents come before anything reorders or simplifies the mesh,
+		// so vertices split at mirrored uvs get optimized (and picked
+		// by LODs) like any other vertex
+		if (!mesh.Indices.empty())
+		{
+			MeshTangents::Options tangentOptions;
+			tangentOptions.TangentMode = options.TangentMode;
+			tangentOptions.MaxThreads = options.MaxThreads;
+			MeshTangents::Generate(mesh.Vertices, mesh.Indices, mesh.Indices.size(), tangentOptions);
+		}
+
+		// Make the index buffer friendly to the vertex cache, which is
+		// only worth it once corners are shared between triangles
+		if (options.OptimizeVertexCache && options.WeldVertices)
+		{
+			mesh.CacheStats = MeshOptimizer::Optimize(mesh.Vertices, mesh.Indices, submeshSizes);
+		}
+		else
+		{
+			mesh.CacheStats.Before = MeshOptimizer::AnalyzeVertexCache(mesh.Indices.data(), mesh.Indices.size(), mesh.Vertices.size());
+			mesh.CacheStats.After = mesh.CacheStats.Before;
+		}
+
+		// LODs need shared vertices to collapse edges between, and
+		// simplify each submesh on its own so materials never mix
+		unsigned int lodCount = options.WeldVertices ? options.LodCount : 1;
+		std::vector<MeshSimplifier::LodRange> submeshLods;
+		mesh.Lods = MeshSimplifier::BuildLodChain(mesh.Vertices, mesh.Indices, lodCount, options.OptimizeVertexCache, submeshSizes, &submeshLods);
+		for (size_t s = 0; s < mesh.Submeshes.size(); s++)
+		{
+			for (size_t lod = 0; lod < mesh.Lods.size(); lod++)
+				mesh.Submeshes[s].Lods.push_back(submeshLods[lod * mesh.Submeshes.size() + s]);
+		}
+
+		// Clustering moves the full mesh's triangles around, so the
+		// cache stats have to reflect the final order
+		// - Each submesh is clustered separately, so no cluster
+		//   crosses a material boundary
+		if (options.BuildClusters && !mesh.Indices.empty())
+		{
+			for (const Submesh& part : mesh.Submeshes)
+			{
+				std::vector<MeshClusters::Cluster> clusters = MeshClusters::Build(
+					mesh.Vertices.data(), mesh.Vertices.size(), mesh.Indices.data(),
+					part.Lods[0].IndexStart, part.Lods[0].IndexCount,
+					options.MaxClusterVertices, options.MaxClusterTriangles);
+				mesh.Clusters.insert(mesh.Clusters.end(), clusters.begin(), clusters.end());
+			}
+			mesh.CacheStats.After = MeshOptimizer::AnalyzeVertexCache(
+				mesh.Indices.data() + mesh.Lods[0].IndexStart, mesh.Lods[0].IndexCount, mesh.Vertices.size());
+		}
+
+		// Local space bounds of everything that was actually used
+		if (!mesh.Vertices.empty())
+		{
+			mesh.BoundsMin = mesh.Vertices[0].Position;
+			mesh.BoundsMax = mesh.Vertices[0].Position;
+			for (const Vertex& v : mesh.Vertices)
+			{
+				mesh.BoundsMin = XMFLOAT3(fminf(mesh.BoundsMin.x, v.Position.x), fminf(mesh.BoundsMin.y, v.Position.y), fminf(mesh.BoundsMin.z, v.Position.z));
+				mesh.BoundsMax = XMFLOAT3(fmaxf(mesh.BoundsMax.x, v.Position.x), fmaxf(mesh.BoundsMax.y, v.Position.y), fmaxf(mesh.BoundsMax.z, v.Position.z));
+			}
+		}
+
+		return mesh;
+	}
+
+	StreamInfo Stream(const char* objFile, StreamHandler& handler, size_t bufferSize, unsigned int maxThreads)
+	{
+		std::ifstream file(objFile, std::ios::binary);
+		if (!file.is_open())
+			throw std::invalid_argument("Error opening file: Invalid file path or file is inaccessible");
+
+		// One byte is always left spare, for the newline that ends
+		// a final line without one (and small files get a buffer
+		// of their own size)
+		file.seekg(0, std::ios::end);
+		uint64_t fileSize = (uint64_t)file.tellg();
+		file.seekg(0, std::ios::beg);
+		std::vector<char> buffer((size_t)std::min<uint64_t>(std::max<size_t>(bufferSize, 1 << 16), fileSize + 2));
+		size_t filled = 0;
+		bool atEnd = false;
+
+		FaceRecord total = {};
+		MaterialGroups groups;
+		std::vector<ObjChunk> chunks;
+		std::vector<StreamTriangle> triangles;
+		while (!atEnd)
+		{
+			file.read(buffer.data() + filled, (std::streamsize)(buffer.size() - 1 - filled));
+			size_t read = (size_t)file.gcount();
+			atEnd = filled + read < buffer.size() - 1;
+			filled += read;
+
+			// Only complete lines are parsed, and the partial one at
+			// the end moves to the front for the next read
+			size_t complete = filled;
+			while (complete > 0 && buffer[complete - 1] != '\n')
+				complete--;
+			if (atEnd && complete < filled)
+			{
+				buffer[filled++] = '\n';
+				complete = filled;
+			}
+			if (complete == 0)
+			{
+				// A single line longer than the whole buffer
+				if (!atEnd)
+					buffer.resize(buffer.size() * 2);
+				continue;
+			}
+
+			chunks.clear();
+			ParseChunks(buffer.data(), buffer.data() + complete, maxThreads, chunks);
+			for (ObjChunk& chunk : chunks)
+				StreamChunk(chunk, total, groups, handler, triangles);
+
+			memmove(buffer.data(), buffer.data() + complete, filled - complete);
+			filled -= complete;
+		}
+
+		StreamInfo info;
+		info.Materials = groups.Names;
+		info.MaterialLibraries = groups.Libraries;
+		return info;
+	}
+}
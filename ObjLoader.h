@@ -0,0 +1,170 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstddef>
+#include "Vertex.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshClusters.h"
+#include "MeshTangents.h"
+
+// --------------------------------------------------------
+// Loads .OBJ files into vertex and index arrays ready for
+// Mesh::CreateBuffers()
+//
+// - The file is memory mapped and tokenized in place, so
+//   there is no per-line copy and no line length limit
+// - Large files are split into newline-aligned chunks that
+//   are parsed in parallel, then merged in file order
+// - Supports positions, uvs and normals, with faces of any
+//   size (positive or negative indices), which are split
+//   into a fan of triangles
+// - Faces are grouped into one submesh per usemtl material,
+//   and every submesh shares the same vertex and index arrays
+//   (o and g groups don't split submeshes, so a model with
+//   hundreds of parts but a few materials is a few draws)
+// - Converts from right-handed OBJ space to left-handed
+//   DirectX space (flipped Z, winding and V coordinate)
+// - Face corners that reference the same position, uv and
+//   normal are welded into a single shared vertex
+// - Tangents are generated next, which can add vertices
+//   where uvs are mirrored (see MeshTangents)
+// - Triangles and vertices can then be reordered for the
+//   GPU's vertex cache (see MeshOptimizer)
+// - Simplified LODs are appended to the index buffer, all
+//   sharing the same vertices (see MeshSimplifier)
+// - The full mesh can be split into clusters for culling
+//   (see MeshClusters)
+// - Files too big for memory can be streamed instead, which
+//   hands over raw elements and triangles a buffer at a time
+//   (see MeshConverter)
+// --------------------------------------------------------
+namespace ObjLoader
+{
+	struct LoadOptions
+	{
+		// Share vertices between faces that use the exact same
+		// position/uv/normal triplet (otherwise every corner of
+		// every triangle gets its own vertex)
+		bool WeldVertices = true;
+
+		// When above zero, positions closer than this distance are
+		// also treated as the same position while welding
+		float WeldEpsilon = 0.0f;
+
+		// Upper limit on parsing threads for large files (zero uses
+		// one per hardware thread); the result doesn't depend on it
+		unsigned int MaxThreads = 0;
+
+		// Reorder triangles and vertices for the post-transform
+		// vertex cache once the mesh is indexed
+		bool OptimizeVertexCache = true;
+
+		// Levels of detail to build, including the full mesh (each
+		// has about half the triangles of the one before)
+		unsigned int LodCount = 4;
+
+		// Split the full detail mesh into clusters of at most this
+		// many vertices and triangles, for culling before each draw
+		bool BuildClusters = false;
+		unsigned int MaxClusterVertices = MeshClusters::DefaultMaxVertices;
+		unsigned int MaxClusterTriangles = MeshClusters::DefaultMaxTriangles;
+
+		// How tangents are generated (MikkTSpace mode may add vertices
+		// where mirrored uvs meet)
+		MeshTangents::Mode TangentMode = MeshTangents::Mode::MikkTSpace;
+
+		// Give the loaded Mesh a BVH of its full detail triangles, for
+		// ray queries on the CPU (kept in a .meshbvh file next to the
+		// source, and only rebuilt when the mesh changes)
+		bool BuildBvh = true;
+	};
+
+	// Triangles that share a material
+	struct Submesh
+	{
+		std::string Material;	// Name given to usemtl (empty before the first one)
+
+		// Where the submesh sits within each LOD, the full mesh first
+		// - Submeshes are in the same order in every LOD, so together
+		//   they always cover the LOD's whole range
+		std::vector<MeshSimplifier::LodRange> Lods;
+	};
+
+	struct MeshData
+	{
+		std::vector<Vertex> Vertices;
+		std::vector<unsigned int> Indices;
+
+		// Where each LOD sits in Indices, starting with the full mesh
+		std::vector<MeshSimplifier::LodRange> Lods;
+
+		// Runs of triangles that share a material, in the order each
+		// material was first used (always at least one)
+		std::vector<Submesh> Submeshes;
+
+		// Material libraries named by mtllib, as written in the file
+		// (so relative to the .obj file's directory)
+		std::vector<std::string> MaterialLibraries;
+
+		// Clusters of the full mesh, if requested (each is a range
+		// within the first LOD, and within a single submesh)
+		std::vector<MeshClusters::Cluster> Clusters;
+
+		// Number of vertices before welding (one per triangle corner)
+		unsigned int SourceVertexCount = 0;
+
+		// Axis-aligned bounds of the (left-handed) positions
+		DirectX::XMFLOAT3 BoundsMin = DirectX::XMFLOAT3(0, 0, 0);
+		DirectX::XMFLOAT3 BoundsMax = DirectX::XMFLOAT3(0, 0, 0);
+
+		// Simulated vertex cache behavior of the full mesh before and
+		// after optimizing (both the same if it wasn't optimized)
+		MeshOptimizer::Stats CacheStats = {};
+	};
+
+	// Throws std::invalid_argument if the file can't be opened
+	// or a face references data that doesn't exist
+	MeshData Load(const char* objFile, const LoadOptions& options = LoadOptions());
+	MeshData Parse(const char* text, size_t length, const LoadOptions& options = LoadOptions());
+
+	// One triangle of a streamed file, with the 0-based index of
+	// each corner's position, uv and normal (-1 where omitted)
+	struct StreamTriangle
+	{
+		int Positions[3];
+		int UVs[3];
+		int Normals[3];
+		unsigned int Material;	// Index into StreamInfo::Materials
+	};
+
+	// --------------------------------------------------------
+	// Receives a streamed file in file order, with elements
+	// already in left-handed space and triangles already
+	// wound for it (nothing is welded or indexed)
+	// - Triangles only reference elements handed over before
+	//   them, so each kind can be written straight to disk
+	// --------------------------------------------------------
+	class StreamHandler
+	{
+	public:
+		virtual ~StreamHandler() = default;
+		virtual void AddPositions(const DirectX::XMFLOAT3* positions, size_t count) = 0;
+		virtual void AddUVs(const DirectX::XMFLOAT2* uvs, size_t count) = 0;
+		virtual void AddNormals(const DirectX::XMFLOAT3* normals, size_t count) = 0;
+		virtual void AddTriangles(const StreamTriangle* triangles, size_t count) = 0;
+	};
+
+	struct StreamInfo
+	{
+		std::vector<std::string> Materials;			// In the order faces first used them
+		std::vector<std::string> MaterialLibraries;	// As written in the file
+	};
+
+	// Parses a file of any size one buffer at a time (each split
+	// across threads like Parse()), so memory use depends on the
+	// buffer size rather than the file
+	// - Element counts are limited to what an int can index
+	// - Throws like Load()
+	StreamInfo Stream(const char* objFile, StreamHandler& handler, size_t bufferSize = 64 << 20, unsigned int maxThreads = 0);
+}
@@ -0,0 +1,264 @@
+#include "Tests.h"
+#include "ObjLoader.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace DirectX;
+
+#ifndef _MSC_VER
+#define sscanf_s sscanf
+#endif
+
+namespace
+{
+	const char* testFile = "ObjLoaderTests.obj";
+
+	// --------------------------------------------------------
+	// A bumpy grid of quads (with a triangle in each row, so
+	// both face sizes show up), with positions, uvs and normals
+	// - Short enough per line for the old 100 character loader
+	// --------------------------------------------------------
+	std::string MakeGrid(int size)
+	{
+		std::string text;
+		char line[100];
+		for (int y = 0; y <= size; y++)
+		{
+			for (int x = 0; x <= size; x++)
+			{
+				snprintf(line, sizeof(line), "v %.4f %.4f %.4f\n", x * 0.5f, sinf(x * 0.3f) * cosf(y * 0.2f), y * -0.5f);
+				text += line;
+				snprintf(line, sizeof(line), "vt %.5f %.5f\n", (float)x / size, (float)y / size);
+				text += line;
+				snprintf(line, sizeof(line), "vn %.4f %.4f %.4f\n", 0.0f, 0.8f, (x % 7) * 0.1f);
+				text += line;
+			}
+		}
+
+		int row = size + 1;
+		for (int y = 0; y < size; y++)
+		{
+			for (int x = 0; x < size; x++)
+			{
+				int a = y * row + x + 1;
+				int b = a + 1;
+				int c = a + row + 1;
+				int d = a + row;
+				if (x == y)
+					snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, b, b, b, c, c, c);
+				else
+					snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, b, b, b, c, c, c, d, d, d);
+				text += line;
+			}
+		}
+		return text;
+	}
+
+	void WriteFile(const char* path, const std::string& text)
+	{
+		std::ofstream file(path, std::ios::binary);
+		file.write(text.data(), (std::streamsize)text.size());
+	}
+
+	// --------------------------------------------------------
+	// The getline/sscanf loader that ObjLoader replaced, kept
+	// to check the new one against: every triangle corner gets
+	// its own vertex, in the same left-handed conversion
+	// --------------------------------------------------------
+	void LoadWithGetline(const char* objFile, std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+	{
+		std::ifstream obj(objFile);
+		if (!obj.is_open())
+			throw std::invalid_argument("Error opening file: Invalid file path or file is inaccessible");
+
+		std::vector<XMFLOAT3> positions;
+		std::vector<XMFLOAT3> normals;
+		std::vector<XMFLOAT2> uvs;
+		unsigned int indexCounter = 0;
+		char chars[100];
+
+		while (obj.good())
+		{
+			obj.getline(chars, 100);
+			if (chars[0] == 'v' && chars[1] == 'n')
+			{
+				XMFLOAT3 norm;
+				sscanf_s(chars, "vn %f %f %f", &norm.x, &norm.y, &norm.z);
+				normals.push_back(norm);
+			}
+			else if (chars[0] == 'v' && chars[1] == 't')
+			{
+				XMFLOAT2 uv;
+				sscanf_s(chars, "vt %f %f", &uv.x, &uv.y);
+				uvs.push_back(uv);
+			}
+			else if (chars[0] == 'v')
+			{
+				XMFLOAT3 pos;
+				sscanf_s(chars, "v %f %f %f", &pos.x, &pos.y, &pos.z);
+				positions.push_back(pos);
+			}
+			else if (chars[0] == 'f')
+			{
+				unsigned int i[12];
+				int numbersRead = sscanf_s(
+					chars,
+					"f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u",
+					&i[0], &i[1], &i[2],
+					&i[3], &i[4], &i[5],
+					&i[6], &i[7], &i[8],
+					&i[9], &i[10], &i[11]);
+
+				Vertex corners[4] = {};
+				for (int c = 0; c < numbersRead / 3; c++)
+				{
+					corners[c].Position = positions[i[c * 3] - 1];
+					corners[c].UV = uvs[i[c * 3 + 1] - 1];
+					corners[c].Normal = normals[i[c * 3 + 2] - 1];
+					corners[c].UV.y = 1.0f - corners[c].UV.y;
+					corners[c].Position.z *= -1.0f;
+					corners[c].Normal.z *= -1.0f;
+				}
+
+				// Flipped winding, then the quad's second half
+				verts.push_back(corners[0]);
+				verts.push_back(corners[2]);
+				verts.push_back(corners[1]);
+				if (numbersRead == 12)
+				{
+					verts.push_back(corners[0]);
+					verts.push_back(corners[3]);
+					verts.push_back(corners[2]);
+				}
+				while (indexCounter < verts.size())
+					indices.push_back(indexCounter++);
+			}
+		}
+	}
+
+	bool SameVertex(const Vertex& a, const Vertex& b)
+	{
+		return
+			a.Position.x == b.Position.x && a.Position.y == b.Position.y && a.Position.z == b.Position.z &&
+			a.UV.x == b.UV.x && a.UV.y == b.UV.y &&
+			a.Normal.x == b.Normal.x && a.Normal.y == b.Normal.y && a.Normal.z == b.Normal.z;
+	}
+
+	// --------------------------------------------------------
+	// Loads the file both ways and checks that they agree
+	// - Unwelded and unoptimized, the new loader has to give
+	//   the old one's vertices, in the old order (and then only
+	//   adds fast tangents, so its timing is mostly parsing)
+	// - With the defaults (welded, optimized), the full detail
+	//   LOD still has to have the old number of indices
+	// --------------------------------------------------------
+	void CheckAgainstGetline(const char* path, double megabytes, bool report)
+	{
+		std::vector<Vertex> oldVertices;
+		std::vector<unsigned int> oldIndices;
+		auto start = std::chrono::steady_clock::now();
+		LoadWithGetline(path, oldVertices, oldIndices);
+		auto oldEnd = std::chrono::steady_clock::now();
+
+		ObjLoader::LoadOptions raw;
+		raw.WeldVertices = false;
+		raw.OptimizeVertexCache = false;
+		raw.LodCount = 1;
+		raw.TangentMode = MeshTangents::Mode::Fast;
+		raw.BuildBvh = false;
+		ObjLoader::MeshData unwelded = ObjLoader::Load(path, raw);
+		auto newEnd = std::chrono::steady_clock::now();
+
+		CHECK(unwelded.Vertices.size() == oldVertices.size());
+		CHECK(unwelded.Indices.size() == oldIndices.size());
+		size_t mismatches = 0;
+		for (size_t i = 0; i < oldVertices.size() && i < unwelded.Vertices.size(); i++)
+			mismatches += !SameVertex(oldVertices[i], unwelded.Vertices[unwelded.Indices[i]]);
+		CHECK(mismatches == 0);
+
+		ObjLoader::LoadOptions defaults;
+		defaults.BuildBvh = false;
+		ObjLoader::MeshData welded = ObjLoader::Load(path, defaults);
+		CHECK(!welded.Lods.empty());
+		CHECK(!welded.Lods.empty() && welded.Lods[0].IndexCount == oldIndices.size());
+		CHECK(welded.Vertices.size() < oldVertices.size());
+
+		if (report)
+		{
+			double oldSeconds = std::chrono::duration<double>(oldEnd - start).count();
+			double newSeconds = std::chrono::duration<double>(newEnd - oldEnd).count();
+			printf("  %.1f MB, %zu triangles: getline %.1f MB/s, ObjLoader %.1f MB/s (%.1fx)\n",
+				megabytes, oldIndices.size() / 3,
+				megabytes / oldSeconds, megabytes / newSeconds, oldSeconds / newSeconds);
+		}
+	}
+}
+
+TEST(ObjLoaderMatchesGetlineLoader)
+{
+	std::string text = MakeGrid(40);
+	WriteFile(testFile, text);
+	CheckAgainstGetline(testFile, text.size() / 1e6, false);
+	std::remove(testFile);
+}
+
+TEST(ObjLoaderRejectsBadIndices)
+{
+	const char* overflow = "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 99999999999999999999\n";
+	const char* missing = "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 4\n";
+	const char* relative = "v 0 0 0\nv 1 0 0\nv 0 1 0\nf -3 -2 -1\n";
+
+	bool threw = false;
+	try { ObjLoader::Parse(overflow, strlen(overflow)); }
+	catch (const std::invalid_argument&) { threw = true; }
+	CHECK(threw);
+
+	threw = false;
+	try { ObjLoader::Parse(missing, strlen(missing)); }
+	catch (const std::invalid_argument&) { threw = true; }
+	CHECK(threw);
+
+	ObjLoader::MeshData mesh = ObjLoader::Parse(relative, strlen(relative));
+	CHECK(mesh.Vertices.size() == 3);
+	CHECK(mesh.Indices.size() == 3);
+}
+
+TEST(ObjLoaderRejectsNonFinitePositions)
+{
+	const char* notNumbers[] = {
+		"v nan 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n",
+		"v 0 inf 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n",
+		"v 0 0 0\nv 1 0 0\nv 0 1 -infinity\nf 1 2 3\n" };
+	ObjLoader::LoadOptions weld;
+	weld.WeldEpsilon = 0.001f;
+	for (const char* text : notNumbers)
+	{
+		bool threw = false;
+		try { ObjLoader::Parse(text, strlen(text), weld); }
+		catch (const std::invalid_argument&) { threw = true; }
+		CHECK(threw);
+	}
+
+	// Positions far more cells away than the grid can count still
+	// weld with their neighbors, and only with them
+	const char* far = "v 1e30 0 0\nv 1e30 0 0\nv 0 1 0\nv -3e38 0 0\nv -3e38 0 0\nf 1 3 4\nf 2 3 5\n";
+	weld.WeldEpsilon = 1e-30f;
+	ObjLoader::MeshData mesh = ObjLoader::Parse(far, strlen(far), weld);
+	CHECK(mesh.Vertices.size() == 3);
+	CHECK(mesh.Indices.size() == 6);
+}
+
+// Parses a generated OBJ of about 65 MB, timing both loaders
+BENCHMARK(ObjLoaderThroughput)
+{
+	std::string text = MakeGrid(650);
+	WriteFile(testFile, text);
+	CheckAgainstGetline(testFile, text.size() / 1e6, true);
+	std::remove(testFile);
+}
@@ -0,0 +1,401 @@
+#include "OcclusionBuffer.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+using namespace DirectX;
+
+namespace
+{
+	// --------------------------------------------------------
+	// Runs work(begin, end) over [0, count), split into up to
+	// maxThreads ranges, with the calling thread taking one
+	// --------------------------------------------------------
+	template <typename Work>
+	void ParallelFor(size_t count, unsigned int maxThreads, const Work& work)
+	{
+		size_t threadCount = maxThreads > 0 ? maxThreads : std::max(1u, std::thread::hardware_concurrency());
+		threadCount = std::min(threadCount, std::max<size_t>(1, count));
+
+		std::vector<std::thread> threads;
+		for (size_t i = 1; i < threadCount; i++)
+			threads.emplace_back(work, count * i / threadCount, count * (i + 1) / threadCount);
+		work(0, count / threadCount);
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+
+	// Centers of four pixels in a row, from the first one's x
+	XMVECTOR PixelCenters(int x)
+	{
+		return XMVectorAdd(XMVectorReplicate((float)x), XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f));
+	}
+
+	void WriteLittleEndian(std::ofstream& out, uint32_t value, int bytes)
+	{
+		for (int i = 0; i < bytes; i++)
+			out.put((char)((value >> (8 * i)) & 0xFF));
+	}
+}
+
+OcclusionBuffer::OcclusionBuffer(unsigned int width, unsigned int height, unsigned int maxThreads) :
+	width(width),
+	height(height),
+	maxThreads(maxThreads),
+	stats()
+{
+	if (width == 0 || height == 0 || width % TileSize != 0 || height % TileSize != 0)
+		throw std::invalid_argument("Error creating occlusion buffer: Width and height must be non-zero multiples of the tile size");
+
+	tilesX = width / TileSize;
+	tilesY = height / TileSize;
+	depth.assign((size_t)width * height, 1.0f);
+	tileDepth.assign((size_t)tilesX * tilesY, 1.0f);
+	bins.resize(tilesY);
+	XMStoreFloat4x4(&viewProjection, XMMatrixIdentity());
+}
+
+void OcclusionBuffer::Begin(const XMFLOAT4X4& viewProjection)
+{
+	this->viewProjection = viewProjection;
+	std::fill(depth.begin(), depth.end(), 1.0f);
+	std::fill(tileDepth.begin(), tileDepth.end(), 1.0f);
+	triangles.clear();
+	double rasterizeTime = stats.RasterizeTime;
+	stats = {};
+	stats.RasterizeTime = rasterizeTime;
+}
+
+// --------------------------------------------------------
+// Moves each triangle into clip space and clips it to the
+// near plane (z >= 0), which leaves nothing, the triangle,
+// or a quad that's drawn as two triangles
+// --------------------------------------------------------
+void OcclusionBuffer::AddOccluder(const MeshBvh::Tree& tree, const XMFLOAT4X4& world)
+{
+	XMMATRIX toClip = XMLoadFloat4x4(&world) * XMLoadFloat4x4(&viewProjection);
+	stats.OccluderCount++;
+	stats.TriangleCount += (unsigned int)tree.Triangles.size();
+
+	for (const MeshBvh::Triangle& source : tree.Triangles)
+	{
+		XMVECTOR v0 = XMLoadFloat3(&source.V0);
+		XMVECTOR corners[3] =
+		{
+			v0,
+			XMVectorAdd(v0, XMLoadFloat3(&source.Edge1)),
+			XMVectorAdd(v0, XMLoadFloat3(&source.Edge2)),
+		};
+		XMFLOAT4 clip[3];
+		for (int i = 0; i < 3; i++)
+			XMStoreFloat4(&clip[i], XMVector3Transform(corners[i], toClip));
+
+		if (clip[0].z >= 0.0f && clip[1].z >= 0.0f && clip[2].z >= 0.0f)
+		{
+			AddScreenTriangle(clip);
+			continue;
+		}
+
+		// Each corner in front is kept, and each edge crossing the
+		// plane adds the point where it does
+		XMFLOAT4 polygon[4];
+		int count = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			const XMFLOAT4& from = clip[i];
+			const XMFLOAT4& to = clip[(i + 1) % 3];
+			if (from.z >= 0.0f)
+				polygon[count++] = from;
+			if ((from.z >= 0.0f) != (to.z >= 0.0f))
+			{
+				float t = from.z / (from.z - to.z);
+				XMStoreFloat4(&polygon[count++], XMVectorLerp(XMLoadFloat4(&from), XMLoadFloat4(&to), t));
+			}
+		}
+		for (int i = 2; i < count; i++)
+		{
+			XMFLOAT4 fan[3] = { polygon[0], polygon[i - 1], polygon[i] };
+			AddScreenTriangle(fan);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Sets up a triangle that's in front of the near plane,
+// skipping it if it can't cover a pixel center
+// --------------------------------------------------------
+void OcclusionBuffer::AddScreenTriangle(const XMFLOAT4 (&clip)[3])
+{
+	float x[3], y[3], z[3];
+	for (int i = 0; i < 3; i++)
+	{
+		if (clip[i].w <= 0.0f)
+			return;
+		x[i] = (clip[i].x / clip[i].w * 0.5f + 0.5f) * width;
+		y[i] = (0.5f - clip[i].y / clip[i].w * 0.5f) * height;
+		z[i] = clip[i].z / clip[i].w;
+	}
+
+	// Pixels whose centers are inside the bounding rectangle
+	ScreenTriangle triangle;
+	triangle.MinX = std::max(0, (int)ceilf(std::min({ x[0], x[1], x[2] }) - 0.5f));
+	triangle.MaxX = std::min((int)width - 1, (int)floorf(std::max({ x[0], x[1], x[2] }) - 0.5f));
+	triangle.MinY = std::max(0, (int)ceilf(std::min({ y[0], y[1], y[2] }) - 0.5f));
+	triangle.MaxY = std::min((int)height - 1, (int)floorf(std::max({ y[0], y[1], y[2] }) - 0.5f));
+	if (triangle.MinX > triangle.MaxX || triangle.MinY > triangle.MaxY)
+		return;
+
+	// Either winding is drawn, so edges are flipped to face inside
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (area == 0.0f)
+		return;
+	float facing = area > 0.0f ? 1.0f : -1.0f;
+	for (int i = 0; i < 3; i++)
+	{
+		int j = (i + 1) % 3;
+		triangle.EdgeX[i] = (y[i] - y[j]) * facing;
+		triangle.EdgeY[i] = (x[j] - x[i]) * facing;
+		triangle.EdgeConstant[i] = (x[i] * y[j] - y[i] * x[j]) * facing;
+	}
+
+	triangle.DepthX = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+	triangle.DepthY = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+	triangle.DepthConstant = z[0] - triangle.DepthX * x[0] - triangle.DepthY * y[0];
+	triangles.push_back(triangle);
+}
+
+void OcclusionBuffer::Rasterize()
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	// Binned in the order they were queued, so every bin is too
+	for (std::vector<unsigned int>& bin : bins)
+		bin.clear();
+	for (unsigned int t = 0; t < (unsigned int)triangles.size(); t++)
+	{
+		for (int row = triangles[t].MinY / (int)TileSize; row <= triangles[t].MaxY / (int)TileSize; row++)
+			bins[row].push_back(t);
+	}
+	stats.RasterizedCount = (unsigned int)triangles.size();
+
+	// Rows of tiles share no pixels, so each is one thread's alone
+	ParallelFor(tilesY, maxThreads, [this](size_t begin, size_t end)
+		{
+			for (size_t row = begin; row < end; row++)
+				RasterizeTileRow((unsigned int)row);
+		});
+
+	stats.RasterizeTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// --------------------------------------------------------
+// Four pixels at a time, starting from the multiple of four
+// at or before each triangle's left edge (width is always a
+// multiple of four, so groups never run off the row)
+// --------------------------------------------------------
+void OcclusionBuffer::RasterizeTileRow(unsigned int tileRow)
+{
+	int rowStart = (int)(tileRow * TileSize);
+	int rowEnd = rowStart + (int)TileSize - 1;
+	for (unsigned int t : bins[tileRow])
+	{
+		const ScreenTriangle& triangle = triangles[t];
+		XMVECTOR edgeX[3], edgeY[3], edgeConstant[3];
+		for (int e = 0; e < 3; e++)
+		{
+			edgeX[e] = XMVectorReplicate(triangle.EdgeX[e]);
+			edgeY[e] = XMVectorReplicate(triangle.EdgeY[e]);
+			edgeConstant[e] = XMVectorReplicate(triangle.EdgeConstant[e]);
+		}
+		XMVECTOR depthX = XMVectorReplicate(triangle.DepthX);
+
+		int firstX = triangle.MinX & ~3;
+		for (int y = std::max(triangle.MinY, rowStart); y <= std::min(triangle.MaxY, rowEnd); y++)
+		{
+			XMVECTOR centerY = XMVectorReplicate(y + 0.5f);
+			XMVECTOR rowEdge[3];
+			for (int e = 0; e < 3; e++)
+				rowEdge[e] = XMVectorMultiplyAdd(edgeY[e], centerY, edgeConstant[e]);
+			XMVECTOR rowDepth = XMVectorReplicate(triangle.DepthY * (y + 0.5f) + triangle.DepthConstant);
+
+			float* row = &depth[(size_t)y * width];
+			for (int x = firstX; x <= triangle.MaxX; x += 4)
+			{
+				XMVECTOR centerX = PixelCenters(x);
+				XMVECTOR inside = XMVectorGreaterOrEqual(XMVectorMultiplyAdd(edgeX[0], centerX, rowEdge[0]), XMVectorZero());
+				inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(XMVectorMultiplyAdd(edgeX[1], centerX, rowEdge[1]), XMVectorZero()));
+				inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(XMVectorMultiplyAdd(edgeX[2], centerX, rowEdge[2]), XMVectorZero()));
+				if (XMVector4EqualInt(inside, XMVectorFalseInt()))
+					continue;
+
+				XMVECTOR pixelDepth = XMVectorMultiplyAdd(depthX, centerX, rowDepth);
+				XMVECTOR old = XMLoadFloat4((const XMFLOAT4*)&row[x]);
+				XMStoreFloat4((XMFLOAT4*)&row[x], XMVectorSelect(old, XMVectorMin(old, pixelDepth), inside));
+			}
+		}
+	}
+
+	// Each tile's farthest pixel
+	for (unsigned int tileX = 0; tileX < tilesX; tileX++)
+	{
+		XMVECTOR farthest = XMVectorZero();
+		for (int y = rowStart; y <= rowEnd; y++)
+		{
+			const float* pixels = &depth[(size_t)y * width + tileX * TileSize];
+			for (unsigned int x = 0; x < TileSize; x += 4)
+				farthest = XMVectorMax(farthest, XMLoadFloat4((const XMFLOAT4*)&pixels[x]));
+		}
+		XMFLOAT4 lanes;
+		XMStoreFloat4(&lanes, farthest);
+		tileDepth[(size_t)tileRow * tilesX + tileX] = std::max(std::max(lanes.x, lanes.y), std::max(lanes.z, lanes.w));
+	}
+}
+
+// --------------------------------------------------------
+// The box's nearest corner is compared against every pixel
+// its screen rectangle covers, skipping whole tiles whose
+// farthest pixel is already nearer
+// --------------------------------------------------------
+bool OcclusionBuffer::IsOccluded(XMFLOAT3 center, XMFLOAT3 extent) const
+{
+	XMMATRIX toClip = XMLoadFloat4x4(&viewProjection);
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+	float nearest = FLT_MAX;
+	for (int c = 0; c < 8; c++)
+	{
+		XMVECTOR corner = XMVectorSet(
+			center.x + (c & 1 ? extent.x : -extent.x),
+			center.y + (c & 2 ? extent.y : -extent.y),
+			center.z + (c & 4 ? extent.z : -extent.z), 1.0f);
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector4Transform(corner, toClip));
+		if (clip.z < 0.0f || clip.w <= 0.0f)
+			return false;
+
+		float x = (clip.x / clip.w * 0.5f + 0.5f) * width;
+		float y = (0.5f - clip.y / clip.w * 0.5f) * height;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		nearest = std::min(nearest, clip.z / clip.w);
+	}
+
+	// Pixels whose centers the rectangle covers
+	int x0 = std::max(0, (int)ceilf(minX - 0.5f));
+	int x1 = std::min((int)width - 1, (int)floorf(maxX - 0.5f));
+	int y0 = std::max(0, (int)ceilf(minY - 0.5f));
+	int y1 = std::min((int)height - 1, (int)floorf(maxY - 0.5f));
+	if (x0 > x1 || y0 > y1)
+		return false;
+
+	XMVECTOR nearestDepth = XMVectorReplicate(nearest);
+	XMVECTOR first = XMVectorReplicate((float)x0);
+	XMVECTOR last = XMVectorReplicate((float)x1);
+	for (int tileY = y0 / (int)TileSize; tileY <= y1 / (int)TileSize; tileY++)
+	{
+		for (int tileX = x0 / (int)TileSize; tileX <= x1 / (int)TileSize; tileX++)
+		{
+			if (tileDepth[(size_t)tileY * tilesX + tileX] < nearest)
+				continue;
+
+			int startX = std::max(x0, tileX * (int)TileSize) & ~3;
+			int endX = std::min(x1, tileX * (int)TileSize + (int)TileSize - 1);
+			int startY = std::max(y0, tileY * (int)TileSize);
+			int endY = std::min(y1, tileY * (int)TileSize + (int)TileSize - 1);
+			for (int y = startY; y <= endY; y++)
+			{
+				const float* row = &depth[(size_t)y * width];
+				for (int x = startX; x <= endX; x += 4)
+				{
+					// Only the lanes within the rectangle count
+					XMVECTOR lanes = XMVectorAdd(XMVectorReplicate((float)x), XMVectorSet(0, 1, 2, 3));
+					XMVECTOR covered = XMVectorAndInt(XMVectorGreaterOrEqual(lanes, first), XMVectorLessOrEqual(lanes, last));
+					XMVECTOR showing = XMVectorGreaterOrEqual(XMLoadFloat4((const XMFLOAT4*)&row[x]), nearestDepth);
+					if (!XMVector4EqualInt(XMVectorAndInt(covered, showing), XMVectorFalseInt()))
+						return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+unsigned int OcclusionBuffer::GetWidth() const
+{
+	return width;
+}
+
+unsigned int OcclusionBuffer::GetHeight() const
+{
+	return height;
+}
+
+float OcclusionBuffer::GetDepth(unsigned int x, unsigned int y) const
+{
+	return depth[(size_t)y * width + x];
+}
+
+OcclusionBuffer::Stats OcclusionBuffer::GetStats() const
+{
+	return stats;
+}
+
+// --------------------------------------------------------
+// Depths are stretched over whatever range was drawn, since
+// a perspective projection leaves nearly all of them near 1
+// - 24 bit pixels, bottom row first, rows padded to 4 bytes
+// --------------------------------------------------------
+bool OcclusionBuffer::WriteImage(const char* bmpFile) const
+{
+	float nearest = 1.0f, farthest = 0.0f;
+	for (float d : depth)
+	{
+		if (d < 1.0f)
+		{
+			nearest = std::min(nearest, d);
+			farthest = std::max(farthest, d);
+		}
+	}
+	float range = farthest > nearest ? farthest - nearest : 1.0f;
+
+	std::ofstream out(bmpFile, std::ios::binary | std::ios::trunc);
+	if (!out)
+		return false;
+
+	uint32_t rowSize = (width * 3 + 3) & ~3u;
+	uint32_t imageSize = rowSize * height;
+	out.write("BM", 2);
+	WriteLittleEndian(out, 54 + imageSize, 4);
+	WriteLittleEndian(out, 0, 4);
+	WriteLittleEndian(out, 54, 4);
+	WriteLittleEndian(out, 40, 4);	// BITMAPINFOHEADER
+	WriteLittleEndian(out, width, 4);
+	WriteLittleEndian(out, height, 4);
+	WriteLittleEndian(out, 1, 2);
+	WriteLittleEndian(out, 24, 2);
+	WriteLittleEndian(out, 0, 4);	// Uncompressed
+	WriteLittleEndian(out, imageSize, 4);
+	WriteLittleEndian(out, 2835, 4);	// 72 dpi
+	WriteLittleEndian(out, 2835, 4);
+	WriteLittleEndian(out, 0, 4);
+	WriteLittleEndian(out, 0, 4);
+
+	std::vector<char> row(rowSize, 0);
+	for (unsigned int y = height; y-- > 0;)
+	{
+		for (unsigned int x = 0; x < width; x++)
+		{
+			float d = depth[(size_t)y * width + x];
+			unsigned char grey = d < 1.0f ? (unsigned char)(255.0f - 223.0f * (d - nearest) / range) : 0;
+			row[x * 3] = row[x * 3 + 1] = row[x * 3 + 2] = (char)grey;
+		}
+		out.write(row.data(), rowSize);
+	}
+	return (bool)out;
+}
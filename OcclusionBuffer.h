@@ -0,0 +1,97 @@
+#pragma once
+#include <vector>
+#include <DirectXMath.h>
+#include "MeshBvh.h"
+
+// --------------------------------------------------------
+// A small depth buffer drawn on the CPU from a few large
+// occluders, so entities hidden behind them can be skipped
+// before anything is sent to the GPU
+//
+// - Occluders are queued as triangles (a mesh's BVH already
+//   holds LOD 0's), then all rasterized at once: each is set
+//   up as edge and depth planes, binned by the rows of tiles
+//   it touches, and each row of tiles is filled by one thread,
+//   four pixels at a time with DirectXMath
+// - Pixels keep the nearest depth, which doesn't depend on
+//   the order triangles arrive in, so the result is the same
+//   however many threads there are
+// - Every 8x8 tile also keeps its farthest depth, so most of
+//   an occlusion test is one comparison per tile, and only
+//   tiles the test can't settle are checked pixel by pixel
+// - Pixels are covered when their center is, so at this
+//   resolution an entity peeking out from behind an occluder
+//   by less than a pixel can be culled
+// - Triangles that cross the near plane are clipped to it,
+//   since a floor the camera stands on is one of the best
+//   occluders there is
+// - Has no dependency on Direct3D
+// --------------------------------------------------------
+class OcclusionBuffer
+{
+public:
+	static const unsigned int TileSize = 8;
+
+	struct Stats
+	{
+		unsigned int OccluderCount;		// Since Begin()
+		unsigned int TriangleCount;		// Queued by the occluders
+		unsigned int RasterizedCount;	// Set up to draw (after clipping, and skipping those off screen or edge on)
+		double RasterizeTime;			// Milliseconds the last Rasterize() took
+	};
+
+	// Width and height must be multiples of TileSize (throws
+	// std::invalid_argument otherwise), and maxThreads of zero
+	// uses every hardware thread
+	OcclusionBuffer(unsigned int width = 320, unsigned int height = 184, unsigned int maxThreads = 0);
+
+	// Clears the buffer and the queue for a new view (view * projection,
+	// in Direct3D's clip space)
+	void Begin(const DirectX::XMFLOAT4X4& viewProjection);
+
+	// Queues every triangle of the tree, placed by the world matrix
+	void AddOccluder(const MeshBvh::Tree& tree, const DirectX::XMFLOAT4X4& world);
+
+	// Draws everything queued since Begin()
+	void Rasterize();
+
+	// True when every pixel the world space box (center and half
+	// size) covers is nearer than all of it
+	// - Boxes reaching in front of the near plane, or completely
+	//   off screen, are never occluded
+	bool IsOccluded(DirectX::XMFLOAT3 center, DirectX::XMFLOAT3 extent) const;
+
+	unsigned int GetWidth() const;
+	unsigned int GetHeight() const;
+	float GetDepth(unsigned int x, unsigned int y) const;	// 1 where nothing was drawn
+	Stats GetStats() const;
+
+	// Writes the buffer as a greyscale .bmp, nearer being brighter
+	// and empty pixels black, returning false on failure
+	bool WriteImage(const char* bmpFile) const;
+
+private:
+	// A triangle ready to rasterize: each edge's plane is positive
+	// inside it, and depth is a plane over the screen
+	struct ScreenTriangle
+	{
+		float EdgeX[3], EdgeY[3], EdgeConstant[3];
+		float DepthX, DepthY, DepthConstant;
+		int MinX, MaxX, MinY, MaxY;		// Pixels, clamped to the screen
+	};
+
+	unsigned int width;
+	unsigned int height;
+	unsigned int tilesX;
+	unsigned int tilesY;
+	unsigned int maxThreads;
+	DirectX::XMFLOAT4X4 viewProjection;
+	std::vector<float> depth;		// Row by row
+	std::vector<float> tileDepth;	// Farthest depth of each tile
+	std::vector<ScreenTriangle> triangles;
+	std::vector<std::vector<unsigned int>> bins;	// Triangles touching each row of tiles
+	Stats stats;
+
+	void AddScreenTriangle(const DirectX::XMFLOAT4 (&clip)[3]);
+	void RasterizeTileRow(unsigned int tileRow);
+};
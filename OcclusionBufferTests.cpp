@@ -0,0 +1,279 @@
+#include "Tests.h"
+#include "OcclusionBuffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	const unsigned int width = 320;
+	const unsigned int height = 184;
+	const float nearClip = 0.1f;
+	const float farClip = 100.0f;
+
+	// A camera at the origin looking down +Z, unless given a view
+	XMFLOAT4X4 MakeViewProjection(FXMMATRIX view = XMMatrixIdentity())
+	{
+		XMFLOAT4X4 viewProjection;
+		XMStoreFloat4x4(&viewProjection, view * XMMatrixPerspectiveFovLH(XM_PI / 3.0f, (float)width / height, nearClip, farClip));
+		return viewProjection;
+	}
+
+	XMFLOAT4X4 MakeWorld(FXMMATRIX matrix)
+	{
+		XMFLOAT4X4 world;
+		XMStoreFloat4x4(&world, matrix);
+		return world;
+	}
+
+	// The depth buffer value of a point straight ahead at this distance
+	float DepthAt(float distance)
+	{
+		return farClip / (farClip - nearClip) * (1.0f - nearClip / distance);
+	}
+
+	MeshBvh::Tree MakeTree(const std::vector<XMFLOAT3>& positions, const std::vector<unsigned int>& indices)
+	{
+		std::vector<Vertex> vertices(positions.size(), Vertex());
+		for (size_t i = 0; i < positions.size(); i++)
+			vertices[i].Position = positions[i];
+		return MeshBvh::Build(vertices.data(), indices.data(), indices.size());
+	}
+
+	// Two triangles in the XY plane, centered on the origin
+	MeshBvh::Tree MakeQuad(float halfWidth, float halfHeight)
+	{
+		return MakeTree(
+			{ XMFLOAT3(-halfWidth, -halfHeight, 0), XMFLOAT3(-halfWidth, halfHeight, 0), XMFLOAT3(halfWidth, halfHeight, 0), XMFLOAT3(halfWidth, -halfHeight, 0) },
+			{ 0, 1, 2, 0, 2, 3 });
+	}
+
+	// A unit cube's twelve triangles
+	MeshBvh::Tree MakeCube()
+	{
+		std::vector<XMFLOAT3> positions;
+		for (int c = 0; c < 8; c++)
+			positions.push_back(XMFLOAT3((c & 1) ? 0.5f : -0.5f, (c & 2) ? 0.5f : -0.5f, (c & 4) ? 0.5f : -0.5f));
+		return MakeTree(positions, {
+			0, 2, 3, 0, 3, 1, 4, 5, 7, 4, 7, 6, 0, 1, 5, 0, 5, 4,
+			2, 6, 7, 2, 7, 3, 0, 4, 6, 0, 6, 2, 1, 3, 7, 1, 7, 5 });
+	}
+
+	// Where a view space point lands on screen, in pixels
+	XMFLOAT2 ToScreen(XMFLOAT3 point)
+	{
+		XMFLOAT4X4 viewProjection = MakeViewProjection();
+		XMFLOAT3 ndc;
+		XMStoreFloat3(&ndc, XMVector3TransformCoord(XMLoadFloat3(&point), XMLoadFloat4x4(&viewProjection)));
+		return XMFLOAT2((ndc.x * 0.5f + 0.5f) * width, (0.5f - ndc.y * 0.5f) * height);
+	}
+}
+
+// A 8 x 8 wall ten units ahead of the camera
+TEST(OcclusionBufferHidesBoxesBehindAWall)
+{
+	OcclusionBuffer buffer(width, height);
+	buffer.Begin(MakeViewProjection());
+	buffer.AddOccluder(MakeQuad(4.0f, 4.0f), MakeWorld(XMMatrixTranslation(0, 0, 10)));
+	buffer.Rasterize();
+
+	OcclusionBuffer::Stats stats = buffer.GetStats();
+	CHECK(stats.OccluderCount == 1 && stats.TriangleCount == 2 && stats.RasterizedCount == 2);
+	CHECK(Tests::Near(buffer.GetDepth(width / 2, height / 2), DepthAt(10.0f), 1e-5f));
+	CHECK(buffer.GetDepth(0, 0) == 1.0f);
+
+	CHECK(buffer.IsOccluded(XMFLOAT3(0, 0, 20), XMFLOAT3(1, 1, 1)));		// Behind it
+	CHECK(buffer.IsOccluded(XMFLOAT3(3, -3, 12), XMFLOAT3(0.5f, 0.5f, 0.5f)));
+	CHECK(!buffer.IsOccluded(XMFLOAT3(0, 0, 5), XMFLOAT3(1, 1, 1)));		// In front of it
+	CHECK(!buffer.IsOccluded(XMFLOAT3(0, 0, 10), XMFLOAT3(1, 1, 1)));		// Through it
+	CHECK(!buffer.IsOccluded(XMFLOAT3(9, 0, 20), XMFLOAT3(1, 1, 1)));		// Peeking out the side
+	CHECK(!buffer.IsOccluded(XMFLOAT3(0, 0, 0), XMFLOAT3(1, 1, 1)));		// Around the camera
+	CHECK(!buffer.IsOccluded(XMFLOAT3(100, 0, 20), XMFLOAT3(1, 1, 1)));	// Off screen
+}
+
+// --------------------------------------------------------
+// Random boxes around the same wall: any box called hidden
+// must really be behind the wall and inside its outline on
+// screen (give or take the pixel centers), and some must be
+// --------------------------------------------------------
+TEST(OcclusionBufferNeverHidesVisibleBoxes)
+{
+	OcclusionBuffer buffer(width, height);
+	buffer.Begin(MakeViewProjection());
+	buffer.AddOccluder(MakeQuad(4.0f, 4.0f), MakeWorld(XMMatrixTranslation(0, 0, 10)));
+	buffer.Rasterize();
+
+	XMFLOAT2 wallMin = ToScreen(XMFLOAT3(-4, 4, 10));
+	XMFLOAT2 wallMax = ToScreen(XMFLOAT3(4, -4, 10));
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> across(-15.0f, 15.0f);
+	std::uniform_real_distribution<float> ahead(1.0f, 40.0f);
+	std::uniform_real_distribution<float> size(0.05f, 3.0f);
+	unsigned int occluded = 0;
+	unsigned int wrong = 0;
+	for (int i = 0; i < 20000; i++)
+	{
+		XMFLOAT3 center(across(random), across(random), ahead(random));
+		XMFLOAT3 extent(size(random), size(random), size(random));
+		if (!buffer.IsOccluded(center, extent))
+			continue;
+		occluded++;
+
+		bool behind = center.z - extent.z > 10.0f;
+		bool inside = true;
+		for (int c = 0; c < 8; c++)
+		{
+			XMFLOAT2 corner = ToScreen(XMFLOAT3(
+				center.x + ((c & 1) ? extent.x : -extent.x),
+				center.y + ((c & 2) ? extent.y : -extent.y),
+				center.z + ((c & 4) ? extent.z : -extent.z)));
+			inside = inside &&
+				corner.x >= wallMin.x - 1.0f && corner.x <= wallMax.x + 1.0f &&
+				corner.y >= wallMin.y - 1.0f && corner.y <= wallMax.y + 1.0f;
+		}
+		wrong += !(behind && inside);
+	}
+	CHECK(occluded > 100);
+	CHECK(wrong == 0);
+}
+
+// A floor running under the camera is clipped at the near plane, not lost
+TEST(OcclusionBufferClipsAtTheNearPlane)
+{
+	OcclusionBuffer buffer(width, height);
+	buffer.Begin(MakeViewProjection(XMMatrixLookToLH(XMVectorSet(0, 1.7f, 0, 0), XMVectorSet(0, -0.3f, 1, 0), XMVectorSet(0, 1, 0, 0))));
+	buffer.AddOccluder(MakeQuad(500.0f, 500.0f), MakeWorld(XMMatrixRotationRollPitchYaw(XM_PIDIV2, 0, 0)));
+	buffer.Rasterize();
+
+	CHECK(buffer.GetStats().RasterizedCount > 2);
+	CHECK(buffer.GetDepth(width / 2, height - 1) < 1.0f);
+	CHECK(buffer.IsOccluded(XMFLOAT3(0, -3, 10), XMFLOAT3(1, 1, 1)));
+	CHECK(!buffer.IsOccluded(XMFLOAT3(0, 1, 10), XMFLOAT3(1, 0.5f, 1)));
+}
+
+// --------------------------------------------------------
+// Hundreds of overlapping walls and cubes (some through the
+// near plane) give exactly the same depths with one thread
+// or many, and in either order
+// --------------------------------------------------------
+TEST(OcclusionBufferIsDeterministic)
+{
+	MeshBvh::Tree quad = MakeQuad(2.0f, 1.0f);
+	MeshBvh::Tree cube = MakeCube();
+	std::mt19937 random(2);
+	std::uniform_real_distribution<float> across(-20.0f, 20.0f);
+	std::uniform_real_distribution<float> ahead(-2.0f, 60.0f);
+	std::uniform_real_distribution<float> angle(-XM_PI, XM_PI);
+	std::vector<XMFLOAT4X4> worlds;
+	for (int i = 0; i < 400; i++)
+	{
+		worlds.push_back(MakeWorld(
+			XMMatrixScaling(3, 3, 3) *
+			XMMatrixRotationRollPitchYaw(angle(random), angle(random), angle(random)) *
+			XMMatrixTranslation(across(random), across(random) * 0.5f, ahead(random))));
+	}
+
+	XMFLOAT4X4 viewProjection = MakeViewProjection();
+	OcclusionBuffer single(width, height, 1);
+	OcclusionBuffer threaded(width, height, 8);
+	single.Begin(viewProjection);
+	threaded.Begin(viewProjection);
+	for (size_t i = 0; i < worlds.size(); i++)
+	{
+		single.AddOccluder((i % 2) ? cube : quad, worlds[i]);
+		size_t reversed = worlds.size() - 1 - i;
+		threaded.AddOccluder((reversed % 2) ? cube : quad, worlds[reversed]);
+	}
+	single.Rasterize();
+	threaded.Rasterize();
+
+	unsigned int differences = 0;
+	unsigned int drawn = 0;
+	for (unsigned int y = 0; y < height; y++)
+	{
+		for (unsigned int x = 0; x < width; x++)
+		{
+			differences += single.GetDepth(x, y) != threaded.GetDepth(x, y);
+			drawn += single.GetDepth(x, y) < 1.0f;
+		}
+	}
+	CHECK(differences == 0);
+	CHECK(drawn > width * height / 4);
+	CHECK(single.GetStats().RasterizedCount == threaded.GetStats().RasterizedCount);
+}
+
+TEST(OcclusionBufferWritesAnImage)
+{
+	bool threw = false;
+	try { OcclusionBuffer wrongSize(321, 184); }
+	catch (const std::invalid_argument&) { threw = true; }
+	CHECK(threw);
+
+	OcclusionBuffer buffer(width, height);
+	buffer.Begin(MakeViewProjection());
+	buffer.AddOccluder(MakeQuad(4.0f, 4.0f), MakeWorld(XMMatrixTranslation(0, 0, 10)));
+	buffer.Rasterize();
+	CHECK(buffer.WriteImage("OcclusionBufferTests.bmp"));
+
+	// A .bmp header, and a file as long as the header says
+	std::ifstream file("OcclusionBufferTests.bmp", std::ios::binary | std::ios::ate);
+	std::streamoff length = file.tellg();
+	file.seekg(0);
+	char header[6] = {};
+	file.read(header, 6);
+	file.close();
+	std::remove("OcclusionBufferTests.bmp");
+	unsigned int size = (unsigned char)header[2] | (unsigned char)header[3] << 8 | (unsigned char)header[4] << 16 | (unsigned int)(unsigned char)header[5] << 24;
+	CHECK(header[0] == 'B' && header[1] == 'M');
+	CHECK(size == length && length > (std::streamoff)(width * height));
+}
+
+// --------------------------------------------------------
+// Rasterizing 1000 cubes on one thread and on all of them,
+// and then testing 100k boxes against the result
+// --------------------------------------------------------
+BENCHMARK(OcclusionBufferThroughput)
+{
+	MeshBvh::Tree cube = MakeCube();
+	std::mt19937 random(3);
+	std::uniform_real_distribution<float> across(-30.0f, 30.0f);
+	std::uniform_real_distribution<float> ahead(3.0f, 80.0f);
+	std::uniform_real_distribution<float> size(1.0f, 6.0f);
+	std::vector<XMFLOAT4X4> worlds;
+	for (int i = 0; i < 1000; i++)
+		worlds.push_back(MakeWorld(XMMatrixScaling(size(random), size(random), size(random)) * XMMatrixTranslation(across(random), across(random) * 0.3f, ahead(random))));
+
+	const unsigned int threadCounts[] = { 1, 0 };
+	for (unsigned int threads : threadCounts)
+	{
+		OcclusionBuffer buffer(width, height, threads);
+		double milliseconds = 0.0;
+		const int passes = 50;
+		for (int pass = 0; pass < passes; pass++)
+		{
+			buffer.Begin(MakeViewProjection());
+			for (const XMFLOAT4X4& world : worlds)
+				buffer.AddOccluder(cube, world);
+			buffer.Rasterize();
+			milliseconds += buffer.GetStats().RasterizeTime;
+		}
+		printf("  Rasterizing %u triangles (%s): %.3f ms\n", buffer.GetStats().RasterizedCount,
+			threads == 1 ? "one thread" : "every thread", milliseconds / passes);
+
+		if (threads != 0)
+			continue;
+		unsigned int occluded = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < 100000; i++)
+			occluded += buffer.IsOccluded(XMFLOAT3(across(random), across(random) * 0.3f, ahead(random)), XMFLOAT3(0.5f, 0.5f, 0.5f));
+		printf("  Testing 100000 boxes: %.3f ms, %u occluded\n",
+			std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(), occluded);
+	}
+}
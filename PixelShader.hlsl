@@ -1,5 +1,6 @@
 #include "ShaderInclude.hlsli"
 #define NUM_LIGHTS 5
+#define MAX_SHADOW_CASCADES 4
 
 cbuffer ExternalData : register(b0)
 {
@@ -15,6 +16,10 @@ cbuffer ExternalData : register(b0)
     float padding;
     
     Light lights[NUM_LIGHTS];
+    
+    // Each cascade's light view * projection (see ShadowCascades.h)
+    matrix shadowViewProjections[MAX_SHADOW_CASCADES];
+    int cascadeCount;
 }
 
 Texture2D Albedo : register(t0);
@@ -25,6 +30,36 @@ Texture2D ShadowMap : register(t4);
 SamplerState BasicSampler : register(s0); // "s" registers for samplers
 SamplerComparisonState ShadowSampler : register(s1);
 
+// --------------------------------------------------------
+// How lit a world position is by the shadowed light, from
+// the first cascade whose square covers it
+// - ShadowMap holds MAX_SHADOW_CASCADES squares side by side
+// - A texel's margin is left at each square's edge, so the
+//   comparison filter never reads from the next square
+// - Past the last cascade, nothing is shadowed
+// --------------------------------------------------------
+float ShadowAmount(float3 worldPosition)
+{
+    float width, height;
+    ShadowMap.GetDimensions(width, height);
+    float margin = MAX_SHADOW_CASCADES / width;
+    
+    for (int c = 0; c < cascadeCount; c++)
+    {
+        float4 shadowMapPos = mul(shadowViewProjections[c], float4(worldPosition, 1.0f));
+        
+        // Convert normalized coords to UVS for sample
+        float2 shadowUV = shadowMapPos.xy * 0.5f + 0.5f;
+        shadowUV.y = 1 - shadowUV.y;
+        if (any(shadowUV < margin) || any(shadowUV > 1 - margin) || shadowMapPos.z < 0 || shadowMapPos.z > 1)
+            continue;
+        
+        shadowUV.x = (shadowUV.x + c) / MAX_SHADOW_CASCADES;
+        return ShadowMap.SampleCmpLevelZero(ShadowSampler, shadowUV, shadowMapPos.z).r;
+    }
+    return 1.0f;
+}
+
 // --------------------------------------------------------
 // The entry point (main method) for our pixel shader
 // 
@@ -42,27 +77,16 @@ float4 main(VertexToPixel input) : SV_TARGET
 	//   of the triangle we're rendering
     
     
-    // Shadow map calc
-    // Perspective divide
-    input.shadowMapPos /= input.shadowMapPos.w;
-    
-    // Convert normalized coords to UVS for sample
-    float2 shadowUV = input.shadowMapPos.xy * 0.5f + 0.5f;
-    shadowUV.y = 1 - shadowUV.y;
-    
-    // Get distances needed
-    float distToLight = input.shadowMapPos.z;
-    //float distToShadowMap = ShadowMap.Sample(ShadowSampler, shadowUV).r;
-    
-    float shadowAmount = ShadowMap.SampleCmpLevelZero(ShadowSampler, shadowUV, distToLight).r;
+    // Shadow map calc (orthographic, so no perspective divide)
+    float shadowAmount = ShadowAmount(input.worldPosition);
 
     float3 unpackedNormal = NormalMap.Sample(BasicSampler, input.UV).rgb * 2 - 1;
-    float3 tangent = normalize(input.Tangent);
+    float3 tangent = normalize(input.Tangent.xyz);
     input.Normal = normalize(input.Normal);
     input.UV = input.UV * uvScale + uvOffset;
     
     tangent = normalize(tangent - input.Normal * dot(tangent, input.Normal));
-    float3 bi_tangent = cross(tangent, input.Normal);
+    float3 bi_tangent = cross(tangent, input.Normal) * (input.Tangent.w < 0.0f ? -1.0f : 1.0f); // Flipped for mirrored uvs
     float3x3 tbn = float3x3(tangent, bi_tangent, input.Normal);
     input.Normal = normalize(mul(unpackedNormal, tbn));
     
@@ -0,0 +1,170 @@
+#include "RenderQueue.h"
+#include "GameEntity.h"
+#include <chrono>
+#include <stdexcept>
+
+using namespace DirectX;
+
+// Anonymous namespace for the id fields, which are private to this file
+namespace
+{
+	// Field numbers for GetId()
+	const int VertexShaderField = 0;
+	const int PixelShaderField = 1;
+	const int MaterialField = 2;
+	const int MeshField = 3;
+}
+
+void RenderQueue::Begin(std::shared_ptr<Camera> camera)
+{
+	this->camera = camera;
+	view = camera->GetView();
+	farClip = camera->GetFarClip();
+	packets.clear();
+	items.clear();
+	stats = {};
+}
+
+// --------------------------------------------------------
+// Depth is the view space depth of the center of the mesh's
+// bounds (as a fraction of the far clip distance), shared
+// by all of the entity's packets
+// --------------------------------------------------------
+void RenderQueue::Add(GameEntity* entity, unsigned int pass)
+{
+	if (pass > 3)
+		throw std::invalid_argument("Error adding to render queue: The pass must be from 0 to 3");
+
+	std::shared_ptr<Mesh> mesh = entity->GetMesh();
+	XMFLOAT3 boundsMin = mesh->GetBoundsMin();
+	XMFLOAT3 boundsMax = mesh->GetBoundsMax();
+	XMFLOAT4X4 world = entity->GetTransform()->GetWorldMatrix();
+	XMVECTOR center = XMVectorScale(XMVectorAdd(XMLoadFloat3(&boundsMin), XMLoadFloat3(&boundsMax)), 0.5f);
+	center = XMVector3Transform(center, XMLoadFloat4x4(&world) * XMLoadFloat4x4(&view));
+	float depth = XMVectorGetZ(center) / farClip;
+
+	int submeshCount = entity->GetMaterialCount();
+	for (int first = 0; first < submeshCount;)
+	{
+		std::shared_ptr<Material> material = entity->GetMaterial(first);
+		int count = 1;
+		while (first + count < submeshCount && entity->GetMaterial(first + count) == material)
+			count++;
+
+		Packet packet = {};
+		packet.Entity = entity;
+		packet.Geometry = mesh.get();
+		packet.Surface = material.get();
+		packet.VertexShader = entity->GetVertexShader(first).get();
+		packet.PixelShader = material->GetPixelShader().get();
+		packet.FirstSubmesh = first;
+		packet.SubmeshCount = count;
+
+		uint64_t key = MakeKey(pass,
+			GetId(VertexShaderField, packet.VertexShader),
+			GetId(PixelShaderField, packet.PixelShader),
+			GetId(MaterialField, packet.Surface),
+			GetId(MeshField, packet.Geometry),
+			depth);
+		items.push_back({ key, (unsigned int)packets.size() });
+		packets.push_back(packet);
+		first += count;
+	}
+}
+
+// --------------------------------------------------------
+// Each kind of state is only set when it differs from the
+// packet before
+// - Setting a vertex shader also binds its own (unused) copy
+//   of ObjectData, so the entity's has to be bound again
+// - Setting a pixel shader means its constants have to go
+//   up again, so the next material is always set too
+// - The mesh is prepared once per entity in a row (a mesh
+//   shared by entities picks its LOD for each), and packed
+//   meshes change the vertex shader's dequantization
+// --------------------------------------------------------
+void RenderQueue::Submit(const std::function<void(std::shared_ptr<SimplePixelShader>)>& setFrameData)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	XMFLOAT4X4 proj = camera->GetProj();
+	XMFLOAT3 cameraPosition = camera->GetPosition();
+	SimpleVertexShader* vertexShader = nullptr;
+	SimplePixelShader* pixelShader = nullptr;
+	Material* material = nullptr;
+	Mesh* mesh = nullptr;
+	GameEntity* entity = nullptr;
+	for (const SortItem& item : items)
+	{
+		const Packet& packet = packets[item.Packet];
+		bool packed = packet.Geometry->GetVertexFormat() == VertexFormat::Packed;
+		bool vertexShaderChanged = packet.VertexShader != vertexShader;
+		if (vertexShaderChanged || (packed && packet.Geometry != mesh))
+		{
+			std::shared_ptr<SimpleVertexShader> vs = packet.Entity->GetVertexShader(packet.FirstSubmesh);
+			if (vertexShaderChanged)
+			{
+				vs->SetShader();
+				vs->SetMatrix4x4("viewMatrix", view);
+				vs->SetMatrix4x4("projMatrix", proj);
+				vertexShader = packet.VertexShader;
+				entity = nullptr;
+			}
+
+			// Packed positions are stored relative to the mesh's bounds
+			if (packed)
+			{
+				vs->SetFloat3("positionOffset", packet.Geometry->GetQuantization().Offset);
+				vs->SetFloat3("positionScale", packet.Geometry->GetQuantization().Scale);
+			}
+
+			// Only the per-frame data, as ObjectData comes from BindObjectConstants()
+			vs->CopyBufferData("ExternalData");
+		}
+		mesh = packet.Geometry;
+
+		if (packet.PixelShader != pixelShader)
+		{
+			std::shared_ptr<SimplePixelShader> ps = packet.Surface->GetPixelShader();
+			ps->SetShader();
+			setFrameData(ps);
+			ps->SetFloat3("cameraPosition", cameraPosition);
+			pixelShader = packet.PixelShader;
+			material = nullptr;
+		}
+
+		if (packet.Surface != material)
+		{
+			std::shared_ptr<SimplePixelShader> ps = packet.Surface->GetPixelShader();
+			ps->SetFloat4("colorTint", packet.Surface->GetColorTint());
+			ps->SetFloat2("uvScale", packet.Surface->GetUVScale());
+			ps->SetFloat2("uvOffset", packet.Surface->GetUVOffset());
+			ps->SetFloat("roughness", packet.Surface->GetRoughness());
+			ps->CopyAllBufferData();
+			packet.Surface->PrepareMaterial();
+			material = packet.Surface;
+		}
+
+		if (packet.Entity != entity)
+		{
+			packet.Geometry->PrepareDraw(camera, packet.Entity->GetTransform()->GetWorldMatrix());
+			packet.Entity->BindObjectConstants();
+			entity = packet.Entity;
+		}
+
+		packet.Geometry->DrawSubmeshes(packet.FirstSubmesh, packet.SubmeshCount);
+	}
+
+	stats.SubmitTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+unsigned int RenderQueue::GetId(int field, const void* object)
+{
+	std::unordered_map<const void*, unsigned int>::iterator found = ids[field].find(object);
+	if (found != ids[field].end())
+		return found->second;
+
+	unsigned int id = (unsigned int)ids[field].size();
+	ids[field].emplace(object, id);
+	return id;
+}
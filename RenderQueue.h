@@ -0,0 +1,115 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <DirectXMath.h>
+
+class GameEntity;
+class Mesh;
+class Material;
+class Camera;
+class SimpleVertexShader;
+class SimplePixelShader;
+
+// --------------------------------------------------------
+// Collects a frame's draws as packets, sorts them by the
+// state they need, and submits them changing only what
+// differs from the packet before
+//
+// - A packet is an entity's run of submeshes that share a
+//   material (like GameEntity::Draw() draws them)
+// - Each packet gets a 64-bit key, most significant first:
+//   pass (2 bits), vertex shader (7), pixel shader (7),
+//   material (16), mesh (16), then view depth (16), so
+//   sorting the keys groups the most expensive changes
+//   together and draws front to back within each group
+// - Shaders, materials and meshes are numbered the first
+//   time they're seen and keep their numbers across frames,
+//   so the order doesn't flicker; numbers past a field's
+//   range wrap around, which only costs sorting quality,
+//   since Submit() compares the objects themselves
+// - Keys are radix sorted, a byte at a time from the least
+//   significant, skipping bytes every key has in common
+// - Keys and sorting are in RenderQueueSort.cpp, which only
+//   deals in keys, so it builds without the renderer (as in
+//   the Tests project)
+// --------------------------------------------------------
+class RenderQueue
+{
+public:
+	struct StateChanges
+	{
+		unsigned int VertexShaders;
+		unsigned int PixelShaders;
+		unsigned int Materials;
+		unsigned int Meshes;
+	};
+
+	struct Stats
+	{
+		unsigned int PacketCount;
+		StateChanges Unsorted;	// Had the packets been submitted in the order they were added
+		StateChanges Sorted;	// After sorting (drawing without a queue changes everything every packet)
+		double SortTime;		// Milliseconds
+		double SubmitTime;
+	};
+
+	struct SortItem
+	{
+		uint64_t Key;
+		unsigned int Packet;
+	};
+
+	// Empties the queue for a new frame, seen from the camera
+	void Begin(std::shared_ptr<Camera> camera);
+
+	// Queues every submesh of the entity (which must outlive the
+	// frame), throwing std::invalid_argument for a pass over 3
+	void Add(GameEntity* entity, unsigned int pass = 0);
+
+	void Sort();
+
+	// Draws everything in sorted order
+	// - The callback is given each pixel shader as it's set, for
+	//   the frame's own data (lights, shadows and the like), which
+	//   goes to the GPU with the material's constants
+	void Submit(const std::function<void(std::shared_ptr<SimplePixelShader>)>& setFrameData);
+
+	Stats GetStats() const;
+
+	// A packet's key (the fields past their ranges wrap, and depth
+	// is 0 at the camera and 1 at the far clip)
+	static uint64_t MakeKey(unsigned int pass, unsigned int vertexShader, unsigned int pixelShader, unsigned int material, unsigned int mesh, float depth);
+
+	// Sorts by key, keeping equal keys in order, using scratch
+	// as the other buffer
+	static void RadixSort(std::vector<SortItem>& items, std::vector<SortItem>& scratch);
+
+	// The state changes submitting the items in order would make
+	static StateChanges CountChanges(const std::vector<SortItem>& items);
+
+private:
+	struct Packet
+	{
+		GameEntity* Entity;
+		Mesh* Geometry;
+		Material* Surface;
+		SimpleVertexShader* VertexShader;
+		SimplePixelShader* PixelShader;
+		int FirstSubmesh;
+		int SubmeshCount;
+	};
+
+	std::shared_ptr<Camera> camera;
+	DirectX::XMFLOAT4X4 view;
+	float farClip;
+	std::vector<Packet> packets;
+	std::vector<SortItem> items;
+	std::vector<SortItem> scratch;
+	std::unordered_map<const void*, unsigned int> ids[4];	// Vertex shaders, pixel shaders, materials and meshes
+	Stats stats = {};
+
+	unsigned int GetId(int field, const void* object);
+};
@@ -0,0 +1,113 @@
+#include "RenderQueue.h"
+#include <chrono>
+#include <cmath>
+
+using namespace DirectX;
+
+// Anonymous namespace for the key layout, which is private to this file
+namespace
+{
+	const unsigned int DepthShift = 0;
+	const unsigned int MeshShift = 16;
+	const unsigned int MaterialShift = 32;
+	const unsigned int PixelShaderShift = 48;
+	const unsigned int VertexShaderShift = 55;
+	const unsigned int PassShift = 62;
+
+	// Bits of each field (shaders only get seven each)
+	const uint64_t DepthMask = 0xFFFFull << DepthShift;
+	const uint64_t MeshMask = 0xFFFFull << MeshShift;
+	const uint64_t MaterialMask = 0xFFFFull << MaterialShift;
+	const uint64_t PixelShaderMask = 0x7Full << PixelShaderShift;
+	const uint64_t VertexShaderMask = 0x7Full << VertexShaderShift;
+}
+
+void RenderQueue::Sort()
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	stats.PacketCount = (unsigned int)packets.size();
+	stats.Unsorted = CountChanges(items);
+	RadixSort(items, scratch);
+	stats.Sorted = CountChanges(items);
+	stats.SortTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+RenderQueue::Stats RenderQueue::GetStats() const
+{
+	return stats;
+}
+
+// --------------------------------------------------------
+// Depth is clamped to the camera's range, so anything behind
+// it sorts first and anything past the far clip sorts last
+// --------------------------------------------------------
+uint64_t RenderQueue::MakeKey(unsigned int pass, unsigned int vertexShader, unsigned int pixelShader, unsigned int material, unsigned int mesh, float depth)
+{
+	uint64_t quantizedDepth = (uint64_t)(fminf(fmaxf(depth, 0.0f), 1.0f) * 65535.0f + 0.5f);
+	return ((uint64_t)pass << PassShift) |
+		(((uint64_t)vertexShader << VertexShaderShift) & VertexShaderMask) |
+		(((uint64_t)pixelShader << PixelShaderShift) & PixelShaderMask) |
+		(((uint64_t)material << MaterialShift) & MaterialMask) |
+		(((uint64_t)mesh << MeshShift) & MeshMask) |
+		(quantizedDepth << DepthShift);
+}
+
+// --------------------------------------------------------
+// Least significant byte first, each pass a counting sort
+// into the other array, which keeps equal keys in order
+// - All eight histograms come from one read of the keys,
+//   and a byte that's the same in every key is skipped
+// --------------------------------------------------------
+void RenderQueue::RadixSort(std::vector<SortItem>& items, std::vector<SortItem>& scratch)
+{
+	if (items.size() < 2)
+		return;
+
+	size_t counts[8][256] = {};
+	for (const SortItem& item : items)
+	{
+		for (int b = 0; b < 8; b++)
+			counts[b][(item.Key >> (b * 8)) & 0xFF]++;
+	}
+
+	scratch.resize(items.size());
+	for (int b = 0; b < 8; b++)
+	{
+		unsigned int shift = b * 8;
+		if (counts[b][(items[0].Key >> shift) & 0xFF] == items.size())
+			continue;
+
+		size_t offset = 0;
+		for (int value = 0; value < 256; value++)
+		{
+			size_t count = counts[b][value];
+			counts[b][value] = offset;
+			offset += count;
+		}
+		for (const SortItem& item : items)
+			scratch[counts[b][(item.Key >> shift) & 0xFF]++] = item;
+		items.swap(scratch);
+	}
+}
+
+// --------------------------------------------------------
+// A field that differs from the packet before is a change,
+// and the first packet changes everything
+// --------------------------------------------------------
+RenderQueue::StateChanges RenderQueue::CountChanges(const std::vector<SortItem>& items)
+{
+	StateChanges changes = {};
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		uint64_t changed = i == 0 ? ~0ull : items[i].Key ^ items[i - 1].Key;
+		if (changed & VertexShaderMask)
+			changes.VertexShaders++;
+		if (changed & PixelShaderMask)
+			changes.PixelShaders++;
+		if (changed & MaterialMask)
+			changes.Materials++;
+		if (changed & MeshMask)
+			changes.Meshes++;
+	}
+	return changes;
+}
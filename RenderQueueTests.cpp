@@ -0,0 +1,127 @@
+#include "Tests.h"
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+	struct SortTimes
+	{
+		double RadixSortTime;	// Milliseconds
+		double StdSortTime;		// Milliseconds for the same with std::sort()
+		RenderQueue::StateChanges Unsorted;
+		RenderQueue::StateChanges Sorted;
+		unsigned int MismatchCount;	// Places the two sorts disagree (should be zero)
+	};
+
+	// --------------------------------------------------------
+	// Sorts this many packets with made up keys, spread over a
+	// few hundred materials (each with its own pair of shaders
+	// out of a few) and a thousand meshes, both ways
+	// --------------------------------------------------------
+	SortTimes TimeSorts(unsigned int packetCount)
+	{
+		const unsigned int materialCount = 300;
+		const unsigned int meshCount = 1000;
+		std::mt19937 random(1);
+		std::uniform_int_distribution<unsigned int> vertexShaders(0, 3);
+		std::uniform_int_distribution<unsigned int> pixelShaders(0, 7);
+		std::uniform_int_distribution<unsigned int> materials(0, materialCount - 1);
+		std::uniform_int_distribution<unsigned int> meshes(0, meshCount - 1);
+		std::uniform_real_distribution<float> depths(0.0f, 1.0f);
+		std::vector<unsigned int> materialShaders(materialCount * 2);
+		for (unsigned int m = 0; m < materialCount; m++)
+		{
+			materialShaders[m * 2] = vertexShaders(random);
+			materialShaders[m * 2 + 1] = pixelShaders(random);
+		}
+
+		std::vector<RenderQueue::SortItem> unsorted(packetCount);
+		for (unsigned int i = 0; i < packetCount; i++)
+		{
+			unsigned int m = materials(random);
+			unsorted[i].Key = RenderQueue::MakeKey(0, materialShaders[m * 2], materialShaders[m * 2 + 1], m, meshes(random), depths(random));
+			unsorted[i].Packet = i;
+		}
+
+		SortTimes result = {};
+		std::vector<RenderQueue::SortItem> radixSorted, stdSorted, scratch;
+		unsigned int passes = 0;
+		while (passes < 3 || result.RadixSortTime + result.StdSortTime < 100.0)
+		{
+			radixSorted = unsorted;
+			stdSorted = unsorted;
+			auto start = std::chrono::steady_clock::now();
+			RenderQueue::RadixSort(radixSorted, scratch);
+			auto radixEnd = std::chrono::steady_clock::now();
+			std::sort(stdSorted.begin(), stdSorted.end(), [](const RenderQueue::SortItem& a, const RenderQueue::SortItem& b) {
+				return a.Key < b.Key || (a.Key == b.Key && a.Packet < b.Packet);
+			});
+			auto end = std::chrono::steady_clock::now();
+
+			result.RadixSortTime += std::chrono::duration<double, std::milli>(radixEnd - start).count();
+			result.StdSortTime += std::chrono::duration<double, std::milli>(end - radixEnd).count();
+			passes++;
+		}
+		result.RadixSortTime /= passes;
+		result.StdSortTime /= passes;
+
+		// The radix sort is stable, so equal keys stay in packet order
+		result.Unsorted = RenderQueue::CountChanges(unsorted);
+		result.Sorted = RenderQueue::CountChanges(radixSorted);
+		for (unsigned int i = 0; i < packetCount; i++)
+		{
+			if (radixSorted[i].Key != stdSorted[i].Key || radixSorted[i].Packet != stdSorted[i].Packet)
+				result.MismatchCount++;
+		}
+		return result;
+	}
+}
+
+
+// --------------------------------------------------------
+// The radix sort against std::sort(), at counts around the
+// size of one byte's buckets, and the state changes it saves
+// (the made up packets use 4 vertex shaders, 8 pixel
+// shaders and 300 materials)
+// --------------------------------------------------------
+TEST(RenderQueueSortMatchesStdSort)
+{
+	const unsigned int counts[] = { 2, 255, 256, 257, 10007 };
+	for (unsigned int count : counts)
+	{
+		SortTimes result = TimeSorts(count);
+		CHECK(result.MismatchCount == 0);
+
+		// Sorted, every vertex shader is set once, every pixel
+		// shader once per vertex shader, and so on down
+		CHECK(result.Sorted.VertexShaders <= 4);
+		CHECK(result.Sorted.PixelShaders <= 4 * 8);
+		CHECK(result.Sorted.Materials <= 300);
+		CHECK(result.Sorted.VertexShaders <= result.Unsorted.VertexShaders);
+		CHECK(result.Sorted.PixelShaders <= result.Unsorted.PixelShaders);
+		CHECK(result.Sorted.Materials <= result.Unsorted.Materials);
+		CHECK(result.Sorted.Meshes <= result.Unsorted.Meshes);
+		if (count > 1000)
+			CHECK(result.Sorted.Materials * 10 < result.Unsorted.Materials);
+	}
+}
+
+// Milliseconds to sort, and the state changes left, at 10k, 100k and 1M packets
+BENCHMARK(RenderQueueSortThroughput)
+{
+	const unsigned int counts[] = { 10000, 100000, 1000000 };
+	for (unsigned int count : counts)
+	{
+		SortTimes result = TimeSorts(count);
+		printf("  %7u packets: radix %.3f ms, std::sort %.3f ms\n", count, result.RadixSortTime, result.StdSortTime);
+		printf("    vertex shader/pixel shader/material/mesh changes: %u/%u/%u/%u unsorted, %u/%u/%u/%u sorted\n",
+			result.Unsorted.VertexShaders, result.Unsorted.PixelShaders, result.Unsorted.Materials, result.Unsorted.Meshes,
+			result.Sorted.VertexShaders, result.Sorted.PixelShaders, result.Sorted.Materials, result.Sorted.Meshes);
+		CHECK(result.MismatchCount == 0);
+	}
+}
@@ -0,0 +1,122 @@
+#include "SceneQuery.h"
+
+using namespace DirectX;
+
+// Anonymous namespace for the helpers, which are private to this file
+namespace
+{
+	MeshBvh::Ray TransformRay(const MeshBvh::Ray& ray, FXMMATRIX matrix)
+	{
+		MeshBvh::Ray local;
+		XMStoreFloat3(&local.Origin, XMVector3TransformCoord(XMLoadFloat3(&ray.Origin), matrix));
+		XMStoreFloat3(&local.Direction, XMVector3TransformNormal(XMLoadFloat3(&ray.Direction), matrix));
+		local.MaxDistance = ray.MaxDistance;
+		return local;
+	}
+
+	// Fills in the rest of a hit once the closest one is known
+	void FinishHit(const std::vector<std::shared_ptr<GameEntity>>& entities, const MeshBvh::Ray& ray, SceneQuery::Hit& hit)
+	{
+		if (hit.Entity < 0)
+			return;
+
+		XMVECTOR position = XMVectorMultiplyAdd(XMLoadFloat3(&ray.Direction), XMVectorReplicate(hit.Distance), XMLoadFloat3(&ray.Origin));
+		XMStoreFloat3(&hit.Position, position);
+
+		// Submeshes are ranges of LOD 0's indices
+		std::shared_ptr<Mesh> mesh = entities[hit.Entity]->GetMesh();
+		unsigned int index = mesh->GetLod(0).IndexStart + hit.Triangle * 3;
+		hit.Submesh = 0;
+		for (int s = 0; s < mesh->GetSubmeshCount(); s++)
+		{
+			const MeshSimplifier::LodRange& range = mesh->GetSubmesh(s).Lods[0];
+			if (index >= range.IndexStart && index < range.IndexStart + range.IndexCount)
+			{
+				hit.Submesh = s;
+				break;
+			}
+		}
+	}
+}
+
+namespace SceneQuery
+{
+	MeshBvh::Ray GetScreenRay(std::shared_ptr<Camera> camera, float x, float y, float width, float height)
+	{
+		XMFLOAT4X4 view = camera->GetView();
+		XMFLOAT4X4 proj = camera->GetProj();
+		XMMATRIX inverseViewProj = XMMatrixInverse(0, XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&proj)));
+
+		// Pixel to clip space, with y pointing up
+		float clipX = x / width * 2.0f - 1.0f;
+		float clipY = 1.0f - y / height * 2.0f;
+		XMVECTOR nearPoint = XMVector3TransformCoord(XMVectorSet(clipX, clipY, 0.0f, 1.0f), inverseViewProj);
+		XMVECTOR farPoint = XMVector3TransformCoord(XMVectorSet(clipX, clipY, 1.0f, 1.0f), inverseViewProj);
+		XMVECTOR offset = XMVectorSubtract(farPoint, nearPoint);
+
+		MeshBvh::Ray ray;
+		XMStoreFloat3(&ray.Origin, nearPoint);
+		XMStoreFloat3(&ray.Direction, XMVector3Normalize(offset));
+		ray.MaxDistance = XMVectorGetX(XMVector3Length(offset));
+		return ray;
+	}
+
+	bool Raycast(const std::vector<std::shared_ptr<GameEntity>>& entities, const MeshBvh::Ray& ray, Hit& hit)
+	{
+		hit = Hit();
+		MeshBvh::Hit closest;
+		for (size_t e = 0; e < entities.size(); e++)
+		{
+			const MeshBvh::Tree& tree = entities[e]->GetMesh()->GetBvh();
+			if (tree.Nodes.empty())
+				continue;
+
+			// Only hits closer than any other entity's change closest
+			XMFLOAT4X4 inverse = entities[e]->GetTransform()->GetWorldInverseMatrix();
+			if (MeshBvh::Intersect(tree, TransformRay(ray, XMLoadFloat4x4(&inverse)), closest))
+			{
+				hit.Entity = (int)e;
+				hit.Triangle = closest.Triangle;
+				hit.Distance = closest.Distance;
+			}
+		}
+
+		FinishHit(entities, ray, hit);
+		return hit.Entity >= 0;
+	}
+
+	void Raycast(const std::vector<std::shared_ptr<GameEntity>>& entities, const MeshBvh::Ray* rays, size_t rayCount, Hit* hits)
+	{
+		std::vector<MeshBvh::Ray> localRays(rayCount);
+		std::vector<MeshBvh::Hit> closest(rayCount);
+		for (size_t r = 0; r < rayCount; r++)
+			hits[r] = Hit();
+
+		for (size_t e = 0; e < entities.size(); e++)
+		{
+			const MeshBvh::Tree& tree = entities[e]->GetMesh()->GetBvh();
+			if (tree.Nodes.empty())
+				continue;
+
+			XMFLOAT4X4 inverse = entities[e]->GetTransform()->GetWorldInverseMatrix();
+			XMMATRIX inverseMatrix = XMLoadFloat4x4(&inverse);
+			for (size_t r = 0; r < rayCount; r++)
+				localRays[r] = TransformRay(rays[r], inverseMatrix);
+
+			// A ray's hit only changes when this entity is closer
+			MeshBvh::Intersect(tree, localRays.data(), rayCount, closest.data());
+			for (size_t r = 0; r < rayCount; r++)
+			{
+				if (closest[r].Distance < hits[r].Distance)
+				{
+					hits[r].Entity = (int)e;
+					hits[r].Triangle = closest[r].Triangle;
+					hits[r].Distance = closest[r].Distance;
+				}
+			}
+		}
+
+		for (size_t r = 0; r < rayCount; r++)
+			FinishHit(entities, rays[r], hits[r]);
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <DirectXMath.h>
+#include "MeshBvh.h"
+#include "GameEntity.h"
+#include "Camera.h"
+
+// --------------------------------------------------------
+// Ray queries against every entity in a scene, using each
+// mesh's BVH (see MeshBvh), for picking and gameplay
+//
+// - Rays are moved into each entity's object space with its
+//   transform's inverse, rather than moving the mesh, so one
+//   tree serves every entity sharing the mesh
+// - The inverse keeps the direction unnormalized, so hit
+//   distances stay in world units and entities can be
+//   compared directly
+// - Entities whose mesh has no BVH are never hit
+// --------------------------------------------------------
+namespace SceneQuery
+{
+	struct Hit
+	{
+		int Entity = -1;		// Into the entities given (-1 when nothing was hit)
+		int Submesh = -1;		// Of the entity's mesh
+		unsigned int Triangle = 0;	// Within LOD 0 of the mesh
+		float Distance = FLT_MAX;	// Along the ray's direction, in world space
+		DirectX::XMFLOAT3 Position = DirectX::XMFLOAT3(0, 0, 0);	// World space
+	};
+
+	// World space ray through a pixel of the camera's view (from the
+	// near plane, with a normalized direction, reaching the far plane)
+	MeshBvh::Ray GetScreenRay(std::shared_ptr<Camera> camera, float x, float y, float width, float height);
+
+	// Closest hit along the ray, returning false if there's none
+	bool Raycast(const std::vector<std::shared_ptr<GameEntity>>& entities, const MeshBvh::Ray& ray, Hit& hit);
+
+	// Closest hits of any number of rays, which go through each
+	// entity's tree together, four at a time
+	void Raycast(const std::vector<std::shared_ptr<GameEntity>>& entities, const MeshBvh::Ray* rays, size_t rayCount, Hit* hits);
+}
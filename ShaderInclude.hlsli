@@ -164,7 +164,49 @@ struct VertexShaderInput
     float3 Position : POSITION; // XYZ position
     float2 UV : TEXCOORD;
     float3 Normal : NORMAL;
-    float3 Tangent : TANGENT;
+    float4 Tangent : TANGENT;   // W is the handedness (-1 where uvs are mirrored)
+};
+
+// Compact version of the vertex above (PackedVertex in C++)
+// - The input layout does the unorm/half/snorm to float conversion,
+//   so all that's left is to undo the quantization and encoding
+struct VertexShaderInputPacked
+{
+    float4 Position : POSITION; // XYZ within the mesh bounds, W is the tangent sign (0 or 1)
+    float2 UV : TEXCOORD;
+    float2 Normal : NORMAL;     // Octahedral encoding
+    float2 Tangent : TANGENT;   // Octahedral encoding
+};
+
+// Unit vector from octahedral coordinates in [-1, 1]
+float3 DecodeOctahedral(float2 e)
+{
+    float3 v = float3(e, 1.0f - abs(e.x) - abs(e.y));
+    float t = saturate(-v.z);
+    v.xy += (v.xy >= 0.0f) ? -t : t; // Per component
+    return normalize(v);
+}
+
+// Restores a full vertex, given the offset and scale of the
+// mesh's quantized positions
+VertexShaderInput UnpackVertex(VertexShaderInputPacked input, float3 positionOffset, float3 positionScale)
+{
+    VertexShaderInput output;
+    output.Position = positionOffset + input.Position.xyz * positionScale;
+    output.UV = input.UV;
+    output.Normal = DecodeOctahedral(input.Normal);
+    output.Tangent = float4(DecodeOctahedral(input.Tangent), input.Position.w * 2.0f - 1.0f);
+    return output;
+}
+
+// Per-object data, kept in a buffer each GameEntity owns and
+// only rewrites when its transform changes
+// - Shared by every vertex shader that draws entities, so the
+//   same buffer can be bound to all of them
+cbuffer ObjectData : register(b1)
+{
+    matrix worldMatrix;
+    matrix worldInvMatrix;
 };
 
 // Struct representing the data we're sending down the pipeline
@@ -182,9 +224,8 @@ struct VertexToPixel
     float4 screenPosition : SV_POSITION; // XYZW position (System Value Position)
     float2 UV : TEXCOORD;
     float3 Normal : NORMAL;
-    float3 Tangent : TANGENT;
+    float4 Tangent : TANGENT;
     float3 worldPosition : POSITION;
-    float4 shadowMapPos : SHADOW_POSITION;
 };
 struct VertexToPixel_Sky
 {
@@ -0,0 +1,110 @@
+#include "ShadowCascades.h"
+#include <stdexcept>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace ShadowCascades
+{
+	void ComputeSplits(float nearClip, float farClip, int count, float blend, float* splits)
+	{
+		for (int i = 0; i <= count; i++)
+		{
+			float fraction = (float)i / count;
+			float logarithmic = nearClip * powf(farClip / nearClip, fraction);
+			float uniform = nearClip + (farClip - nearClip) * fraction;
+			splits[i] = blend * logarithmic + (1.0f - blend) * uniform;
+		}
+
+		// Exact ends, whatever the rounding above did
+		splits[0] = nearClip;
+		splits[count] = farClip;
+	}
+
+	// --------------------------------------------------------
+	// The sphere is found in the camera's view space, where the
+	// slice is symmetric about the z axis, so its center stays
+	// on the axis and its radius depends only on the depths
+	// --------------------------------------------------------
+	Cascade Fit(const XMFLOAT4X4& cameraView, float fov, float aspectRatio,
+		float nearDepth, float farDepth, XMFLOAT3 lightDirection, unsigned int resolution, float casterDistance)
+	{
+		float tanY = tanf(fov * 0.5f);
+		float tanX = tanY * aspectRatio;
+
+		// Squared distances of the near and far corners from the axis
+		float nearOffAxis = nearDepth * nearDepth * (tanX * tanX + tanY * tanY);
+		float farOffAxis = farDepth * farDepth * (tanX * tanX + tanY * tanY);
+
+		// Centered where it's as far from the near corners as the far
+		// ones, unless that's past the far plane
+		float centerDepth = (farDepth * farDepth + farOffAxis - nearDepth * nearDepth - nearOffAxis) / (2.0f * (farDepth - nearDepth));
+		centerDepth = fminf(fmaxf(centerDepth, nearDepth), farDepth);
+		float radius = sqrtf(fmaxf(
+			(farDepth - centerDepth) * (farDepth - centerDepth) + farOffAxis,
+			(centerDepth - nearDepth) * (centerDepth - nearDepth) + nearOffAxis));
+
+		// Rounded up, so floating point noise can't change its size
+		radius = ceilf(radius * 16.0f) / 16.0f;
+
+		XMMATRIX viewMatrix = XMLoadFloat4x4(&cameraView);
+		XMVECTOR center = XMVector3Transform(XMVectorSet(0, 0, centerDepth, 1), XMMatrixInverse(nullptr, viewMatrix));
+
+		// The light's view never depends on the camera, so texels keep
+		// the same places in it from frame to frame
+		XMVECTOR direction = XMVector3Normalize(XMLoadFloat3(&lightDirection));
+		XMVECTOR up = fabsf(XMVectorGetY(direction)) > 0.99f ? XMVectorSet(0, 0, 1, 0) : XMVectorSet(0, 1, 0, 0);
+		XMMATRIX lightView = XMMatrixLookToLH(XMVectorZero(), direction, up);
+
+		XMFLOAT3 lightCenter;
+		XMStoreFloat3(&lightCenter, XMVector3Transform(center, lightView));
+
+		// Snapping moves the center by up to a texel, so the square
+		// is a texel wider than the sphere on every side
+		float texelSize = 2.0f * radius / (resolution - 2);
+		float halfSize = radius + texelSize;
+		lightCenter.x = floorf(lightCenter.x / texelSize) * texelSize;
+		lightCenter.y = floorf(lightCenter.y / texelSize) * texelSize;
+
+		XMMATRIX projection = XMMatrixOrthographicOffCenterLH(
+			lightCenter.x - halfSize, lightCenter.x + halfSize,
+			lightCenter.y - halfSize, lightCenter.y + halfSize,
+			lightCenter.z - radius - casterDistance, lightCenter.z + radius);
+
+		Cascade cascade = {};
+		XMStoreFloat4x4(&cascade.View, lightView);
+		XMStoreFloat4x4(&cascade.Projection, projection);
+		XMStoreFloat4x4(&cascade.ViewProjection, lightView * projection);
+		cascade.NearDepth = nearDepth;
+		cascade.FarDepth = farDepth;
+		cascade.Radius = radius;
+		cascade.TexelSize = texelSize;
+		return cascade;
+	}
+
+	int Fit(const Settings& settings, const XMFLOAT4X4& cameraView, float fov, float aspectRatio,
+		float nearClip, float farClip, XMFLOAT3 lightDirection, Cascade* cascades)
+	{
+		if (settings.CascadeCount < 1 || settings.CascadeCount > MaxCascades)
+			throw std::invalid_argument("Error fitting shadow cascades: There must be between one and four cascades");
+		if (settings.Resolution < 3)
+			throw std::invalid_argument("Error fitting shadow cascades: Each cascade needs at least three texels across");
+		float shadowFar = fminf(farClip, settings.MaxDistance);
+		if (!(nearClip > 0.0f && shadowFar > nearClip))
+			throw std::invalid_argument("Error fitting shadow cascades: The camera's depths must be positive and increasing");
+
+		float splits[MaxCascades + 1];
+		ComputeSplits(nearClip, shadowFar, settings.CascadeCount, settings.SplitBlend, splits);
+		for (int c = 0; c < settings.CascadeCount; c++)
+		{
+			cascades[c] = Fit(cameraView, fov, aspectRatio, splits[c], splits[c + 1],
+				lightDirection, settings.Resolution, settings.CasterDistance);
+		}
+		return settings.CascadeCount;
+	}
+
+	Frustum GetFrustum(const Cascade& cascade)
+	{
+		return Frustum::FromMatrix(XMLoadFloat4x4(&cascade.ViewProjection));
+	}
+}
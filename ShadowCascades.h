@@ -0,0 +1,63 @@
+#pragma once
+#include <DirectXMath.h>
+#include "Frustum.h"
+
+// --------------------------------------------------------
+// Cascaded shadow maps for a directional light: the camera's
+// view is split by depth into slices, and each slice gets its
+// own orthographic projection from the light, so shadows near
+// the camera get most of the texels
+//
+// - Splits blend evenly spaced and logarithmic ones, since
+//   logarithmic alone leaves the first slice tiny
+// - Each projection is a square around the sphere that holds
+//   its slice, so its size doesn't change as the camera turns,
+//   and it only moves in whole texels (in the light's space),
+//   so shadow edges don't shimmer as the camera moves
+// - The near plane is pulled back toward the light, so things
+//   outside the slice can still cast shadows into it
+// - Nothing here needs a device: it's only matrices, and each
+//   cascade's frustum culls its own casters
+// --------------------------------------------------------
+namespace ShadowCascades
+{
+	const int MaxCascades = 4;
+
+	struct Settings
+	{
+		int CascadeCount = 4;
+		float MaxDistance = 80.0f;		// Camera depth past which nothing is shadowed
+		float SplitBlend = 0.75f;		// 0 is evenly spaced splits, 1 is logarithmic
+		unsigned int Resolution = 1024;	// Texels across each cascade's square
+		float CasterDistance = 50.0f;	// How far before a slice casters are kept
+	};
+
+	struct Cascade
+	{
+		DirectX::XMFLOAT4X4 View;
+		DirectX::XMFLOAT4X4 Projection;
+		DirectX::XMFLOAT4X4 ViewProjection;
+		float NearDepth;	// Camera depths the slice covers
+		float FarDepth;
+		float Radius;		// Of the sphere around the slice
+		float TexelSize;	// In world units
+	};
+
+	// Fills count + 1 depths from nearClip to farClip
+	void ComputeSplits(float nearClip, float farClip, int count, float blend, float* splits);
+
+	// Fits a cascade to the slice of a perspective camera's view
+	// between two depths (lightDirection needn't be normalized)
+	Cascade Fit(const DirectX::XMFLOAT4X4& cameraView, float fov, float aspectRatio,
+		float nearDepth, float farDepth, DirectX::XMFLOAT3 lightDirection, unsigned int resolution, float casterDistance);
+
+	// Fits every cascade the settings ask for, returning how many
+	// - Throws std::invalid_argument for a cascade count outside
+	//   1 to MaxCascades, a resolution under three texels, or a
+	//   camera that ends before it starts
+	int Fit(const Settings& settings, const DirectX::XMFLOAT4X4& cameraView, float fov, float aspectRatio,
+		float nearClip, float farClip, DirectX::XMFLOAT3 lightDirection, Cascade* cascades);
+
+	// Planes for culling the cascade's casters
+	Frustum GetFrustum(const Cascade& cascade);
+}
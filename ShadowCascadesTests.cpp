@@ -0,0 +1,259 @@
+#include "Tests.h"
+#include "ShadowCascades.h"
+#include "EntityCulling.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	const float fov = XM_PIDIV4;
+	const float aspectRatio = 16.0f / 9.0f;
+	const XMFLOAT3 lightDirection(0.4f, -1.0f, 0.6f);
+
+	XMFLOAT4X4 MakeView(XMFLOAT3 position, float yaw, float pitch)
+	{
+		XMFLOAT4X4 view;
+		XMStoreFloat4x4(&view, XMMatrixLookToLH(XMLoadFloat3(&position),
+			XMVector3Rotate(XMVectorSet(0, 0, 1, 0), XMQuaternionRotationRollPitchYaw(pitch, yaw, 0)),
+			XMVectorSet(0, 1, 0, 0)));
+		return view;
+	}
+
+	// A world space point in the cascade's clip space
+	XMFLOAT3 ToClip(const ShadowCascades::Cascade& cascade, XMVECTOR point)
+	{
+		XMFLOAT3 clip;
+		XMStoreFloat3(&clip, XMVector3TransformCoord(point, XMLoadFloat4x4(&cascade.ViewProjection)));
+		return clip;
+	}
+
+	// --------------------------------------------------------
+	// Whether all eight corners of the camera's slice land in
+	// the cascade, with room for a texel of filtering at the
+	// sides
+	// --------------------------------------------------------
+	bool HoldsSlice(const ShadowCascades::Cascade& cascade, const XMFLOAT4X4& cameraView, unsigned int resolution)
+	{
+		XMMATRIX inverseView = XMMatrixInverse(nullptr, XMLoadFloat4x4(&cameraView));
+		float tanY = tanf(fov * 0.5f);
+		float tanX = tanY * aspectRatio;
+		float margin = 1.0f - 2.0f / resolution;
+		for (int c = 0; c < 8; c++)
+		{
+			float depth = (c & 4) ? cascade.FarDepth : cascade.NearDepth;
+			XMVECTOR corner = XMVectorSet(
+				((c & 1) ? 1.0f : -1.0f) * depth * tanX,
+				((c & 2) ? 1.0f : -1.0f) * depth * tanY,
+				depth, 1.0f);
+			XMFLOAT3 clip = ToClip(cascade, XMVector3TransformCoord(corner, inverseView));
+			if (fabsf(clip.x) > margin || fabsf(clip.y) > margin || clip.z < 0.0f || clip.z > 1.0f)
+				return false;
+		}
+		return true;
+	}
+
+	// How far into its texel a point lands, from 0 to 1 across
+	XMFLOAT2 TexelOffset(const ShadowCascades::Cascade& cascade, XMVECTOR point, unsigned int resolution)
+	{
+		XMFLOAT3 clip = ToClip(cascade, point);
+		float u = (clip.x * 0.5f + 0.5f) * resolution;
+		float v = (clip.y * 0.5f + 0.5f) * resolution;
+		return XMFLOAT2(u - floorf(u), v - floorf(v));
+	}
+
+	// Equal offsets, allowing for one being just under 1 and the other just over 0
+	bool SameOffset(float a, float b, float tolerance)
+	{
+		float difference = fabsf(a - b);
+		return difference < tolerance || difference > 1.0f - tolerance;
+	}
+}
+
+TEST(ShadowCascadeSplitsBlendUniformAndLogarithmic)
+{
+	float splits[ShadowCascades::MaxCascades + 1];
+	ShadowCascades::ComputeSplits(0.1f, 80.0f, 4, 0.0f, splits);
+	for (int i = 0; i <= 4; i++)
+		CHECK(Tests::Near(splits[i], 0.1f + (80.0f - 0.1f) * i / 4.0f, 1e-4f));
+
+	ShadowCascades::ComputeSplits(0.1f, 80.0f, 4, 1.0f, splits);
+	for (int i = 1; i < 4; i++)
+		CHECK(Tests::Near(splits[i] / splits[i - 1], splits[i + 1] / splits[i], 1e-3f));
+
+	// The ends are exact, and anything in between still increases
+	ShadowCascades::ComputeSplits(0.1f, 80.0f, 3, 0.75f, splits);
+	CHECK(splits[0] == 0.1f && splits[3] == 80.0f);
+	for (int i = 1; i <= 3; i++)
+		CHECK(splits[i] > splits[i - 1]);
+}
+
+// --------------------------------------------------------
+// Every cascade holds its whole slice, from a spread of
+// camera positions and directions, including looking
+// straight along the light
+// --------------------------------------------------------
+TEST(ShadowCascadesHoldTheirSlices)
+{
+	ShadowCascades::Settings settings;
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> angle(-XM_PI, XM_PI);
+	unsigned int escaped = 0;
+	for (int i = 0; i < 500; i++)
+	{
+		XMFLOAT4X4 view = MakeView(XMFLOAT3(position(random), position(random), position(random)), angle(random), angle(random) * 0.45f);
+		if (i == 0)
+			XMStoreFloat4x4(&view, XMMatrixLookToLH(XMVectorZero(), XMLoadFloat3(&lightDirection), XMVectorSet(0, 1, 0, 0)));
+
+		ShadowCascades::Cascade cascades[ShadowCascades::MaxCascades];
+		int count = ShadowCascades::Fit(settings, view, fov, aspectRatio, 0.1f, 1000.0f, lightDirection, cascades);
+		CHECK(count == settings.CascadeCount);
+		for (int c = 0; c < count; c++)
+			escaped += !HoldsSlice(cascades[c], view, settings.Resolution);
+
+		// Slices meet end to end, and stop at the shadow distance
+		CHECK(cascades[0].NearDepth == 0.1f && cascades[count - 1].FarDepth == settings.MaxDistance);
+		for (int c = 1; c < count; c++)
+			CHECK(cascades[c].NearDepth == cascades[c - 1].FarDepth);
+	}
+	CHECK(escaped == 0);
+}
+
+// --------------------------------------------------------
+// Moving or turning the camera must not move shadow texels
+// across the world: a fixed point stays at the same place
+// within its texel, and the cascade's size doesn't change
+// --------------------------------------------------------
+TEST(ShadowCascadesSnapToTexels)
+{
+	ShadowCascades::Settings settings;
+	XMVECTOR point = XMVectorSet(3.3f, 0.7f, 12.1f, 1.0f);
+	ShadowCascades::Cascade first[ShadowCascades::MaxCascades];
+	ShadowCascades::Fit(settings, MakeView(XMFLOAT3(0, 2, 0), 0.0f, 0.0f), fov, aspectRatio, 0.1f, 1000.0f, lightDirection, first);
+
+	unsigned int shimmers = 0;
+	unsigned int resizes = 0;
+	for (int frame = 1; frame < 200; frame++)
+	{
+		XMFLOAT4X4 view = MakeView(XMFLOAT3(frame * 0.0137f, 2.0f, frame * 0.0071f), frame * 0.005f, 0.0f);
+		ShadowCascades::Cascade cascades[ShadowCascades::MaxCascades];
+		ShadowCascades::Fit(settings, view, fov, aspectRatio, 0.1f, 1000.0f, lightDirection, cascades);
+		for (int c = 0; c < settings.CascadeCount; c++)
+		{
+			XMFLOAT2 before = TexelOffset(first[c], point, settings.Resolution);
+			XMFLOAT2 after = TexelOffset(cascades[c], point, settings.Resolution);
+			shimmers += !SameOffset(before.x, after.x, 0.02f) || !SameOffset(before.y, after.y, 0.02f);
+			resizes += cascades[c].Radius != first[c].Radius;
+		}
+	}
+	CHECK(shimmers == 0);
+	CHECK(resizes == 0);
+}
+
+// Casters up to the caster distance toward the light from anything in
+// a slice are kept, even outside the slice, and ones past it aren't
+TEST(ShadowCascadesKeepCastersTowardTheLight)
+{
+	ShadowCascades::Settings settings;
+	XMFLOAT4X4 view = MakeView(XMFLOAT3(0, 2, 0), 0.3f, -0.2f);
+	ShadowCascades::Cascade cascades[ShadowCascades::MaxCascades];
+	ShadowCascades::Fit(settings, view, fov, aspectRatio, 0.1f, 1000.0f, lightDirection, cascades);
+
+	XMMATRIX inverseView = XMMatrixInverse(nullptr, XMLoadFloat4x4(&view));
+	XMVECTOR toLight = -XMVector3Normalize(XMLoadFloat3(&lightDirection));
+	for (int c = 0; c < settings.CascadeCount; c++)
+	{
+		Frustum frustum = ShadowCascades::GetFrustum(cascades[c]);
+		float depth = (cascades[c].NearDepth + cascades[c].FarDepth) * 0.5f;
+		XMVECTOR center = XMVector3TransformCoord(XMVectorSet(0, 0, depth, 1), inverseView);
+		XMFLOAT3 inSlice, nearCaster, farCaster, aside;
+		XMStoreFloat3(&inSlice, center);
+		XMStoreFloat3(&nearCaster, center + toLight * settings.CasterDistance * 0.9f);
+		XMStoreFloat3(&farCaster, center + toLight * (cascades[c].Radius * 2.0f + settings.CasterDistance * 1.1f));
+		XMStoreFloat3(&aside, center + XMVector3Normalize(XMVector3Cross(toLight, XMVectorSet(0, 1, 0, 0))) * cascades[c].Radius * 3.0f);
+
+		XMFLOAT3 extent(0.1f, 0.1f, 0.1f);
+		CHECK(frustum.IntersectsBox(inSlice, extent));
+		CHECK(frustum.IntersectsBox(nearCaster, extent));
+		CHECK(!frustum.IntersectsBox(farCaster, extent));
+		CHECK(!frustum.IntersectsBox(aside, extent));
+	}
+}
+
+TEST(ShadowCascadesRejectBadSettings)
+{
+	XMFLOAT4X4 view = MakeView(XMFLOAT3(0, 0, 0), 0.0f, 0.0f);
+	ShadowCascades::Cascade cascades[ShadowCascades::MaxCascades];
+	ShadowCascades::Settings settings;
+	unsigned int threw = 0;
+
+	settings.CascadeCount = ShadowCascades::MaxCascades + 1;
+	try { ShadowCascades::Fit(settings, view, fov, aspectRatio, 0.1f, 100.0f, lightDirection, cascades); }
+	catch (const std::invalid_argument&) { threw++; }
+
+	settings = ShadowCascades::Settings();
+	settings.Resolution = 2;
+	try { ShadowCascades::Fit(settings, view, fov, aspectRatio, 0.1f, 100.0f, lightDirection, cascades); }
+	catch (const std::invalid_argument&) { threw++; }
+
+	settings = ShadowCascades::Settings();
+	try { ShadowCascades::Fit(settings, view, fov, aspectRatio, 10.0f, 5.0f, lightDirection, cascades); }
+	catch (const std::invalid_argument&) { threw++; }
+	CHECK(threw == 3);
+
+	// A light straight down still gets a usable view
+	CHECK(ShadowCascades::Fit(settings, view, fov, aspectRatio, 0.1f, 100.0f, XMFLOAT3(0, -1, 0), cascades) == 4);
+	CHECK(HoldsSlice(cascades[3], view, settings.Resolution));
+}
+
+// --------------------------------------------------------
+// What the cascades cost a frame: fitting all four, then
+// culling every cascade's casters from 100k boxes
+// --------------------------------------------------------
+BENCHMARK(ShadowCascadesPerFrame)
+{
+	ShadowCascades::Settings settings;
+	const unsigned int count = 100000;
+	std::mt19937 random(2);
+	std::uniform_real_distribution<float> spread(-200.0f, 200.0f);
+	std::uniform_real_distribution<float> size(0.5f, 5.0f);
+	EntityCulling::Bounds bounds;
+	bounds.Resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		bounds.CenterX[i] = spread(random);
+		bounds.CenterY[i] = spread(random) * 0.1f;
+		bounds.CenterZ[i] = spread(random);
+		bounds.ExtentX[i] = bounds.ExtentY[i] = bounds.ExtentZ[i] = size(random);
+	}
+
+	const int frames = 200;
+	double fitTime = 0.0;
+	double cullTime = 0.0;
+	unsigned int casters = 0;
+	std::vector<unsigned int> visible;
+	for (int frame = 0; frame < frames; frame++)
+	{
+		XMFLOAT4X4 view = MakeView(XMFLOAT3(frame * 0.5f, 2.0f, 0.0f), frame * 0.01f, 0.0f);
+		ShadowCascades::Cascade cascades[ShadowCascades::MaxCascades];
+		auto start = std::chrono::steady_clock::now();
+		ShadowCascades::Fit(settings, view, fov, aspectRatio, 0.1f, 1000.0f, lightDirection, cascades);
+		auto fitted = std::chrono::steady_clock::now();
+		for (int c = 0; c < settings.CascadeCount; c++)
+		{
+			EntityCulling::Cull(ShadowCascades::GetFrustum(cascades[c]), bounds, visible);
+			casters += (unsigned int)visible.size();
+		}
+		auto culled = std::chrono::steady_clock::now();
+		fitTime += std::chrono::duration<double, std::micro>(fitted - start).count();
+		cullTime += std::chrono::duration<double, std::milli>(culled - fitted).count();
+	}
+	printf("  Fitting %d cascades: %.2f us\n", settings.CascadeCount, fitTime / frames);
+	printf("  Culling %u boxes for each: %.3f ms, %.0f casters a frame\n", count, cullTime / frames, (double)casters / frames);
+}
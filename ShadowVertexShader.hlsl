@@ -1,17 +1,30 @@
 #include "ShaderInclude.hlsli"
 
 // Constant Buffer for external (C++) data
+// - The world matrix is in ObjectData (see ShaderInclude.hlsli)
 cbuffer externalData : register(b0)
 {
-    matrix world;
     matrix view;
     matrix projection;
+#ifdef PACKED_VERTICES
+    float3 positionOffset;
+    float3 positionScale;
+#endif
 };
 // --------------------------------------------------------
 // A simplified vertex shader for rendering to a shadow map
+// - ShadowVertexShaderPacked.hlsl compiles this file again
+//   with PACKED_VERTICES defined, for meshes using PackedVertex
 // --------------------------------------------------------
+#ifdef PACKED_VERTICES
+float4 main(VertexShaderInputPacked input) : SV_POSITION
+{
+    float3 position = positionOffset + input.Position.xyz * positionScale;
+#else
 float4 main(VertexShaderInput input) : SV_POSITION
 {
-    matrix wvp = mul(projection, mul(view, world));
-    return mul(wvp, float4(input.Position, 1.0f));
+    float3 position = input.Position;
+#endif
+    matrix wvp = mul(projection, mul(view, worldMatrix));
+    return mul(wvp, float4(position, 1.0f));
 }
\ No newline at end of file
@@ -0,0 +1,3 @@
+// Same shadow vertex shader, reading PackedVertex instead of Vertex
+#define PACKED_VERTICES
+#include "ShadowVertexShader.hlsl"
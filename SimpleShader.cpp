@@ -1,9 +1,13 @@
 #include "SimpleShader.h"
+#include "CommandBuffer.h"
 
 // Default error reporting state
 bool ISimpleShader::ReportErrors = false;
 bool ISimpleShader::ReportWarnings = false;
 
+// Shaders use their context directly until this is set
+CommandBuffer* ISimpleShader::Commands = 0;
+
 // To enable error reporting, use either or both 
 // of the following lines somewhere in your program, 
 // preferably before loading/using any shaders.
@@ -349,9 +353,7 @@ void ISimpleShader::CopyAllBufferData()
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
 		// Copy the entire local data buffer
-		deviceContext->UpdateSubresource(
-			constantBuffers[i].ConstantBuffer.Get(), 0, 0,
-			constantBuffers[i].LocalDataBuffer, 0, 0);
+		CopyToConstantBuffer(&constantBuffers[i]);
 	}
 }
 
@@ -380,9 +382,7 @@ void ISimpleShader::CopyBufferData(unsigned int index)
 	if (!cb) return;
 
 	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer.Get(), 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	CopyToConstantBuffer(cb);
 }
 
 // --------------------------------------------------------
@@ -402,12 +402,27 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 	if (!cb) return;
 
 	// Copy the data and get out
+	CopyToConstantBuffer(cb);
+}
+
+
+// --------------------------------------------------------
+// Copies a buffer's local data to the GPU, or records the
+// copy when this shader records its commands
+// --------------------------------------------------------
+void ISimpleShader::CopyToConstantBuffer(SimpleConstantBuffer* cb)
+{
+	if (IsRecorded())
+	{
+		Commands->UpdateBuffer(cb->ConstantBuffer.Get(), cb->LocalDataBuffer, cb->Size);
+		return;
+	}
+
 	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer.Get(), 0, 0, 
+		cb->ConstantBuffer.Get(), 0, 0,
 		cb->LocalDataBuffer, 0, 0);
 }
 
-
 // --------------------------------------------------------
 // Sets a variable by name with arbitrary data of the specified size
 //
@@ -869,8 +884,16 @@ void SimpleVertexShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader and input layout
-	deviceContext->IASetInputLayout(inputLayout.Get());
-	deviceContext->VSSetShader(shader.Get(), 0, 0);
+	if (Commands)
+	{
+		Commands->SetInputLayout(inputLayout.Get());
+		Commands->SetVertexShader(shader.Get());
+	}
+	else
+	{
+		deviceContext->IASetInputLayout(inputLayout.Get());
+		deviceContext->VSSetShader(shader.Get(), 0, 0);
+	}
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -880,6 +903,11 @@ void SimpleVertexShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
+		if (Commands)
+		{
+			Commands->SetConstantBuffer(ShaderStage::Vertex, constantBuffers[i].BindIndex, constantBuffers[i].ConstantBuffer.Get());
+			continue;
+		}
 		deviceContext->VSSetConstantBuffers(
 			constantBuffers[i].BindIndex,
 			1,
@@ -911,7 +939,10 @@ bool SimpleVertexShader::SetShaderResourceView(std::string name, Microsoft::WRL:
 	}
 
 	// Set the shader resource view
-	deviceContext->VSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	if (Commands)
+		Commands->SetShaderResource(ShaderStage::Vertex, srvInfo->BindIndex, srv.Get());
+	else
+		deviceContext->VSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
 
 	// Success
 	return true;
@@ -941,7 +972,10 @@ bool SimpleVertexShader::SetSamplerState(std::string name, Microsoft::WRL::ComPt
 	}
 
 	// Set the shader resource view
-	deviceContext->VSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	if (Commands)
+		Commands->SetSampler(ShaderStage::Vertex, sampInfo->BindIndex, samplerState.Get());
+	else
+		deviceContext->VSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
 
 	// Success
 	return true;
@@ -1012,7 +1046,10 @@ void SimplePixelShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 	
 	// Set the shader
-	deviceContext->PSSetShader(shader.Get(), 0, 0);
+	if (Commands)
+		Commands->SetPixelShader(shader.Get());
+	else
+		deviceContext->PSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1022,6 +1059,11 @@ void SimplePixelShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
+		if (Commands)
+		{
+			Commands->SetConstantBuffer(ShaderStage::Pixel, constantBuffers[i].BindIndex, constantBuffers[i].ConstantBuffer.Get());
+			continue;
+		}
 		deviceContext->PSSetConstantBuffers(
 			constantBuffers[i].BindIndex,
 			1,
@@ -1053,7 +1095,10 @@ bool SimplePixelShader::SetShaderResourceView(std::string name, Microsoft::WRL::
 	}
 
 	// Set the shader resource view
-	deviceContext->PSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	if (Commands)
+		Commands->SetShaderResource(ShaderStage::Pixel, srvInfo->BindIndex, srv.Get());
+	else
+		deviceContext->PSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
 
 	// Success
 	return true;
@@ -1083,7 +1128,10 @@ bool SimplePixelShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr
 	}
 
 	// Set the shader resource view
-	deviceContext->PSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	if (Commands)
+		Commands->SetSampler(ShaderStage::Pixel, sampInfo->BindIndex, samplerState.Get());
+	else
+		deviceContext->PSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
 
 	// Success
 	return true;
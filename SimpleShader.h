@@ -11,6 +11,7 @@
 #include <vector>
 #include <string>
 
+class CommandBuffer;
 
 // --------------------------------------------------------
 // Used by simple shaders to store information about
@@ -122,6 +123,10 @@ public:
 	static bool ReportErrors;
 	static bool ReportWarnings;
 
+	// When set, vertex and pixel shaders record their binds and
+	// constant buffer copies here instead of using the context
+	static CommandBuffer* Commands;
+
 protected:
 	
 	bool shaderValid;
@@ -148,6 +153,10 @@ protected:
 	virtual bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob) = 0;
 	virtual void SetShaderAndCBs() = 0;
 
+	// Whether this type of shader records into Commands (when set)
+	virtual bool IsRecorded() { return false; }
+	void CopyToConstantBuffer(SimpleConstantBuffer* cb);
+
 	virtual void CleanUp();
 
 	// Helpers for finding data by name
@@ -187,6 +196,7 @@ protected:
 	 Microsoft::WRL::ComPtr<ID3D11VertexShader> shader;
 	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	void SetShaderAndCBs();
+	bool IsRecorded() { return Commands != 0; }
 	void CleanUp();
 };
 
@@ -208,6 +218,7 @@ protected:
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> shader;
 	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	void SetShaderAndCBs();
+	bool IsRecorded() { return Commands != 0; }
 	void CleanUp();
 };
 
@@ -39,8 +39,8 @@ Sky::~Sky()
 
 void Sky::Draw(std::shared_ptr<Camera> camera)
 {
-	Graphics::Context->RSSetState(rasterizer.Get());
-	Graphics::Context->OMSetDepthStencilState(depthBuffer.Get(),0);
+	Graphics::Commands.SetRasterizerState(rasterizer.Get());
+	Graphics::Commands.SetDepthStencilState(depthBuffer.Get());
 
 	vertexShader->SetShader();
 	pixelShader->SetShader();
@@ -54,8 +54,8 @@ void Sky::Draw(std::shared_ptr<Camera> camera)
 
 	mesh->Draw();
 
-	Graphics::Context->RSSetState(0);
-	Graphics::Context->OMSetDepthStencilState(0, 0);
+	Graphics::Commands.SetRasterizerState(0);
+	Graphics::Commands.SetDepthStencilState(0);
 }
 
 
@@ -0,0 +1,46 @@
+#pragma once
+#include <cmath>
+
+// --------------------------------------------------------
+// A small test harness for the headless test program
+// (Tests.vcxproj), which runs the CPU side of the engine
+// without opening a window
+//
+// - TEST() declares a check that always runs; BENCHMARK()
+//   declares a timing that only runs with --bench, since
+//   some of them take seconds
+// - CHECK() records a failure and carries on, so one run
+//   reports every broken expectation, not just the first
+// - A test that throws counts as failed
+// --------------------------------------------------------
+namespace Tests
+{
+	typedef void (*TestFunction)();
+
+	// Declared through TEST() and BENCHMARK() rather than directly
+	struct Registration
+	{
+		Registration(const char* name, TestFunction function, bool benchmark);
+	};
+
+	void Fail(const char* file, int line, const char* expression);
+
+	// Whether two floats are within a tolerance of each other
+	inline bool Near(float a, float b, float tolerance)
+	{
+		return fabsf(a - b) <= tolerance;
+	}
+}
+
+#define TEST(name) \
+	static void name(); \
+	static Tests::Registration name##Registration(#name, name, false); \
+	static void name()
+
+#define BENCHMARK(name) \
+	static void name(); \
+	static Tests::Registration name##Registration(#name, name, true); \
+	static void name()
+
+#define CHECK(expression) \
+	do { if (!(expression)) Tests::Fail(__FILE__, __LINE__, #expression); } while (0)
@@ -0,0 +1,102 @@
+#include "Tests.h"
+
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <vector>
+
+// --------------------------------------------------------
+// Command line front end for the headless tests, built as
+// its own console program (Tests.vcxproj)
+//
+// Tests [--bench] [name]
+//
+// Returns zero only if every test that ran passed
+// --------------------------------------------------------
+
+namespace
+{
+	struct Test
+	{
+		const char* Name;
+		Tests::TestFunction Function;
+		bool Benchmark;
+	};
+
+	// Built before main() by each file's registrations, so it
+	// has to exist before the first of them (hence the function)
+	std::vector<Test>& GetTests()
+	{
+		static std::vector<Test> tests;
+		return tests;
+	}
+
+	unsigned int failures = 0;
+}
+
+namespace Tests
+{
+	Registration::Registration(const char* name, TestFunction function, bool benchmark)
+	{
+		GetTests().push_back({ name, function, benchmark });
+	}
+
+	void Fail(const char* file, int line, const char* expression)
+	{
+		printf("  %s(%d): CHECK(%s) failed\n", file, line, expression);
+		failures++;
+	}
+}
+
+static void PrintUsage()
+{
+	printf(
+		"Usage: Tests [--bench] [name]\n"
+		"  --bench    Also run the benchmarks\n"
+		"  name       Only run tests whose names contain this\n");
+}
+
+int main(int argc, char* argv[])
+{
+	bool benchmarks = false;
+	const char* filter = nullptr;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--bench") == 0)
+			benchmarks = true;
+		else if (argv[i][0] != '-' && !filter)
+			filter = argv[i];
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	unsigned int run = 0;
+	unsigned int failed = 0;
+	for (const Test& test : GetTests())
+	{
+		if (test.Benchmark && !benchmarks)
+			continue;
+		if (filter && !strstr(test.Name, filter))
+			continue;
+
+		printf("%s\n", test.Name);
+		unsigned int failuresBefore = failures;
+		try
+		{
+			test.Function();
+		}
+		catch (const std::exception& e)
+		{
+			printf("  Threw: %s\n", e.what());
+			failures++;
+		}
+		run++;
+		failed += (failures != failuresBefore);
+	}
+
+	printf("%u of %u passed\n", run - failed, run);
+	return failed == 0 ? 0 : 1;
+}
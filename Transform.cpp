@@ -1,191 +1,250 @@
 #include "Transform.h"
+#include <algorithm>
 
 using namespace DirectX;
 
 Transform::Transform() :
-	position(0, 0, 0),
-	pitchYawRoll(0, 0, 0),
-	scale(1, 1, 1),
-	matrixChanged(false)
+	pool(TransformPool::GetShared()),
+	parent(nullptr)
 {
-	// Init matricies
-	XMStoreFloat4x4(&worldMatrix, XMMatrixIdentity());
-	XMStoreFloat4x4(&worldInverseTransposeMatrix, XMMatrixIdentity());
+	// New slots start out as the identity
+	slot = pool->Allocate();
+}
+
+Transform::~Transform()
+{
+	while (!children.empty())
+		children.back()->SetParent(nullptr);
+	SetParent(nullptr);
+	pool->Free(slot);
+}
+
+void Transform::SetParent(Transform* parent, bool keepWorld)
+{
+	if (parent == this->parent)
+		return;
+
+	// The pool checks for cycles before anything changes here
+	pool->SetParent(slot, parent ? (int)parent->slot : -1, keepWorld);
+	if (this->parent)
+	{
+		std::vector<Transform*>& siblings = this->parent->children;
+		siblings.erase(std::find(siblings.begin(), siblings.end(), this));
+	}
+	this->parent = parent;
+	if (parent)
+		parent->children.push_back(this);
+}
+
+Transform* Transform::GetParent()
+{
+	return parent;
+}
+
+int Transform::GetChildCount()
+{
+	return (int)children.size();
+}
+
+Transform* Transform::GetChild(int index)
+{
+	return children[index];
 }
 
 void Transform::SetPosition(float x, float y, float z)
 {
-	position.x = x;
-	position.y = y;
-	position.z = z;
-	matrixChanged = true;
+	pool->SetPosition(slot, XMFLOAT3(x, y, z));
 }
 
 void Transform::SetPosition(DirectX::XMFLOAT3 position)
 {
-	this->position = position;
-	matrixChanged = true;
+	pool->SetPosition(slot, position);
 }
 
 void Transform::SetRotation(float p, float y, float r)
 {
-	pitchYawRoll.x = p;
-	pitchYawRoll.y = y;
-	pitchYawRoll.z = r;
-	matrixChanged = true;
+	pool->SetPitchYawRoll(slot, XMFLOAT3(p, y, r));
 }
 
 void Transform::SetRotation(DirectX::XMFLOAT3 rotation)
 {
-	pitchYawRoll = rotation;
-	matrixChanged = true;
+	pool->SetPitchYawRoll(slot, rotation);
+}
+
+void Transform::SetRotation(DirectX::XMFLOAT4 quaternion)
+{
+	pool->SetRotation(slot, quaternion);
 }
 
 void Transform::SetScale(float x, float y, float z)
 {
-	scale.x = x;
-	scale.y = y;
-	scale.z = z;
-	matrixChanged = true;
+	pool->SetScale(slot, XMFLOAT3(x, y, z));
 }
 
 void Transform::SetScale(DirectX::XMFLOAT3 scale)
 {
-	this->scale = scale;
-	matrixChanged = true;
+	pool->SetScale(slot, scale);
 }
 
 DirectX::XMFLOAT3 Transform::GetPosition()
 {
-	return position;
+	return pool->GetPosition(slot);
 }
 
 DirectX::XMFLOAT3 Transform::GetPitchYawRoll()
 {
-	return pitchYawRoll;
+	return pool->GetPitchYawRoll(slot);
+}
+
+DirectX::XMFLOAT4 Transform::GetRotation()
+{
+	return pool->GetRotation(slot);
 }
 
 DirectX::XMFLOAT3 Transform::GetScale()
 {
-	return scale;
+	return pool->GetScale(slot);
 }
 
+// Already built by the pool's last update, unless the transform
+// has changed since
 DirectX::XMFLOAT4X4 Transform::GetWorldMatrix()
 {
-	if (!matrixChanged)
-	{
-		return worldMatrix;
-	}
-	XMMATRIX world =
-		(XMMatrixScaling(scale.x,scale.y,scale.z)) *
-		(XMMatrixRotationRollPitchYaw(pitchYawRoll.x,pitchYawRoll.y,pitchYawRoll.z)) *
-		(XMMatrixTranslation(position.x, position.y, position.z));
-	XMStoreFloat4x4(&worldMatrix, world);
-	XMStoreFloat4x4(&worldInverseTransposeMatrix, XMMatrixInverse(0, XMMatrixTranspose(world)));
-	return worldMatrix;
+	return pool->GetWorldMatrix(slot);
 }
 
 DirectX::XMFLOAT4X4 Transform::GetWorldInverseTransposeMatrix()
 {
-	return worldInverseTransposeMatrix;
+	return pool->GetWorldInverseTransposeMatrix(slot);
+}
+
+DirectX::XMFLOAT4X4 Transform::GetWorldInverseMatrix()
+{
+	// Transposing the inverse transpose gives the inverse back
+	XMFLOAT4X4 inverseTranspose = GetWorldInverseTransposeMatrix();
+	XMFLOAT4X4 inverse;
+	XMStoreFloat4x4(&inverse, XMMatrixTranspose(XMLoadFloat4x4(&inverseTranspose)));
+	return inverse;
+}
+
+uint64_t Transform::GetVersion()
+{
+	return pool->GetVersion(slot);
 }
 
+unsigned int Transform::GetPoolSlot()
+{
+	return slot;
+}
+
+// The rows of the rotation matrix the pool already keeps
 DirectX::XMFLOAT3 Transform::GetRight()
 {
-	XMVECTOR rot = XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&pitchYawRoll));
-	XMVECTOR right = XMVectorSet(1,0,0,0);
-	XMFLOAT3 dir;
-	XMStoreFloat3(&dir,XMVector3Rotate(right, rot));
-	return dir;
+	XMFLOAT3X3 basis = pool->GetBasis(slot);
+	return XMFLOAT3(basis._11, basis._12, basis._13);
 }
 
 DirectX::XMFLOAT3 Transform::GetUp()
 {
-	XMVECTOR rot = XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&pitchYawRoll));
-	XMVECTOR up = XMVectorSet(0, 1, 0, 0);
-	XMFLOAT3 dir;
-	XMStoreFloat3(&dir, XMVector3Rotate(up, rot));
-	return dir;
+	XMFLOAT3X3 basis = pool->GetBasis(slot);
+	return XMFLOAT3(basis._21, basis._22, basis._23);
 }
 
 DirectX::XMFLOAT3 Transform::GetForward()
 {
-	XMVECTOR rot = XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&pitchYawRoll));
-	XMVECTOR foreward = XMVectorSet(0, 0, 1, 0);
-	XMFLOAT3 dir;
-	XMStoreFloat3(&dir, XMVector3Rotate(foreward, rot));
-	return dir;
+	XMFLOAT3X3 basis = pool->GetBasis(slot);
+	return XMFLOAT3(basis._31, basis._32, basis._33);
+}
+
+DirectX::XMFLOAT3 Transform::GetWorldPosition()
+{
+	XMFLOAT4X4 world = GetWorldMatrix();
+	return XMFLOAT3(world._41, world._42, world._43);
+}
+
+DirectX::XMFLOAT3 Transform::LocalToWorldPoint(DirectX::XMFLOAT3 point)
+{
+	XMFLOAT4X4 world = GetWorldMatrix();
+	XMFLOAT3 result;
+	XMStoreFloat3(&result, XMVector3TransformCoord(XMLoadFloat3(&point), XMLoadFloat4x4(&world)));
+	return result;
+}
+
+DirectX::XMFLOAT3 Transform::WorldToLocalPoint(DirectX::XMFLOAT3 point)
+{
+	XMFLOAT4X4 inverse = GetWorldInverseMatrix();
+	XMFLOAT3 result;
+	XMStoreFloat3(&result, XMVector3TransformCoord(XMLoadFloat3(&point), XMLoadFloat4x4(&inverse)));
+	return result;
+}
+
+DirectX::XMFLOAT3 Transform::LocalToWorldDirection(DirectX::XMFLOAT3 direction)
+{
+	XMFLOAT4X4 world = GetWorldMatrix();
+	XMFLOAT3 result;
+	XMStoreFloat3(&result, XMVector3TransformNormal(XMLoadFloat3(&direction), XMLoadFloat4x4(&world)));
+	return result;
+}
+
+DirectX::XMFLOAT3 Transform::WorldToLocalDirection(DirectX::XMFLOAT3 direction)
+{
+	XMFLOAT4X4 inverse = GetWorldInverseMatrix();
+	XMFLOAT3 result;
+	XMStoreFloat3(&result, XMVector3TransformNormal(XMLoadFloat3(&direction), XMLoadFloat4x4(&inverse)));
+	return result;
 }
 
 void Transform::MoveAbsolute(float x, float y, float z) {
+	XMFLOAT3 position = GetPosition();
 	position.x += x;
 	position.y += y;
 	position.z += z;
-	matrixChanged = true;
+	SetPosition(position);
 }
 
 void Transform::MoveAbsolute(DirectX::XMFLOAT3 offset)
 {
-	position.x += offset.x;
-	position.y += offset.y;
-	position.z += offset.z;
-	matrixChanged = true;
+	MoveAbsolute(offset.x, offset.y, offset.z);
 }
 
 void Transform::MoveRelative(float x, float y, float z)
 {
-	XMVECTOR vec = XMVectorSet(x, y, z, 0);
-	XMVECTOR quat = XMQuaternionRotationRollPitchYaw(
-		this->GetPitchYawRoll().x,
-		this->GetPitchYawRoll().y,
-		this->GetPitchYawRoll().z
-	);
-	XMVECTOR dir = XMVector3Rotate(vec,quat);
-	XMStoreFloat3(&position,XMLoadFloat3(&position) + dir);
-	matrixChanged = true;
+	// The offset times the rotation matrix
+	XMFLOAT3X3 basis = pool->GetBasis(slot);
+	XMFLOAT3 position = GetPosition();
+	position.x += x * basis._11 + y * basis._21 + z * basis._31;
+	position.y += x * basis._12 + y * basis._22 + z * basis._32;
+	position.z += x * basis._13 + y * basis._23 + z * basis._33;
+	SetPosition(position);
 }
 
 void Transform::MoveRelative(DirectX::XMFLOAT3 offset)
 {
-	XMVECTOR vec = XMVectorSet(offset.x,offset.y,offset.z,0);
-	XMVECTOR quat = XMQuaternionRotationRollPitchYaw(
-		this->GetPitchYawRoll().x,
-		this->GetPitchYawRoll().y,
-		this->GetPitchYawRoll().z
-	);
-	XMVECTOR dir = XMVector3Rotate(vec, quat);
-	XMStoreFloat3(&position, XMLoadFloat3(&position) + dir);
-	matrixChanged = true;
+	MoveRelative(offset.x, offset.y, offset.z);
 }
 
 void Transform::Rotate(float pitch, float yaw, float roll)
 {
-	pitchYawRoll.x += pitch;
-	pitchYawRoll.y += yaw;
-	pitchYawRoll.z += roll;
-	matrixChanged = true;
+	XMFLOAT4 quaternion;
+	XMStoreFloat4(&quaternion, XMQuaternionRotationRollPitchYaw(pitch, yaw, roll));
+	pool->Rotate(slot, quaternion);
 }
 
 void Transform::Rotate(DirectX::XMFLOAT3 rotation)
 {
-	pitchYawRoll.x += rotation.x;
-	pitchYawRoll.y += rotation.y;
-	pitchYawRoll.z += rotation.z;
-	matrixChanged = true;
+	Rotate(rotation.x, rotation.y, rotation.z);
 }
 
 void Transform::Scale(float x, float y, float z)
 {
+	XMFLOAT3 scale = GetScale();
 	scale.x += x;
 	scale.y += y;
 	scale.z += z;
-	matrixChanged = true;
+	SetScale(scale);
 }
 
 void Transform::Scale(DirectX::XMFLOAT3 scale)
 {
-	this->scale.x += scale.x;
-	this->scale.y += scale.y;
-	this->scale.z += scale.z;
-	matrixChanged = true;
+	Scale(scale.x, scale.y, scale.z);
 }
@@ -1,29 +1,76 @@
 #pragma once
 #include <DirectXMath.h>
+#include <memory>
+#include <vector>
+#include "TransformPool.h"
 
+// --------------------------------------------------------
+// A handle to one slot of the shared TransformPool, which
+// keeps the actual data so every transform's matrices can
+// be rebuilt in one batch (see TransformPool::Update())
+//
+// - Position, rotation and scale are relative to the parent
+//   (if there is one), and the world matrix includes every
+//   ancestor's
+// - Destroying a parent leaves its children where they are
+//   in the world, as roots
+// - Rotations are quaternions underneath, so pitch, yaw and
+//   roll read back as equivalent angles rather than the ones
+//   that were set, and Rotate() turns about the transform's
+//   own axes
+// --------------------------------------------------------
 class Transform
 {
 public:
 	Transform();
+	Transform(const Transform&) = delete;	// Each transform frees its own slot
+	Transform& operator=(const Transform&) = delete;
+	~Transform();
 
 	// Setters
 	void SetPosition(float x, float y, float z);
 	void SetPosition(DirectX::XMFLOAT3 position);
 	void SetRotation(float p, float y, float r);
 	void SetRotation(DirectX::XMFLOAT3 rotation);
+	void SetRotation(DirectX::XMFLOAT4 quaternion);
 	void SetScale(float x, float y, float z);
 	void SetScale(DirectX::XMFLOAT3 scale);
 
+	// Hierarchy (keepWorld adjusts the local transform so the
+	// world one doesn't change; parenting to a descendant throws
+	// std::invalid_argument)
+	void SetParent(Transform* parent, bool keepWorld = true);
+	Transform* GetParent();
+	int GetChildCount();
+	Transform* GetChild(int index);
+
 	// Getters
 	DirectX::XMFLOAT3 GetPosition();
 	DirectX::XMFLOAT3 GetPitchYawRoll();
+	DirectX::XMFLOAT4 GetRotation();
 	DirectX::XMFLOAT3 GetScale();
 	DirectX::XMFLOAT4X4 GetWorldMatrix();
 	DirectX::XMFLOAT4X4 GetWorldInverseTransposeMatrix();
+	DirectX::XMFLOAT4X4 GetWorldInverseMatrix();
+
+	// Changes whenever the world matrix does, so anything keeping
+	// a copy (like a constant buffer) can skip updating it
+	uint64_t GetVersion();
+
+	// Where this transform lives in the shared pool, for anything
+	// that writes to the pool directly (like AnimationSampler)
+	unsigned int GetPoolSlot();
 	DirectX::XMFLOAT3 GetRight();
 	DirectX::XMFLOAT3 GetUp();
 	DirectX::XMFLOAT3 GetForward();
 
+	// Conversions between this transform's space and the world
+	DirectX::XMFLOAT3 GetWorldPosition();
+	DirectX::XMFLOAT3 LocalToWorldPoint(DirectX::XMFLOAT3 point);
+	DirectX::XMFLOAT3 WorldToLocalPoint(DirectX::XMFLOAT3 point);
+	DirectX::XMFLOAT3 LocalToWorldDirection(DirectX::XMFLOAT3 direction);
+	DirectX::XMFLOAT3 WorldToLocalDirection(DirectX::XMFLOAT3 direction);
+
 	// Transformers
 	void MoveAbsolute(float x, float y, float z);
 	void MoveAbsolute(DirectX::XMFLOAT3 offset);
@@ -35,15 +82,10 @@ public:
 	void Scale(DirectX::XMFLOAT3 scale);
 
 private:
-	// Transofrm Data
-	DirectX::XMFLOAT3 position;
-	DirectX::XMFLOAT3 scale;
-	DirectX::XMFLOAT3 pitchYawRoll;
-
-	// Matrix
-	DirectX::XMFLOAT4X4 worldMatrix;
-	DirectX::XMFLOAT4X4 worldInverseTransposeMatrix;
-	bool matrixChanged;
+	// Where the position, rotation, scale and matrices live
+	std::shared_ptr<TransformPool> pool;
+	unsigned int slot;
 
+	Transform* parent;
+	std::vector<Transform*> children;
 };
-
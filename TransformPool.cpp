@@ -0,0 +1,474 @@
+#include "TransformPool.h"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <cmath>
+
+using namespace DirectX;
+
+// Anonymous namespace for the helpers, which are private to this file
+namespace
+{
+	// The angles XMMatrixRotationRollPitchYaw() needs for a rotation
+	// (roll about Z, then pitch about X, then yaw about Y)
+	XMFLOAT3 GetQuaternionPitchYawRoll(FXMVECTOR quaternion)
+	{
+		XMFLOAT4X4 m;
+		XMStoreFloat4x4(&m, XMMatrixRotationQuaternion(quaternion));
+		// Pitch from both its sine and cosine, as asin() alone loses
+		// precision near straight up or down
+		float cosPitch = sqrtf(m._31 * m._31 + m._33 * m._33);
+		float pitch = atan2f(-m._32, cosPitch);
+
+		// Straight up or down, yaw and roll turn about the same axis
+		if (cosPitch < 0.001f)
+			return XMFLOAT3(pitch, atan2f(-m._13, m._11), 0.0f);
+		return XMFLOAT3(pitch, atan2f(m._31, m._33), atan2f(m._12, m._22));
+	}
+}
+
+TransformPool::TransformPool() :
+	versionCounter(0),
+	transformCount(0),
+	updatedCount(0),
+	worldUpdatedCount(0),
+	updateTime(0.0)
+{
+}
+
+std::shared_ptr<TransformPool> TransformPool::GetShared()
+{
+	static std::shared_ptr<TransformPool> shared = std::make_shared<TransformPool>();
+	return shared;
+}
+
+unsigned int TransformPool::Allocate()
+{
+	unsigned int slot;
+	if (!freeSlots.empty())
+	{
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
+	{
+		// Grows a whole group of four at a time, so every group can
+		// be loaded as one vector
+		slot = (unsigned int)worldMatrices.size();
+		if (slot % 4 == 0)
+		{
+			size_t size = slot + 4;
+			for (std::vector<float>* component : { &positionX, &positionY, &positionZ, &rotationX, &rotationY, &rotationZ })
+				component->resize(size, 0.0f);
+			for (std::vector<float>* component : { &rotationW, &scaleX, &scaleY, &scaleZ })
+				component->resize(size, 1.0f);
+			dirty.resize((size + 63) / 64, 0);
+		}
+		for (std::vector<XMFLOAT4X4>* matrices : { &localMatrices, &localInverseTransposeMatrices, &worldMatrices, &worldInverseTransposeMatrices })
+			matrices->emplace_back();
+		bases.emplace_back();
+		parents.push_back(-1);
+		orderPositions.push_back(0);
+		subtreeSizes.push_back(1);
+		versions.push_back(0);
+	}
+
+	positionX[slot] = positionY[slot] = positionZ[slot] = 0.0f;
+	rotationX[slot] = rotationY[slot] = rotationZ[slot] = 0.0f;
+	rotationW[slot] = 1.0f;
+	scaleX[slot] = scaleY[slot] = scaleZ[slot] = 1.0f;
+	for (std::vector<XMFLOAT4X4>* matrices : { &localMatrices, &localInverseTransposeMatrices, &worldMatrices, &worldInverseTransposeMatrices })
+		XMStoreFloat4x4(&(*matrices)[slot], XMMatrixIdentity());
+	XMStoreFloat3x3(&bases[slot], XMMatrixIdentity());
+
+	// New slots are roots, so they go at the end of the order
+	parents[slot] = -1;
+	subtreeSizes[slot] = 1;
+	orderPositions[slot] = (unsigned int)order.size();
+	order.push_back(slot);
+	versions[slot] = ++versionCounter;
+	transformCount++;
+	return slot;
+}
+
+void TransformPool::Free(unsigned int slot)
+{
+	// Direct children are the slots in the subtree whose parent is
+	// this one
+	std::vector<unsigned int> children;
+	unsigned int start = orderPositions[slot];
+	for (unsigned int p = start + 1; p < start + subtreeSizes[slot]; p++)
+	{
+		if (parents[order[p]] == (int)slot)
+			children.push_back(order[p]);
+	}
+	for (unsigned int child : children)
+		SetParent(child, -1, true);
+
+	// Now a leaf, which leaves the order and its ancestors' subtrees
+	start = orderPositions[slot];
+	ResizeSubtrees(parents[slot], -1);
+	order.erase(order.begin() + start);
+	for (unsigned int p = start; p < order.size(); p++)
+		orderPositions[order[p]] = p;
+
+	parents[slot] = -1;
+	dirty[slot / 64] &= ~(1ull << (slot % 64));
+	freeSlots.push_back(slot);
+	transformCount--;
+}
+
+void TransformPool::SetPosition(unsigned int slot, XMFLOAT3 position)
+{
+	positionX[slot] = position.x;
+	positionY[slot] = position.y;
+	positionZ[slot] = position.z;
+	MarkDirty(slot);
+}
+
+void TransformPool::SetRotation(unsigned int slot, XMFLOAT4 quaternion)
+{
+	XMFLOAT4 normalized;
+	XMStoreFloat4(&normalized, XMQuaternionNormalize(XMLoadFloat4(&quaternion)));
+	rotationX[slot] = normalized.x;
+	rotationY[slot] = normalized.y;
+	rotationZ[slot] = normalized.z;
+	rotationW[slot] = normalized.w;
+	MarkDirty(slot);
+}
+
+void TransformPool::SetPitchYawRoll(unsigned int slot, XMFLOAT3 pitchYawRoll)
+{
+	XMFLOAT4 quaternion;
+	XMStoreFloat4(&quaternion, XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&pitchYawRoll)));
+	SetRotation(slot, quaternion);
+}
+
+void TransformPool::SetScale(unsigned int slot, XMFLOAT3 scale)
+{
+	scaleX[slot] = scale.x;
+	scaleY[slot] = scale.y;
+	scaleZ[slot] = scale.z;
+	MarkDirty(slot);
+}
+
+XMFLOAT3 TransformPool::GetPosition(unsigned int slot)
+{
+	return XMFLOAT3(positionX[slot], positionY[slot], positionZ[slot]);
+}
+
+XMFLOAT4 TransformPool::GetRotation(unsigned int slot)
+{
+	return XMFLOAT4(rotationX[slot], rotationY[slot], rotationZ[slot], rotationW[slot]);
+}
+
+XMFLOAT3 TransformPool::GetScale(unsigned int slot)
+{
+	return XMFLOAT3(scaleX[slot], scaleY[slot], scaleZ[slot]);
+}
+
+XMFLOAT3 TransformPool::GetPitchYawRoll(unsigned int slot)
+{
+	XMFLOAT4 rotation = GetRotation(slot);
+	return GetQuaternionPitchYawRoll(XMLoadFloat4(&rotation));
+}
+
+void TransformPool::Rotate(unsigned int slot, XMFLOAT4 quaternion)
+{
+	XMFLOAT4 rotation = GetRotation(slot);
+	XMFLOAT4 rotated;
+	XMStoreFloat4(&rotated, XMQuaternionMultiply(XMLoadFloat4(&quaternion), XMLoadFloat4(&rotation)));
+	SetRotation(slot, rotated);
+}
+
+// The group's local pass is all the basis needs, so the world
+// matrices can wait for the next full update
+XMFLOAT3X3 TransformPool::GetBasis(unsigned int slot)
+{
+	if (dirty[slot / 64] & (1ull << (slot % 64)))
+		UpdateGroup(slot / 4);
+	return bases[slot];
+}
+
+// --------------------------------------------------------
+// Moves the slot's whole range in the depth first order so
+// it ends up at the end of the new parent's subtree
+// - Only the ranges between the old and new places shift,
+//   and only the ancestors on either side change size
+// --------------------------------------------------------
+void TransformPool::SetParent(unsigned int slot, int parent, bool keepWorld)
+{
+	if (parent == parents[slot])
+		return;
+
+	unsigned int from = orderPositions[slot];
+	unsigned int size = subtreeSizes[slot];
+	if (parent >= 0 && orderPositions[parent] >= from && orderPositions[parent] < from + size)
+		throw std::invalid_argument("Error parenting transform: Parent is the transform itself or one of its children");
+
+	// The world transform to keep, before anything moves
+	XMFLOAT4X4 world;
+	XMFLOAT4X4 parentWorld;
+	if (keepWorld)
+	{
+		world = GetWorldMatrix(slot);
+		if (parent >= 0)
+			parentWorld = GetWorldMatrix(parent);
+	}
+
+	// The new parent's subtree ends here, which may include the slot
+	// itself (when it's already a descendant), and never splits it
+	unsigned int to = parent >= 0 ? orderPositions[parent] + subtreeSizes[parent] : (unsigned int)order.size();
+	ResizeSubtrees(parents[slot], -(int)size);
+	unsigned int first;
+	unsigned int last;
+	if (to > from)
+	{
+		std::rotate(order.begin() + from, order.begin() + from + size, order.begin() + to);
+		first = from;
+		last = to;
+	}
+	else
+	{
+		std::rotate(order.begin() + to, order.begin() + from, order.begin() + from + size);
+		first = to;
+		last = from + size;
+	}
+	for (unsigned int p = first; p < last; p++)
+		orderPositions[order[p]] = p;
+
+	parents[slot] = parent;
+	ResizeSubtrees(parent, (int)size);
+
+	if (keepWorld)
+	{
+		XMMATRIX local = XMLoadFloat4x4(&world);
+		if (parent >= 0)
+			local = XMMatrixMultiply(local, XMMatrixInverse(0, XMLoadFloat4x4(&parentWorld)));
+
+		XMVECTOR scale, rotation, translation;
+		XMMatrixDecompose(&scale, &rotation, &translation, local);
+		XMFLOAT3 position, scaleValues;
+		XMFLOAT4 rotationValues;
+		XMStoreFloat3(&position, translation);
+		XMStoreFloat4(&rotationValues, rotation);
+		XMStoreFloat3(&scaleValues, scale);
+		SetPosition(slot, position);
+		SetRotation(slot, rotationValues);
+		SetScale(slot, scaleValues);
+	}
+	MarkDirty(slot);
+}
+
+int TransformPool::GetParent(unsigned int slot)
+{
+	return parents[slot];
+}
+
+XMFLOAT4X4 TransformPool::GetWorldMatrix(unsigned int slot)
+{
+	if (!dirtySlots.empty())
+		Update();
+	return worldMatrices[slot];
+}
+
+XMFLOAT4X4 TransformPool::GetWorldInverseTransposeMatrix(unsigned int slot)
+{
+	if (!dirtySlots.empty())
+		Update();
+	return worldInverseTransposeMatrices[slot];
+}
+
+uint64_t TransformPool::GetVersion(unsigned int slot)
+{
+	if (!dirtySlots.empty())
+		Update();
+	return versions[slot];
+}
+
+// --------------------------------------------------------
+// Two passes over just the dirty slots
+// - Local matrices first, four at a time, for every group
+//   with a dirty slot in it
+// - Then each dirty subtree's world matrices, in depth first
+//   order so parents are always done before children (a
+//   dirty slot inside another dirty subtree is skipped, as
+//   that subtree already covered it)
+// --------------------------------------------------------
+void TransformPool::Update()
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	updatedCount = 0;
+	worldUpdatedCount = 0;
+
+	dirtyPositions.clear();
+	for (unsigned int slot : dirtySlots)
+	{
+		if (dirty[slot / 64] & (1ull << (slot % 64)))
+		{
+			UpdateGroup(slot / 4);
+			updatedCount += 4;
+		}
+
+		// Slots freed since they changed are no longer in the order
+		unsigned int position = orderPositions[slot];
+		if (position < order.size() && order[position] == slot)
+			dirtyPositions.push_back(position);
+	}
+	dirtySlots.clear();
+
+	std::sort(dirtyPositions.begin(), dirtyPositions.end());
+	unsigned int subtreeEnd = 0;
+	for (unsigned int position : dirtyPositions)
+	{
+		if (position < subtreeEnd)
+			continue;
+
+		subtreeEnd = position + subtreeSizes[order[position]];
+		for (unsigned int p = position; p < subtreeEnd; p++)
+			UpdateWorld(order[p]);
+		worldUpdatedCount += subtreeEnd - position;
+	}
+	updateTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+TransformPool::Stats TransformPool::GetStats()
+{
+	Stats stats = {};
+	stats.TransformCount = transformCount;
+	stats.Capacity = (unsigned int)worldMatrices.size();
+	stats.UpdatedCount = updatedCount;
+	stats.WorldUpdatedCount = worldUpdatedCount;
+	stats.UpdateTime = updateTime;
+	return stats;
+}
+
+void TransformPool::MarkDirty(unsigned int slot)
+{
+	uint64_t bit = 1ull << (slot % 64);
+	if (dirty[slot / 64] & bit)
+		return;
+
+	dirty[slot / 64] |= bit;
+	dirtySlots.push_back(slot);
+}
+
+void TransformPool::UpdateWorld(unsigned int slot)
+{
+	versions[slot] = ++versionCounter;
+
+	int parent = parents[slot];
+	if (parent < 0)
+	{
+		worldMatrices[slot] = localMatrices[slot];
+		worldInverseTransposeMatrices[slot] = localInverseTransposeMatrices[slot];
+		return;
+	}
+
+	// The inverse transpose of a product is the product of the
+	// inverse transposes, in the same order
+	XMStoreFloat4x4(&worldMatrices[slot], XMMatrixMultiply(
+		XMLoadFloat4x4(&localMatrices[slot]),
+		XMLoadFloat4x4(&worldMatrices[parent])));
+	XMStoreFloat4x4(&worldInverseTransposeMatrices[slot], XMMatrixMultiply(
+		XMLoadFloat4x4(&localInverseTransposeMatrices[slot]),
+		XMLoadFloat4x4(&worldInverseTransposeMatrices[parent])));
+}
+
+void TransformPool::ResizeSubtrees(int slot, int sizeChange)
+{
+	for (int ancestor = slot; ancestor >= 0; ancestor = parents[ancestor])
+		subtreeSizes[ancestor] += sizeChange;
+}
+
+// --------------------------------------------------------
+// Builds four local matrices (scale, then rotation, then
+// translation, as with separate DirectXMath calls) and
+// their inverse transposes, one SIMD lane per transform
+// - The rotation comes from XMMatrixRotationQuaternion()'s
+//   closed form, which needs only multiplies and adds, and
+//   its rows are also kept as the slots' bases
+// - For world = S * R * T, the inverse transpose's upper
+//   3x3 is S^-1 * R, and its last column undoes T
+// - Each matrix row is assembled across the four lanes and
+//   then transposed, so it ends up in its own transform
+// - Free slots in the group are rebuilt along with the rest,
+//   which is harmless since nothing reads them
+// - GetBasis() can run this early for one group, and Update()
+//   then only does the group's world matrices
+// --------------------------------------------------------
+void TransformPool::UpdateGroup(unsigned int group)
+{
+	unsigned int base = group * 4;
+	XMVECTOR x = XMLoadFloat4((const XMFLOAT4*)&rotationX[base]);
+	XMVECTOR y = XMLoadFloat4((const XMFLOAT4*)&rotationY[base]);
+	XMVECTOR z = XMLoadFloat4((const XMFLOAT4*)&rotationZ[base]);
+	XMVECTOR w = XMLoadFloat4((const XMFLOAT4*)&rotationW[base]);
+
+	// Twice each product of two components
+	XMVECTOR x2 = XMVectorAdd(x, x);
+	XMVECTOR y2 = XMVectorAdd(y, y);
+	XMVECTOR z2 = XMVectorAdd(z, z);
+	XMVECTOR xx = XMVectorMultiply(x, x2), yy = XMVectorMultiply(y, y2), zz = XMVectorMultiply(z, z2);
+	XMVECTOR xy = XMVectorMultiply(x, y2), xz = XMVectorMultiply(x, z2), yz = XMVectorMultiply(y, z2);
+	XMVECTOR wx = XMVectorMultiply(w, x2), wy = XMVectorMultiply(w, y2), wz = XMVectorMultiply(w, z2);
+
+	XMVECTOR one = XMVectorSplatOne();
+	XMVECTOR rotation[3][3] =
+	{
+		{ XMVectorSubtract(XMVectorSubtract(one, yy), zz), XMVectorAdd(xy, wz), XMVectorSubtract(xz, wy) },
+		{ XMVectorSubtract(xy, wz), XMVectorSubtract(XMVectorSubtract(one, xx), zz), XMVectorAdd(yz, wx) },
+		{ XMVectorAdd(xz, wy), XMVectorSubtract(yz, wx), XMVectorSubtract(XMVectorSubtract(one, xx), yy) },
+	};
+
+	XMVECTOR scale[3] =
+	{
+		XMLoadFloat4((const XMFLOAT4*)&scaleX[base]),
+		XMLoadFloat4((const XMFLOAT4*)&scaleY[base]),
+		XMLoadFloat4((const XMFLOAT4*)&scaleZ[base]),
+	};
+	XMVECTOR position[3] =
+	{
+		XMLoadFloat4((const XMFLOAT4*)&positionX[base]),
+		XMLoadFloat4((const XMFLOAT4*)&positionY[base]),
+		XMLoadFloat4((const XMFLOAT4*)&positionZ[base]),
+	};
+
+	// Row by row, each row of each matrix in the lane of its transform
+	XMVECTOR zero = XMVectorZero();
+	XMMATRIX basisRows[3];
+	XMMATRIX localRows[4];
+	XMMATRIX inverseTransposeRows[3];
+	for (int row = 0; row < 3; row++)
+	{
+		basisRows[row] = XMMatrixTranspose(XMMATRIX(rotation[row][0], rotation[row][1], rotation[row][2], zero));
+		XMVECTOR inverseScale = XMVectorReciprocal(scale[row]);
+		XMVECTOR translation = XMVectorMultiplyAdd(position[0], rotation[row][0],
+			XMVectorMultiplyAdd(position[1], rotation[row][1], XMVectorMultiply(position[2], rotation[row][2])));
+		localRows[row] = XMMatrixTranspose(XMMATRIX(
+			XMVectorMultiply(rotation[row][0], scale[row]),
+			XMVectorMultiply(rotation[row][1], scale[row]),
+			XMVectorMultiply(rotation[row][2], scale[row]),
+			zero));
+		inverseTransposeRows[row] = XMMatrixTranspose(XMMATRIX(
+			XMVectorMultiply(rotation[row][0], inverseScale),
+			XMVectorMultiply(rotation[row][1], inverseScale),
+			XMVectorMultiply(rotation[row][2], inverseScale),
+			XMVectorNegate(XMVectorMultiply(translation, inverseScale))));
+	}
+	localRows[3] = XMMatrixTranspose(XMMATRIX(position[0], position[1], position[2], one));
+	XMVECTOR inverseTransposeLastRow = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+
+	unsigned int count = (unsigned int)worldMatrices.size() - base < 4 ? (unsigned int)worldMatrices.size() - base : 4;
+	for (unsigned int lane = 0; lane < count; lane++)
+	{
+		for (int row = 0; row < 4; row++)
+			XMStoreFloat4((XMFLOAT4*)localMatrices[base + lane].m[row], localRows[row].r[lane]);
+		for (int row = 0; row < 3; row++)
+			XMStoreFloat4((XMFLOAT4*)localInverseTransposeMatrices[base + lane].m[row], inverseTransposeRows[row].r[lane]);
+		XMStoreFloat4((XMFLOAT4*)localInverseTransposeMatrices[base + lane].m[3], inverseTransposeLastRow);
+		for (int row = 0; row < 3; row++)
+			XMStoreFloat3((XMFLOAT3*)bases[base + lane].m[row], basisRows[row].r[lane]);
+	}
+	dirty[base / 64] &= ~(0xFull << (base % 64));
+}
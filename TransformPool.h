@@ -0,0 +1,147 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <DirectXMath.h>
+
+// --------------------------------------------------------
+// Storage for every Transform's position, rotation, scale
+// and matrices, so they can all be updated in one pass
+//
+// - Each component lives in its own array (structure of
+//   arrays), so four transforms load into one SIMD vector
+// - Rotations are stored as quaternions, with pitch, yaw
+//   and roll converted to and from them
+// - Position, rotation and scale are relative to the slot's
+//   parent (if it has one), and world matrices are the
+//   local ones times the parent's world matrix
+// - Changing a transform sets its bit in a dirty bitset and
+//   adds it to a list, and Update() then rebuilds the local
+//   matrices of every dirty transform, four at a time,
+//   followed by the world matrices of their subtrees
+// - Slots are also kept in depth first order (every parent
+//   right before its subtree), so each dirty subtree is one
+//   contiguous range that's swept front to back, and clean
+//   subtrees are never touched
+// - The inverse transpose comes straight from the scale
+//   and rotation rather than from a general inverse
+// - Each slot's rotation matrix is kept too, as its right,
+//   up and forward directions
+// - Asking for matrices while anything is dirty updates
+//   first, so they're never stale
+// - Every rebuild of a slot's world matrices gives it a new
+//   version, taken from a counter for the whole pool, so a
+//   version is never repeated (even by a reused slot) and
+//   anything holding a copy of the matrices can tell when
+//   they've changed
+// - Slots are reused once freed, and Transform holds one
+//   as a handle (see GetShared())
+// --------------------------------------------------------
+class TransformPool
+{
+public:
+	struct Stats
+	{
+		unsigned int TransformCount;	// Slots in use
+		unsigned int Capacity;			// Slots, including free ones
+		unsigned int UpdatedCount;		// Local matrices rebuilt by the last Update()
+		unsigned int WorldUpdatedCount;	// World matrices rebuilt by the last Update()
+		double UpdateTime;				// Milliseconds the last Update() took
+	};
+
+	TransformPool();
+	TransformPool(const TransformPool&) = delete;
+	TransformPool& operator=(const TransformPool&) = delete;
+
+	// The pool every Transform allocates from
+	static std::shared_ptr<TransformPool> GetShared();
+
+	// A slot with no parent, translation or rotation and a scale
+	// of one
+	unsigned int Allocate();
+
+	// Freeing a slot with children detaches them first, keeping
+	// their world transforms (which moves memory for every slot
+	// after it in depth first order)
+	void Free(unsigned int slot);
+
+	void SetPosition(unsigned int slot, DirectX::XMFLOAT3 position);
+	void SetRotation(unsigned int slot, DirectX::XMFLOAT4 quaternion);
+	void SetPitchYawRoll(unsigned int slot, DirectX::XMFLOAT3 pitchYawRoll);
+	void SetScale(unsigned int slot, DirectX::XMFLOAT3 scale);
+	DirectX::XMFLOAT3 GetPosition(unsigned int slot);
+	DirectX::XMFLOAT4 GetRotation(unsigned int slot);
+	DirectX::XMFLOAT3 GetScale(unsigned int slot);
+
+	// Angles that give the slot's rotation (not necessarily the ones
+	// it was set with, as several sets of angles give each rotation)
+	DirectX::XMFLOAT3 GetPitchYawRoll(unsigned int slot);
+
+	// Applies another rotation before the slot's current one (so
+	// about the slot's own axes), renormalizing so that many small
+	// rotations in a row don't drift away from a unit quaternion
+	void Rotate(unsigned int slot, DirectX::XMFLOAT4 quaternion);
+
+	// Rows are the slot's right, up and forward directions, relative
+	// to its parent (only its own group is rebuilt if it changed, not
+	// the whole pool)
+	DirectX::XMFLOAT3X3 GetBasis(unsigned int slot);
+
+	// Moves the slot (and its subtree) under a new parent, or makes
+	// it a root when parent is negative
+	// - With keepWorld, the local transform changes so the world one
+	//   doesn't (as closely as position, rotation and scale can,
+	//   since scaled parents can shear their children)
+	// - Throws std::invalid_argument if the parent is the slot itself
+	//   or one of its descendants
+	void SetParent(unsigned int slot, int parent, bool keepWorld = true);
+	int GetParent(unsigned int slot);
+
+	DirectX::XMFLOAT4X4 GetWorldMatrix(unsigned int slot);
+	DirectX::XMFLOAT4X4 GetWorldInverseTransposeMatrix(unsigned int slot);
+
+	// Changes whenever the slot's world matrices do (never zero, so
+	// zero can mean "nothing uploaded yet")
+	uint64_t GetVersion(unsigned int slot);
+
+	// Rebuilds the matrices of every transform that changed since
+	// they were last built, along with everything below them (once
+	// a frame, before drawing)
+	void Update();
+
+	Stats GetStats();
+
+private:
+	// Component arrays, padded to a multiple of four slots
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+	std::vector<float> scaleX, scaleY, scaleZ;
+	std::vector<DirectX::XMFLOAT3X3> bases;
+	std::vector<DirectX::XMFLOAT4X4> localMatrices;
+	std::vector<DirectX::XMFLOAT4X4> localInverseTransposeMatrices;
+	std::vector<DirectX::XMFLOAT4X4> worldMatrices;
+	std::vector<DirectX::XMFLOAT4X4> worldInverseTransposeMatrices;
+
+	// The hierarchy: per slot, then every slot in depth first order
+	std::vector<int> parents;
+	std::vector<unsigned int> orderPositions;	// Where each slot is in order
+	std::vector<unsigned int> subtreeSizes;		// Including the slot itself
+	std::vector<unsigned int> order;
+
+	std::vector<uint64_t> versions;		// Per slot, from versionCounter
+	uint64_t versionCounter;
+
+	std::vector<uint64_t> dirty;			// One bit per slot
+	std::vector<unsigned int> dirtySlots;	// Every slot with its bit set
+	std::vector<unsigned int> dirtyPositions;	// Scratch space for Update()
+	std::vector<unsigned int> freeSlots;
+	unsigned int transformCount;
+	unsigned int updatedCount;
+	unsigned int worldUpdatedCount;
+	double updateTime;
+
+	void MarkDirty(unsigned int slot);
+	void UpdateGroup(unsigned int group);
+	void UpdateWorld(unsigned int slot);
+	void ResizeSubtrees(int slot, int sizeChange);
+};
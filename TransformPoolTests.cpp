@@ -0,0 +1,293 @@
+#include "Tests.h"
+#include "TransformPool.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	bool NearMatrix(const XMFLOAT4X4& a, const XMFLOAT4X4& b, float tolerance)
+	{
+		for (int r = 0; r < 4; r++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				if (!Tests::Near(a.m[r][c], b.m[r][c], tolerance * fmaxf(1.0f, fabsf(b.m[r][c]))))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	struct TRS
+	{
+		XMFLOAT3 Position;
+		XMFLOAT3 PitchYawRoll;
+		XMFLOAT3 Scale;
+	};
+
+	TRS RandomTRS(std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+		std::uniform_real_distribution<float> angle(-3.0f, 3.0f);
+		std::uniform_real_distribution<float> scale(0.25f, 4.0f);
+		return {
+			XMFLOAT3(position(random), position(random), position(random)),
+			XMFLOAT3(angle(random), angle(random), angle(random)),
+			XMFLOAT3(scale(random), scale(random), scale(random)) };
+	}
+
+	// --------------------------------------------------------
+	// World matrices the way Transform built them before the
+	// pool: composed one at a time, with a general inverse
+	// --------------------------------------------------------
+	void ComposeMatrices(const TRS& trs, XMFLOAT4X4& world, XMFLOAT4X4& worldInverseTranspose)
+	{
+		XMMATRIX matrix =
+			XMMatrixScaling(trs.Scale.x, trs.Scale.y, trs.Scale.z) *
+			XMMatrixRotationRollPitchYaw(trs.PitchYawRoll.x, trs.PitchYawRoll.y, trs.PitchYawRoll.z) *
+			XMMatrixTranslation(trs.Position.x, trs.Position.y, trs.Position.z);
+		XMStoreFloat4x4(&world, matrix);
+		XMStoreFloat4x4(&worldInverseTranspose, XMMatrixInverse(0, XMMatrixTranspose(matrix)));
+	}
+
+	// --------------------------------------------------------
+	// Turns the slot about its own up axis this many times, and
+	// returns the angle (in radians) between the rotation it
+	// ends up with and the single turn it should add up to
+	// --------------------------------------------------------
+	float TurnDrift(TransformPool& pool, unsigned int slot, int steps, float step)
+	{
+		XMFLOAT4 start = pool.GetRotation(slot);
+		XMFLOAT4 turn;
+		XMStoreFloat4(&turn, XMQuaternionRotationRollPitchYaw(0.0f, step, 0.0f));
+		for (int i = 0; i < steps; i++)
+			pool.Rotate(slot, turn);
+
+		// Turning about the slot's own axis applies before the start
+		XMFLOAT4 rotation = pool.GetRotation(slot);
+		float total = fmodf(steps * step, XM_2PI);
+		XMVECTOR expected = XMQuaternionMultiply(
+			XMQuaternionRotationRollPitchYaw(0.0f, total, 0.0f), XMLoadFloat4(&start));
+		XMFLOAT4 difference;
+		XMStoreFloat4(&difference, XMQuaternionMultiply(XMLoadFloat4(&rotation), XMQuaternionConjugate(expected)));
+		return 2.0f * atan2f(sqrtf(difference.x * difference.x + difference.y * difference.y + difference.z * difference.z), fabsf(difference.w));
+	}
+
+	// --------------------------------------------------------
+	// Matrices per second Update() manages with every one of
+	// this many transforms changing each time (the worst case),
+	// with only the updates themselves timed
+	// --------------------------------------------------------
+	double PoolMatricesPerSecond(unsigned int transformCount)
+	{
+		TransformPool pool;
+		std::vector<XMFLOAT3> positions(transformCount);
+		for (unsigned int i = 0; i < transformCount; i++)
+		{
+			unsigned int slot = pool.Allocate();
+			float t = (float)i;
+			positions[slot] = XMFLOAT3(t, t * 0.5f, -t);
+			pool.SetPosition(slot, positions[slot]);
+			pool.SetPitchYawRoll(slot, XMFLOAT3(t * 0.01f, t * 0.02f, t * 0.03f));
+			pool.SetScale(slot, XMFLOAT3(1.0f + t * 0.001f, 2.0f, 0.5f));
+		}
+
+		unsigned int updates = 0;
+		double milliseconds = 0.0;
+		while (updates < 3 || milliseconds < 100.0)
+		{
+			for (unsigned int slot = 0; slot < transformCount; slot++)
+				pool.SetPosition(slot, positions[slot]);
+			pool.Update();
+			updates++;
+			milliseconds += pool.GetStats().UpdateTime;
+		}
+		return (double)transformCount * updates / (milliseconds / 1000.0);
+	}
+
+	// Transforms per second that can be rotated and then have their
+	// forward direction read back (like a camera turning each frame)
+	double RotationsPerSecond(unsigned int transformCount)
+	{
+		TransformPool pool;
+		for (unsigned int i = 0; i < transformCount; i++)
+			pool.SetPitchYawRoll(pool.Allocate(), XMFLOAT3(i * 0.01f, i * 0.02f, 0.0f));
+		pool.Update();
+
+		XMFLOAT4 turn;
+		XMStoreFloat4(&turn, XMQuaternionRotationRollPitchYaw(0.001f, 0.002f, 0.0f));
+
+		unsigned int passes = 0;
+		double milliseconds = 0.0;
+		while (passes < 3 || milliseconds < 100.0)
+		{
+			auto start = std::chrono::steady_clock::now();
+			for (unsigned int slot = 0; slot < transformCount; slot++)
+			{
+				pool.Rotate(slot, turn);
+				pool.GetBasis(slot);
+			}
+			milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			// World matrices are outside the timing, as they'd be batched
+			pool.Update();
+			passes++;
+		}
+		return (double)transformCount * passes / (milliseconds / 1000.0);
+	}
+}
+
+// A count that isn't a multiple of four, so the last group is partly padding
+TEST(TransformPoolMatchesComposedMatrices)
+{
+	const unsigned int count = 1003;
+	TransformPool pool;
+	std::mt19937 random(1);
+	std::vector<TRS> transforms;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		TRS trs = RandomTRS(random);
+		unsigned int slot = pool.Allocate();
+		CHECK(slot == i);
+		pool.SetPosition(slot, trs.Position);
+		pool.SetPitchYawRoll(slot, trs.PitchYawRoll);
+		pool.SetScale(slot, trs.Scale);
+		transforms.push_back(trs);
+	}
+	pool.Update();
+	CHECK(pool.GetStats().TransformCount == count);
+	CHECK(pool.GetStats().WorldUpdatedCount == count);
+
+	unsigned int mismatches = 0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		XMFLOAT4X4 world;
+		XMFLOAT4X4 worldInverseTranspose;
+		ComposeMatrices(transforms[i], world, worldInverseTranspose);
+		mismatches += !NearMatrix(pool.GetWorldMatrix(i), world, 1e-4f);
+		mismatches += !NearMatrix(pool.GetWorldInverseTransposeMatrix(i), worldInverseTranspose, 1e-3f);
+	}
+	CHECK(mismatches == 0);
+}
+
+// Only the groups of four holding a changed transform are rebuilt
+TEST(TransformPoolUpdatesOnlyDirtyTransforms)
+{
+	TransformPool pool;
+	for (unsigned int i = 0; i < 1000; i++)
+		pool.Allocate();
+	pool.Update();
+
+	pool.Update();
+	CHECK(pool.GetStats().UpdatedCount == 0);
+	CHECK(pool.GetStats().WorldUpdatedCount == 0);
+
+	uint64_t version = pool.GetVersion(10);
+	pool.SetPosition(10, XMFLOAT3(1, 2, 3));
+	pool.SetScale(11, XMFLOAT3(2, 2, 2));
+	pool.SetPosition(500, XMFLOAT3(4, 5, 6));
+	pool.Update();
+	CHECK(pool.GetStats().UpdatedCount == 8);
+	CHECK(pool.GetStats().WorldUpdatedCount == 3);
+	CHECK(pool.GetVersion(10) != version);
+	CHECK(pool.GetWorldMatrix(500)._42 == 5.0f);
+
+	// Reading a matrix brings it up to date without an explicit Update()
+	pool.SetPosition(999, XMFLOAT3(7, 8, 9));
+	CHECK(pool.GetWorldMatrix(999)._43 == 9.0f);
+}
+
+// --------------------------------------------------------
+// A million small turns about one axis, which would drift
+// far from a unit quaternion without renormalizing
+// - Afterwards the rotation, the basis and the world matrix
+//   must all still be the single rotation of the total angle
+// --------------------------------------------------------
+TEST(TransformPoolRotationsDontDrift)
+{
+	TransformPool pool;
+	unsigned int slot = pool.Allocate();
+	pool.SetPitchYawRoll(slot, XMFLOAT3(0.5f, 0.0f, 0.0f));
+
+	// Each step rounds the quaternion, so the total angle can stray
+	// a little (TransformPoolRotations prints how far)
+	float angleError = TurnDrift(pool, slot, 1000000, 0.0001f);
+	CHECK(angleError < XMConvertToRadians(0.01f));
+
+	XMFLOAT4 rotation = pool.GetRotation(slot);
+	CHECK(Tests::Near(XMVectorGetX(XMQuaternionLength(XMLoadFloat4(&rotation))), 1.0f, 1e-5f));
+
+	// The basis stays orthonormal and agrees with the world matrix
+	XMFLOAT3X3 basis = pool.GetBasis(slot);
+	XMVECTOR right = XMVectorSet(basis._11, basis._12, basis._13, 0.0f);
+	XMVECTOR up = XMVectorSet(basis._21, basis._22, basis._23, 0.0f);
+	XMVECTOR forward = XMVectorSet(basis._31, basis._32, basis._33, 0.0f);
+	CHECK(Tests::Near(XMVectorGetX(XMVector3Length(right)), 1.0f, 1e-5f));
+	CHECK(Tests::Near(XMVectorGetX(XMVector3Length(up)), 1.0f, 1e-5f));
+	CHECK(Tests::Near(XMVectorGetX(XMVector3Length(forward)), 1.0f, 1e-5f));
+	CHECK(fabsf(XMVectorGetX(XMVector3Dot(right, up))) < 1e-5f);
+	CHECK(fabsf(XMVectorGetX(XMVector3Dot(up, forward))) < 1e-5f);
+	CHECK(fabsf(XMVectorGetX(XMVector3Dot(forward, right))) < 1e-5f);
+	CHECK(XMVectorGetX(XMVector3Dot(XMVector3Cross(right, up), forward)) > 0.0f);
+
+	XMFLOAT4X4 world = pool.GetWorldMatrix(slot);
+	CHECK(Tests::Near(world._31, basis._31, 1e-5f) && Tests::Near(world._32, basis._32, 1e-5f) && Tests::Near(world._33, basis._33, 1e-5f));
+
+	// And the angles read back give the same rotation again
+	XMFLOAT3 angles = pool.GetPitchYawRoll(slot);
+	XMVECTOR fromAngles = XMQuaternionRotationRollPitchYaw(angles.x, angles.y, angles.z);
+	CHECK(fabsf(XMVectorGetX(XMQuaternionDot(fromAngles, XMLoadFloat4(&rotation)))) > 1.0f - 1e-5f);
+}
+
+// --------------------------------------------------------
+// Matrices per second at 10k, 100k and 1M transforms, every
+// one changing each time, against composing them one at a
+// time as Transform did before the pool
+// --------------------------------------------------------
+BENCHMARK(TransformPoolUpdates)
+{
+	const unsigned int counts[] = { 10000, 100000, 1000000 };
+	for (unsigned int count : counts)
+	{
+		std::mt19937 random(2);
+		std::vector<TRS> transforms(count);
+		for (TRS& trs : transforms)
+			trs = RandomTRS(random);
+		std::vector<XMFLOAT4X4> world(count);
+		std::vector<XMFLOAT4X4> worldInverseTranspose(count);
+
+		auto start = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < count; i++)
+			ComposeMatrices(transforms[i], world[i], worldInverseTranspose[i]);
+		double composeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		double pooled = PoolMatricesPerSecond(count);
+		printf("  %7u transforms: pool %.1fM matrices/s, one at a time %.1fM matrices/s\n",
+			count, pooled / 1000000.0, count / composeSeconds / 1000000.0);
+		CHECK(pooled > 0.0);
+	}
+}
+
+// Rotations (and reading back the new basis) per second, and
+// how far a million small turns stray from the total angle
+BENCHMARK(TransformPoolRotations)
+{
+	const unsigned int counts[] = { 10000, 100000, 1000000 };
+	for (unsigned int count : counts)
+	{
+		double rotations = RotationsPerSecond(count);
+		printf("  %7u transforms: %.1fM rotations/s\n", count, rotations / 1000000.0);
+		CHECK(rotations > 0.0);
+	}
+
+	TransformPool pool;
+	unsigned int slot = pool.Allocate();
+	pool.SetPitchYawRoll(slot, XMFLOAT3(0.5f, 0.0f, 0.0f));
+	float angleError = TurnDrift(pool, slot, 1000000, 0.0001f);
+	printf("  1000000 turns: off by %.5f degrees\n", XMConvertToDegrees(angleError));
+}
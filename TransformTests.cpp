@@ -0,0 +1,296 @@
+#include "Tests.h"
+#include "Transform.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	// --------------------------------------------------------
+	// The world matrix built the slow way: the local matrix
+	// from the transform's own getters, times every ancestor's
+	// --------------------------------------------------------
+	XMMATRIX ComposeWorld(Transform* transform)
+	{
+		XMFLOAT3 position = transform->GetPosition();
+		XMFLOAT4 rotation = transform->GetRotation();
+		XMFLOAT3 scale = transform->GetScale();
+		XMMATRIX local =
+			XMMatrixScaling(scale.x, scale.y, scale.z) *
+			XMMatrixRotationQuaternion(XMLoadFloat4(&rotation)) *
+			XMMatrixTranslation(position.x, position.y, position.z);
+		return transform->GetParent() ? local * ComposeWorld(transform->GetParent()) : local;
+	}
+
+	// Largest difference between two matrices, relative to the larger of 1 and b's biggest element
+	float MatrixError(const XMFLOAT4X4& a, FXMMATRIX bMatrix)
+	{
+		XMFLOAT4X4 b;
+		XMStoreFloat4x4(&b, bMatrix);
+		float difference = 0.0f;
+		float largest = 1.0f;
+		for (int r = 0; r < 4; r++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				difference = fmaxf(difference, fabsf(a.m[r][c] - b.m[r][c]));
+				largest = fmaxf(largest, fabsf(b.m[r][c]));
+			}
+		}
+		return difference / largest;
+	}
+
+	bool IsAncestorOrSelf(Transform* ancestor, Transform* transform)
+	{
+		for (Transform* t = transform; t; t = t->GetParent())
+		{
+			if (t == ancestor)
+				return true;
+		}
+		return false;
+	}
+
+	float Distance(XMFLOAT3 a, XMFLOAT3 b)
+	{
+		return XMVectorGetX(XMVector3Length(XMLoadFloat3(&a) - XMLoadFloat3(&b)));
+	}
+}
+
+// --------------------------------------------------------
+// Random moves, rotations, scales, reparenting and deleted
+// parents, checking every world matrix against composing
+// it from the ancestors after each step
+// - Scales are uniform, so keepWorld can be exact (scaled
+//   parents can otherwise shear their children)
+// --------------------------------------------------------
+TEST(TransformHierarchyMatchesComposedMatrices)
+{
+	std::mt19937 random(5);
+	std::uniform_real_distribution<float> value(-2.0f, 2.0f);
+	std::vector<std::unique_ptr<Transform>> transforms;
+	for (int i = 0; i < 200; i++)
+		transforms.push_back(std::make_unique<Transform>());
+
+	float worldError = 0.0f;
+	float inverseTransposeError = 0.0f;
+	float keepWorldError = 0.0f;
+	unsigned int missedCycles = 0;
+	unsigned int falseCycles = 0;
+	for (int step = 0; step < 2000; step++)
+	{
+		Transform* transform = transforms[random() % transforms.size()].get();
+		int other = (int)(random() % (transforms.size() + 1)) - 1;
+		Transform* parent = other < 0 ? nullptr : transforms[other].get();
+		switch (random() % 6)
+		{
+		case 0:
+			transform->SetPosition(value(random), value(random), value(random));
+			break;
+		case 1:
+			transform->SetRotation(value(random), value(random), value(random));
+			break;
+		case 2:
+		{
+			float scale = 0.8f + fabsf(value(random)) * 0.2f;
+			transform->SetScale(scale, scale, scale);
+			break;
+		}
+		case 3:
+		case 4:
+		{
+			// Parenting to itself or a descendant has to throw, and
+			// nothing else may
+			bool keepWorld = (random() % 2) == 0;
+			bool cycle = parent && IsAncestorOrSelf(transform, parent);
+			XMFLOAT4X4 before = transform->GetWorldMatrix();
+			try
+			{
+				transform->SetParent(parent, keepWorld);
+				missedCycles += cycle;
+				if (keepWorld)
+					keepWorldError = fmaxf(keepWorldError, MatrixError(transform->GetWorldMatrix(), XMLoadFloat4x4(&before)));
+			}
+			catch (const std::invalid_argument&)
+			{
+				falseCycles += !cycle;
+			}
+			CHECK(!parent || !cycle || transform->GetParent() != parent);
+			break;
+		}
+		case 5:
+		{
+			// Deleting a parent leaves its children where they were
+			if (random() % 10 != 0)
+				break;
+			std::vector<std::pair<Transform*, XMFLOAT4X4>> children;
+			for (int c = 0; c < transform->GetChildCount(); c++)
+				children.push_back({ transform->GetChild(c), transform->GetChild(c)->GetWorldMatrix() });
+			for (std::unique_ptr<Transform>& t : transforms)
+			{
+				if (t.get() == transform)
+					t = std::make_unique<Transform>();
+			}
+			for (auto& child : children)
+			{
+				CHECK(child.first->GetParent() == nullptr);
+				keepWorldError = fmaxf(keepWorldError, MatrixError(child.first->GetWorldMatrix(), XMLoadFloat4x4(&child.second)));
+			}
+			break;
+		}
+		}
+
+		if (step % 50 == 0)
+			TransformPool::GetShared()->Update();
+		if (step % 7 == 0)
+		{
+			for (std::unique_ptr<Transform>& t : transforms)
+			{
+				XMMATRIX world = ComposeWorld(t.get());
+				worldError = fmaxf(worldError, MatrixError(t->GetWorldMatrix(), world));
+				inverseTransposeError = fmaxf(inverseTransposeError,
+					MatrixError(t->GetWorldInverseTransposeMatrix(), XMMatrixInverse(0, XMMatrixTranspose(world))));
+			}
+		}
+	}
+	CHECK(worldError < 1e-4f);
+	CHECK(inverseTransposeError < 1e-3f);
+	CHECK(keepWorldError < 1e-4f);
+	CHECK(missedCycles == 0);
+	CHECK(falseCycles == 0);
+}
+
+TEST(TransformLocalWorldHelpers)
+{
+	Transform parent;
+	parent.SetPosition(10.0f, 0.0f, 0.0f);
+	parent.SetRotation(0.0f, XM_PIDIV2, 0.0f);
+	parent.SetScale(2.0f, 2.0f, 2.0f);
+	Transform child;
+	child.SetParent(&parent, false);
+	child.SetPosition(0.0f, 0.0f, 1.0f);
+
+	// A yaw of 90 degrees turns +Z to +X, then the parent's scale and offset apply
+	XMFLOAT3 world = child.GetWorldPosition();
+	CHECK(Distance(world, XMFLOAT3(12.0f, 0.0f, 0.0f)) < 1e-5f);
+	CHECK(Distance(parent.LocalToWorldPoint(XMFLOAT3(0, 0, 1)), world) < 1e-5f);
+	CHECK(Distance(parent.WorldToLocalPoint(world), XMFLOAT3(0, 0, 1)) < 1e-5f);
+
+	// Directions turn and scale, but don't move
+	XMFLOAT3 direction = parent.LocalToWorldDirection(XMFLOAT3(0, 0, 1));
+	CHECK(Distance(direction, XMFLOAT3(2.0f, 0.0f, 0.0f)) < 1e-5f);
+	CHECK(Distance(parent.WorldToLocalDirection(direction), XMFLOAT3(0, 0, 1)) < 1e-5f);
+
+	// Round trips through an arbitrary chain
+	Transform grandchild;
+	grandchild.SetParent(&child, false);
+	grandchild.SetRotation(0.3f, -1.2f, 2.0f);
+	grandchild.SetScale(0.5f, 3.0f, 1.5f);
+	XMFLOAT3 point(1.0f, -2.0f, 3.0f);
+	CHECK(Distance(grandchild.WorldToLocalPoint(grandchild.LocalToWorldPoint(point)), point) < 1e-4f);
+	CHECK(Distance(grandchild.WorldToLocalDirection(grandchild.LocalToWorldDirection(point)), point) < 1e-4f);
+
+	// And the hierarchy queries agree with each other
+	CHECK(child.GetParent() == &parent);
+	CHECK(parent.GetChildCount() == 1 && parent.GetChild(0) == &child);
+	child.SetParent(nullptr);
+	CHECK(parent.GetChildCount() == 0);
+	CHECK(Distance(child.GetWorldPosition(), XMFLOAT3(12.0f, 0.0f, 0.0f)) < 1e-5f);
+}
+
+// --------------------------------------------------------
+// 1000 trees of 100 nodes (branching 3), where moving a node
+// only rebuilds its own subtree
+// --------------------------------------------------------
+namespace
+{
+	std::vector<std::unique_ptr<Transform>> BuildForest()
+	{
+		std::vector<std::unique_ptr<Transform>> nodes;
+		nodes.reserve(100000);
+		for (int tree = 0; tree < 1000; tree++)
+		{
+			size_t root = nodes.size();
+			for (int n = 0; n < 100; n++)
+			{
+				nodes.push_back(std::make_unique<Transform>());
+				nodes.back()->SetPosition(1.0f, 0.0f, 0.0f);
+				nodes.back()->SetRotation(0.0f, 0.1f, 0.0f);
+				if (n > 0)
+					nodes.back()->SetParent(nodes[root + (n - 1) / 3].get(), false);
+			}
+		}
+		return nodes;
+	}
+}
+
+TEST(TransformDirtyPropagationStaysInSubtrees)
+{
+	std::vector<std::unique_ptr<Transform>> nodes = BuildForest();
+	std::shared_ptr<TransformPool> pool = TransformPool::GetShared();
+	pool->Update();
+
+	pool->Update();
+	CHECK(pool->GetStats().WorldUpdatedCount == 0);
+
+	// Leaves (nodes 34 to 99 of a tree have no children)
+	for (int i = 0; i < 10; i++)
+		nodes[i * 10000 + 50]->Rotate(0.1f, 0.0f, 0.0f);
+	pool->Update();
+	CHECK(pool->GetStats().WorldUpdatedCount == 10);
+
+	// Roots take their whole tree along
+	for (int i = 0; i < 10; i++)
+		nodes[i * 10000]->MoveAbsolute(0.0f, 1.0f, 0.0f);
+	pool->Update();
+	CHECK(pool->GetStats().WorldUpdatedCount == 1000);
+
+	// A node and its own ancestor in the same update only sweep once
+	nodes[100]->MoveAbsolute(1.0f, 0.0f, 0.0f);
+	nodes[101]->MoveAbsolute(1.0f, 0.0f, 0.0f);
+	pool->Update();
+	CHECK(pool->GetStats().WorldUpdatedCount == 100);
+
+	// The moved subtree's world matrices include the move
+	XMFLOAT3 before = nodes[150]->GetWorldPosition();
+	nodes[100]->MoveAbsolute(0.0f, 0.0f, 5.0f);
+	CHECK(Distance(nodes[150]->GetWorldPosition(), XMFLOAT3(before.x, before.y, before.z + 5.0f)) < 1e-4f);
+}
+
+// Update time for a few moving nodes in a 100k node scene
+BENCHMARK(TransformHierarchyFewMoving)
+{
+	std::vector<std::unique_ptr<Transform>> nodes = BuildForest();
+	std::shared_ptr<TransformPool> pool = TransformPool::GetShared();
+	pool->Update();
+	printf("  100k nodes, all dirty: %.3f ms\n", pool->GetStats().UpdateTime);
+
+	std::mt19937 random(3);
+	double leafTime = 0.0;
+	double rootTime = 0.0;
+	const int frames = 100;
+	for (int frame = 0; frame < frames; frame++)
+	{
+		for (int i = 0; i < 10; i++)
+			nodes[(random() % 1000) * 100 + 50 + random() % 50]->Rotate(0.01f, 0.0f, 0.0f);
+		pool->Update();
+		leafTime += pool->GetStats().UpdateTime;
+
+		for (int i = 0; i < 10; i++)
+			nodes[(random() % 1000) * 100]->Rotate(0.0f, 0.01f, 0.0f);
+		pool->Update();
+		rootTime += pool->GetStats().UpdateTime;
+	}
+	printf("  10 leaves moving: %.4f ms per update\n", leafTime / frames);
+	printf("  10 roots (1000 nodes) moving: %.4f ms per update\n", rootTime / frames);
+
+	auto start = std::chrono::steady_clock::now();
+	nodes[500]->SetParent(nodes[99900].get());
+	printf("  Reparenting a subtree across the scene: %.3f ms\n",
+		std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
@@ -0,0 +1,131 @@
+#include "VertexPacking.h"
+
+#include <cmath>
+#include <DirectXPackedVector.h>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace
+{
+	const float unormMax = 65535.0f;
+	const float snormMax = 32767.0f;
+
+	uint16_t ToUnorm16(float value)
+	{
+		value = fminf(fmaxf(value, 0.0f), 1.0f);
+		return (uint16_t)lrintf(value * unormMax);
+	}
+
+	int16_t ToSnorm16(float value)
+	{
+		value = fminf(fmaxf(value, -1.0f), 1.0f);
+		return (int16_t)lrintf(value * snormMax);
+	}
+
+	// Matches the GPU's snorm conversion, where -32768 also means -1
+	float FromSnorm16(int16_t value)
+	{
+		return fmaxf(value / snormMax, -1.0f);
+	}
+
+	float SignNotZero(float value)
+	{
+		return value >= 0.0f ? 1.0f : -1.0f;
+	}
+}
+
+namespace VertexPacking
+{
+	Quantization GetQuantization(XMFLOAT3 boundsMin, XMFLOAT3 boundsMax)
+	{
+		// Flat axes get a zero scale, which decodes to the offset
+		Quantization quantization;
+		quantization.Offset = boundsMin;
+		quantization.Scale = XMFLOAT3(
+			boundsMax.x - boundsMin.x,
+			boundsMax.y - boundsMin.y,
+			boundsMax.z - boundsMin.z);
+		return quantization;
+	}
+
+	// --------------------------------------------------------
+	// Projects onto the octahedron |x| + |y| + |z| = 1, then
+	// folds the lower half over the upper one
+	// --------------------------------------------------------
+	XMFLOAT2 EncodeOctahedral(XMFLOAT3 v)
+	{
+		float length = fabsf(v.x) + fabsf(v.y) + fabsf(v.z);
+		if (length == 0.0f)
+			return XMFLOAT2(0, 0);
+
+		XMFLOAT2 e(v.x / length, v.y / length);
+		if (v.z < 0.0f)
+		{
+			XMFLOAT2 folded(
+				(1.0f - fabsf(e.y)) * SignNotZero(e.x),
+				(1.0f - fabsf(e.x)) * SignNotZero(e.y));
+			e = folded;
+		}
+		return e;
+	}
+
+	XMFLOAT3 DecodeOctahedral(XMFLOAT2 e)
+	{
+		XMFLOAT3 v(e.x, e.y, 1.0f - fabsf(e.x) - fabsf(e.y));
+		float t = fmaxf(-v.z, 0.0f);
+		v.x += v.x >= 0.0f ? -t : t;
+		v.y += v.y >= 0.0f ? -t : t;
+
+		XMStoreFloat3(&v, XMVector3Normalize(XMLoadFloat3(&v)));
+		return v;
+	}
+
+	PackedVertex Pack(const Vertex& v, const Quantization& quantization)
+	{
+		PackedVertex packed = {};
+		packed.Position[0] = ToUnorm16(quantization.Scale.x > 0.0f ? (v.Position.x - quantization.Offset.x) / quantization.Scale.x : 0.0f);
+		packed.Position[1] = ToUnorm16(quantization.Scale.y > 0.0f ? (v.Position.y - quantization.Offset.y) / quantization.Scale.y : 0.0f);
+		packed.Position[2] = ToUnorm16(quantization.Scale.z > 0.0f ? (v.Position.z - quantization.Offset.z) / quantization.Scale.z : 0.0f);
+		packed.Position[3] = v.Tangent.w < 0.0f ? 0 : 0xFFFF;
+
+		packed.UV[0] = XMConvertFloatToHalf(v.UV.x);
+		packed.UV[1] = XMConvertFloatToHalf(v.UV.y);
+
+		XMFLOAT2 normal = EncodeOctahedral(v.Normal);
+		packed.Normal[0] = ToSnorm16(normal.x);
+		packed.Normal[1] = ToSnorm16(normal.y);
+
+		XMFLOAT2 tangent = EncodeOctahedral(XMFLOAT3(v.Tangent.x, v.Tangent.y, v.Tangent.z));
+		packed.Tangent[0] = ToSnorm16(tangent.x);
+		packed.Tangent[1] = ToSnorm16(tangent.y);
+		return packed;
+	}
+
+	// --------------------------------------------------------
+	// The same decode the packed vertex shaders do, so the CPU
+	// can check what the GPU will see
+	// --------------------------------------------------------
+	Vertex Unpack(const PackedVertex& v, const Quantization& quantization)
+	{
+		Vertex unpacked = {};
+		unpacked.Position = XMFLOAT3(
+			quantization.Offset.x + v.Position[0] / unormMax * quantization.Scale.x,
+			quantization.Offset.y + v.Position[1] / unormMax * quantization.Scale.y,
+			quantization.Offset.z + v.Position[2] / unormMax * quantization.Scale.z);
+		unpacked.UV = XMFLOAT2(XMConvertHalfToFloat(v.UV[0]), XMConvertHalfToFloat(v.UV[1]));
+		unpacked.Normal = DecodeOctahedral(XMFLOAT2(FromSnorm16(v.Normal[0]), FromSnorm16(v.Normal[1])));
+		XMFLOAT3 tangent = DecodeOctahedral(XMFLOAT2(FromSnorm16(v.Tangent[0]), FromSnorm16(v.Tangent[1])));
+		unpacked.Tangent = XMFLOAT4(tangent.x, tangent.y, tangent.z, v.Position[3] == 0 ? -1.0f : 1.0f);
+		return unpacked;
+	}
+
+	XMFLOAT3 GetMaxPositionError(const Quantization& quantization)
+	{
+		// Rounding to the nearest step is off by at most half a step
+		return XMFLOAT3(
+			quantization.Scale.x / unormMax * 0.5f,
+			quantization.Scale.y / unormMax * 0.5f,
+			quantization.Scale.z / unormMax * 0.5f);
+	}
+}
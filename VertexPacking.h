@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <DirectXMath.h>
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// A compact, 20 byte alternative to Vertex (which is 44)
+//
+// - Position: 16-bit unorm per axis, relative to the mesh's
+//   bounds, with the tangent's handedness sign in W
+// - UV: half floats
+// - Normal and tangent: octahedral encoding, 16-bit snorm
+//
+// Must match VertexShaderInputPacked in ShaderInclude.hlsli
+// --------------------------------------------------------
+struct PackedVertex
+{
+	uint16_t Position[4];	// DXGI_FORMAT_R16G16B16A16_UNORM
+	uint16_t UV[2];			// DXGI_FORMAT_R16G16_FLOAT
+	int16_t Normal[2];		// DXGI_FORMAT_R16G16_SNORM
+	int16_t Tangent[2];		// DXGI_FORMAT_R16G16_SNORM
+};
+
+// Which of the two layouts a mesh's vertex buffer uses
+enum class VertexFormat
+{
+	Full,
+	Packed
+};
+
+namespace VertexPacking
+{
+	// Maps quantized positions back to object space:
+	// position = Offset + unorm * Scale
+	struct Quantization
+	{
+		DirectX::XMFLOAT3 Offset;
+		DirectX::XMFLOAT3 Scale;
+	};
+
+	Quantization GetQuantization(DirectX::XMFLOAT3 boundsMin, DirectX::XMFLOAT3 boundsMax);
+
+	// Unit vector <-> octahedral coordinates in [-1, 1]
+	DirectX::XMFLOAT2 EncodeOctahedral(DirectX::XMFLOAT3 v);
+	DirectX::XMFLOAT3 DecodeOctahedral(DirectX::XMFLOAT2 e);
+
+	PackedVertex Pack(const Vertex& v, const Quantization& quantization);
+	Vertex Unpack(const PackedVertex& v, const Quantization& quantization);
+
+	// Largest position error Pack() can introduce on each axis
+	DirectX::XMFLOAT3 GetMaxPositionError(const Quantization& quantization);
+}
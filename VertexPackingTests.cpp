@@ -0,0 +1,157 @@
+#include "Tests.h"
+#include "VertexPacking.h"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	// Angle between two vectors, in degrees (acos of the dot product
+	// loses too much precision for angles this small)
+	float AngleBetween(XMFLOAT3 a, XMFLOAT3 b)
+	{
+		XMVECTOR va = XMLoadFloat3(&a);
+		XMVECTOR vb = XMLoadFloat3(&b);
+		float sine = XMVectorGetX(XMVector3Length(XMVector3Cross(va, vb)));
+		float cosine = XMVectorGetX(XMVector3Dot(va, vb));
+		return XMConvertToDegrees(atan2f(sine, cosine));
+	}
+
+	XMFLOAT3 RandomDirection(std::mt19937& random)
+	{
+		std::normal_distribution<float> normal;
+		XMFLOAT3 v;
+		do
+		{
+			v = XMFLOAT3(normal(random), normal(random), normal(random));
+		} while (v.x == 0.0f && v.y == 0.0f && v.z == 0.0f);
+		XMStoreFloat3(&v, XMVector3Normalize(XMLoadFloat3(&v)));
+		return v;
+	}
+
+	// --------------------------------------------------------
+	// The directions most likely to break the octahedral fold:
+	// the axes, the octahedron's edges and the points between
+	// --------------------------------------------------------
+	std::vector<XMFLOAT3> GetEdgeDirections()
+	{
+		std::vector<XMFLOAT3> directions;
+		for (int x = -1; x <= 1; x++)
+		{
+			for (int y = -1; y <= 1; y++)
+			{
+				for (int z = -1; z <= 1; z++)
+				{
+					if (x == 0 && y == 0 && z == 0)
+						continue;
+					XMFLOAT3 v((float)x, (float)y, (float)z);
+					XMStoreFloat3(&v, XMVector3Normalize(XMLoadFloat3(&v)));
+					directions.push_back(v);
+				}
+			}
+		}
+		return directions;
+	}
+
+	// 16-bit snorm octahedral vectors are within about 0.005 degrees
+	const float maxDirectionError = 0.01f;
+}
+
+TEST(OctahedralRoundTripErrorIsBounded)
+{
+	std::vector<XMFLOAT3> directions = GetEdgeDirections();
+	std::mt19937 random(1);
+	for (int i = 0; i < 100000; i++)
+		directions.push_back(RandomDirection(random));
+
+	VertexPacking::Quantization quantization = VertexPacking::GetQuantization(XMFLOAT3(0, 0, 0), XMFLOAT3(1, 1, 1));
+	float worstNormal = 0.0f;
+	float worstTangent = 0.0f;
+	unsigned int handednessErrors = 0;
+	for (size_t i = 0; i < directions.size(); i++)
+	{
+		Vertex v = {};
+		v.Normal = directions[i];
+		v.Tangent = XMFLOAT4(directions[i].y, directions[i].z, directions[i].x, (i & 1) ? 1.0f : -1.0f);
+		Vertex unpacked = VertexPacking::Unpack(VertexPacking::Pack(v, quantization), quantization);
+
+		worstNormal = fmaxf(worstNormal, AngleBetween(v.Normal, unpacked.Normal));
+		worstTangent = fmaxf(worstTangent, AngleBetween(XMFLOAT3(v.Tangent.x, v.Tangent.y, v.Tangent.z),
+			XMFLOAT3(unpacked.Tangent.x, unpacked.Tangent.y, unpacked.Tangent.z)));
+		handednessErrors += (unpacked.Tangent.w != v.Tangent.w);
+	}
+	printf("  worst normal %.5f, tangent %.5f degrees\n", worstNormal, worstTangent);
+	CHECK(worstNormal <= maxDirectionError);
+	CHECK(worstTangent <= maxDirectionError);
+	CHECK(handednessErrors == 0);
+
+	// A zero vector encodes to the center instead of dividing by zero
+	XMFLOAT2 zero = VertexPacking::EncodeOctahedral(XMFLOAT3(0, 0, 0));
+	CHECK(zero.x == 0.0f && zero.y == 0.0f);
+}
+
+TEST(PositionErrorStaysWithinMaxPositionError)
+{
+	XMFLOAT3 boundsMin(-12.5f, 0.25f, -3.0f);
+	XMFLOAT3 boundsMax(40.0f, 7.75f, 1000.0f);
+	VertexPacking::Quantization quantization = VertexPacking::GetQuantization(boundsMin, boundsMax);
+	XMFLOAT3 bound = VertexPacking::GetMaxPositionError(quantization);
+
+	// Float math in the decode adds a rounding error of its own
+	// on top of the half step, relative to the size of the bounds
+	XMFLOAT3 slack(
+		bound.x + 1e-6f * fmaxf(fabsf(boundsMin.x), fabsf(boundsMax.x)),
+		bound.y + 1e-6f * fmaxf(fabsf(boundsMin.y), fabsf(boundsMax.y)),
+		bound.z + 1e-6f * fmaxf(fabsf(boundsMin.z), fabsf(boundsMax.z)));
+
+	std::mt19937 random(2);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	unsigned int outside = 0;
+	for (int i = 0; i < 100000; i++)
+	{
+		Vertex v = {};
+		v.Position = XMFLOAT3(
+			boundsMin.x + unit(random) * quantization.Scale.x,
+			boundsMin.y + unit(random) * quantization.Scale.y,
+			boundsMin.z + unit(random) * quantization.Scale.z);
+		if (i < 2)
+			v.Position = (i == 0) ? boundsMin : boundsMax;
+
+		Vertex unpacked = VertexPacking::Unpack(VertexPacking::Pack(v, quantization), quantization);
+		outside +=
+			fabsf(unpacked.Position.x - v.Position.x) > slack.x ||
+			fabsf(unpacked.Position.y - v.Position.y) > slack.y ||
+			fabsf(unpacked.Position.z - v.Position.z) > slack.z;
+	}
+	CHECK(outside == 0);
+
+	// A flat axis has no steps, and decodes to exactly the bounds
+	VertexPacking::Quantization flat = VertexPacking::GetQuantization(XMFLOAT3(1, 2, 3), XMFLOAT3(5, 2, 9));
+	Vertex v = {};
+	v.Position = XMFLOAT3(4.0f, 2.0f, 6.0f);
+	Vertex unpacked = VertexPacking::Unpack(VertexPacking::Pack(v, flat), flat);
+	CHECK(unpacked.Position.y == 2.0f);
+	CHECK(VertexPacking::GetMaxPositionError(flat).y == 0.0f);
+}
+
+// Half floats keep 11 significant bits, so the relative error is at most 2^-11
+TEST(UVErrorStaysWithinHalfPrecision)
+{
+	VertexPacking::Quantization quantization = VertexPacking::GetQuantization(XMFLOAT3(0, 0, 0), XMFLOAT3(1, 1, 1));
+	std::mt19937 random(3);
+	std::uniform_real_distribution<float> tiled(-8.0f, 8.0f);
+	unsigned int outside = 0;
+	for (int i = 0; i < 100000; i++)
+	{
+		Vertex v = {};
+		v.UV = XMFLOAT2(tiled(random), tiled(random));
+		Vertex unpacked = VertexPacking::Unpack(VertexPacking::Pack(v, quantization), quantization);
+		outside +=
+			fabsf(unpacked.UV.x - v.UV.x) > fabsf(v.UV.x) / 2048.0f + 1e-7f ||
+			fabsf(unpacked.UV.y - v.UV.y) > fabsf(v.UV.y) / 2048.0f + 1e-7f;
+	}
+	CHECK(outside == 0);
+}
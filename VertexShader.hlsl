@@ -1,25 +1,25 @@
 #include "ShaderInclude.hlsli"
 
+// The world matrices are in ObjectData (see ShaderInclude.hlsli)
 cbuffer ExternalData : register(b0)
 {
-    matrix worldMatrix;
     matrix viewMatrix;
     matrix projMatrix;
-    matrix worldInvMatrix;
-    matrix lightView;
-    matrix lightProjection;
+#ifdef PACKED_VERTICES
+    float3 positionOffset;
+    float3 positionScale;
+#endif
 };
 
 
 
 // --------------------------------------------------------
-// The entry point (main method) for our vertex shader
+// Does the actual work of the vertex shader
 // 
 // - Input is exactly one vertex worth of data (defined by a struct)
 // - Output is a single struct of data to pass down the pipeline
-// - Named "main" because that's the default the shader compiler looks for
 // --------------------------------------------------------
-VertexToPixel main( VertexShaderInput input )
+VertexToPixel TransformVertex( VertexShaderInput input )
 {
 	// Set up output struct
 	VertexToPixel output;
@@ -40,14 +40,29 @@ VertexToPixel main( VertexShaderInput input )
 	// - We don't need to alter it here, but we do need to send it to the pixel shader
     output.UV = input.UV;
     output.Normal = normalize(mul((float3x3) worldInvMatrix, input.Normal));
-    output.Tangent = normalize(mul((float3x3) worldMatrix, input.Tangent)); 
+    output.Tangent = float4(normalize(mul((float3x3) worldMatrix, input.Tangent.xyz)), input.Tangent.w);
     output.worldPosition = mul(worldMatrix, float4(input.Position, 1)).xyz;
-
-	// Shadow calc
-    matrix shadowWVP = mul(lightProjection, mul(lightView, worldMatrix));
-    output.shadowMapPos = mul(shadowWVP, float4(input.Position, 1.0f));
 	
 	// Whatever we return will make its way through the pipeline to the
 	// next programmable stage we're using (the pixel shader for now)
 	return output;
-}
\ No newline at end of file
+}
+
+// --------------------------------------------------------
+// The entry point (main method) for our vertex shader
+// 
+// - Named "main" because that's the default the shader compiler looks for
+// - VertexShaderPacked.hlsl compiles this file again with
+//   PACKED_VERTICES defined, for meshes using PackedVertex
+// --------------------------------------------------------
+#ifdef PACKED_VERTICES
+VertexToPixel main( VertexShaderInputPacked input )
+{
+	return TransformVertex(UnpackVertex(input, positionOffset, positionScale));
+}
+#else
+VertexToPixel main( VertexShaderInput input )
+{
+	return TransformVertex(input);
+}
+#endif
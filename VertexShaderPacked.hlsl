@@ -0,0 +1,3 @@
+// Same vertex shader, reading PackedVertex instead of Vertex
+#define PACKED_VERTICES
+#include "VertexShader.hlsl"